@@ -10,6 +10,7 @@
 #include "mrm/readers/MrmManagers.h"
 
 #include "MRM.h"
+#include "ResourceUriCache.h"
 
 #include <memory>
 
@@ -21,6 +22,7 @@ typedef struct
     UnifiedResourceView* unifiedView = nullptr;
     const PriFile* priFile = nullptr;
     ProviderResolver* resolver = nullptr;
+    ResourceUriCache* uriCache = nullptr;
 } MrmObjects;
 
 constexpr wchar_t ResourceUriPrefix[] = L"ms-resource://";
@@ -57,6 +59,56 @@ static HRESULT BlobResultReleaseOwnershipBuffer(
     return S_OK;
 }
 
+// Copies a candidate's string value for the caller, as UTF-16 into resourceString or,
+// when resourceStringUtf8 is given, as UTF-8.  Sets found to false if the candidate isn't a string;
+// other failures, such as a value that can't be converted, are returned.
+static HRESULT GetStringValueFromCandidate(
+    _In_ const ResourceCandidateResult& candidate,
+    _Outptr_opt_ PWSTR* resourceString,
+    _Outptr_opt_ PSTR* resourceStringUtf8,
+    _Out_ bool* found)
+{
+    *found = false;
+
+    if (resourceStringUtf8 != nullptr)
+    {
+        *resourceStringUtf8 = nullptr;
+
+        BlobResult utf8Result;
+        HRESULT hr = candidate.GetStringValueUtf8(&utf8Result);
+        if (hr == HRESULT_FROM_WIN32(ERROR_MRM_RESOURCE_TYPE_MISMATCH))
+        {
+            return S_OK;
+        }
+        RETURN_IF_FAILED(hr);
+
+        // This ensures the blob result holds a copy of the data we can return to the caller, not a pointer to the PRI file.
+        void* buffer;
+        UINT32 bufferSize;
+        RETURN_IF_FAILED(BlobResultReleaseOwnershipBuffer(utf8Result, &buffer, &bufferSize));
+        *resourceStringUtf8 = reinterpret_cast<PSTR>(buffer);
+        *found = true;
+    }
+    else
+    {
+        *resourceString = nullptr;
+
+        StringResult stringResult;
+        HRESULT hr = candidate.GetStringValue(&stringResult);
+        if (hr == HRESULT_FROM_WIN32(ERROR_MRM_RESOURCE_TYPE_MISMATCH))
+        {
+            return S_OK;
+        }
+        RETURN_IF_FAILED(hr);
+
+        // This ensures the string result holds a copy of the data we can return to the caller, not a pointer to the PRI file.
+        RETURN_IF_FAILED(StringResultReleaseOwnershipBuffer(stringResult, resourceString));
+        *found = true;
+    }
+
+    return S_OK;
+}
+
 static HRESULT GetQualifierInfoFromCandidateImpl(
     _In_ MrmObjects* resourceManager,
     _In_ const ResourceCandidateResult* candidate,
@@ -196,7 +248,15 @@ static HRESULT LoadResourceCandidate(
 
     NamedResourceResult namedResource;
 
-    if (index == INDEX_RESOURCE_URI)
+    const IResourceMapBase* cachedResourceMap;
+    int cachedItemIndex;
+    if ((index == INDEX_RESOURCE_URI) && (resourceManagerObjects->uriCache != nullptr) &&
+        resourceManagerObjects->uriCache->TryGet(
+            resourceIdOrUri, resourceManagerObjects->unifiedView->GetGeneration(), &cachedResourceMap, &cachedItemIndex))
+    {
+        RETURN_IF_FAILED(cachedResourceMap->GetResourceByIndex(cachedItemIndex, &namedResource));
+    }
+    else if (index == INDEX_RESOURCE_URI)
     {
         if ((wcslen(resourceIdOrUri) <= static_cast<size_t>(ResourceUriPrefixLength)) ||
             (CompareStringOrdinal(ResourceUriPrefix, ResourceUriPrefixLength, resourceIdOrUri, ResourceUriPrefixLength, TRUE) !=
@@ -254,6 +314,15 @@ static HRESULT LoadResourceCandidate(
         }
 
         RETURN_IF_FAILED(internalResourceMap->GetResource(relativeResourceId, &namedResource));
+
+        if (resourceManagerObjects->uriCache != nullptr)
+        {
+            resourceManagerObjects->uriCache->Add(
+                resourceIdOrUri,
+                resourceManagerObjects->unifiedView->GetGeneration(),
+                internalResourceMap,
+                namedResource.GetResourceIndexInSchema());
+        }
     }
     else
     {
@@ -328,19 +397,15 @@ static HRESULT LoadStringResource(
     _In_opt_ void* resourceMap,
     int index,
     _In_opt_ PCWSTR resourceIdOrUri,
-    _Outptr_ PWSTR* resourceString)
+    _Outptr_opt_ PWSTR* resourceString,
+    _Outptr_opt_ PSTR* resourceStringUtf8)
 {
     ResourceCandidateResult candidate;
     RETURN_IF_FAILED(LoadResourceCandidate(resourceManager, resourceContext, resourceMap, index, resourceIdOrUri, &candidate, nullptr, nullptr, nullptr, nullptr));
 
-    StringResult stringResult;
-    if (!candidate.TryGetStringValue(&stringResult))
-    {
-        return HRESULT_FROM_WIN32(ERROR_MRM_RESOURCE_TYPE_MISMATCH);
-    }
-
-    // This ensures the string result holds a copy of the data we can return to the caller, not a pointer to the PRI file.
-    RETURN_IF_FAILED(StringResultReleaseOwnershipBuffer(stringResult, resourceString));
+    bool found;
+    RETURN_IF_FAILED(GetStringValueFromCandidate(candidate, resourceString, resourceStringUtf8, &found));
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_RESOURCE_TYPE_MISMATCH), !found);
 
     return S_OK;
 }
@@ -378,7 +443,8 @@ static HRESULT LoadStringOrEmbeddedResource(
     int index,
     _In_opt_ PCWSTR resourceIdOrUri,
     _Out_ MrmType* resourceType,
-    _Outptr_result_maybenull_ PWSTR* resourceString,
+    _Outptr_opt_result_maybenull_ PWSTR* resourceString,
+    _Outptr_opt_result_maybenull_ PSTR* resourceStringUtf8,
     _Out_ MrmResourceData* data,
     _Outptr_opt_result_maybenull_ PWSTR* resourceName,
     _Out_opt_ UINT32* qualifierCount, 
@@ -417,19 +483,21 @@ static HRESULT LoadStringOrEmbeddedResource(
         // This ensures the blob result holds a copy of the data we can return to the caller, not a pointer to the PRI file.
         RETURN_IF_FAILED(BlobResultReleaseOwnershipBuffer(blobResult, &data->data, &data->size));
 
-        *resourceString = nullptr;
+        if (resourceStringUtf8 != nullptr)
+        {
+            *resourceStringUtf8 = nullptr;
+        }
+        else
+        {
+            *resourceString = nullptr;
+        }
         *resourceType = MrmType_Embedded;
     }
     else
     {
-        StringResult stringResult;
-        if (!candidate.TryGetStringValue(&stringResult))
-        {
-            return E_UNEXPECTED;
-        }
-
-        // This ensures the string result holds a copy of the data we can return to the caller, not a pointer to the PRI file.
-        RETURN_IF_FAILED(StringResultReleaseOwnershipBuffer(stringResult, resourceString));
+        bool found;
+        RETURN_IF_FAILED(GetStringValueFromCandidate(candidate, resourceString, resourceStringUtf8, &found));
+        RETURN_HR_IF(E_UNEXPECTED, !found);
 
         if (MrmEnvironment::IsStringResourceValueType(internalResourceType))
         {
@@ -475,6 +543,12 @@ static void DestroyResourceManager(_In_ void* resourceManager)
         resourceManagerObjects->resolver = nullptr;
     }
 
+    if (resourceManagerObjects->uriCache != nullptr)
+    {
+        delete resourceManagerObjects->uriCache;
+        resourceManagerObjects->uriCache = nullptr;
+    }
+
     delete resourceManagerObjects;
 
     return;
@@ -518,6 +592,8 @@ STDAPI MrmCreateResourceManager(_In_ PCWSTR priFileName, _Out_ MrmManagerHandle*
         primaryMap->GetDecisionInfo(),
         &resourceManagerObjects->resolver));
 
+    RETURN_IF_FAILED(ResourceUriCache::CreateInstance(&resourceManagerObjects->uriCache));
+
     *resourceManager = reinterpret_cast<MrmManagerHandle>(resourceManagerObjects.release());
     return S_OK;
 }
@@ -707,7 +783,18 @@ STDAPI MrmLoadStringResource(
     _In_ PCWSTR resourceId,
     _Outptr_ PWSTR* resourceString)
 {
-    RETURN_IF_FAILED(LoadStringResource(resourceManager, resourceContext, resourceMap, INDEX_RESOURCE_ID, resourceId, resourceString));
+    RETURN_IF_FAILED(LoadStringResource(resourceManager, resourceContext, resourceMap, INDEX_RESOURCE_ID, resourceId, resourceString, nullptr));
+    return S_OK;
+}
+
+STDAPI MrmLoadStringResourceUtf8(
+    _In_ MrmManagerHandle resourceManager,
+    _In_opt_ MrmContextHandle resourceContext,
+    _In_opt_ MrmMapHandle resourceMap,
+    _In_ PCWSTR resourceId,
+    _Outptr_ PSTR* resourceString)
+{
+    RETURN_IF_FAILED(LoadStringResource(resourceManager, resourceContext, resourceMap, INDEX_RESOURCE_ID, resourceId, nullptr, resourceString));
     return S_OK;
 }
 
@@ -717,7 +804,17 @@ STDAPI MrmLoadStringResourceFromResourceUri(
     _In_ PCWSTR resourceUri,
     _Outptr_ PWSTR* resourceString)
 {
-    RETURN_IF_FAILED(LoadStringResource(resourceManager, resourceContext, nullptr, INDEX_RESOURCE_URI, resourceUri, resourceString));
+    RETURN_IF_FAILED(LoadStringResource(resourceManager, resourceContext, nullptr, INDEX_RESOURCE_URI, resourceUri, resourceString, nullptr));
+    return S_OK;
+}
+
+STDAPI MrmLoadStringResourceFromResourceUriUtf8(
+    _In_ MrmManagerHandle resourceManager,
+    _In_opt_ MrmContextHandle resourceContext,
+    _In_ PCWSTR resourceUri,
+    _Outptr_ PSTR* resourceString)
+{
+    RETURN_IF_FAILED(LoadStringResource(resourceManager, resourceContext, nullptr, INDEX_RESOURCE_URI, resourceUri, nullptr, resourceString));
     return S_OK;
 }
 
@@ -752,7 +849,21 @@ STDAPI MrmLoadStringOrEmbeddedResource(
     _Out_ MrmResourceData* data)
 {
     RETURN_IF_FAILED(LoadStringOrEmbeddedResource(
-        resourceManager, resourceContext, resourceMap, INDEX_RESOURCE_ID, resourceId, resourceType, resourceString, data, nullptr, nullptr, nullptr, nullptr));
+        resourceManager, resourceContext, resourceMap, INDEX_RESOURCE_ID, resourceId, resourceType, resourceString, nullptr, data, nullptr, nullptr, nullptr, nullptr));
+    return S_OK;
+}
+
+STDAPI MrmLoadStringOrEmbeddedResourceUtf8(
+    _In_ MrmManagerHandle resourceManager,
+    _In_opt_ MrmContextHandle resourceContext,
+    _In_opt_ MrmMapHandle resourceMap,
+    _In_ PCWSTR resourceId,
+    _Out_ MrmType* resourceType,
+    _Outptr_result_maybenull_ PSTR* resourceString,
+    _Out_ MrmResourceData* data)
+{
+    RETURN_IF_FAILED(LoadStringOrEmbeddedResource(
+        resourceManager, resourceContext, resourceMap, INDEX_RESOURCE_ID, resourceId, resourceType, nullptr, resourceString, data, nullptr, nullptr, nullptr, nullptr));
     return S_OK;
 }
 
@@ -776,6 +887,7 @@ STDAPI MrmLoadStringOrEmbeddedResourceWithQualifierValues(
         resourceId, 
         resourceType, 
         resourceString, 
+        nullptr, 
         data, 
         nullptr, 
         qualifierCount, 
@@ -793,7 +905,20 @@ STDAPI MrmLoadStringOrEmbeddedFromResourceUri(
     _Out_ MrmResourceData* data)
 {
     RETURN_IF_FAILED(LoadStringOrEmbeddedResource(
-        resourceManager, resourceContext, nullptr, INDEX_RESOURCE_URI, resourceUri, resourceType, resourceString, data, nullptr, nullptr, nullptr, nullptr));
+        resourceManager, resourceContext, nullptr, INDEX_RESOURCE_URI, resourceUri, resourceType, resourceString, nullptr, data, nullptr, nullptr, nullptr, nullptr));
+    return S_OK;
+}
+
+STDAPI MrmLoadStringOrEmbeddedFromResourceUriUtf8(
+    _In_ MrmManagerHandle resourceManager,
+    _In_opt_ MrmContextHandle resourceContext,
+    _In_ PCWSTR resourceUri,
+    _Out_ MrmType* resourceType,
+    _Outptr_result_maybenull_ PSTR* resourceString,
+    _Out_ MrmResourceData* data)
+{
+    RETURN_IF_FAILED(LoadStringOrEmbeddedResource(
+        resourceManager, resourceContext, nullptr, INDEX_RESOURCE_URI, resourceUri, resourceType, nullptr, resourceString, data, nullptr, nullptr, nullptr, nullptr));
     return S_OK;
 }
 
@@ -808,7 +933,7 @@ STDAPI MrmLoadStringOrEmbeddedResourceByIndex(
     _Out_ MrmResourceData* data)
 {
     RETURN_IF_FAILED(LoadStringOrEmbeddedResource(
-        resourceManager, resourceContext, resourceMap, index, nullptr, resourceType, resourceString, data, resourceName, nullptr, nullptr, nullptr));
+        resourceManager, resourceContext, resourceMap, index, nullptr, resourceType, resourceString, nullptr, data, resourceName, nullptr, nullptr, nullptr));
     return S_OK;
 }
 
@@ -833,6 +958,7 @@ STDAPI MrmLoadStringOrEmbeddedResourceByIndexWithQualifierValues(
         nullptr, 
         resourceType, 
         resourceString, 
+        nullptr, 
         data, 
         resourceName, 
         qualifierCount, 
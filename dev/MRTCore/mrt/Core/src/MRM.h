@@ -58,6 +58,21 @@ extern "C"
         _In_ PCWSTR resourceUri,
         _Outptr_ PWSTR* resourceString);
 
+    // The Utf8 variants return nul-terminated UTF-8, freed with MrmFreeResource.  Strings stored
+    // as UTF-8 or ASCII are returned without conversion.
+    STDAPI MrmLoadStringResourceUtf8(
+        _In_ MrmManagerHandle resourceManager,
+        _In_opt_ MrmContextHandle resourceContext,
+        _In_opt_ MrmMapHandle resourceMap,
+        _In_ PCWSTR resourceId,
+        _Outptr_ PSTR* resourceString);
+
+    STDAPI MrmLoadStringResourceFromResourceUriUtf8(
+        _In_ MrmManagerHandle resourceManager,
+        _In_opt_ MrmContextHandle resourceContext,
+        _In_ PCWSTR resourceUri,
+        _Outptr_ PSTR* resourceString);
+
     STDAPI MrmLoadEmbeddedResource(
         _In_ MrmManagerHandle resourceManager,
         _In_opt_ MrmContextHandle resourceContext,
@@ -80,6 +95,15 @@ extern "C"
         _Outptr_result_maybenull_ PWSTR* resourceString,
         _Out_ MrmResourceData* data);
 
+    STDAPI MrmLoadStringOrEmbeddedResourceUtf8(
+        _In_ MrmManagerHandle resourceManager,
+        _In_opt_ MrmContextHandle resourceContext,
+        _In_opt_ MrmMapHandle resourceMap,
+        _In_ PCWSTR resourceId,
+        _Out_ MrmType* resourceType,
+        _Outptr_result_maybenull_ PSTR* resourceString,
+        _Out_ MrmResourceData* data);
+
     STDAPI MrmLoadStringOrEmbeddedResourceWithQualifierValues(
         _In_ MrmManagerHandle resourceManager,
         _In_opt_ MrmContextHandle resourceContext,
@@ -100,6 +124,14 @@ extern "C"
         _Outptr_result_maybenull_ PWSTR* resourceString,
         _Out_ MrmResourceData* data);
 
+    STDAPI MrmLoadStringOrEmbeddedFromResourceUriUtf8(
+        _In_ MrmManagerHandle resourceManager,
+        _In_opt_ MrmContextHandle resourceContext,
+        _In_ PCWSTR resourceUri,
+        _Out_ MrmType* resourceType,
+        _Outptr_result_maybenull_ PSTR* resourceString,
+        _Out_ MrmResourceData* data);
+
     STDAPI MrmLoadStringOrEmbeddedResourceByIndex(
         _In_ MrmManagerHandle resourceManager,
         _In_opt_ MrmContextHandle resourceContext,
@@ -0,0 +1,178 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+
+#include <Windows.h>
+
+#include "mrm/BaseInternal.h"
+
+#include <string.h>
+#include <wchar.h>
+
+namespace Microsoft::Resources
+{
+class IResourceMapBase;
+}
+
+// Remembers which resource map and item an ms-resource URI resolved to, so
+// repeated lookups skip parsing the URI and walking the map's names.  The
+// cache is set-associative with a fixed size, and is flushed whenever the
+// unified view's generation changes.  Maps are stored but never dereferenced.
+class ResourceUriCache : public Microsoft::Resources::DefObject
+{
+public:
+    static const int NumSets = 256;
+    static const int NumWays = 4;
+    static const size_t MaxUriLength = 512;
+
+    static HRESULT CreateInstance(_Outptr_ ResourceUriCache** result)
+    {
+        *result = nullptr;
+
+        Microsoft::Resources::AutoDeletePtr<ResourceUriCache> pRtrn = new ResourceUriCache();
+        RETURN_IF_NULL_ALLOC(pRtrn);
+
+        *result = pRtrn.Detach();
+        return S_OK;
+    }
+
+    ~ResourceUriCache() { Flush(); }
+
+    bool TryGet(_In_ PCWSTR uri, _In_ UINT64 generation, _Out_ const Microsoft::Resources::IResourceMapBase** map, _Out_ int* itemIndex)
+    {
+        *map = nullptr;
+        *itemIndex = -1;
+
+        UINT32 hash = ComputeHash(uri);
+        const Entry* set = &m_entries[(hash % NumSets) * NumWays];
+
+        AcquireSRWLockShared(&m_lock);
+        bool found = false;
+        if (generation == m_generation)
+        {
+            for (int i = 0; i < NumWays; i++)
+            {
+                if ((set[i].uri != nullptr) && (set[i].hash == hash) && (wcscmp(set[i].uri, uri) == 0))
+                {
+                    *map = set[i].map;
+                    *itemIndex = set[i].itemIndex;
+                    found = true;
+                    break;
+                }
+            }
+        }
+        ReleaseSRWLockShared(&m_lock);
+
+        return found;
+    }
+
+    // Caching is best effort, so URIs that are too long or can't be copied
+    // are silently skipped.
+    void Add(_In_ PCWSTR uri, _In_ UINT64 generation, _In_ const Microsoft::Resources::IResourceMapBase* map, _In_ int itemIndex)
+    {
+        size_t length = wcslen(uri);
+        if (length > MaxUriLength)
+        {
+            return;
+        }
+
+        PWSTR copy = _DefArray_Alloc(WCHAR, length + 1);
+        if (copy == nullptr)
+        {
+            return;
+        }
+        memcpy(copy, uri, (length + 1) * sizeof(WCHAR));
+
+        UINT32 hash = ComputeHash(uri);
+        UINT32 setIndex = hash % NumSets;
+        Entry* set = &m_entries[setIndex * NumWays];
+
+        AcquireSRWLockExclusive(&m_lock);
+        if (generation != m_generation)
+        {
+            Flush();
+            m_generation = generation;
+        }
+
+        int victim = -1;
+        for (int i = 0; i < NumWays; i++)
+        {
+            if (set[i].uri == nullptr)
+            {
+                victim = ((victim < 0) ? i : victim);
+            }
+            else if ((set[i].hash == hash) && (wcscmp(set[i].uri, uri) == 0))
+            {
+                // Another thread got here first.
+                victim = -2;
+                break;
+            }
+        }
+
+        if (victim != -2)
+        {
+            if (victim < 0)
+            {
+                victim = m_nextVictim[setIndex];
+                m_nextVictim[setIndex] = static_cast<BYTE>((victim + 1) % NumWays);
+            }
+
+            if (set[victim].uri != nullptr)
+            {
+                Def_Free(set[victim].uri);
+            }
+            set[victim].hash = hash;
+            set[victim].uri = copy;
+            set[victim].map = map;
+            set[victim].itemIndex = itemIndex;
+            copy = nullptr;
+        }
+        ReleaseSRWLockExclusive(&m_lock);
+
+        if (copy != nullptr)
+        {
+            Def_Free(copy);
+        }
+    }
+
+    // Keys are compared exactly, so the hash doesn't need to fold case.
+    static UINT32 ComputeHash(_In_ PCWSTR uri)
+    {
+        UINT32 hash = 2166136261u;
+        for (PCWSTR next = uri; *next != L'\0'; next++)
+        {
+            hash = (hash ^ static_cast<UINT32>(*next)) * 16777619u;
+        }
+        return hash;
+    }
+
+private:
+    ResourceUriCache() : m_generation(0), m_entries{}, m_nextVictim{} { InitializeSRWLock(&m_lock); }
+
+    // Callers hold the lock exclusively, or own the cache outright.
+    void Flush()
+    {
+        for (Entry& entry : m_entries)
+        {
+            if (entry.uri != nullptr)
+            {
+                Def_Free(entry.uri);
+                entry.uri = nullptr;
+            }
+        }
+    }
+
+    struct Entry
+    {
+        UINT32 hash;
+        PWSTR uri;
+        const Microsoft::Resources::IResourceMapBase* map;
+        int itemIndex;
+    };
+
+    SRWLOCK m_lock;
+    UINT64 m_generation;
+    Entry m_entries[NumSets * NumWays];
+    BYTE m_nextVictim[NumSets];
+};
@@ -3,6 +3,10 @@
 
 #include <Windows.h>
 #include "..\src\MRM.h"
+#include "..\src\ResourceUriCache.h"
+
+#include <memory>
+#include <stdio.h>
 
 #include "CppUnitTest.h"
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -272,6 +276,65 @@ public:
         MrmDestroyResourceManager(resourceManager);
     }
 
+    TEST_METHOD(ReadResourceStringUtf8)
+    {
+        MrmManagerHandle resourceManager;
+        Assert::AreEqual(MrmCreateResourceManager(L".\\resources.pri", &resourceManager), S_OK);
+
+        char* resourceString;
+        Assert::AreEqual(MrmLoadStringResourceUtf8(resourceManager, nullptr, nullptr, L"resources/IDS_MANIFEST_MUSIC_APP_NAME", &resourceString), S_OK);
+        Assert::AreEqual(resourceString, "Groove Music");
+        MrmFreeResource(resourceString);
+
+        Assert::AreEqual(
+            MrmLoadStringResourceFromResourceUriUtf8(resourceManager, nullptr, L"ms-resource://Microsoft.ZuneMusic/resources/IDS_MANIFEST_MUSIC_APP_NAME", &resourceString),
+            S_OK);
+        Assert::AreEqual(resourceString, "Groove Music");
+        MrmFreeResource(resourceString);
+
+        Assert::AreEqual(
+            MrmLoadStringResourceUtf8(resourceManager, nullptr, nullptr, L"Files/Controls/AlbumBasicInfoControl.xbf", &resourceString),
+            HRESULT_FROM_WIN32(ERROR_MRM_RESOURCE_TYPE_MISMATCH));
+
+        MrmDestroyResourceManager(resourceManager);
+    }
+
+    TEST_METHOD(ReadStringOrEmbeddedResourceUtf8)
+    {
+        MrmManagerHandle resourceManager;
+        Assert::AreEqual(MrmCreateResourceManager(L".\\resources.pri", &resourceManager), S_OK);
+
+        {
+            MrmType resourceType;
+            char* resourceString;
+            MrmResourceData resourceData {};
+
+            Assert::AreEqual(MrmLoadStringOrEmbeddedResourceUtf8(resourceManager, nullptr, nullptr, L"Files/Controls/AlbumBasicInfoControl.xbf", &resourceType, &resourceString, &resourceData), S_OK);
+
+            Assert::IsNull(resourceString);
+            Assert::IsTrue(resourceType == MrmType_Embedded);
+            Assert::AreEqual(resourceData.size, 15002u);
+
+            MrmFreeResource(resourceData.data);
+        }
+
+        {
+            MrmType resourceType;
+            char* resourceString;
+            MrmResourceData resourceData {};
+
+            Assert::AreEqual(MrmLoadStringOrEmbeddedFromResourceUriUtf8(resourceManager, nullptr, L"ms-resource:///resources/IDS_MANIFEST_MUSIC_APP_NAME", &resourceType, &resourceString, &resourceData), S_OK);
+
+            Assert::IsTrue(resourceType == MrmType_String);
+            Assert::IsNull(resourceData.data);
+            Assert::AreEqual(resourceString, "Groove Music");
+
+            MrmFreeResource(resourceString);
+        }
+
+        MrmDestroyResourceManager(resourceManager);
+    }
+
     TEST_METHOD(ReadStringOrEmbeddedResourceWithQualifierOverride)
     {
         MrmManagerHandle resourceManager;
@@ -560,6 +623,37 @@ public:
         }
     }
 
+    TEST_METHOD(RepeatedUriCalls)
+    {
+        MrmManagerHandle resourceManager;
+        Assert::AreEqual(MrmCreateResourceManager(L".\\resources.pri", &resourceManager), S_OK);
+
+        // The first call of each spelling resolves the URI and caches it, later calls hit the cache.  Spellings that
+        // differ only by case are cached separately and must still resolve to the same resource.
+        PCWSTR uris[] = { L"ms-resource://Microsoft.ZuneMusic/resources/IDS_MANIFEST_MUSIC_APP_NAME",
+                          L"ms-resource:///resources/IDS_MANIFEST_MUSIC_APP_NAME",
+                          L"ms-resource:///Resources/ids_manifest_music_app_name" };
+        for (unsigned int i = 0; i < 10; i++)
+        {
+            for (unsigned int j = 0; j < ARRAYSIZE(uris); j++)
+            {
+                wchar_t* resourceString;
+                Assert::AreEqual(MrmLoadStringResourceFromResourceUri(resourceManager, nullptr, uris[j], &resourceString), S_OK);
+                Assert::AreEqual(resourceString, L"Groove Music");
+
+                MrmFreeResource(resourceString);
+            }
+
+            // Failures are never cached, so a bad URI keeps failing the same way.
+            wchar_t* resourceString;
+            Assert::AreEqual(
+                MrmLoadStringResourceFromResourceUri(resourceManager, nullptr, L"ms-resource:///abc", &resourceString),
+                HRESULT_FROM_WIN32(ERROR_MRM_NAMED_RESOURCE_NOT_FOUND));
+        }
+
+        MrmDestroyResourceManager(resourceManager);
+    }
+
 private:
     void VerifyQualifierValue(UINT32 qualifierCount, PWSTR* qualifierNames, PWSTR* qualifierValues, PCWSTR name, PCWSTR expectedValue)
     {
@@ -577,4 +671,121 @@ private:
         Assert::IsTrue(found);
     }
 };
+
+TEST_CLASS(ResourceUriCacheTest)
+{
+public:
+    TEST_METHOD(HitsAndMisses)
+    {
+        Microsoft::Resources::AutoDeletePtr<ResourceUriCache> cache;
+        Assert::AreEqual(ResourceUriCache::CreateInstance(&cache), S_OK);
+        const Microsoft::Resources::IResourceMapBase* map = nullptr;
+        int itemIndex = 0;
+
+        Assert::IsFalse(cache->TryGet(L"ms-resource:///resources/a", 0, &map, &itemIndex));
+        Assert::IsNull(map);
+        Assert::AreEqual(itemIndex, -1);
+
+        cache->Add(L"ms-resource:///resources/a", 0, FakeMap(0), 1);
+        cache->Add(L"ms-resource:///resources/b", 0, FakeMap(1), 2);
+
+        Assert::IsTrue(cache->TryGet(L"ms-resource:///resources/a", 0, &map, &itemIndex));
+        Assert::IsTrue(map == FakeMap(0));
+        Assert::AreEqual(itemIndex, 1);
+
+        Assert::IsTrue(cache->TryGet(L"ms-resource:///resources/b", 0, &map, &itemIndex));
+        Assert::IsTrue(map == FakeMap(1));
+        Assert::AreEqual(itemIndex, 2);
+
+        // Keys are compared exactly.
+        Assert::IsFalse(cache->TryGet(L"ms-resource:///resources/A", 0, &map, &itemIndex));
+        Assert::IsFalse(cache->TryGet(L"ms-resource:///resources/ab", 0, &map, &itemIndex));
+
+        // Adding the same URI again keeps the entry that is already there.
+        cache->Add(L"ms-resource:///resources/a", 0, FakeMap(1), 5);
+        Assert::IsTrue(cache->TryGet(L"ms-resource:///resources/a", 0, &map, &itemIndex));
+        Assert::IsTrue(map == FakeMap(0));
+        Assert::AreEqual(itemIndex, 1);
+
+        // URIs that are too long are never cached.
+        std::unique_ptr<wchar_t[]> longUri(new wchar_t[ResourceUriCache::MaxUriLength + 2]);
+        wmemset(longUri.get(), L'x', ResourceUriCache::MaxUriLength + 1);
+        longUri[ResourceUriCache::MaxUriLength + 1] = L'\0';
+        cache->Add(longUri.get(), 0, FakeMap(0), 3);
+        Assert::IsFalse(cache->TryGet(longUri.get(), 0, &map, &itemIndex));
+    }
+
+    TEST_METHOD(GenerationChangeInvalidates)
+    {
+        Microsoft::Resources::AutoDeletePtr<ResourceUriCache> cache;
+        Assert::AreEqual(ResourceUriCache::CreateInstance(&cache), S_OK);
+        const Microsoft::Resources::IResourceMapBase* map = nullptr;
+        int itemIndex = 0;
+
+        cache->Add(L"ms-resource:///resources/a", 1, FakeMap(0), 1);
+        cache->Add(L"ms-resource:///resources/b", 1, FakeMap(0), 2);
+        Assert::IsTrue(cache->TryGet(L"ms-resource:///resources/a", 1, &map, &itemIndex));
+
+        // A reader that has seen a newer generation must not get entries from the old one.
+        Assert::IsFalse(cache->TryGet(L"ms-resource:///resources/a", 2, &map, &itemIndex));
+        Assert::IsNull(map);
+
+        // The first add for the new generation flushes everything from the old one.
+        cache->Add(L"ms-resource:///resources/a", 2, FakeMap(1), 7);
+        Assert::IsTrue(cache->TryGet(L"ms-resource:///resources/a", 2, &map, &itemIndex));
+        Assert::IsTrue(map == FakeMap(1));
+        Assert::AreEqual(itemIndex, 7);
+        Assert::IsFalse(cache->TryGet(L"ms-resource:///resources/b", 2, &map, &itemIndex));
+
+        // Stale readers miss too, rather than seeing entries from the new generation.
+        Assert::IsFalse(cache->TryGet(L"ms-resource:///resources/a", 1, &map, &itemIndex));
+    }
+
+    TEST_METHOD(FullSetEvictsOldest)
+    {
+        Microsoft::Resources::AutoDeletePtr<ResourceUriCache> cache;
+        Assert::AreEqual(ResourceUriCache::CreateInstance(&cache), S_OK);
+        const Microsoft::Resources::IResourceMapBase* map = nullptr;
+        int itemIndex = 0;
+
+        // Find enough URIs that land in the same set to overflow it.
+        wchar_t uris[ResourceUriCache::NumWays + 1][40];
+        UINT32 targetSet = 0;
+        unsigned int found = 0;
+        for (unsigned int i = 0; found < ARRAYSIZE(uris); i++)
+        {
+            wchar_t uri[40];
+            swprintf_s(uri, L"ms-resource:///resources/r%u", i);
+            UINT32 set = ResourceUriCache::ComputeHash(uri) % ResourceUriCache::NumSets;
+            if (found == 0)
+            {
+                targetSet = set;
+            }
+            if (set == targetSet)
+            {
+                wcscpy_s(uris[found++], uri);
+            }
+        }
+
+        for (unsigned int i = 0; i < ARRAYSIZE(uris); i++)
+        {
+            cache->Add(uris[i], 0, FakeMap(0), static_cast<int>(i));
+        }
+
+        Assert::IsFalse(cache->TryGet(uris[0], 0, &map, &itemIndex));
+        for (unsigned int i = 1; i < ARRAYSIZE(uris); i++)
+        {
+            Assert::IsTrue(cache->TryGet(uris[i], 0, &map, &itemIndex));
+            Assert::AreEqual(itemIndex, static_cast<int>(i));
+        }
+    }
+
+private:
+    // The cache never dereferences maps, so any distinct addresses will do.
+    static const Microsoft::Resources::IResourceMapBase* FakeMap(int index)
+    {
+        static int maps[2];
+        return reinterpret_cast<const Microsoft::Resources::IResourceMapBase*>(&maps[index]);
+    }
+};
 } // namespace UnitTest
@@ -161,6 +161,8 @@ class FileAtomPoolUnitTests : public WEX::TestClass<FileAtomPoolUnitTests>, publ
     BEGIN_TEST_METHOD(BigPoolBuilderReaderTests)
         TEST_METHOD_PROPERTY(L"DataSource", L"Table:AtomPool.UnitTests.xml#BigAtomPoolTests")
     END_TEST_METHOD()
+
+    TEST_METHOD(WriteableStringPoolTests);
 };
 
 void FileAtomPoolUnitTests::New_ParamChecks(void)
@@ -518,6 +520,104 @@ void FileAtomPoolUnitTests::BigPoolBuilderReaderTests(void)
     delete pBuilder;
 }
 
+// Returns the offset a scan of the pool finds for pString, the way the pool used to search.
+static int ScanStringPool(_In_ const WriteableStringPool* pPool, _In_ PCWSTR pString)
+{
+    DEFCOMPAREOPTIONS options = (pPool->GetIsCaseInsensitive() ? DefCompare_CaseInsensitive : DefCompare_Default);
+    PCWSTR pChars = pPool->GetBuffer();
+    for (int i = 1; i < static_cast<int>(pPool->GetNumCharsInPool()); i++)
+    {
+        if ((pString[0] == pChars[i]) && (DefString_CompareWithOptions(pString, &pChars[i], options) == Def_Equal))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void FileAtomPoolUnitTests::WriteableStringPoolTests(void)
+{
+    const int NumStrings = 100000;
+    String tmp;
+
+    for (int caseInsensitive = 0; caseInsensitive < 2; caseInsensitive++)
+    {
+        UINT32 flags = ((caseInsensitive != 0) ? WriteableStringPool::fCompareCaseInsensitive : WriteableStringPool::fCompareDefault);
+        AutoDeletePtr<WriteableStringPool> pPool;
+        VERIFY_SUCCEEDED(WriteableStringPool::CreateInstance(4, flags, &pPool));
+
+        Log::Comment(L"[ Suffixes of existing strings are shared ]");
+        VERIFY_ARE_EQUAL(0, pPool->GetOrAddStringOffset(nullptr));
+        VERIFY_ARE_EQUAL(0, pPool->GetOrAddStringOffset(L""));
+        VERIFY_ARE_EQUAL(1, pPool->GetOrAddStringOffset(L"Scale-200"));
+        VERIFY_ARE_EQUAL(7, pPool->GetOrAddStringOffset(L"200"));
+        VERIFY_ARE_EQUAL(7, pPool->GetStringOffset(L"200"));
+        VERIFY_ARE_EQUAL(11, pPool->GetOrAddStringOffset(L"LANGUAGE-200"));
+        VERIFY_ARE_EQUAL(2, pPool->GetOrAddStringOffset(L"cale-200"));
+        VERIFY_ARE_EQUAL(6, pPool->GetOrAddStringOffset(L"-200"));
+
+        // The first character must match exactly, even in a case-insensitive pool.
+        VERIFY_ARE_EQUAL(((caseInsensitive != 0) ? 4 : -1), pPool->GetStringOffset(L"lE-200"));
+        VERIFY_ARE_EQUAL(-1, pPool->GetStringOffset(L"Le-200"));
+
+        Log::Comment(L"[ Lookups find the same offsets as a scan of the pool ]");
+        for (int i = 0; i < 2000; i++)
+        {
+            PCWSTR pString = tmp.Format(((i % 3) == 0) ? L"item-%d" : L"ITEM-%d", i % 700);
+            int expected = ScanStringPool(pPool, pString);
+            VERIFY_ARE_EQUAL(expected, pPool->GetStringOffset(pString));
+
+            int numCharsBefore = static_cast<int>(pPool->GetNumCharsInPool());
+            VERIFY_ARE_EQUAL(((expected >= 0) ? expected : numCharsBefore), pPool->GetOrAddStringOffset(pString));
+        }
+
+        Log::Comment(L"[ Localized strings, and their suffixes, are found as a scan finds them ]");
+        static const PCWSTR localized[] = {
+            L"\x041f\x0440\x0438\x0432\x0435\x0442",
+            L"\x043f\x0440\x0438\x0432\x0435\x0442",
+            L"\x0440\x0418\x0412\x0415\x0422",
+            L"\x0435\x0442",
+            L"\x00e9t\x00e9",
+            L"\x00c9T\x00c9",
+            L"t\x00c9",
+            L"\x03b1\x03b2\x03b3",
+            L"\x0392\x0393",
+        };
+        for (unsigned int i = 0; i < ARRAYSIZE(localized); i++)
+        {
+            int expected = ScanStringPool(pPool, localized[i]);
+            VERIFY_ARE_EQUAL(expected, pPool->GetStringOffset(localized[i]));
+
+            int numCharsBefore = static_cast<int>(pPool->GetNumCharsInPool());
+            VERIFY_ARE_EQUAL(((expected >= 0) ? expected : numCharsBefore), pPool->GetOrAddStringOffset(localized[i]));
+        }
+
+        Log::Comment(L"[ Many distinct strings ]");
+        LARGE_INTEGER frequency;
+        LARGE_INTEGER start;
+        LARGE_INTEGER end;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&start);
+        for (int i = 0; i < NumStrings; i++)
+        {
+            VERIFY_IS_TRUE(pPool->GetOrAddStringOffset(tmp.Format(L"Resources/Strings/Item%d", i)) > 0);
+        }
+        QueryPerformanceCounter(&end);
+
+        Log::Comment(tmp.Format(
+            L"[ %d strings, %u chars in %.1f ms ]",
+            NumStrings,
+            pPool->GetNumCharsInPool(),
+            static_cast<double>(end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart));
+
+        for (int i = 0; i < NumStrings; i += 997)
+        {
+            PCWSTR pString = tmp.Format(L"Resources/Strings/Item%d", i);
+            VERIFY_ARE_EQUAL(ScanStringPool(pPool, pString), pPool->GetStringOffset(pString));
+        }
+    }
+}
+
 /*!
      * StaticAtomPool Unit Tests
      */
@@ -7,6 +7,7 @@
 #include "Helpers.h"
 
 #include "mrm/build/Base.h"
+#include "mrm/Compression.h"
 #include "mrm/readers/SectionReaders.h"
 #include "mrm/build/SectionBuilders.h"
 #include "TestSections.h"
@@ -33,6 +34,41 @@ class DataItemsSectionUnitTests : public WEX::TestClass<DataItemsSectionUnitTest
     BEGIN_TEST_METHOD(SimpleBuilderReaderTests)
         TEST_METHOD_PROPERTY(L"DataSource", L"Table:DataItemsSection.UnitTests.xml#SimpleTests")
     END_TEST_METHOD()
+
+    TEST_METHOD(HotItemLayoutTests);
+
+    TEST_METHOD(CompressionCodecTests);
+
+    TEST_METHOD(CompressedSectionTests);
+
+    TEST_METHOD(CompressedSectionRandomLookupTests);
+
+    TEST_METHOD(DecodedStringCacheTests);
+
+    TEST_METHOD(DataBlobBuilderTests);
+
+    TEST_METHOD(ParallelFileBuildTests);
+
+    TEST_METHOD(StreamingFileBuildTests);
+
+private:
+    static void AddTestSections(
+        _In_ FileBuilder* pFileBuilder,
+        _In_ int numSections,
+        _Out_writes_(numSections) AutoDeletePtr<DataItemsSectionBuilder>* pSections);
+
+    static int CountPagesTouched(
+        _In_ const FileDataItemsSection* pSection,
+        _In_ const BYTE* pBase,
+        _In_ int numItems,
+        _In_reads_(numItems) const UINT32* pItemIndices);
+
+    static void BuildLocalizedStringSection(
+        _In_ bool compressed,
+        _In_ int numStrings,
+        _Out_ unique_deffree_ptr<BYTE>* pBuffer,
+        _Out_ UINT32* pcbWritten,
+        _Outptr_ FileDataItemsSection** ppSection);
 };
 
 void DataItemsSectionUnitTests::New_ParamChecks(void)
@@ -127,4 +163,649 @@ void DataItemsSectionUnitTests::SimpleBuilderReaderTests(void)
     }
 }
 
+int DataItemsSectionUnitTests::CountPagesTouched(
+    _In_ const FileDataItemsSection* pSection,
+    _In_ const BYTE* pBase,
+    _In_ int numItems,
+    _In_reads_(numItems) const UINT32* pItemIndices)
+{
+    const size_t PageSize = 4096;
+    size_t pages[64];
+    int numPages = 0;
+
+    for (int i = 0; i < numItems; i++)
+    {
+        const BYTE* pData;
+        UINT32 cbData;
+        VERIFY_SUCCEEDED(pSection->GetItemDataRef(pItemIndices[i], &pData, &cbData));
+
+        for (size_t page = (pData - pBase) / PageSize; page <= (pData + cbData - 1 - pBase) / PageSize; page++)
+        {
+            bool found = false;
+            for (int j = 0; (j < numPages) && !found; j++)
+            {
+                found = (pages[j] == page);
+            }
+            if (!found && (numPages < static_cast<int>(ARRAYSIZE(pages))))
+            {
+                pages[numPages++] = page;
+            }
+        }
+    }
+    return numPages;
+}
+
+void DataItemsSectionUnitTests::HotItemLayoutTests(void)
+{
+    // 64 large items of 1KB each; every eighth one is used at startup.
+    const int NumItems = 64;
+    const int ItemSize = 1024;
+    UINT32 hotItems[NumItems / 8];
+    String tmp;
+
+    for (int layout = 0; layout < 2; layout++)
+    {
+        AutoDeletePtr<DataItemsSectionBuilder> pBuilder;
+        VERIFY_SUCCEEDED(DataItemsSectionBuilder::CreateInstance(&pBuilder));
+
+        BYTE item[ItemSize];
+        for (int i = 0; i < NumItems; i++)
+        {
+            memset(item, i + 1, sizeof(item));
+
+            DataItemsSectionBuilder::PrebuildItemReference prebuilt;
+            VERIFY_SUCCEEDED(pBuilder->AddDataItem(item, sizeof(item), BaseFile::Align64Bit, &prebuilt));
+
+            DataItemsSectionBuilder::BuiltItemReference built;
+            VERIFY_SUCCEEDED(pBuilder->GetBuiltItemInfo(&prebuilt, &built));
+            if ((i % 8) == 7)
+            {
+                // listed hottest first, in reverse index order
+                hotItems[(NumItems / 8) - 1 - (i / 8)] = built.itemIndex;
+            }
+        }
+
+        if (layout == 1)
+        {
+            VERIFY_SUCCEEDED(pBuilder->SetHotItems(ARRAYSIZE(hotItems), hotItems));
+        }
+        VERIFY_SUCCEEDED(pBuilder->Finalize());
+
+        UINT32 cbBuffer = pBuilder->GetMaxSizeInBytes();
+        unique_deffree_ptr<BYTE> buffer(_DefArray_AllocZeroed(BYTE, cbBuffer));
+        VERIFY_IS_NOT_NULL(buffer.get());
+
+        UINT32 cbWritten = 0;
+        VERIFY_SUCCEEDED(pBuilder->Build(buffer.get(), cbBuffer, &cbWritten));
+
+        AutoDeletePtr<FileDataItemsSection> pSection;
+        VERIFY_SUCCEEDED(FileDataItemsSection::CreateInstance(buffer.get(), cbWritten, &pSection));
+        VERIFY_ARE_EQUAL(NumItems, pSection->GetNumItems());
+
+        // Item indices and contents don't depend on the layout.
+        for (int i = 0; i < NumItems; i++)
+        {
+            const BYTE* pData;
+            UINT32 cbData;
+            VERIFY_SUCCEEDED(pSection->GetItemDataRef(i, &pData, &cbData));
+            VERIFY_ARE_EQUAL(static_cast<UINT32>(ItemSize), cbData);
+            VERIFY_ARE_EQUAL(static_cast<BYTE>(i + 1), pData[0]);
+            VERIFY_ARE_EQUAL(static_cast<BYTE>(i + 1), pData[ItemSize - 1]);
+        }
+
+        int pagesTouched = CountPagesTouched(pSection, buffer.get(), ARRAYSIZE(hotItems), hotItems);
+        Log::Comment(tmp.Format(L"[ %s layout: %d pages touched ]", ((layout == 0) ? L"default" : L"profiled"), pagesTouched));
+
+        // 8KB of hot data spans at most 3 pages when contiguous, and at least
+        // one page per item when spread across 64KB.
+        if (layout == 0)
+        {
+            VERIFY_IS_TRUE(pagesTouched >= 8);
+        }
+        else
+        {
+            VERIFY_IS_TRUE(pagesTouched <= 3);
+        }
+    }
+}
+
+void DataItemsSectionUnitTests::CompressionCodecTests(void)
+{
+    const UINT32 cbMax = 200000;
+    unique_deffree_ptr<BYTE> input(_DefArray_AllocZeroed(BYTE, cbMax));
+    unique_deffree_ptr<BYTE> compressed(_DefArray_AllocZeroed(BYTE, DefCompression::GetMaxCompressedSize(cbMax)));
+    unique_deffree_ptr<BYTE> output(_DefArray_AllocZeroed(BYTE, cbMax));
+    VERIFY_IS_NOT_NULL(input.get());
+    VERIFY_IS_NOT_NULL(compressed.get());
+    VERIFY_IS_NOT_NULL(output.get());
+
+    const UINT32 sizes[] = {0, 1, 4, 15, 16, 300, 4096, 70000, cbMax};
+    for (int pattern = 0; pattern < 3; pattern++)
+    {
+        // zeros (long matches), text-like repeats and pseudo-random bytes (nothing to match)
+        UINT32 seed = 12345;
+        for (UINT32 i = 0; i < cbMax; i++)
+        {
+            seed = (seed * 1103515245) + 12345;
+            input.get()[i] = ((pattern == 0) ? 0 : ((pattern == 1) ? static_cast<BYTE>("Resource string "[i % 16]) : static_cast<BYTE>(seed >> 16)));
+        }
+
+        for (size_t i = 0; i < ARRAYSIZE(sizes); i++)
+        {
+            UINT32 cbCompressed = 0;
+            VERIFY_SUCCEEDED(DefCompression::Compress(
+                input.get(), sizes[i], compressed.get(), DefCompression::GetMaxCompressedSize(sizes[i]), &cbCompressed));
+            VERIFY_IS_TRUE(cbCompressed <= DefCompression::GetMaxCompressedSize(sizes[i]));
+
+            VERIFY_SUCCEEDED(DefCompression::Decompress(compressed.get(), cbCompressed, output.get(), sizes[i]));
+            VERIFY_ARE_EQUAL(0, memcmp(input.get(), output.get(), sizes[i]));
+
+            if (sizes[i] > 0)
+            {
+                // Truncated data or the wrong size must fail rather than overrun
+                VERIFY_FAILED(DefCompression::Decompress(compressed.get(), cbCompressed - 1, output.get(), sizes[i]));
+                VERIFY_FAILED(DefCompression::Decompress(compressed.get(), cbCompressed, output.get(), sizes[i] - 1));
+            }
+        }
+    }
+
+    // A back-reference before the start of the output is corrupt
+    const BYTE badDistance[] = {0x10, 'a', 0x02, 0x00};
+    VERIFY_FAILED(DefCompression::Decompress(badDistance, sizeof(badDistance), output.get(), 5));
+
+    // Too little room for the compressed data
+    UINT32 cbCompressed = 0;
+    VERIFY_ARE_EQUAL(
+        HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER),
+        DefCompression::Compress(input.get(), cbMax, compressed.get(), cbMax / 2, &cbCompressed));
+}
+
+void DataItemsSectionUnitTests::BuildLocalizedStringSection(
+    _In_ bool compressed,
+    _In_ int numStrings,
+    _Out_ unique_deffree_ptr<BYTE>* pBuffer,
+    _Out_ UINT32* pcbWritten,
+    _Outptr_ FileDataItemsSection** ppSection)
+{
+    static PCWSTR const phrases[] = {L"Open the settings page for ",
+                                     L"Ouvrir la page des param\u00e8tres pour ",
+                                     L"Einstellungsseite \u00f6ffnen f\u00fcr ",
+                                     L"Abrir la p\u00e1gina de configuraci\u00f3n de "};
+
+    AutoDeletePtr<DataItemsSectionBuilder> pBuilder;
+    VERIFY_SUCCEEDED(DataItemsSectionBuilder::CreateInstance(&pBuilder));
+    pBuilder->SetCompressed(compressed);
+
+    String value;
+    for (int i = 0; i < numStrings; i++)
+    {
+        value.Format(L"%s item %d (%s)", phrases[i % ARRAYSIZE(phrases)], i, ((i % 3) == 0) ? L"Default" : L"Alternate");
+
+        DataItemsSectionBuilder::PrebuildItemReference prebuilt;
+        VERIFY_SUCCEEDED(pBuilder->AddDataString(value, &prebuilt));
+    }
+    VERIFY_SUCCEEDED(pBuilder->Finalize());
+    VERIFY_IS_TRUE(BaseFile::SectionTypesEqual(
+        pBuilder->GetSectionType(), (compressed ? FileDataItemsSection::GetCompressedSectionTypeId() : FileDataItemsSection::GetSectionTypeId())));
+
+    UINT32 cbBuffer = pBuilder->GetMaxSizeInBytes();
+    pBuffer->reset(_DefArray_AllocZeroed(BYTE, cbBuffer));
+    VERIFY_IS_NOT_NULL(pBuffer->get());
+
+    VERIFY_SUCCEEDED(pBuilder->Build(pBuffer->get(), cbBuffer, pcbWritten));
+    VERIFY_SUCCEEDED(FileDataItemsSection::CreateInstance(pBuilder->GetSectionType(), pBuffer->get(), *pcbWritten, ppSection));
+}
+
+void DataItemsSectionUnitTests::CompressedSectionTests(void)
+{
+    const int NumStrings = 2000;
+    String tmp;
+
+    unique_deffree_ptr<BYTE> plainBuffer;
+    unique_deffree_ptr<BYTE> compressedBuffer;
+    UINT32 cbPlain = 0;
+    UINT32 cbCompressed = 0;
+    AutoDeletePtr<FileDataItemsSection> pPlain;
+    AutoDeletePtr<FileDataItemsSection> pCompressed;
+
+    BuildLocalizedStringSection(false, NumStrings, &plainBuffer, &cbPlain, &pPlain);
+    BuildLocalizedStringSection(true, NumStrings, &compressedBuffer, &cbCompressed, &pCompressed);
+
+    Log::Comment(tmp.Format(L"[ %d strings: %u bytes uncompressed, %u bytes compressed ]", NumStrings, cbPlain, cbCompressed));
+    VERIFY_IS_FALSE(pPlain->IsCompressed());
+    VERIFY_IS_TRUE(pCompressed->IsCompressed());
+    VERIFY_IS_TRUE((cbCompressed * 2) < cbPlain);
+
+    // Compressed sections only hand out copies
+    const BYTE* pRef;
+    UINT32 cbRef;
+    VERIFY_ARE_EQUAL(HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED), pCompressed->GetItemDataRef(0, &pRef, &cbRef));
+
+    // Same items, in both directions so blocks get evicted from the cache and decompressed again
+    VERIFY_ARE_EQUAL(pPlain->GetNumItems(), pCompressed->GetNumItems());
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int n = 0; n < NumStrings; n++)
+        {
+            int i = ((pass == 0) ? n : (NumStrings - 1 - n));
+            BlobResult plain;
+            BlobResult unpacked;
+            VERIFY_SUCCEEDED(pPlain->GetItemDataRef(i, &plain));
+            VERIFY_SUCCEEDED(pCompressed->GetItemDataRef(i, &unpacked));
+
+            size_t cbPlainItem;
+            size_t cbUnpackedItem;
+            const void* pPlainItem = plain.GetRef(&cbPlainItem);
+            const void* pUnpackedItem = unpacked.GetRef(&cbUnpackedItem);
+            VERIFY_ARE_EQUAL(cbPlainItem, cbUnpackedItem);
+            VERIFY_ARE_EQUAL(0, memcmp(pPlainItem, pUnpackedItem, cbPlainItem));
+        }
+    }
+
+    BlobResult outOfRange;
+    VERIFY_ARE_EQUAL(HRESULT_FROM_WIN32(ERROR_RANGE_NOT_FOUND), pCompressed->GetItemDataRef(NumStrings, &outOfRange));
+
+    // Truncated compressed data
+    AutoDeletePtr<FileDataItemsSection> pTruncated;
+    VERIFY_FAILED(FileDataItemsSection::CreateInstance(
+        FileDataItemsSection::GetCompressedSectionTypeId(), compressedBuffer.get(), cbCompressed - 16, &pTruncated));
+
+    // Readers only accept data items section types
+    AutoDeletePtr<FileDataItemsSection> pWrongType;
+    VERIFY_FAILED(FileDataItemsSection::CreateInstance(gDataSectionType, plainBuffer.get(), cbPlain, &pWrongType));
+}
+
+void DataItemsSectionUnitTests::DecodedStringCacheTests(void)
+{
+    const int NumStrings = 100;
+    String tmp;
+
+    AutoDeletePtr<DataItemsSectionBuilder> pBuilder;
+    VERIFY_SUCCEEDED(DataItemsSectionBuilder::CreateInstance(&pBuilder));
+
+    // Stored as UTF-8, like strings that are smaller in UTF-8 than in UTF-16.
+    UINT32 itemIndices[NumStrings];
+    for (int i = 0; i < NumStrings; i++)
+    {
+        tmp.Format(L"Param\u00e8tres de l'\u00e9l\u00e9ment %d", i);
+        char utf8[MAX_PATH];
+        int cbUtf8 = WideCharToMultiByte(CP_UTF8, 0, tmp, -1, utf8, sizeof(utf8), nullptr, nullptr);
+        VERIFY_IS_TRUE(cbUtf8 > 0);
+
+        DataItemsSectionBuilder::PrebuildItemReference prebuilt;
+        VERIFY_SUCCEEDED(pBuilder->AddDataItem(utf8, cbUtf8, &prebuilt));
+
+        DataItemsSectionBuilder::BuiltItemReference built;
+        VERIFY_SUCCEEDED(pBuilder->GetBuiltItemInfo(&prebuilt, &built));
+        itemIndices[i] = built.itemIndex;
+    }
+    VERIFY_SUCCEEDED(pBuilder->Finalize());
+
+    UINT32 cbBuffer = pBuilder->GetMaxSizeInBytes();
+    unique_deffree_ptr<BYTE> buffer(_DefArray_AllocZeroed(BYTE, cbBuffer));
+    VERIFY_IS_NOT_NULL(buffer.get());
+    UINT32 cbWritten = 0;
+    VERIFY_SUCCEEDED(pBuilder->Build(buffer.get(), cbBuffer, &cbWritten));
+
+    Log::Comment(L"[ No cache by default: each lookup decodes a new copy ]");
+    AutoDeletePtr<FileDataItemsSection> pSection;
+    VERIFY_SUCCEEDED(FileDataItemsSection::CreateInstance(buffer.get(), cbWritten, &pSection));
+
+    DecodedStringCache::Stats stats;
+    VERIFY_IS_FALSE(pSection->TryGetDecodedStringCacheStats(&stats));
+
+    StringResult uncached;
+    VERIFY_SUCCEEDED(pSection->GetItemDataAsString(itemIndices[1], DEFSTRING_ENCODING_UTF8, &uncached));
+    VERIFY_ARE_EQUAL(DEFRESULTTYPE::DefResultType_Buffer, uncached.GetType());
+    VERIFY_ARE_EQUAL(0, wcscmp(uncached.GetRef(), L"Param\u00e8tres de l'\u00e9l\u00e9ment 1"));
+
+    Log::Comment(L"[ With the cache, repeated lookups return the same decoded copy ]");
+    VERIFY_SUCCEEDED(pSection->EnableDecodedStringCache(64 * 1024));
+    VERIFY_SUCCEEDED(pSection->EnableDecodedStringCache(16));
+
+    PCWSTR firstLookup[NumStrings];
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = 0; i < NumStrings; i++)
+        {
+            StringResult value;
+            VERIFY_SUCCEEDED(pSection->GetItemDataAsString(itemIndices[i], DEFSTRING_ENCODING_UTF8, &value));
+            VERIFY_ARE_EQUAL(DEFRESULTTYPE::DefResultType_Reference, value.GetType());
+            VERIFY_ARE_EQUAL(0, wcscmp(value.GetRef(), tmp.Format(L"Param\u00e8tres de l'\u00e9l\u00e9ment %d", i)));
+            if (pass == 0)
+            {
+                firstLookup[i] = value.GetRef();
+            }
+            else
+            {
+                VERIFY_ARE_EQUAL(firstLookup[i], value.GetRef());
+            }
+        }
+    }
+
+    VERIFY_IS_TRUE(pSection->TryGetDecodedStringCacheStats(&stats));
+    VERIFY_ARE_EQUAL(static_cast<UINT64>(64 * 1024), stats.cbBudget);
+    VERIFY_ARE_EQUAL(static_cast<UINT64>(NumStrings), stats.numHits);
+    VERIFY_ARE_EQUAL(static_cast<UINT64>(NumStrings), stats.numMisses);
+    VERIFY_ARE_EQUAL(static_cast<UINT32>(NumStrings), stats.numEntries);
+    Log::Comment(tmp.Format(L"[ %u strings cached in %I64u bytes ]", stats.numEntries, stats.cbUsed));
+
+    Log::Comment(L"[ The same item decoded as ASCII is cached separately ]");
+    StringResult ascii;
+    VERIFY_SUCCEEDED(pSection->GetItemDataAsString(itemIndices[1], DEFSTRING_ENCODING_ASCII, &ascii));
+    VERIFY_ARE_NOT_EQUAL(firstLookup[1], ascii.GetRef());
+    VERIFY_ARE_NOT_EQUAL(0, wcscmp(ascii.GetRef(), firstLookup[1]));
+
+    StringResult asciiAgain;
+    VERIFY_SUCCEEDED(pSection->GetItemDataAsString(itemIndices[1], DEFSTRING_ENCODING_ASCII, &asciiAgain));
+    VERIFY_ARE_EQUAL(ascii.GetRef(), asciiAgain.GetRef());
+
+    StringResult utf8Again;
+    VERIFY_SUCCEEDED(pSection->GetItemDataAsString(itemIndices[1], DEFSTRING_ENCODING_UTF8, &utf8Again));
+    VERIFY_ARE_EQUAL(firstLookup[1], utf8Again.GetRef());
+
+    VERIFY_IS_TRUE(pSection->TryGetDecodedStringCacheStats(&stats));
+    VERIFY_ARE_EQUAL(static_cast<UINT32>(NumStrings + 1), stats.numEntries);
+
+    Log::Comment(L"[ Once the budget is used up, strings are decoded but not cached ]");
+    AutoDeletePtr<FileDataItemsSection> pSmall;
+    VERIFY_SUCCEEDED(FileDataItemsSection::CreateInstance(buffer.get(), cbWritten, &pSmall));
+    VERIFY_SUCCEEDED(pSmall->EnableDecodedStringCache(256));
+
+    int numCached = 0;
+    for (int i = 0; i < NumStrings; i++)
+    {
+        StringResult value;
+        VERIFY_SUCCEEDED(pSmall->GetItemDataAsString(itemIndices[i], DEFSTRING_ENCODING_UTF8, &value));
+        VERIFY_ARE_EQUAL(0, wcscmp(value.GetRef(), tmp.Format(L"Param\u00e8tres de l'\u00e9l\u00e9ment %d", i)));
+        numCached += ((value.GetType() == DEFRESULTTYPE::DefResultType_Reference) ? 1 : 0);
+    }
+
+    VERIFY_IS_TRUE(pSmall->TryGetDecodedStringCacheStats(&stats));
+    VERIFY_IS_TRUE(stats.cbUsed <= stats.cbBudget);
+    VERIFY_IS_TRUE((numCached > 0) && (numCached < NumStrings));
+    VERIFY_ARE_EQUAL(static_cast<UINT32>(numCached), stats.numEntries);
+}
+
+void DataItemsSectionUnitTests::CompressedSectionRandomLookupTests(void)
+{
+    const int NumStrings = 2000;
+    const int NumLookups = 5000;
+
+    unique_deffree_ptr<BYTE> plainBuffer;
+    unique_deffree_ptr<BYTE> compressedBuffer;
+    UINT32 cbPlain = 0;
+    UINT32 cbCompressed = 0;
+    AutoDeletePtr<FileDataItemsSection> pPlain;
+    AutoDeletePtr<FileDataItemsSection> pCompressed;
+
+    BuildLocalizedStringSection(false, NumStrings, &plainBuffer, &cbPlain, &pPlain);
+    BuildLocalizedStringSection(true, NumStrings, &compressedBuffer, &cbCompressed, &pCompressed);
+
+    // Random lookups mostly miss the cached block, so most of them decompress a different block than the last.
+    UINT32 seed = 12345;
+    for (int n = 0; n < NumLookups; n++)
+    {
+        seed = (seed * 1103515245) + 12345;
+        int i = static_cast<int>((seed >> 8) % NumStrings);
+
+        BlobResult plain;
+        BlobResult unpacked;
+        VERIFY_SUCCEEDED(pPlain->GetItemDataRef(i, &plain));
+        VERIFY_SUCCEEDED(pCompressed->GetItemDataRef(i, &unpacked));
+
+        size_t cbPlainItem;
+        size_t cbUnpackedItem;
+        const void* pPlainItem = plain.GetRef(&cbPlainItem);
+        const void* pUnpackedItem = unpacked.GetRef(&cbUnpackedItem);
+        VERIFY_ARE_EQUAL(cbPlainItem, cbUnpackedItem);
+        VERIFY_ARE_EQUAL(0, memcmp(pPlainItem, pUnpackedItem, cbPlainItem));
+    }
+}
+
+void DataItemsSectionUnitTests::DataBlobBuilderTests(void)
+{
+    const int NumStrings = 50000;
+    String tmp;
+
+    AutoDeletePtr<DataBlobBuilder> pBuilder;
+    VERIFY_SUCCEEDED(DataBlobBuilder::CreateInstance(&pBuilder));
+
+    UINT32 offset = 0;
+    VERIFY_FAILED(pBuilder->AddData(nullptr, 4, &offset));
+    VERIFY_FAILED(pBuilder->AddData(reinterpret_cast<const BYTE*>(L"x"), 0, &offset));
+    VERIFY_ARE_EQUAL(0u, pBuilder->GetMaxSizeInBytesOfDataBlob());
+
+    Log::Comment(L"[ Enough items to need several segments ]");
+    unique_deffree_ptr<UINT32> offsets(_DefArray_AllocZeroed(UINT32, NumStrings));
+    VERIFY_IS_NOT_NULL(offsets.get());
+
+    UINT32 expectedOffset = 0;
+    for (int i = 0; i < NumStrings; i++)
+    {
+        PCWSTR pString = tmp.Format(L"Data blob item %d", i);
+        UINT32 cbString = static_cast<UINT32>((wcslen(pString) + 1) * sizeof(WCHAR));
+        VERIFY_SUCCEEDED(pBuilder->AddData(reinterpret_cast<const BYTE*>(pString), cbString, &offsets.get()[i]));
+        VERIFY_ARE_EQUAL(expectedOffset, offsets.get()[i]);
+        expectedOffset += _DEFFILE_PAD(cbString, 4);
+    }
+    VERIFY_ARE_EQUAL(expectedOffset, pBuilder->GetMaxSizeInBytesOfDataBlob());
+
+    for (int i = 0; i < NumStrings; i += 97)
+    {
+        PCWSTR pExpected = tmp.Format(L"Data blob item %d", i);
+        UINT32 cbString = static_cast<UINT32>((wcslen(pExpected) + 1) * sizeof(WCHAR));
+        const BYTE* pString = reinterpret_cast<const BYTE*>(pExpected);
+
+        VERIFY_IS_TRUE(pBuilder->TryFindData(pString, cbString, offsets.get()[i]));
+        VERIFY_IS_FALSE(pBuilder->TryFindData(pString, cbString, offsets.get()[(i + 1) % NumStrings]));
+
+        VERIFY_IS_TRUE(pBuilder->TryFindExistingData(pString, cbString, &offset));
+        VERIFY_ARE_EQUAL(offsets.get()[i], offset);
+
+        VERIFY_SUCCEEDED(pBuilder->GetOrAddData(pString, cbString, &offset));
+        VERIFY_ARE_EQUAL(offsets.get()[i], offset);
+
+        StringResult str;
+        VERIFY_IS_TRUE(pBuilder->TryGetStringData(offsets.get()[i], &str));
+        VERIFY_ARE_EQUAL(0, wcscmp(str.GetRef(), pExpected));
+
+        BlobResult blob;
+        VERIFY_IS_TRUE(pBuilder->TryGetBlobData(offsets.get()[i], cbString, &blob));
+        VERIFY_ARE_EQUAL(0, memcmp(blob.GetRef(nullptr), pString, cbString));
+    }
+
+    Log::Comment(L"[ Duplicates keep the first offset; new data is appended ]");
+    const BYTE* pDuplicate = reinterpret_cast<const BYTE*>(L"Data blob item 7");
+    const BYTE* pMissing = reinterpret_cast<const BYTE*>(L"not there");
+    VERIFY_IS_FALSE(pBuilder->TryFindExistingData(pMissing, sizeof(L"not there"), &offset));
+
+    VERIFY_SUCCEEDED(pBuilder->AddData(pDuplicate, sizeof(L"Data blob item 7"), &offset));
+    VERIFY_ARE_EQUAL(expectedOffset, offset);
+    VERIFY_IS_TRUE(pBuilder->TryFindExistingData(pDuplicate, sizeof(L"Data blob item 7"), &offset));
+    VERIFY_ARE_EQUAL(offsets.get()[7], offset);
+
+    VERIFY_SUCCEEDED(pBuilder->GetOrAddData(pMissing, sizeof(L"not there"), &offset));
+    VERIFY_ARE_EQUAL(expectedOffset + _DEFFILE_PAD(sizeof(L"Data blob item 7"), 4), offset);
+
+    BlobResult pastEnd;
+    VERIFY_IS_FALSE(pBuilder->TryGetBlobData(pBuilder->GetMaxSizeInBytesOfDataBlob(), 4, &pastEnd));
+
+    Log::Comment(L"[ The built blob holds every item at its offset, with zeroed padding ]");
+    UINT32 cbBlob = pBuilder->GetMaxSizeInBytesOfDataBlob();
+    unique_deffree_ptr<BYTE> blob(_DefArray_Alloc(BYTE, cbBlob));
+    VERIFY_IS_NOT_NULL(blob.get());
+    memset(blob.get(), 0xcc, cbBlob);
+
+    UINT32 cbWritten = 0;
+    VERIFY_FAILED(pBuilder->BuildDataBlob(blob.get(), cbBlob - 1, &cbWritten));
+    VERIFY_SUCCEEDED(pBuilder->BuildDataBlob(blob.get(), cbBlob, &cbWritten));
+    VERIFY_ARE_EQUAL(cbBlob, cbWritten);
+
+    for (int i = 0; i < NumStrings; i++)
+    {
+        PCWSTR pString = tmp.Format(L"Data blob item %d", i);
+        UINT32 cbString = static_cast<UINT32>((wcslen(pString) + 1) * sizeof(WCHAR));
+        VERIFY_ARE_EQUAL(0, memcmp(&blob.get()[offsets.get()[i]], pString, cbString));
+        for (UINT32 pad = cbString; pad < _DEFFILE_PAD(cbString, 4); pad++)
+        {
+            VERIFY_ARE_EQUAL(0, blob.get()[offsets.get()[i] + pad]);
+        }
+    }
+}
+
+void DataItemsSectionUnitTests::AddTestSections(
+    _In_ FileBuilder* pFileBuilder,
+    _In_ int numSections,
+    _Out_writes_(numSections) AutoDeletePtr<DataItemsSectionBuilder>* pSections)
+{
+    // Sections of different sizes with some repeated items, so each one
+    // writes less than its maximum size by a different amount.
+    BYTE item[300];
+    for (int s = 0; s < numSections; s++)
+    {
+        VERIFY_SUCCEEDED(DataItemsSectionBuilder::CreateInstance(&pSections[s]));
+        for (int i = 0; i < (s + 1) * 10; i++)
+        {
+            memset(item, (s * 31) + (i % 7), sizeof(item));
+
+            DataItemsSectionBuilder::PrebuildItemReference prebuilt;
+            VERIFY_SUCCEEDED(pSections[s]->AddDataItem(item, 1 + ((i * 13) % sizeof(item)), BaseFile::Align64Bit, &prebuilt));
+        }
+        VERIFY_SUCCEEDED(pFileBuilder->AddSection(pSections[s]));
+    }
+}
+
+void DataItemsSectionUnitTests::ParallelFileBuildTests(void)
+{
+    const int NumSections = 8;
+    unique_deffree_ptr<void> files[2];
+    UINT32 cbFiles[2] = {0, 0};
+
+    for (int parallel = 0; parallel < 2; parallel++)
+    {
+        AutoDeletePtr<DataItemsSectionBuilder> sections[NumSections];
+        AutoDeletePtr<DataSectionBuilder> pSerialSection;
+        AutoDeletePtr<FileBuilder> pFileBuilder;
+        VERIFY_SUCCEEDED(FileBuilder::CreateInstance(gUniversalPriFileMagic, 0, &pFileBuilder));
+        AddTestSections(pFileBuilder, NumSections, sections);
+
+        // One section that can't be built concurrently, so the calling thread
+        // builds it while the pool builds the rest.
+        const WCHAR serialData[] = L"Built on the calling thread";
+        UINT32 offset;
+        VERIFY_SUCCEEDED(DataSectionBuilder::CreateInstance(&pSerialSection));
+        VERIFY_SUCCEEDED(pSerialSection->AddData(reinterpret_cast<const BYTE*>(serialData), sizeof(serialData), &offset));
+        VERIFY_IS_FALSE(pSerialSection->CanBuildConcurrently());
+        VERIFY_IS_TRUE(sections[0]->CanBuildConcurrently());
+        VERIFY_SUCCEEDED(pFileBuilder->AddSection(pSerialSection));
+
+        BaseFile::SectionIndex hotSections[] = {7, 3};
+        FileBuilder::AccessProfile profile = {ARRAYSIZE(hotSections), hotSections, 0, nullptr};
+        VERIFY_SUCCEEDED(pFileBuilder->SetAccessProfile(&profile));
+
+        pFileBuilder->SetParallelBuild(parallel == 1);
+
+        void* pFile = nullptr;
+        VERIFY_SUCCEEDED(pFileBuilder->GenerateFileContents(&pFile, &cbFiles[parallel]));
+        files[parallel].reset(pFile);
+    }
+
+    VERIFY_ARE_EQUAL(cbFiles[0], cbFiles[1]);
+    VERIFY_ARE_EQUAL(0, memcmp(files[0].get(), files[1].get(), cbFiles[0]));
+
+    AutoDeletePtr<BaseFile> pFile;
+    VERIFY_SUCCEEDED(BaseFile::CreateInstance(0, static_cast<const BYTE*>(files[1].get()), cbFiles[1], &pFile));
+    VERIFY_ARE_EQUAL(NumSections + 1, static_cast<int>(pFile->GetNumSections()));
+
+    for (int s = 0; s < NumSections; s++)
+    {
+        const void* pData;
+        UINT32 cbData;
+        VERIFY_SUCCEEDED(pFile->GetSectionData(s, &pData, &cbData));
+
+        AutoDeletePtr<FileDataItemsSection> pSection;
+        VERIFY_SUCCEEDED(FileDataItemsSection::CreateInstance(pData, static_cast<int>(cbData), &pSection));
+        VERIFY_IS_TRUE(pSection->GetNumItems() > 0);
+    }
+}
+
+// Collects a streamed file and checks that it arrives in order.
+class TestFileSink : public IFileBuilderSink
+{
+public:
+    TestFileSink(_In_ BYTE* pBuffer, _In_ UINT32 cbBuffer) : m_pBuffer(pBuffer), m_cbBuffer(cbBuffer), m_cbEnd(0), m_cbLargestWrite(0) {}
+
+    virtual HRESULT Write(_In_ UINT32 offset, _In_reads_bytes_(cbData) const void* pData, _In_ UINT32 cbData)
+    {
+        VERIFY_IS_TRUE(cbData <= m_cbBuffer - offset);
+
+        // Only the final header and TOC go back to the start.
+        VERIFY_IS_TRUE((offset >= m_cbEnd) || (offset == 0));
+
+        memcpy(&m_pBuffer[offset], pData, cbData);
+        m_cbEnd = max(m_cbEnd, offset + cbData);
+        m_cbLargestWrite = max(m_cbLargestWrite, cbData);
+        return S_OK;
+    }
+
+    UINT32 GetEnd() const { return m_cbEnd; }
+
+    UINT32 GetLargestWrite() const { return m_cbLargestWrite; }
+
+private:
+    BYTE* m_pBuffer;
+    UINT32 m_cbBuffer;
+    UINT32 m_cbEnd;
+    UINT32 m_cbLargestWrite;
+};
+
+void DataItemsSectionUnitTests::StreamingFileBuildTests(void)
+{
+    const int NumSections = 8;
+    unique_deffree_ptr<void> expected;
+    UINT32 cbExpected = 0;
+    {
+        AutoDeletePtr<DataItemsSectionBuilder> sections[NumSections];
+        AutoDeletePtr<FileBuilder> pFileBuilder;
+        VERIFY_SUCCEEDED(FileBuilder::CreateInstance(gUniversalPriFileMagic, 0, &pFileBuilder));
+        AddTestSections(pFileBuilder, NumSections, sections);
+
+        void* pFile = nullptr;
+        VERIFY_SUCCEEDED(pFileBuilder->GenerateFileContents(&pFile, &cbExpected));
+        expected.reset(pFile);
+    }
+
+    AutoDeletePtr<DataItemsSectionBuilder> sections[NumSections];
+    AutoDeletePtr<FileBuilder> pFileBuilder;
+    VERIFY_SUCCEEDED(FileBuilder::CreateInstance(gUniversalPriFileMagic, 0, &pFileBuilder));
+    AddTestSections(pFileBuilder, NumSections, sections);
+
+    UINT32 cbLargestSection = 0;
+    for (int s = 0; s < NumSections; s++)
+    {
+        cbLargestSection = max(cbLargestSection, sections[s]->GetMaxSizeInBytes());
+    }
+
+    unique_deffree_ptr<BYTE> streamed(_DefArray_AllocZeroed(BYTE, cbExpected));
+    VERIFY_IS_NOT_NULL(streamed.get());
+
+    TestFileSink sink(streamed.get(), cbExpected);
+    UINT32 cbStreamed = 0;
+    VERIFY_SUCCEEDED(pFileBuilder->GenerateFileContents(&sink, &cbStreamed));
+
+    VERIFY_ARE_EQUAL(cbExpected, cbStreamed);
+    VERIFY_ARE_EQUAL(cbExpected, sink.GetEnd());
+    VERIFY_ARE_EQUAL(0, memcmp(expected.get(), streamed.get(), cbExpected));
+
+    // Nothing bigger than one section slot is ever handed over at once.
+    VERIFY_IS_TRUE(sink.GetLargestWrite() <= BaseFile::PadData(cbLargestSection) + BaseFile::GetSectionStructureOverhead());
+
+    // The builder doesn't keep the streamed data.
+    const BYTE* pSectionData;
+    UINT32 cbSectionData;
+    VERIFY_SUCCEEDED(pFileBuilder->GetSectionData(0, &pSectionData, &cbSectionData));
+    VERIFY_IS_NULL(pSectionData);
+}
+
 }; // namespace UnitTests
@@ -39,8 +39,38 @@ public:
         TEST_METHOD_PROPERTY(L"DataSource", L"Table:DefChecksum.UnitTests.xml#FileChecksumTests")
     END_TEST_METHOD()
     TEST_METHOD(FileChecksumFailsForMissingFile);
+    TEST_METHOD(FileChecksumMemoTests);
+    TEST_METHOD(Crc32MatchesReferenceTests);
+    TEST_METHOD(Crc32KnownVectorTests);
 };
 
+// Bit-at-a-time CRC-32 (ISO 3309) with the same conditioning as _DefComputeCrc32.
+static UINT32 ComputeReferenceCrc32(_In_ UINT32 partialCrc, _In_reads_bytes_(cbBuf) const BYTE* pBuf, _In_ size_t cbBuf)
+{
+    UINT32 crc = ~partialCrc;
+    for (size_t i = 0; i < cbBuf; i++)
+    {
+        crc ^= pBuf[i];
+        for (int k = 0; k < 8; k++)
+        {
+            crc = ((crc & 1) ? (0xedb88320 ^ (crc >> 1)) : (crc >> 1));
+        }
+    }
+    return ~crc;
+}
+
+static UINT32 ComputeReferenceStringCrc32(_In_ UINT32 partialCrc, _In_ bool isCaseInsensitive, _In_reads_(cchStr) PCWSTR pStr, _In_ UINT32 cchStr)
+{
+    UINT32 crc = partialCrc;
+    for (UINT32 i = 0; i < cchStr; i++)
+    {
+        WCHAR ch = (isCaseInsensitive ? towlower(pStr[i]) : pStr[i]);
+        BYTE bytes[2] = {static_cast<BYTE>(ch & 0xff), static_cast<BYTE>((ch >> 8) & 0xff)};
+        crc = ComputeReferenceCrc32(crc, bytes, sizeof(bytes));
+    }
+    return crc;
+}
+
 void DefChecksumUnitTests::IntegerChecksumTests(void)
 {
     DefChecksum::Checksum cs1;
@@ -356,4 +386,189 @@ void DefChecksumUnitTests::FileChecksumFailsForMissingFile(void)
     VERIFY_FAILED(DefChecksum::ComputeFileChecksum(0, L"missingfile.htm", &checksum));
 }
 
+static void OverwriteTestFile(_In_ PCWSTR pPath, _In_ const char* pContents, _In_opt_ const FILETIME* pLastWriteTime)
+{
+    HANDLE hFile = CreateFileW(pPath, GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    VERIFY_ARE_NOT_EQUAL(INVALID_HANDLE_VALUE, hFile);
+
+    DWORD cbWritten;
+    VERIFY_WIN32_BOOL_SUCCEEDED(WriteFile(hFile, pContents, static_cast<DWORD>(strlen(pContents)), &cbWritten, nullptr));
+    if (pLastWriteTime != nullptr)
+    {
+        VERIFY_WIN32_BOOL_SUCCEEDED(SetFileTime(hFile, pLastWriteTime, pLastWriteTime, pLastWriteTime));
+    }
+    CloseHandle(hFile);
+}
+
+// Sets all of the file's times, including the change time, which SetFileTime moves to now.
+static void BackdateTestFile(_In_ PCWSTR pPath, _In_ const FILETIME* pTime)
+{
+    HANDLE hFile = CreateFileW(pPath, FILE_WRITE_ATTRIBUTES, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    VERIFY_ARE_NOT_EQUAL(INVALID_HANDLE_VALUE, hFile);
+
+    FILE_BASIC_INFO info = {};
+    info.CreationTime.LowPart = pTime->dwLowDateTime;
+    info.CreationTime.HighPart = static_cast<LONG>(pTime->dwHighDateTime);
+    info.LastAccessTime = info.CreationTime;
+    info.LastWriteTime = info.CreationTime;
+    info.ChangeTime = info.CreationTime;
+    VERIFY_WIN32_BOOL_SUCCEEDED(SetFileInformationByHandle(hFile, FileBasicInfo, &info, sizeof(info)));
+    CloseHandle(hFile);
+}
+
+void DefChecksumUnitTests::FileChecksumMemoTests(void)
+{
+    WCHAR tempDir[MAX_PATH];
+    WCHAR tempFile[MAX_PATH];
+    VERIFY_ARE_NOT_EQUAL(0u, GetTempPathW(MAX_PATH, tempDir));
+    VERIFY_ARE_NOT_EQUAL(0u, GetTempFileNameW(tempDir, L"mrm", 0, tempFile));
+
+    // Old enough that the memo trusts the file's times
+    ULARGE_INTEGER time;
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    time.LowPart = now.dwLowDateTime;
+    time.HighPart = now.dwHighDateTime;
+    time.QuadPart -= 3600ULL * 10000000ULL;
+    FILETIME anHourAgo = {time.LowPart, time.HighPart};
+
+    DefChecksum::ClearFileChecksumMemo();
+    OverwriteTestFile(tempFile, "The quick brown fox", nullptr);
+    BackdateTestFile(tempFile, &anHourAgo);
+
+    DefChecksum::Checksum first;
+    DefChecksum::Checksum second;
+    VERIFY_SUCCEEDED(DefChecksum::ComputeFileChecksum(0, tempFile, &first));
+    VERIFY_SUCCEEDED(DefChecksum::ComputeFileChecksum(0, tempFile, &second));
+    VERIFY_ARE_EQUAL(first, second);
+    VERIFY_ARE_EQUAL(1u, DefChecksum::GetFileChecksumMemoHits());
+
+    // A different starting checksum is a different result
+    DefChecksum::Checksum seeded;
+    VERIFY_SUCCEEDED(DefChecksum::ComputeFileChecksum(1, tempFile, &seeded));
+    VERIFY_ARE_NOT_EQUAL(first, seeded);
+
+    // Same size, and the last write time put back, in place: the change time still moves.
+    OverwriteTestFile(tempFile, "The quick brown cat", &anHourAgo);
+    DefChecksum::Checksum afterSameTime;
+    DefChecksum::Checksum expected;
+    VERIFY_SUCCEEDED(DefChecksum::ComputeFileChecksum(0, tempFile, &afterSameTime));
+    VERIFY_ARE_NOT_EQUAL(first, afterSameTime);
+    DefChecksum::ClearFileChecksumMemo();
+    VERIFY_SUCCEEDED(DefChecksum::ComputeFileChecksum(0, tempFile, &expected));
+    VERIFY_ARE_EQUAL(expected, afterSameTime);
+
+    // Same size, written just now: never remembered, so always read.
+    OverwriteTestFile(tempFile, "The quick brown dog", nullptr);
+    DefChecksum::Checksum afterNewWrite;
+    VERIFY_SUCCEEDED(DefChecksum::ComputeFileChecksum(0, tempFile, &afterNewWrite));
+    VERIFY_ARE_NOT_EQUAL(afterSameTime, afterNewWrite);
+    OverwriteTestFile(tempFile, "The quick brown elk", nullptr);
+    VERIFY_SUCCEEDED(DefChecksum::ComputeFileChecksum(0, tempFile, &second));
+    VERIFY_ARE_NOT_EQUAL(afterNewWrite, second);
+    DefChecksum::ClearFileChecksumMemo();
+    VERIFY_SUCCEEDED(DefChecksum::ComputeFileChecksum(0, tempFile, &expected));
+    VERIFY_ARE_EQUAL(expected, second);
+
+    DefChecksum::ClearFileChecksumMemo();
+    DeleteFileW(tempFile);
+}
+
+void DefChecksumUnitTests::Crc32MatchesReferenceTests(void)
+{
+    const size_t cbData = 64 * 1024;
+    static BYTE data[cbData + 16];
+
+    UINT32 seed = 0x12345678;
+    for (size_t i = 0; i < cbData + 16; i++)
+    {
+        seed = (seed * 1103515245) + 12345;
+        data[i] = static_cast<BYTE>(seed >> 16);
+    }
+
+    // The standard check value
+    VERIFY_ARE_EQUAL(0xcbf43926u, _DefComputeCrc32(0, reinterpret_cast<const BYTE*>("123456789"), 9));
+
+    // Every length up to a few blocks, at every alignment, from a non-zero start
+    for (UINT32 cb = 0; cb <= 1024; cb++)
+    {
+        for (UINT32 offset = 0; offset < 16; offset++)
+        {
+            const BYTE* pBuf = data + offset;
+            UINT32 expected = ComputeReferenceCrc32(cb, pBuf, cb);
+            UINT32 actual = _DefComputeCrc32(cb, pBuf, cb);
+            if (expected != actual)
+            {
+                VERIFY_ARE_EQUAL(expected, actual, String().Format(L"length %u, offset %u", cb, offset));
+            }
+        }
+    }
+
+    // A large buffer, whole and in uneven pieces
+    UINT32 expected = ComputeReferenceCrc32(0, data, cbData);
+    VERIFY_ARE_EQUAL(expected, _DefComputeCrc32(0, data, static_cast<UINT32>(cbData)));
+
+    UINT32 crc = 0;
+    size_t cbDone = 0;
+    for (UINT32 cbPiece = 1; cbDone < cbData; cbPiece = ((cbPiece * 3) + 7) % 4099)
+    {
+        UINT32 cb = static_cast<UINT32>(((cbData - cbDone) < cbPiece) ? (cbData - cbDone) : cbPiece);
+        crc = _DefComputeCrc32(crc, data + cbDone, cb);
+        cbDone += cb;
+    }
+    VERIFY_ARE_EQUAL(expected, crc);
+
+    // Strings, with and without case folding
+    PCWSTR strings[] = {L"", L"a", L"MixedCase", L"Some/Resource/Path/With/Many/Segments/And/Then/Some/More/Of/Them/Too", L"\x00c4\x00d6\x00dc\x0130\x03a3"};
+    for (int i = 0; i < ARRAYSIZE(strings); i++)
+    {
+        UINT32 cch = static_cast<UINT32>(wcslen(strings[i]));
+        VERIFY_ARE_EQUAL(ComputeReferenceStringCrc32(7, false, strings[i], cch), _DefComputeStringCrc32(7, FALSE, strings[i], cch));
+        VERIFY_ARE_EQUAL(ComputeReferenceStringCrc32(7, true, strings[i], cch), _DefComputeStringCrc32(7, TRUE, strings[i], cch));
+    }
+
+    // A string longer than the case-folding buffer
+    const UINT32 cchLong = 1000;
+    static WCHAR longString[cchLong];
+    for (UINT32 i = 0; i < cchLong; i++)
+    {
+        longString[i] = static_cast<WCHAR>(L'A' + (data[i] % 58));
+    }
+    VERIFY_ARE_EQUAL(ComputeReferenceStringCrc32(0, true, longString, cchLong), _DefComputeStringCrc32(0, TRUE, longString, cchLong));
+}
+
+void DefChecksumUnitTests::Crc32KnownVectorTests(void)
+{
+    struct
+    {
+        const char* pData;
+        UINT32 crc;
+    } vectors[] = {
+        {"", 0x00000000},
+        {"a", 0xe8b7be43},
+        {"abc", 0x352441c2},
+        {"message digest", 0x20159d7f},
+        {"abcdefghijklmnopqrstuvwxyz", 0x4c2750bd},
+        {"The quick brown fox jumps over the lazy dog", 0x414fa339},
+    };
+
+    for (int i = 0; i < ARRAYSIZE(vectors); i++)
+    {
+        const BYTE* pData = reinterpret_cast<const BYTE*>(vectors[i].pData);
+        UINT32 cb = static_cast<UINT32>(strlen(vectors[i].pData));
+        VERIFY_ARE_EQUAL(vectors[i].crc, _DefComputeCrc32(0, pData, cb));
+
+        // Continuing a partial checksum gives the same result as one pass
+        UINT32 cbFirst = cb / 2;
+        VERIFY_ARE_EQUAL(vectors[i].crc, _DefComputeCrc32(_DefComputeCrc32(0, pData, cbFirst), pData + cbFirst, cb - cbFirst));
+    }
+
+    // Runs of a single byte value, longer than one block
+    BYTE zeros[32] = {};
+    BYTE ones[32];
+    memset(ones, 0xff, sizeof(ones));
+    VERIFY_ARE_EQUAL(0x190a55adu, _DefComputeCrc32(0, zeros, sizeof(zeros)));
+    VERIFY_ARE_EQUAL(0xff6cab0bu, _DefComputeCrc32(0, ones, sizeof(ones)));
+}
+
 }; // namespace UnitTests
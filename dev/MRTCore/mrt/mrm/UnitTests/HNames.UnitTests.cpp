@@ -37,6 +37,12 @@ class HierarchicalNamesUnitTests : public WEX::TestClass<HierarchicalNamesUnitTe
     BEGIN_TEST_METHOD(LargeBuilderReaderTests)
         TEST_METHOD_PROPERTY(L"DataSource", L"Table:HNames.UnitTests.xml#LargeBuilderReaderTests")
     END_TEST_METHOD()
+
+    TEST_METHOD(BulkAddTests);
+
+    TEST_METHOD(BulkAddLocalizedNameTests);
+
+    TEST_METHOD(DescendentWalkFallbackTests);
 };
 
 void CheckNames(_In_ const IHierarchicalNames* pNames)
@@ -506,6 +512,197 @@ void CheckItems(__in const IHierarchicalNames* pNames)
     }
 }
 
+void CheckDescendentItemNames(__in const HierarchicalNames* pNames)
+{
+    StringResult name;
+    PCWSTR pBatchName;
+    int batchItemIndex;
+
+    for (int scopeIndex = 0; scopeIndex < pNames->GetNumScopes(); scopeIndex++)
+    {
+        int numItems = 0;
+        VERIFY_SUCCEEDED(pNames->GetNumDescendents(scopeIndex, nullptr, &numItems));
+        if (numItems == 0)
+        {
+            continue;
+        }
+
+        int* pItems = new int[numItems];
+        int numWritten = 0;
+        VERIFY_SUCCEEDED(pNames->GetDescendents(scopeIndex, 0, nullptr, nullptr, numItems, pItems, &numWritten));
+        VERIFY_ARE_EQUAL(numItems, numWritten);
+
+        // Every batched name must match the individually built one.
+        AutoDeletePtr<HierarchicalNamesBatch> batch;
+        VERIFY_SUCCEEDED(HierarchicalNamesBatch::CreateInstance(&batch));
+        VERIFY_SUCCEEDED(pNames->GetDescendentItemNames(scopeIndex, 0, numItems, batch));
+        VERIFY_ARE_EQUAL(numItems, batch->GetNumNames());
+
+        for (int i = 0; i < numItems; i++)
+        {
+            VERIFY(batch->TryGetName(i, &pBatchName, &batchItemIndex));
+            VERIFY_ARE_EQUAL(pItems[i], batchItemIndex);
+            VERIFY(pNames->TryGetRelativeItemName(scopeIndex, pItems[i], &name));
+            VERIFY(DefString_Compare(name.GetRef(), pBatchName) == Def_Equal);
+        }
+        VERIFY(!batch->TryGetName(numItems, &pBatchName));
+
+        // A partial range starts at the requested descendent.
+        batch->Reset();
+        int first = numItems / 2;
+        VERIFY_SUCCEEDED(pNames->GetDescendentItemNames(scopeIndex, first, 2, batch));
+        VERIFY_ARE_EQUAL(min(2, numItems - first), batch->GetNumNames());
+        VERIFY(batch->TryGetName(0, &pBatchName, &batchItemIndex));
+        VERIFY_ARE_EQUAL(pItems[first], batchItemIndex);
+
+        delete[] pItems;
+    }
+
+    // Cached names must match uncached ones, including after eviction.
+    VERIFY_HRESULT_FAILURE(E_INVALIDARG, pNames->SetNameCacheSize(HierarchicalNames::MaxNameCacheSize + 1));
+    // Sizes that aren't a multiple of the set size are rounded up.
+    static const int cacheSizes[] = { 2, HierarchicalNames::NameCacheWays + 1, HierarchicalNames::MaxNameCacheSize };
+    for (unsigned int size = 0; size < ARRAYSIZE(cacheSizes); size++)
+    {
+        VERIFY_SUCCEEDED(pNames->SetNameCacheSize(cacheSizes[size]));
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (int i = 0; i < pNames->GetNumItems(); i++)
+            {
+                StringResult cached;
+                VERIFY(pNames->TryGetItemInfo(i, &cached));
+                VERIFY(pNames->GetItemNames()->TryGetString(i, &name));
+                VERIFY(DefString_Compare(name.GetRef(), cached.GetRef()) == Def_Equal);
+            }
+        }
+    }
+    VERIFY_SUCCEEDED(pNames->SetNameCacheSize(0));
+}
+
+// Depth-first walk of a scope using only the per-scope child lists, the way
+// descendents were enumerated before the cursor existed.
+void WalkDescendents(
+    __in const HierarchicalNames* pNames,
+    __in int scopeIndex,
+    __in int maxScopes,
+    __out_ecount(maxScopes) int* pScopes,
+    __inout int* pNumScopes,
+    __in int maxItems,
+    __out_ecount(maxItems) int* pItems,
+    __inout int* pNumItems)
+{
+    StringResult name;
+    int numChildren = 0;
+    VERIFY(pNames->TryGetScopeInfo(scopeIndex, &name, &numChildren));
+
+    for (int i = 0; i < numChildren; i++)
+    {
+        int childScope = -1;
+        int childItem = -1;
+        VERIFY(pNames->TryGetScopeChild(scopeIndex, i, &childScope, &childItem));
+
+        if (childScope >= 0)
+        {
+            VERIFY(*pNumScopes < maxScopes);
+            pScopes[(*pNumScopes)++] = childScope;
+            WalkDescendents(pNames, childScope, maxScopes, pScopes, pNumScopes, maxItems, pItems, pNumItems);
+        }
+        else
+        {
+            VERIFY(*pNumItems < maxItems);
+            pItems[(*pNumItems)++] = childItem;
+        }
+    }
+}
+
+void CheckDescendentsAgainstWalk(__in const HierarchicalNames* pNames, __in int scopeIndex, __in int numScopes, __in int numItems)
+{
+    int* pWantScopes = new int[pNames->GetNumScopes() + 1];
+    int* pWantItems = new int[pNames->GetNumItems() + 1];
+    int numWantScopes = 0;
+    int numWantItems = 0;
+    WalkDescendents(
+        pNames, scopeIndex, pNames->GetNumScopes(), pWantScopes, &numWantScopes, pNames->GetNumItems(), pWantItems, &numWantItems);
+
+    VERIFY_ARE_EQUAL(numWantScopes, numScopes);
+    VERIFY_ARE_EQUAL(numWantItems, numItems);
+
+    int* pScopes = new int[numScopes + 1];
+    int* pItems = new int[numItems + 1];
+    int numScopesWritten = 0;
+    int numItemsWritten = 0;
+    VERIFY_SUCCEEDED(pNames->GetDescendents(scopeIndex, numScopes, pScopes, &numScopesWritten, numItems, pItems, &numItemsWritten));
+    VERIFY_ARE_EQUAL(numWantScopes, numScopesWritten);
+    VERIFY_ARE_EQUAL(numWantItems, numItemsWritten);
+
+    for (int i = 0; i < numScopesWritten; i++)
+    {
+        VERIFY_ARE_EQUAL(pWantScopes[i], pScopes[i]);
+    }
+
+    for (int i = 0; i < numItemsWritten; i++)
+    {
+        VERIFY_ARE_EQUAL(pWantItems[i], pItems[i]);
+    }
+
+    delete[] pScopes;
+    delete[] pItems;
+    delete[] pWantScopes;
+    delete[] pWantItems;
+}
+
+void CheckDescendentCursor(__in const HierarchicalNames* pNames)
+{
+    for (int scopeIndex = 0; scopeIndex < pNames->GetNumScopes(); scopeIndex++)
+    {
+        int numScopes = 0;
+        int numItems = 0;
+        VERIFY_SUCCEEDED(pNames->GetNumDescendents(scopeIndex, &numScopes, &numItems));
+
+        // Stored counts, if any, must agree with the walked ones.
+        int numStoredItems = -1;
+        VERIFY_SUCCEEDED(pNames->GetNumDescendents(scopeIndex, nullptr, &numStoredItems));
+        VERIFY_ARE_EQUAL(numItems, numStoredItems);
+
+        // Counts and order must match a walk of the child lists.
+        CheckDescendentsAgainstWalk(pNames, scopeIndex, numScopes, numItems);
+
+        int* pScopes = new int[numScopes + 1];
+        int* pItems = new int[numItems + 1];
+        int numScopesWritten = 0;
+        int numItemsWritten = 0;
+        WalkDescendents(pNames, scopeIndex, numScopes, pScopes, &numScopesWritten, numItems, pItems, &numItemsWritten);
+
+        // The cursor visits descendents in the same order.
+        HierarchicalNamesCursor cursor;
+        VERIFY_SUCCEEDED(pNames->InitDescendentCursor(scopeIndex, &cursor));
+
+        int nextScope = 0;
+        int nextItem = 0;
+        int descendentScope;
+        int descendentItem;
+        while (pNames->TryGetNextDescendent(&cursor, &descendentScope, &descendentItem))
+        {
+            if (descendentScope >= 0)
+            {
+                VERIFY(nextScope < numScopesWritten);
+                VERIFY_ARE_EQUAL(pScopes[nextScope++], descendentScope);
+            }
+            else
+            {
+                VERIFY(nextItem < numItemsWritten);
+                VERIFY_ARE_EQUAL(pItems[nextItem++], descendentItem);
+            }
+        }
+        VERIFY_SUCCEEDED(cursor.status);
+        VERIFY_ARE_EQUAL(numScopesWritten, nextScope);
+        VERIFY_ARE_EQUAL(numItemsWritten, nextItem);
+
+        delete[] pScopes;
+        delete[] pItems;
+    }
+}
+
 void HierarchicalNamesUnitTests::New_ParamChecks(void)
 {
     BYTE buf[1000];
@@ -544,6 +741,39 @@ void HierarchicalNamesUnitTests::New_ParamChecks(void)
     delete pPool;
 }
 
+// Checksums streamed from the name data must match checksums of the built names.
+void CheckNameChecksums(__in const HierarchicalNames* pNames)
+{
+    StringResult name;
+    for (int nodeIndex = 0; nodeIndex < pNames->GetNumNames(); nodeIndex++)
+    {
+        DEF_CHECKSUM expected = 0;
+        DEF_CHECKSUM streamed = 0;
+        VERIFY(pNames->TryGetName(nodeIndex, &name));
+        VERIFY_SUCCEEDED(DefChecksum::ComputeStringChecksum(7, true, name.GetRef(), &expected));
+        VERIFY(pNames->TryComputeNameChecksum(nodeIndex, 7, &streamed));
+        VERIFY_ARE_EQUAL(expected, streamed);
+    }
+
+    const IAtomPool* pools[] = {pNames->GetScopeNames(), pNames->GetItemNames()};
+    for (size_t i = 0; i < ARRAYSIZE(pools); i++)
+    {
+        DEF_CHECKSUM expected;
+        VERIFY_SUCCEEDED(DefChecksum::ComputeStringChecksum(0, true, pools[i]->GetDescription(), &expected));
+        expected = DefChecksum::ComputeUInt32Checksum(expected, 1);
+        expected = DefChecksum::ComputeUInt32Checksum(expected, pools[i]->GetNumAtoms());
+        for (int atom = 0; atom < pools[i]->GetNumAtoms(); atom++)
+        {
+            VERIFY(pools[i]->TryGetString(atom, &name));
+            VERIFY_SUCCEEDED(DefChecksum::ComputeStringChecksum(expected, true, name.GetRef(), &expected));
+        }
+
+        DEF_CHECKSUM checksum = 0;
+        VERIFY_SUCCEEDED(DefChecksum::ComputeAtomPoolChecksum(0, pools[i], &checksum));
+        VERIFY_ARE_EQUAL(expected, checksum);
+    }
+}
+
 static void SimpleBuilderReaderTestsInternal(_In_ UINT32 flags, _In_ const DEFFILE_SECTION_TYPEID& type)
 {
     HRESULT hr;
@@ -610,6 +840,9 @@ static void SimpleBuilderReaderTestsInternal(_In_ UINT32 flags, _In_ const DEFFI
     CheckScopes(pReader);
     CheckScopeChildren(pReader);
     CheckItems(pReader);
+    CheckDescendentItemNames(pReader);
+    CheckDescendentCursor(pReader);
+    CheckNameChecksums(pReader);
 
     delete pReader;
     delete pBuilder;
@@ -623,8 +856,9 @@ void HierarchicalNamesUnitTests::SimpleBuilderReaderTests(void)
 
 void HierarchicalNamesUnitTests::SimpleBuilderReaderExTests(void)
 {
-    Log::Comment(L"[ Building ASCII/UTF-16 with new HNames format ]");
-    SimpleBuilderReaderTestsInternal(HierarchicalNamesBuilder::BuildAsciiOrUtf16, gHierarchicalNamesExSectionType);
+    Log::Comment(L"[ Building ASCII/UTF-16 with new HNames format and descendent counts ]");
+    SimpleBuilderReaderTestsInternal(
+        HierarchicalNamesBuilder::BuildAsciiOrUtf16 | HierarchicalNamesBuilder::BuildDescendentItemCounts, gHierarchicalNamesExSectionType);
 }
 
 void HierarchicalNamesUnitTests::LargeBuilderReaderTests(void)
@@ -795,4 +1029,207 @@ void HierarchicalNamesUnitTests::LargeBuilderReaderTests(void)
     }
 }
 
+// Formats a name spread over a few levels of scopes, with some names differing only in case.
+static PCWSTR FormatBulkTestName(_Inout_ String& name, _In_ int i)
+{
+    return name.Format(L"Scope%d/%s%d/Item%d", (i * 7) % 13, (((i % 3) == 0) ? L"sub" : L"Sub"), (i / 13) % 97, i);
+}
+
+static void AddBulkTestNames(_In_ HierarchicalNamesBuilder* pBuilder, _In_ int numNames, _In_ bool bulk)
+{
+    String name;
+
+    if (bulk)
+    {
+        VERIFY_SUCCEEDED(pBuilder->BeginBulkAdd());
+    }
+
+    // Add in a scrambled order, with repeats, so children don't arrive sorted.
+    UINT32 seed = 12345;
+    for (int n = 0; n < numNames; n++)
+    {
+        seed = (seed * 1103515245) + 12345;
+        int i = ((n == 0) ? 0 : static_cast<int>((seed >> 8) % numNames));
+        PCWSTR pName = FormatBulkTestName(name, i);
+
+        ItemInfo* pItem;
+        VERIFY_SUCCEEDED(pBuilder->GetOrAddItem(pName, &pItem));
+
+        int itemIndex = -1;
+        VERIFY_IS_TRUE(pBuilder->Contains(pName, nullptr, &itemIndex));
+        VERIFY_ARE_EQUAL(pItem->GetIndex(), itemIndex);
+    }
+}
+
+void HierarchicalNamesUnitTests::BulkAddTests(void)
+{
+    const int NumNames = 20000;
+    String tmp;
+
+    AutoDeletePtr<HierarchicalNamesBuilder> pIncremental;
+    VERIFY_SUCCEEDED(HierarchicalNamesBuilder::CreateInstance(HierarchicalNamesBuilder::BuildAsciiOrUtf16, &pIncremental));
+    AddBulkTestNames(pIncremental, NumNames, false);
+
+    AutoDeletePtr<HierarchicalNamesBuilder> pBulk;
+    VERIFY_SUCCEEDED(HierarchicalNamesBuilder::CreateInstance(HierarchicalNamesBuilder::BuildAsciiOrUtf16, &pBulk));
+    AddBulkTestNames(pBulk, NumNames, true);
+    VERIFY_IS_TRUE(pBulk->IsBulkAdding());
+
+    Log::Comment(L"[ Lookups and duplicates behave the same during a bulk add ]");
+    ItemInfo* pItem;
+    ScopeInfo* pScope;
+    int numItems = pBulk->GetNumItems();
+    VERIFY_SUCCEEDED(pBulk->GetOrAddItem(L"SCOPE0/SUB0/ITEM0", &pItem));
+    VERIFY_ARE_EQUAL(0, DefString_Compare(pItem->GetName(), L"Item0"));
+    VERIFY_ARE_EQUAL(numItems, pBulk->GetNumItems());
+    VERIFY_FAILED(pBulk->GetOrAddScope(L"Scope0/sub0/Item0", &pScope));
+    VERIFY_IS_FALSE(pBulk->Contains(L"Scope0/sub0/Item1"));
+
+    VERIFY_SUCCEEDED(pBulk->EndBulkAdd());
+    VERIFY_IS_FALSE(pBulk->IsBulkAdding());
+
+    Log::Comment(L"[ The built sections are identical ]");
+    BuildHelper incremental;
+    BuildHelper bulk;
+    VERIFY_SUCCEEDED(incremental.Build(pIncremental));
+    VERIFY_SUCCEEDED(bulk.Build(pBulk));
+    VERIFY_ARE_EQUAL(incremental.GetWrittenSize(), bulk.GetWrittenSize());
+    VERIFY_ARE_EQUAL(0, memcmp(incremental.GetBuffer(), bulk.GetBuffer(), incremental.GetWrittenSize()));
+
+    Log::Comment(L"[ Finalize ends a bulk add ]");
+    AutoDeletePtr<HierarchicalNamesBuilder> pUnended;
+    VERIFY_SUCCEEDED(HierarchicalNamesBuilder::CreateInstance(HierarchicalNamesBuilder::BuildAsciiOrUtf16, &pUnended));
+    AddBulkTestNames(pUnended, NumNames, true);
+
+    BuildHelper unended;
+    VERIFY_SUCCEEDED(unended.Build(pUnended));
+    VERIFY_IS_FALSE(pUnended->IsBulkAdding());
+    VERIFY_ARE_EQUAL(incremental.GetWrittenSize(), unended.GetWrittenSize());
+    VERIFY_ARE_EQUAL(0, memcmp(incremental.GetBuffer(), unended.GetBuffer(), incremental.GetWrittenSize()));
+}
+
+void HierarchicalNamesUnitTests::BulkAddLocalizedNameTests(void)
+{
+    // Cyrillic, Greek and accented names, each paired with a case variant that must resolve to the same item.
+    static const PCWSTR names[] = {
+        L"\x0420\x0435\x0441\x0443\x0440\x0441\x044b/\x0421\x0442\x0440\x043e\x043a\x0430",
+        L"\x0420\x0435\x0441\x0443\x0440\x0441\x044b/\x0417\x0430\x0433\x043e\x043b\x043e\x0432\x043e\x043a",
+        L"\x03c0\x03cc\x03c1\x03bf\x03b9/\x03c4\x03af\x03c4\x03bb\x03bf\x03c2",
+        L"Ressources/\x00e9t\x00e9",
+        L"Ressources/\x00e8t\x00e9",
+    };
+    static const PCWSTR variants[] = {
+        L"\x0440\x0415\x0421\x0423\x0420\x0421\x042b/\x0441\x0422\x0420\x041e\x041a\x0410",
+        L"\x0420\x0415\x0421\x0423\x0420\x0421\x042b/\x0417\x0410\x0413\x041e\x041b\x041e\x0412\x041e\x041a",
+        L"\x03a0\x038c\x03a1\x039f\x0399/\x03a4\x038a\x03a4\x039b\x039f\x03c2",
+        L"RESSOURCES/\x00c9T\x00c9",
+        L"ressources/\x00c8t\x00c9",
+    };
+
+    AutoDeletePtr<HierarchicalNamesBuilder> pIncremental;
+    VERIFY_SUCCEEDED(HierarchicalNamesBuilder::CreateInstance(HierarchicalNamesBuilder::BuildAsciiOrUtf16, &pIncremental));
+    AutoDeletePtr<HierarchicalNamesBuilder> pBulk;
+    VERIFY_SUCCEEDED(HierarchicalNamesBuilder::CreateInstance(HierarchicalNamesBuilder::BuildAsciiOrUtf16, &pBulk));
+    VERIFY_SUCCEEDED(pBulk->BeginBulkAdd());
+
+    for (unsigned int i = 0; i < ARRAYSIZE(names); i++)
+    {
+        ItemInfo* pItem;
+        VERIFY_SUCCEEDED(pIncremental->GetOrAddItem(names[i], &pItem));
+        VERIFY_SUCCEEDED(pBulk->GetOrAddItem(names[i], &pItem));
+    }
+    int numItems = pBulk->GetNumItems();
+    VERIFY_ARE_EQUAL(static_cast<int>(ARRAYSIZE(names)), numItems);
+
+    Log::Comment(L"[ Case variants of localized names find the existing items during a bulk add ]");
+    for (unsigned int i = 0; i < ARRAYSIZE(variants); i++)
+    {
+        int expectedIndex = -1;
+        int itemIndex = -1;
+        VERIFY_IS_TRUE(pBulk->Contains(names[i], nullptr, &expectedIndex));
+        VERIFY_IS_TRUE(pBulk->Contains(variants[i], nullptr, &itemIndex));
+        VERIFY_ARE_EQUAL(expectedIndex, itemIndex);
+
+        ItemInfo* pItem;
+        VERIFY_SUCCEEDED(pBulk->GetOrAddItem(variants[i], &pItem));
+        VERIFY_ARE_EQUAL(expectedIndex, pItem->GetIndex());
+    }
+    VERIFY_ARE_EQUAL(numItems, pBulk->GetNumItems());
+
+    VERIFY_SUCCEEDED(pBulk->EndBulkAdd());
+
+    Log::Comment(L"[ The built sections are identical ]");
+    BuildHelper incremental;
+    BuildHelper bulk;
+    VERIFY_SUCCEEDED(incremental.Build(pIncremental));
+    VERIFY_SUCCEEDED(bulk.Build(pBulk));
+    VERIFY_ARE_EQUAL(incremental.GetWrittenSize(), bulk.GetWrittenSize());
+    VERIFY_ARE_EQUAL(0, memcmp(incremental.GetBuffer(), bulk.GetBuffer(), incremental.GetWrittenSize()));
+}
+
+void HierarchicalNamesUnitTests::DescendentWalkFallbackTests(void)
+{
+    static const PCWSTR names[] = { L"a/b/c1", L"a/b/c2", L"a/b/x/y", L"a/d", L"e/f/g", L"e/h", L"i" };
+
+    AutoDeletePtr<HierarchicalNamesBuilder> pBuilder;
+    VERIFY_SUCCEEDED(HierarchicalNamesBuilder::CreateInstance(HierarchicalNamesBuilder::BuildUtf16Only, &pBuilder));
+    for (unsigned int i = 0; i < ARRAYSIZE(names); i++)
+    {
+        ItemInfo* pItem;
+        VERIFY_SUCCEEDED(pBuilder->GetOrAddItem(names[i], &pItem));
+    }
+
+    BuildHelper built;
+    VERIFY_SUCCEEDED(built.Build(pBuilder));
+
+    HierarchicalNames* pNamesRaw = nullptr;
+    VERIFY_SUCCEEDED(HierarchicalNames::CreateInstance(gHierarchicalNamesSectionType, built.GetBuffer(), built.GetBufferSize(), &pNamesRaw));
+    AutoDeletePtr<HierarchicalNames> pNames = pNamesRaw;
+    VERIFY(pNames->GetNumScopes() > 2);
+
+    // Remember what the well-formed names report.
+    int numScopes[20];
+    int numItems[20];
+    VERIFY(pNames->GetNumScopes() <= static_cast<int>(ARRAYSIZE(numScopes)));
+    for (int scopeIndex = 0; scopeIndex < pNames->GetNumScopes(); scopeIndex++)
+    {
+        VERIFY_SUCCEEDED(pNames->GetNumDescendents(scopeIndex, &numScopes[scopeIndex], &numItems[scopeIndex]));
+    }
+
+    // Point every scope but the root at the root's name node.  The child lists
+    // are untouched, but the cursor can no longer climb back up from a scope.
+    BYTE* pBuffer = built.GetBuffer();
+    const DEFFILE_HNAMES_HEADER* pHeader = reinterpret_cast<const DEFFILE_HNAMES_HEADER*>(pBuffer);
+    VERIFY((pHeader->flags & DEFFILE_HNAMES_FLAGS_DESCENDENT_ITEM_COUNTS) == 0);
+    DEFFILE_HNAMES_SCOPE* pScopes =
+        reinterpret_cast<DEFFILE_HNAMES_SCOPE*>(pBuffer + sizeof(DEFFILE_HNAMES_HEADER) + (pHeader->numNodes * sizeof(DEFFILE_HNAMES_NODE)));
+    for (UINT32 i = 1; i < pHeader->numScopes; i++)
+    {
+        pScopes[i].nameNodeIndex = 0;
+    }
+
+    pNamesRaw = nullptr;
+    VERIFY_SUCCEEDED(HierarchicalNames::CreateInstance(gHierarchicalNamesSectionType, built.GetBuffer(), built.GetBufferSize(), &pNamesRaw));
+    AutoDeletePtr<HierarchicalNames> pPatched = pNamesRaw;
+
+    HierarchicalNamesCursor cursor;
+    VERIFY_SUCCEEDED(pPatched->InitDescendentCursor(0, &cursor));
+    while (pPatched->TryGetNextDescendent(&cursor, nullptr, nullptr))
+    {
+    }
+    VERIFY_FAILED(cursor.status);
+
+    // Counts and enumeration fall back to walking the child lists.
+    for (int scopeIndex = 0; scopeIndex < pPatched->GetNumScopes(); scopeIndex++)
+    {
+        int patchedScopes = -1;
+        int patchedItems = -1;
+        VERIFY_SUCCEEDED(pPatched->GetNumDescendents(scopeIndex, &patchedScopes, &patchedItems));
+        VERIFY_ARE_EQUAL(numScopes[scopeIndex], patchedScopes);
+        VERIFY_ARE_EQUAL(numItems[scopeIndex], patchedItems);
+
+        CheckDescendentsAgainstWalk(pPatched, scopeIndex, patchedScopes, patchedItems);
+    }
+}
+
 }; // namespace UnitTests
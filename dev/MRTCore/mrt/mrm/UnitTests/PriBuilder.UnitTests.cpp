@@ -32,8 +32,97 @@ public:
     BEGIN_TEST_METHOD(DeduplicationTests)
         TEST_METHOD_PROPERTY(L"DataSource", L"Table:PriBuilder.UnitTests.xml#DeduplicationTests")
     END_TEST_METHOD();
+
+    BEGIN_TEST_METHOD(ConcurrentDeduplicationTests)
+        TEST_METHOD_PROPERTY(L"DataSource", L"Table:PriBuilder.UnitTests.xml#DeduplicationTests")
+    END_TEST_METHOD();
+};
+
+static const int MaxLocalizedStringChars = 80;
+
+// Makes numStrings distinct strings that look like localized UI text, MaxLocalizedStringChars apart.
+static void MakeLocalizedStrings(_In_ int numStrings, _Out_ unique_deffree_ptr<WCHAR>* pStrings)
+{
+    static PCWSTR const phrases[] = {L"Open the settings page for",
+                                     L"Ouvrir la page des param\u00e8tres pour",
+                                     L"Einstellungsseite \u00f6ffnen f\u00fcr",
+                                     L"Abrir la p\u00e1gina de configuraci\u00f3n de"};
+
+    pStrings->reset(_DefArray_AllocZeroed(WCHAR, numStrings * MaxLocalizedStringChars));
+    VERIFY_IS_NOT_NULL(pStrings->get());
+
+    for (int i = 0; i < numStrings; i++)
+    {
+        VERIFY_SUCCEEDED(StringCchPrintf(
+            &pStrings->get()[i * MaxLocalizedStringChars], MaxLocalizedStringChars, L"%s item %d", phrases[i % ARRAYSIZE(phrases)], i));
+    }
+}
+
+struct DeduplicationThreadData
+{
+    DataItemOrchestrator* pOrchestrator;
+    const IQualifierSet* pQualifiers;
+    PCWSTR pStrings;
+    int numStrings;
+    int numAdds;
+    int firstString;
+    HANDLE hStart;
+    HRESULT hr;
+    // Receives the reference for each string if set, otherwise references are deleted as they're returned.
+    IBuildInstanceReference** ppReferences;
 };
 
+static DWORD WINAPI AddLocalizedStringsThread(_In_ LPVOID pParam)
+{
+    DeduplicationThreadData* pData = static_cast<DeduplicationThreadData*>(pParam);
+    if (pData->hStart != nullptr)
+    {
+        WaitForSingleObject(pData->hStart, INFINITE);
+    }
+
+    pData->hr = S_OK;
+    for (int n = 0; (n < pData->numAdds) && SUCCEEDED(pData->hr); n++)
+    {
+        // Each thread walks the strings in a different order.
+        int index = ((pData->firstString + (n * 7)) % pData->numStrings);
+
+        IBuildInstanceReference* pReference = nullptr;
+        int qualifierSetIndex;
+        MrmEnvironment::ResourceValueType optimalType;
+        pData->hr = pData->pOrchestrator->AddOptimizedStringAndCreateInstanceReference(
+            MrmEnvironment::ResourceValueType::ResourceValueType_Utf16String,
+            &pData->pStrings[index * MaxLocalizedStringChars],
+            pData->pQualifiers,
+            &pReference,
+            &qualifierSetIndex,
+            &optimalType);
+
+        if (pData->ppReferences != nullptr)
+        {
+            pData->ppReferences[index] = pReference;
+        }
+        else
+        {
+            delete pReference;
+        }
+    }
+    return 0;
+}
+
+// Sets up a test PRI whose orchestrator hasn't been used yet, plus an en-US qualifier set.
+static void InitDeduplicationPri(
+    _Inout_ TestHPri* pPri,
+    _In_ CoreProfile* pProfile,
+    _Outptr_ DecisionInfoQualifierSetBuilder** ppQualifierSetBuilder)
+{
+    VERIFY_SUCCEEDED(pPri->InitFromTestVars(L"", NULL, pProfile, NULL));
+
+    DecisionInfoBuilder* pDecisions = pPri->GetPriSectionBuilder()->GetDecisionInfoBuilder();
+    VERIFY_SUCCEEDED(DecisionInfoQualifierSetBuilder::CreateInstance(pDecisions, ppQualifierSetBuilder));
+    (*ppQualifierSetBuilder)->Reset();
+    VERIFY_SUCCEEDED((*ppQualifierSetBuilder)->AddQualifier(L"Language", L"en-US", 0.0));
+}
+
 void PriBuilderUnitTests::SimpleBuilderReaderTests()
 {
     String tmp;
@@ -320,4 +409,96 @@ void PriBuilderUnitTests::DeduplicationTests()
         (actualDataValueSize2 * 2 == ((wcslen(utf16String2) + 1) * sizeof(wchar_t))));
 }
 
+void PriBuilderUnitTests::ConcurrentDeduplicationTests()
+{
+    const int NumThreads = 4;
+    const int NumStrings = 2000;
+
+    TestHPri pri;
+    AutoDeletePtr<CoreProfile> profile;
+    AutoDeletePtr<DecisionInfoQualifierSetBuilder> qualifierSetBuilder;
+    VERIFY_SUCCEEDED(CoreProfile::ChooseDefaultProfile(&profile));
+    InitDeduplicationPri(&pri, profile, &qualifierSetBuilder);
+
+    DataItemOrchestrator* dataItemOrchestrator = pri.GetPriSectionBuilder()->GetDataItemOrchestrator();
+    VERIFY_SUCCEEDED(dataItemOrchestrator->EnableConcurrentAdds());
+
+    unique_deffree_ptr<WCHAR> strings;
+    MakeLocalizedStrings(NumStrings, &strings);
+
+    Log::Comment(L"[ Threads adding the same strings all get references to the same data items ]");
+    HANDLE hStart = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    VERIFY_IS_NOT_NULL(hStart);
+
+    unique_deffree_ptr<IBuildInstanceReference*> references(_DefArray_AllocZeroed(IBuildInstanceReference*, NumThreads * NumStrings));
+    VERIFY_IS_NOT_NULL(references.get());
+
+    DeduplicationThreadData data[NumThreads] = {};
+    HANDLE threads[NumThreads];
+    for (int i = 0; i < NumThreads; i++)
+    {
+        data[i].pOrchestrator = dataItemOrchestrator;
+        data[i].pQualifiers = qualifierSetBuilder;
+        data[i].pStrings = strings.get();
+        data[i].numStrings = NumStrings;
+        data[i].numAdds = NumStrings;
+        data[i].firstString = (i * 311);
+        data[i].hStart = hStart;
+        data[i].ppReferences = &references.get()[i * NumStrings];
+        threads[i] = CreateThread(nullptr, 0, AddLocalizedStringsThread, &data[i], 0, nullptr);
+        VERIFY_IS_NOT_NULL(threads[i]);
+    }
+
+    SetEvent(hStart);
+    VERIFY_ARE_EQUAL(WAIT_OBJECT_0, WaitForMultipleObjects(NumThreads, threads, TRUE, INFINITE));
+
+    bool seen[NumStrings] = {};
+    for (int s = 0; s < NumStrings; s++)
+    {
+        OrchestratorDataReference* first = static_cast<OrchestratorDataReference*>(references.get()[s]);
+        VERIFY_IS_NOT_NULL(first);
+
+        // Every string in the set is distinct, so each gets its own data item.
+        int index = first->GetInnerReference().index;
+        VERIFY_IS_TRUE((index >= 0) && (index < NumStrings) && !seen[index]);
+        seen[index] = true;
+
+        for (int t = 1; t < NumThreads; t++)
+        {
+            OrchestratorDataReference* other = static_cast<OrchestratorDataReference*>(references.get()[(t * NumStrings) + s]);
+            VERIFY_IS_NOT_NULL(other);
+            VERIFY_ARE_EQUAL(index, other->GetInnerReference().index);
+            VERIFY_ARE_EQUAL(first->GetActualValueSize(), other->GetActualValueSize());
+            VERIFY_IS_TRUE(memcmp(first->GetActualValue(), other->GetActualValue(), first->GetActualValueSize()) == 0);
+        }
+    }
+
+    for (int i = 0; i < NumThreads; i++)
+    {
+        VERIFY_SUCCEEDED(data[i].hr);
+        CloseHandle(threads[i]);
+    }
+    CloseHandle(hStart);
+
+    Log::Comment(L"[ Concurrent adds can't be enabled once data has been added ]");
+    VERIFY_ARE_EQUAL(S_OK, dataItemOrchestrator->EnableConcurrentAdds());
+
+    TestHPri otherPri;
+    AutoDeletePtr<DecisionInfoQualifierSetBuilder> otherQualifierSetBuilder;
+    InitDeduplicationPri(&otherPri, profile, &otherQualifierSetBuilder);
+
+    IBuildInstanceReference* pReference;
+    int qualifierSetIndex;
+    VERIFY_SUCCEEDED(otherPri.GetPriSectionBuilder()->GetDataItemOrchestrator()->AddStringAndCreateInstanceReference(
+        strings.get(), otherQualifierSetBuilder, &pReference, &qualifierSetIndex));
+    VERIFY_ARE_EQUAL(
+        HRESULT_FROM_WIN32(ERROR_INVALID_OPERATION), otherPri.GetPriSectionBuilder()->GetDataItemOrchestrator()->EnableConcurrentAdds());
+    delete pReference;
+
+    for (int i = 0; i < (NumThreads * NumStrings); i++)
+    {
+        delete references.get()[i];
+    }
+}
+
 } // namespace UnitTests
\ No newline at end of file
@@ -32,6 +32,22 @@ public:
         TEST_METHOD_PROPERTY(L"DataSource", L"Table:PriFileManager.UnitTests.xml#BasicSingleFileTests")
     END_TEST_METHOD();
 
+    BEGIN_TEST_METHOD(LoadedFileBudgetTests)
+        TEST_METHOD_PROPERTY(L"DataSource", L"Table:PriFileManager.UnitTests.xml#BasicSingleFileTests")
+    END_TEST_METHOD();
+
+    BEGIN_TEST_METHOD(ReloadChecksumTests)
+        TEST_METHOD_PROPERTY(L"DataSource", L"Table:PriFileManager.UnitTests.xml#BasicSingleFileTests")
+    END_TEST_METHOD();
+
+    BEGIN_TEST_METHOD(SectionLookupTests)
+        TEST_METHOD_PROPERTY(L"DataSource", L"Table:PriFileManager.UnitTests.xml#BasicSingleFileTests")
+    END_TEST_METHOD();
+
+    BEGIN_TEST_METHOD(DecodedStringCacheBudgetTests)
+        TEST_METHOD_PROPERTY(L"DataSource", L"Table:PriFileManager.UnitTests.xml#BasicSingleFileTests")
+    END_TEST_METHOD();
+
     BEGIN_TEST_METHOD(BasicMultiFileTests)
         TEST_METHOD_PROPERTY(L"DataSource", L"Table:PriFileManager.UnitTests.xml#BasicMultiFileTests")
     END_TEST_METHOD();
@@ -297,6 +313,475 @@ void PriFileManagerUnitTests::BasicSingleFileTests()
     // MethodCleanup cleans up our data
 }
 
+// Uses a file without keeping any pointers into it, which leaves it free to
+// be unloaded to fit the budget.
+static void TouchFile(_In_ const ManagedFile* pFile)
+{
+    int next;
+    VERIFY_IS_TRUE(pFile->TryGetSectionIndexByType(HierarchicalSchema::GetSectionTypeId(), 0, 0, &next));
+}
+
+void PriFileManagerUnitTests::LoadedFileBudgetTests()
+{
+    TestHPri pri;
+    String tmp;
+
+    if (!SetupTestMethodOutputFolder(L"LoadedFileBudgetTests"))
+    {
+        return;
+    }
+
+    AutoDeletePtr<CoreProfile> pProfile;
+    VERIFY_SUCCEEDED(CoreProfile::ChooseDefaultProfile(&pProfile));
+
+    if (FAILED(pri.InitFromTestVars(L"", NULL, pProfile, NULL)) || FAILED(pri.Build()))
+    {
+        Log::Error(L"Error building test PRI");
+        return;
+    }
+
+    // Same contents under three names, so the manager sees three files.
+    PCWSTR fileNames[] = {L"budget1.pri", L"budget2.pri", L"budget3.pri"};
+    String priFilePaths[ARRAYSIZE(fileNames)];
+    for (size_t i = 0; i < ARRAYSIZE(fileNames); i++)
+    {
+        if ((GetOutputLongFilePath(fileNames[i], priFilePaths[i]) == NULL) || FAILED(pri.WriteToFile((PCWSTR)priFilePaths[i])))
+        {
+            Log::Error(tmp.Format(L"Error writing test PRI \"%s\"", fileNames[i]));
+            return;
+        }
+    }
+
+    AutoDeletePtr<AtomPoolGroup> pAtoms;
+    VERIFY_SUCCEEDED(AtomPoolGroup::CreateInstance(&pAtoms));
+    AutoDeletePtr<UnifiedEnvironment> pEnvironment;
+    VERIFY_SUCCEEDED(UnifiedEnvironment::CreateInstance(pProfile, pAtoms, &pEnvironment));
+    AutoDeletePtr<PriFileManager> pManager;
+    VERIFY_SUCCEEDED(PriFileManager::CreateInstance(pEnvironment, &pManager));
+
+    ManagedFile* pFiles[ARRAYSIZE(fileNames)];
+    for (size_t i = 0; i < ARRAYSIZE(fileNames); i++)
+    {
+        VERIFY_SUCCEEDED(pManager->GetOrAddFile((PCWSTR)priFilePaths[i], L"", LoadPriFlags::Preload, &pFiles[i]));
+        VERIFY_IS_TRUE(pFiles[i]->IsLoaded());
+    }
+
+    Log::Comment(L"[ No budget by default ]");
+    PriFileManager::LoadedFileStats stats;
+    pManager->GetLoadedFileStats(&stats);
+    VERIFY_ARE_EQUAL(0ULL, stats.numEvictions);
+
+    Log::Comment(L"[ Trimming to two files evicts the least recently used ]");
+    TouchFile(pFiles[1]);
+    TouchFile(pFiles[0]);
+    TouchFile(pFiles[2]);
+    VERIFY_SUCCEEDED(pManager->SetLoadedFileBudget(0, 2));
+    VERIFY_IS_FALSE(pFiles[1]->IsLoaded());
+    VERIFY_IS_TRUE(pFiles[0]->IsLoaded());
+    VERIFY_IS_TRUE(pFiles[2]->IsLoaded());
+
+    Log::Comment(L"[ Access reloads transparently and evicts another file ]");
+    TouchFile(pFiles[1]);
+    VERIFY_IS_TRUE(pFiles[1]->IsLoaded());
+    VERIFY_IS_FALSE(pFiles[0]->IsLoaded());
+    pManager->GetLoadedFileStats(&stats);
+    VERIFY_ARE_EQUAL(2ULL, stats.numEvictions);
+    VERIFY_ARE_EQUAL(1ULL, stats.numReloads);
+    VERIFY_IS_TRUE(stats.maxReloadMicroseconds <= stats.totalReloadMicroseconds);
+
+    Log::Comment(L"[ Pinned files stay loaded ]");
+    pFiles[2]->Pin();
+    pFiles[1]->Pin();
+    TouchFile(pFiles[0]);
+    VERIFY_IS_TRUE(pFiles[0]->IsLoaded());
+    VERIFY_IS_TRUE(pFiles[1]->IsLoaded());
+    VERIFY_IS_TRUE(pFiles[2]->IsLoaded());
+
+    pFiles[1]->Unpin();
+    VERIFY_SUCCEEDED(pManager->TrimLoadedFiles());
+    VERIFY_IS_FALSE(pFiles[1]->IsLoaded());
+    pFiles[2]->Unpin();
+
+    Log::Comment(L"[ Files whose sections were handed out stay loaded ]");
+    const BaseFile* pBaseFile;
+    HierarchicalSchema* pSchema;
+    int schemaSection;
+    VERIFY_SUCCEEDED(pFiles[0]->GetBaseFile(&pBaseFile));
+    VERIFY_IS_TRUE(pFiles[2]->TryGetSectionIndexByType(HierarchicalSchema::GetSectionTypeId(), 0, 0, &schemaSection));
+    VERIFY_IS_FALSE(pFiles[2]->IsReferenced());
+    VERIFY_SUCCEEDED(pManager->GetSchemaSection(pFiles[2]->GetGlobalIndex(), schemaSection, &pSchema));
+    VERIFY_IS_TRUE(pFiles[0]->IsReferenced());
+    VERIFY_IS_TRUE(pFiles[2]->IsReferenced());
+    VERIFY_SUCCEEDED(pManager->SetLoadedFileBudget(0, 1));
+    VERIFY_IS_TRUE(pFiles[0]->IsLoaded());
+    VERIFY_IS_FALSE(pFiles[1]->IsLoaded());
+    VERIFY_IS_TRUE(pFiles[2]->IsLoaded());
+    VERIFY_IS_NOT_NULL(pBaseFile->GetFileHeader());
+    VERIFY_IS_TRUE(pSchema->GetNumScopes() > 0);
+
+    TouchFile(pFiles[1]);
+    VERIFY_IS_TRUE(pFiles[0]->IsLoaded());
+    VERIFY_IS_TRUE(pFiles[1]->IsLoaded());
+    VERIFY_IS_TRUE(pFiles[2]->IsLoaded());
+
+    Log::Comment(L"[ Explicitly unloading a referenced file releases it ]");
+    VERIFY_SUCCEEDED(pFiles[2]->Unload());
+    VERIFY_IS_FALSE(pFiles[2]->IsReferenced());
+    TouchFile(pFiles[2]);
+    VERIFY_IS_FALSE(pFiles[1]->IsLoaded());
+    VERIFY_IS_TRUE(pFiles[2]->IsLoaded());
+    VERIFY_SUCCEEDED(pManager->TrimLoadedFiles());
+    VERIFY_IS_TRUE(pFiles[0]->IsLoaded());
+    VERIFY_IS_FALSE(pFiles[2]->IsLoaded());
+
+    Log::Comment(L"[ Removing the budget stops eviction ]");
+    VERIFY_SUCCEEDED(pManager->SetLoadedFileBudget(0, 0));
+    TouchFile(pFiles[1]);
+    TouchFile(pFiles[2]);
+    VERIFY_IS_TRUE(pFiles[0]->IsLoaded());
+    VERIFY_IS_TRUE(pFiles[1]->IsLoaded());
+    VERIFY_IS_TRUE(pFiles[2]->IsLoaded());
+
+    VERIFY_ARE_EQUAL(E_INVALIDARG, pManager->SetLoadedFileBudget(0, -1));
+
+    Log::Comment(L"[ A budget set before loading holds as files are added ]");
+    AutoDeletePtr<PriFileManager> pBudgetManager;
+    VERIFY_SUCCEEDED(PriFileManager::CreateInstance(pEnvironment, &pBudgetManager));
+    VERIFY_SUCCEEDED(pBudgetManager->SetLoadedFileBudget(0, 1));
+
+    ManagedFile* pBudgetFiles[ARRAYSIZE(fileNames)];
+    for (size_t i = 0; i < ARRAYSIZE(fileNames); i++)
+    {
+        VERIFY_SUCCEEDED(pBudgetManager->GetOrAddFile((PCWSTR)priFilePaths[i], L"", LoadPriFlags::Preload, &pBudgetFiles[i]));
+        VERIFY_IS_TRUE(pBudgetFiles[i]->IsLoaded());
+        for (size_t j = 0; j < i; j++)
+        {
+            VERIFY_IS_FALSE(pBudgetFiles[j]->IsLoaded());
+        }
+    }
+    pBudgetManager->GetLoadedFileStats(&stats);
+    VERIFY_ARE_EQUAL(2ULL, stats.numEvictions);
+    VERIFY_ARE_EQUAL(0ULL, stats.numReloads);
+
+    Log::Comment(L"[ Reloading on access keeps to the budget ]");
+    VERIFY_SUCCEEDED(pBudgetFiles[0]->GetBaseFile(&pBaseFile));
+    VERIFY_IS_TRUE(pBudgetFiles[0]->IsLoaded());
+    VERIFY_IS_FALSE(pBudgetFiles[1]->IsLoaded());
+    VERIFY_IS_FALSE(pBudgetFiles[2]->IsLoaded());
+    pBudgetManager->GetLoadedFileStats(&stats);
+    VERIFY_ARE_EQUAL(3ULL, stats.numEvictions);
+    VERIFY_ARE_EQUAL(1ULL, stats.numReloads);
+}
+
+// Moves all of the file's times, including the change time, an hour back so
+// that its checksum can be remembered.
+static void BackdateFile(_In_ PCWSTR pPath)
+{
+    ULARGE_INTEGER time;
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    time.LowPart = now.dwLowDateTime;
+    time.HighPart = now.dwHighDateTime;
+    time.QuadPart -= 3600ULL * 10000000ULL;
+
+    HANDLE hFile = CreateFileW(pPath, FILE_WRITE_ATTRIBUTES, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    VERIFY_ARE_NOT_EQUAL(INVALID_HANDLE_VALUE, hFile);
+
+    FILE_BASIC_INFO info = {};
+    info.CreationTime.QuadPart = static_cast<LONGLONG>(time.QuadPart);
+    info.LastAccessTime = info.CreationTime;
+    info.LastWriteTime = info.CreationTime;
+    info.ChangeTime = info.CreationTime;
+    VERIFY_WIN32_BOOL_SUCCEEDED(SetFileInformationByHandle(hFile, FileBasicInfo, &info, sizeof(info)));
+    CloseHandle(hFile);
+}
+
+void PriFileManagerUnitTests::ReloadChecksumTests()
+{
+    TestHPri pri;
+    String tmp;
+
+    if (!SetupTestMethodOutputFolder(L"ReloadChecksumTests"))
+    {
+        return;
+    }
+
+    AutoDeletePtr<CoreProfile> pProfile;
+    VERIFY_SUCCEEDED(CoreProfile::ChooseDefaultProfile(&pProfile));
+
+    String priFilePath;
+    if ((GetOutputLongFilePath(L"reload.pri", priFilePath) == NULL) || FAILED(pri.InitFromTestVars(L"", NULL, pProfile, NULL)) ||
+        FAILED(pri.Build()) || FAILED(pri.WriteToFile((PCWSTR)priFilePath)))
+    {
+        Log::Error(L"Error building test PRI");
+        return;
+    }
+    BackdateFile((PCWSTR)priFilePath);
+
+    AutoDeletePtr<AtomPoolGroup> pAtoms;
+    VERIFY_SUCCEEDED(AtomPoolGroup::CreateInstance(&pAtoms));
+    AutoDeletePtr<UnifiedEnvironment> pEnvironment;
+    VERIFY_SUCCEEDED(UnifiedEnvironment::CreateInstance(pProfile, pAtoms, &pEnvironment));
+    AutoDeletePtr<PriFileManager> pManager;
+    VERIFY_SUCCEEDED(PriFileManager::CreateInstance(pEnvironment, &pManager));
+
+    // Files are only checksummed while they might be unloaded to fit a budget.
+    VERIFY_SUCCEEDED(pManager->SetLoadedFileBudget(0, 8));
+
+    DefChecksum::ClearFileChecksumMemo();
+
+    ManagedFile* pFile;
+    VERIFY_SUCCEEDED(pManager->GetOrAddFile((PCWSTR)priFilePath, L"", LoadPriFlags::Preload, &pFile));
+    VERIFY_IS_TRUE(pFile->IsLoaded());
+    VERIFY_ARE_EQUAL(0u, DefChecksum::GetFileChecksumMemoHits());
+
+    Log::Comment(L"[ An unchanged file reloads, and the check is answered from the memo ]");
+    const BaseFile* pBaseFile;
+    VERIFY_SUCCEEDED(pFile->Unload());
+    VERIFY_ARE_EQUAL(0u, DefChecksum::GetFileChecksumMemoHits());
+    VERIFY_SUCCEEDED(pFile->GetBaseFile(&pBaseFile));
+    VERIFY_IS_TRUE(pFile->IsLoaded());
+    VERIFY_ARE_EQUAL(1u, DefChecksum::GetFileChecksumMemoHits());
+
+    VERIFY_SUCCEEDED(pFile->Unload());
+    VERIFY_ARE_EQUAL(1u, DefChecksum::GetFileChecksumMemoHits());
+
+    Log::Comment(L"[ A file changed while unloaded misses the memo and isn't reloaded ]");
+    HANDLE hFile = CreateFileW((PCWSTR)priFilePath, FILE_APPEND_DATA, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    VERIFY_ARE_NOT_EQUAL(INVALID_HANDLE_VALUE, hFile);
+    BYTE extra = 0;
+    DWORD cbWritten;
+    VERIFY_WIN32_BOOL_SUCCEEDED(WriteFile(hFile, &extra, sizeof(extra), &cbWritten, nullptr));
+    CloseHandle(hFile);
+
+    VERIFY_ARE_EQUAL(HRESULT_FROM_WIN32(ERROR_FILE_INVALID), pFile->GetBaseFile(&pBaseFile));
+    VERIFY_IS_FALSE(pFile->IsLoaded());
+    VERIFY_ARE_EQUAL(1u, DefChecksum::GetFileChecksumMemoHits());
+
+    DefChecksum::ClearFileChecksumMemo();
+}
+
+static const int MaxLookupSections = 64;
+
+struct SectionLookupThreadData
+{
+    const IMrmFile* pFile;
+    int numSections;
+    HANDLE hStart;
+    // Reader returned for each section, or nullptr if it isn't a schema
+    const HierarchicalSchema* pSchemas[MaxLookupSections];
+};
+
+static DWORD WINAPI GetSchemaSectionsThread(_In_ LPVOID pParam)
+{
+    SectionLookupThreadData* pData = static_cast<SectionLookupThreadData*>(pParam);
+    WaitForSingleObject(pData->hStart, INFINITE);
+
+    for (int i = 0; i < pData->numSections; i++)
+    {
+        HierarchicalSchema* pSchema = nullptr;
+        if (SUCCEEDED(pData->pFile->GetSchemaSection(0, i, &pSchema)))
+        {
+            pData->pSchemas[i] = pSchema;
+        }
+    }
+    return 0;
+}
+
+void PriFileManagerUnitTests::SectionLookupTests()
+{
+    TestHPri pri;
+    String tmp;
+
+    if (!SetupTestMethodOutputFolder(L"SectionLookupTests"))
+    {
+        return;
+    }
+
+    AutoDeletePtr<CoreProfile> pProfile;
+    VERIFY_SUCCEEDED(CoreProfile::ChooseDefaultProfile(&pProfile));
+
+    String priFilePath;
+    if ((GetOutputLongFilePath(L"sections.pri", priFilePath) == NULL) || FAILED(pri.InitFromTestVars(L"", NULL, pProfile, NULL)) ||
+        FAILED(pri.Build()) || FAILED(pri.WriteToFile((PCWSTR)priFilePath)))
+    {
+        Log::Error(L"Error building test PRI");
+        return;
+    }
+
+    AutoDeletePtr<AtomPoolGroup> pAtoms;
+    VERIFY_SUCCEEDED(AtomPoolGroup::CreateInstance(&pAtoms));
+    AutoDeletePtr<UnifiedEnvironment> pEnvironment;
+    VERIFY_SUCCEEDED(UnifiedEnvironment::CreateInstance(pProfile, pAtoms, &pEnvironment));
+    AutoDeletePtr<PriFileManager> pManager;
+    VERIFY_SUCCEEDED(PriFileManager::CreateInstance(pEnvironment, &pManager));
+
+    // Load without preloading so no section has been initialized yet
+    ManagedFile* pManagedFile;
+    VERIFY_SUCCEEDED(pManager->GetOrAddFile((PCWSTR)priFilePath, L"", LoadPriFlags::Default, &pManagedFile));
+    const IMrmFile* pFile;
+    VERIFY_SUCCEEDED(pManagedFile->GetBaseMrmFile(&pFile));
+    const BaseFile* pBaseFile;
+    VERIFY_SUCCEEDED(pFile->GetBaseFile(&pBaseFile));
+
+    int numSections = pBaseFile->GetNumSections();
+    VERIFY_IS_TRUE(numSections <= MaxLookupSections);
+
+    Log::Comment(L"[ Lookup by type matches a scan of the TOC ]");
+    for (int i = 0; i < numSections; i++)
+    {
+        const DEFFILE_TOC_ENTRY* pToc;
+        VERIFY_SUCCEEDED(pBaseFile->GetTocEntry(i, &pToc));
+
+        int next = -1;
+        VERIFY_IS_TRUE(pFile->TryGetSectionIndexByType(pToc->type, 0, 0, &next));
+        VERIFY_IS_TRUE(next <= i);
+        while (next < i)
+        {
+            VERIFY_IS_TRUE(pFile->TryGetSectionIndexByType(pToc->type, 0, next + 1, &next));
+        }
+        VERIFY_ARE_EQUAL(i, next);
+
+        for (int j = i + 1; j < numSections; j++)
+        {
+            const DEFFILE_TOC_ENTRY* pOtherToc;
+            VERIFY_SUCCEEDED(pBaseFile->GetTocEntry(j, &pOtherToc));
+            if (BaseFile::SectionTypesEqual(pToc->type, pOtherToc->type))
+            {
+                VERIFY_IS_TRUE(pFile->TryGetSectionIndexByType(pToc->type, 0, i + 1, &next));
+                VERIFY_ARE_EQUAL(j, next);
+                break;
+            }
+        }
+    }
+
+    DEFFILE_SECTION_TYPEID missingType = {};
+    const DEFFILE_TOC_ENTRY* pFirstToc;
+    VERIFY_SUCCEEDED(pBaseFile->GetTocEntry(0, &pFirstToc));
+    int next;
+    VERIFY_IS_FALSE(pFile->TryGetSectionIndexByType(missingType, 0, 0, &next));
+    VERIFY_IS_FALSE(pFile->TryGetSectionIndexByType(pFirstToc->type, 0, numSections, &next));
+
+    Log::Comment(L"[ Threads racing to create the same readers all get the same ones ]");
+    const int numThreads = 4;
+    HANDLE hStart = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    VERIFY_IS_NOT_NULL(hStart);
+
+    SectionLookupThreadData data[numThreads] = {};
+    HANDLE threads[numThreads];
+    for (int i = 0; i < numThreads; i++)
+    {
+        data[i].pFile = pFile;
+        data[i].numSections = numSections;
+        data[i].hStart = hStart;
+        threads[i] = CreateThread(nullptr, 0, GetSchemaSectionsThread, &data[i], 0, nullptr);
+        VERIFY_IS_NOT_NULL(threads[i]);
+    }
+
+    SetEvent(hStart);
+    VERIFY_ARE_EQUAL(WAIT_OBJECT_0, WaitForMultipleObjects(numThreads, threads, TRUE, INFINITE));
+
+    int numSchemas = 0;
+    for (int i = 0; i < numSections; i++)
+    {
+        HierarchicalSchema* pSchema = nullptr;
+        bool isSchema = SUCCEEDED(pFile->GetSchemaSection(0, i, &pSchema));
+        numSchemas += (isSchema ? 1 : 0);
+        for (int t = 0; t < numThreads; t++)
+        {
+            VERIFY_ARE_EQUAL(static_cast<const HierarchicalSchema*>(pSchema), data[t].pSchemas[i]);
+        }
+    }
+    VERIFY_IS_TRUE(numSchemas > 0);
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        CloseHandle(threads[i]);
+    }
+    CloseHandle(hStart);
+}
+
+static void GetFirstDataItemsSection(_In_ const ManagedFile* pManagedFile, _Out_ FileDataItemsSection** result)
+{
+    *result = nullptr;
+
+    const IMrmFile* pFile;
+    VERIFY_SUCCEEDED(pManagedFile->GetBaseMrmFile(&pFile));
+
+    int sectionIndex = -1;
+    VERIFY_IS_TRUE(pFile->TryGetSectionIndexByType(FileDataItemsSection::GetSectionTypeId(), 0, 0, &sectionIndex));
+    VERIFY_SUCCEEDED(pFile->GetDataItemsSection(0, sectionIndex, result));
+    VERIFY_IS_NOT_NULL(*result);
+}
+
+void PriFileManagerUnitTests::DecodedStringCacheBudgetTests()
+{
+    TestHPri pri;
+    String tmp;
+
+    if (!SetupTestMethodOutputFolder(L"DecodedStringCacheBudgetTests"))
+    {
+        return;
+    }
+
+    AutoDeletePtr<CoreProfile> pProfile;
+    VERIFY_SUCCEEDED(CoreProfile::ChooseDefaultProfile(&pProfile));
+
+    if (FAILED(pri.InitFromTestVars(L"", NULL, pProfile, NULL)) || FAILED(pri.Build()))
+    {
+        Log::Error(L"Error building test PRI");
+        return;
+    }
+
+    PCWSTR fileNames[] = {L"strings1.pri", L"strings2.pri"};
+    String priFilePaths[ARRAYSIZE(fileNames)];
+    for (size_t i = 0; i < ARRAYSIZE(fileNames); i++)
+    {
+        if ((GetOutputLongFilePath(fileNames[i], priFilePaths[i]) == NULL) || FAILED(pri.WriteToFile((PCWSTR)priFilePaths[i])))
+        {
+            Log::Error(tmp.Format(L"Error writing test PRI \"%s\"", fileNames[i]));
+            return;
+        }
+    }
+
+    AutoDeletePtr<AtomPoolGroup> pAtoms;
+    VERIFY_SUCCEEDED(AtomPoolGroup::CreateInstance(&pAtoms));
+    AutoDeletePtr<UnifiedEnvironment> pEnvironment;
+    VERIFY_SUCCEEDED(UnifiedEnvironment::CreateInstance(pProfile, pAtoms, &pEnvironment));
+    AutoDeletePtr<PriFileManager> pManager;
+    VERIFY_SUCCEEDED(PriFileManager::CreateInstance(pEnvironment, &pManager));
+
+    Log::Comment(L"[ No cache by default ]");
+    VERIFY_ARE_EQUAL(0u, pManager->GetDecodedStringCacheBudget());
+
+    ManagedFile* pFirstFile;
+    VERIFY_SUCCEEDED(pManager->GetOrAddFile((PCWSTR)priFilePaths[0], L"", LoadPriFlags::Preload, &pFirstFile));
+    FileDataItemsSection* pFirstSection;
+    GetFirstDataItemsSection(pFirstFile, &pFirstSection);
+
+    DecodedStringCache::Stats stats;
+    VERIFY_IS_FALSE(pFirstSection->TryGetDecodedStringCacheStats(&stats));
+
+    Log::Comment(L"[ Setting a budget enables the cache on sections already in use ]");
+    VERIFY_SUCCEEDED(pManager->SetDecodedStringCacheBudget(64 * 1024));
+    VERIFY_ARE_EQUAL(static_cast<UINT32>(64 * 1024), pManager->GetDecodedStringCacheBudget());
+    VERIFY_IS_TRUE(pFirstSection->TryGetDecodedStringCacheStats(&stats));
+    VERIFY_ARE_EQUAL(static_cast<UINT64>(64 * 1024), stats.cbBudget);
+
+    Log::Comment(L"[ Files loaded later pick up the budget ]");
+    ManagedFile* pSecondFile;
+    VERIFY_SUCCEEDED(pManager->GetOrAddFile((PCWSTR)priFilePaths[1], L"", LoadPriFlags::Preload, &pSecondFile));
+    FileDataItemsSection* pSecondSection;
+    GetFirstDataItemsSection(pSecondFile, &pSecondSection);
+    VERIFY_IS_TRUE(pSecondSection->TryGetDecodedStringCacheStats(&stats));
+    VERIFY_ARE_EQUAL(static_cast<UINT64>(64 * 1024), stats.cbBudget);
+
+    Log::Comment(L"[ Turning the cache off leaves existing caches alone ]");
+    VERIFY_SUCCEEDED(pManager->SetDecodedStringCacheBudget(0));
+    VERIFY_ARE_EQUAL(0u, pManager->GetDecodedStringCacheBudget());
+    VERIFY_IS_TRUE(pFirstSection->TryGetDecodedStringCacheStats(&stats));
+}
+
 void PriFileManagerUnitTests::BasicMultiFileTests()
 {
     String tmp;
@@ -45,6 +45,12 @@ public:
     BEGIN_TEST_METHOD(LargeDataTests)
         TEST_METHOD_PROPERTY(L"DataSource", L"Table:ResourceMap.UnitTests.xml#LargeDataTests")
     END_TEST_METHOD();
+
+    TEST_METHOD(InternalStringSharingTests);
+    TEST_METHOD(StringValueUtf8Tests);
+    TEST_METHOD(NameIndexPathHashTests);
+    TEST_METHOD(NameIndexLookupTests);
+    TEST_METHOD(DescendentNameTests);
 };
 
 void ResourceMapUnitTests::SimpleBuilderTests()
@@ -748,4 +754,405 @@ void ResourceMapUnitTests::LargeDataTests()
         tmp.Format(L"[ Successfully generated and verify %d resources with %d candidates each ]", numResources, numCandidatesPerResource));
 }
 
+void ResourceMapUnitTests::InternalStringSharingTests()
+{
+    String tmp;
+
+    TestHPri pri;
+    AutoDeletePtr<CoreProfile> pProfile;
+    VERIFY_SUCCEEDED(CoreProfile::ChooseDefaultProfile(&pProfile));
+
+    Log::Comment(L"[ Setting up test PRI ]");
+    if (FAILED(pri.Init(pProfile)))
+    {
+        Log::Error(L"[ Couldn't init TestPri ]");
+        return;
+    }
+
+    PriSectionBuilder* pPriBuilder = pri.GetPriFileBuilder()->GetDescriptor();
+
+    HierarchicalSchemaSectionBuilder* pSchemaBuilder;
+    VERIFY_SUCCEEDED(HierarchicalSchemaSectionBuilder::CreateInstance(pPriBuilder, L"SharedStrings", L"SharedStrings", 1, &pSchemaBuilder));
+
+    int index;
+    HRESULT hr = pPriBuilder->AddSchemaBuilder(pSchemaBuilder, true, &index);
+    if (FAILED(hr) || (index < 0))
+    {
+        delete pSchemaBuilder;
+        Log::Error(tmp.Format(L"[ Failed to add schema builder (0x%x) ]", hr));
+        return;
+    }
+
+    ResourceMapSectionBuilder* pMapBuilder;
+    VERIFY_SUCCEEDED(pPriBuilder->GetOrAddPrimaryResourceMapBuilder(&pMapBuilder));
+
+    // Identical internal strings are stored once; different ones are not.
+    PCWSTR names[] = {L"Shared1", L"Shared2", L"Other"};
+    PCWSTR values[] = {L"Shared value", L"Shared value", L"Other value"};
+    for (unsigned int i = 0; i < ARRAYSIZE(names); i++)
+    {
+        VERIFY_SUCCEEDED(
+            pMapBuilder->AddCandidateWithInternalString(names[i], MrmEnvironment::ResourceValueType_Utf16String, values[i], 0));
+    }
+
+    if (FAILED(pri.Build()) || FAILED(pri.CreateReader(pProfile)))
+    {
+        Log::Error(L"[ Couldn't build and read back test PRI ]");
+        return;
+    }
+
+    const IResourceMapBase* pResources;
+    VERIFY_SUCCEEDED(pri.GetPriFile()->GetPrimaryResourceMap(&pResources));
+
+    const void* pData[ARRAYSIZE(names)];
+    for (unsigned int i = 0; i < ARRAYSIZE(names); i++)
+    {
+        NamedResourceResult resource;
+        ResourceCandidateResult candidate;
+        StringResult value;
+        BlobResult blob;
+        VERIFY_SUCCEEDED(pResources->GetResource(names[i], &resource));
+        VERIFY_SUCCEEDED(resource.GetCandidate(0, &candidate));
+        VERIFY_IS_TRUE(candidate.TryGetStringValue(&value));
+        VERIFY_ARE_EQUAL(Def_Equal, DefString_Compare(value.GetRef(), values[i]));
+        VERIFY_IS_TRUE(candidate.TryGetBlobValue(&blob));
+        pData[i] = blob.GetRef(nullptr);
+    }
+
+    VERIFY_ARE_EQUAL(pData[0], pData[1]);
+    VERIFY_ARE_NOT_EQUAL(pData[0], pData[2]);
+}
+
+void ResourceMapUnitTests::StringValueUtf8Tests()
+{
+    String tmp;
+
+    TestHPri pri;
+    AutoDeletePtr<CoreProfile> pProfile;
+    VERIFY_SUCCEEDED(CoreProfile::ChooseDefaultProfile(&pProfile));
+
+    Log::Comment(L"[ Setting up test PRI ]");
+    if (FAILED(pri.Init(pProfile)))
+    {
+        Log::Error(L"[ Couldn't init TestPri ]");
+        return;
+    }
+
+    PriSectionBuilder* pPriBuilder = pri.GetPriFileBuilder()->GetDescriptor();
+
+    HierarchicalSchemaSectionBuilder* pSchemaBuilder;
+    VERIFY_SUCCEEDED(HierarchicalSchemaSectionBuilder::CreateInstance(pPriBuilder, L"Utf8Strings", L"Utf8Strings", 1, &pSchemaBuilder));
+
+    int index;
+    HRESULT hr = pPriBuilder->AddSchemaBuilder(pSchemaBuilder, true, &index);
+    if (FAILED(hr) || (index < 0))
+    {
+        delete pSchemaBuilder;
+        Log::Error(tmp.Format(L"[ Failed to add schema builder (0x%x) ]", hr));
+        return;
+    }
+
+    ResourceMapSectionBuilder* pMapBuilder;
+    VERIFY_SUCCEEDED(pPriBuilder->GetOrAddPrimaryResourceMapBuilder(&pMapBuilder));
+
+    // Internal strings are stored as the UTF-16 bytes they were added with, so tagging
+    // them as UTF-8 or ASCII lets us store bytes that aren't valid in that encoding.
+    const HRESULT noTranslation = HRESULT_FROM_WIN32(ERROR_NO_UNICODE_TRANSLATION);
+    struct
+    {
+        PCWSTR name;
+        MrmEnvironment::ResourceValueType type;
+        PCWSTR value;
+        HRESULT hrExpected;
+        PCSTR utf8Expected;
+    } cases[] = {
+        {L"Utf16", MrmEnvironment::ResourceValueType_Utf16String, L"caf\x00e9", S_OK, "caf\xc3\xa9"},
+        {L"Utf16Unpaired", MrmEnvironment::ResourceValueType_Utf16String, L"bad\xd800", noTranslation, nullptr},
+        {L"Utf8", MrmEnvironment::ResourceValueType_Utf8String, L"A", S_OK, "A"},
+        {L"Utf8IllFormed", MrmEnvironment::ResourceValueType_Utf8String, L"\x00e9", noTranslation, nullptr},
+        {L"AsciiHighBytes", MrmEnvironment::ResourceValueType_AsciiString, L"\x00e9", S_OK, "\xc3\xa9"},
+    };
+
+    for (unsigned int i = 0; i < ARRAYSIZE(cases); i++)
+    {
+        VERIFY_SUCCEEDED(pMapBuilder->AddCandidateWithInternalString(cases[i].name, cases[i].type, cases[i].value, 0));
+    }
+
+    if (FAILED(pri.Build()) || FAILED(pri.CreateReader(pProfile)))
+    {
+        Log::Error(L"[ Couldn't build and read back test PRI ]");
+        return;
+    }
+
+    const IResourceMapBase* pResources;
+    VERIFY_SUCCEEDED(pri.GetPriFile()->GetPrimaryResourceMap(&pResources));
+
+    for (unsigned int i = 0; i < ARRAYSIZE(cases); i++)
+    {
+        Log::Comment(tmp.Format(L"[ Getting \"%s\" as UTF-8 ]", cases[i].name));
+
+        NamedResourceResult resource;
+        ResourceCandidateResult candidate;
+        VERIFY_SUCCEEDED(pResources->GetResource(cases[i].name, &resource));
+        VERIFY_SUCCEEDED(resource.GetCandidate(0, &candidate));
+
+        BlobResult utf8;
+        VERIFY_ARE_EQUAL(cases[i].hrExpected, candidate.GetStringValueUtf8(&utf8));
+        if (cases[i].utf8Expected != nullptr)
+        {
+            VERIFY_ARE_EQUAL(0, strcmp(cases[i].utf8Expected, static_cast<PCSTR>(utf8.GetRef(nullptr))));
+        }
+    }
+}
+
+void ResourceMapUnitTests::NameIndexPathHashTests()
+{
+    const UINT32 initial = ResourceNameIndexSection::GetInitialPathHash();
+    const UINT32 full = ResourceNameIndexSection::ComputePathHash(initial, L"Files/Images/Logo.png");
+
+    // Case and separator style must not change the hash.
+    VERIFY_ARE_EQUAL(full, ResourceNameIndexSection::ComputePathHash(initial, L"files/images/LOGO.PNG"));
+    VERIFY_ARE_EQUAL(full, ResourceNameIndexSection::ComputePathHash(initial, L"Files\\Images\\Logo.png"));
+    VERIFY_ARE_EQUAL(full, ResourceNameIndexSection::ComputePathHash(initial, L"/Files/Images/Logo.png"));
+
+    // Localized names fold with the ordinal mapping whatever the current locale.
+    const UINT32 localized = ResourceNameIndexSection::ComputePathHash(initial, L"\x0424\x0430\x0439\x043b\x044b/\x00e9t\x00e9");
+    VERIFY_ARE_EQUAL(localized, ResourceNameIndexSection::ComputePathHash(initial, L"\x0444\x0410\x0419\x041b\x042b/\x00c9T\x00c9"));
+    VERIFY_ARE_NOT_EQUAL(localized, ResourceNameIndexSection::ComputePathHash(initial, L"\x0424\x0430\x0439\x043b\x044b/\x00e8t\x00e9"));
+
+    // A scope hash extended with a relative path matches the full path hash.
+    UINT32 scope = ResourceNameIndexSection::ComputePathHash(initial, L"Files");
+    VERIFY_ARE_EQUAL(full, ResourceNameIndexSection::ComputePathHash(scope, L"Images/Logo.png"));
+    scope = ResourceNameIndexSection::ComputePathHash(scope, L"Images");
+    VERIFY_ARE_EQUAL(full, ResourceNameIndexSection::ComputePathHash(scope, L"Logo.png"));
+
+    // Segment boundaries are part of the hash.
+    VERIFY_ARE_NOT_EQUAL(full, ResourceNameIndexSection::ComputePathHash(initial, L"FilesImages/Logo.png"));
+    VERIFY_ARE_EQUAL(initial, ResourceNameIndexSection::ComputePathHash(initial, nullptr));
+}
+
+static const int NameIndexTestNumResources = 40;
+static const int NameIndexTestNumCandidates = 2;
+
+static bool BuildNameIndexTestPri(_Inout_ TestHPri* pPri, _In_ CoreProfile* pProfile, _In_ bool useNameIndex)
+{
+    MrmBuildConfiguration* pConfig = pProfile->GetBuildConfiguration();
+    VERIFY(pConfig != nullptr);
+    UINT32 flags = pConfig->GetFlags() & ~MrmBuildConfiguration::UseResourceNameIndexFlag;
+    pConfig->SetFlags(useNameIndex ? (flags | MrmBuildConfiguration::UseResourceNameIndexFlag) : flags);
+
+    if (FAILED(pPri->Init(pProfile)))
+    {
+        Log::Error(L"[ Couldn't init TestPri ]");
+        return false;
+    }
+
+    PriSectionBuilder* pPriBuilder = pPri->GetPriFileBuilder()->GetDescriptor();
+
+    HierarchicalSchemaSectionBuilder* pSchemaBuilder;
+    VERIFY_SUCCEEDED(HierarchicalSchemaSectionBuilder::CreateInstance(pPriBuilder, L"NameIndex", L"NameIndex", 1, &pSchemaBuilder));
+
+    int index;
+    HRESULT hr = pPriBuilder->AddSchemaBuilder(pSchemaBuilder, true, &index);
+    if (FAILED(hr) || (index < 0))
+    {
+        delete pSchemaBuilder;
+        Log::Error(L"[ Failed to add schema builder ]");
+        return false;
+    }
+
+    DecisionInfoBuilder* pDI = pPriBuilder->GetDecisionInfoBuilder();
+    VERIFY(pDI != nullptr);
+    GenerateQualifierSets(pPriBuilder, pDI, NameIndexTestNumCandidates);
+
+    ResourceMapSectionBuilder* pMapBuilder;
+    VERIFY_SUCCEEDED(pPriBuilder->GetOrAddPrimaryResourceMapBuilder(&pMapBuilder));
+    if (!GenerateCandidates(pMapBuilder, NameIndexTestNumResources, NameIndexTestNumCandidates, L"Img/Res%d", L"%s-%d"))
+    {
+        return false;
+    }
+
+    if (FAILED(pPri->Build()) || FAILED(pPri->CreateReader(pProfile)))
+    {
+        Log::Error(L"[ Couldn't build and read back test PRI ]");
+        return false;
+    }
+
+    return true;
+}
+
+static HRESULT GetResourceIndexForPath(_In_ const IResourceMapBase* pMap, _In_ PCWSTR pPath, _Out_ int* pIndexOut)
+{
+    NamedResourceResult resource;
+    *pIndexOut = -1;
+    RETURN_IF_FAILED(pMap->GetResource(pPath, &resource));
+    *pIndexOut = resource.GetResourceIndexInSchema();
+    return S_OK;
+}
+
+void ResourceMapUnitTests::NameIndexLookupTests()
+{
+    String tmp;
+
+    AutoDeletePtr<CoreProfile> pIndexedProfile;
+    AutoDeletePtr<CoreProfile> pPlainProfile;
+    VERIFY_SUCCEEDED(CoreProfile::ChooseDefaultProfile(&pIndexedProfile));
+    VERIFY_SUCCEEDED(CoreProfile::ChooseDefaultProfile(&pPlainProfile));
+
+    TestHPri indexedPri;
+    TestHPri plainPri;
+    if (!BuildNameIndexTestPri(&indexedPri, pIndexedProfile, true) || !BuildNameIndexTestPri(&plainPri, pPlainProfile, false))
+    {
+        return;
+    }
+
+    const IResourceMapBase* pIndexed;
+    const IResourceMapBase* pPlain;
+    VERIFY_SUCCEEDED(indexedPri.GetPriFile()->GetPrimaryResourceMap(&pIndexed));
+    VERIFY_SUCCEEDED(plainPri.GetPriFile()->GetPrimaryResourceMap(&pPlain));
+
+    // Only the indexed file carries the section; the other one always takes the schema walk.
+    const ResourceNameIndexSection* pNameIndex = pIndexed->GetNameIndex();
+    VERIFY(pNameIndex != nullptr);
+    VERIFY(pPlain->GetNameIndex() == nullptr);
+    VERIFY_ARE_EQUAL(pIndexed->GetNumResources(), pPlain->GetNumResources());
+
+    const ResourceMapSubtree* pIndexedRoot = pIndexed->GetRootSubtree();
+    const ResourceMapSubtree* pPlainRoot = pPlain->GetRootSubtree();
+    AutoDeletePtr<const ResourceMapSubtree> pIndexedScope;
+    AutoDeletePtr<const ResourceMapSubtree> pPlainScope;
+    VERIFY_SUCCEEDED(pIndexedRoot->GetSubtree(L"Img", &pIndexedScope));
+    VERIFY_SUCCEEDED(pPlainRoot->GetSubtree(L"Img", &pPlainScope));
+
+    WCHAR name[20];
+    WCHAR relativeName[20];
+    NamedResourceResult resource;
+    for (int iResource = 0; iResource < NameIndexTestNumResources; iResource++)
+    {
+        VERIFY_SUCCEEDED(StringCchPrintf(name, ARRAYSIZE(name), L"Img/Res%d", iResource));
+        VERIFY_SUCCEEDED(StringCchPrintf(relativeName, ARRAYSIZE(relativeName), L"Res%d", iResource));
+
+        int indexedIndex;
+        int plainIndex;
+        VERIFY_SUCCEEDED(GetResourceIndexForPath(pIndexed, name, &indexedIndex));
+        VERIFY_SUCCEEDED(GetResourceIndexForPath(pPlain, name, &plainIndex));
+        VERIFY_ARE_EQUAL(indexedIndex, plainIndex);
+
+        // The indexed lookup must come from the section, not the fallback walk.
+        int probedIndex;
+        VERIFY(pNameIndex->TryFindItem(0, ResourceNameIndexSection::GetInitialPathHash(), name, &probedIndex));
+        VERIFY_ARE_EQUAL(indexedIndex, probedIndex);
+
+        // Subtree lookups extend the scope hash with the relative path.
+        VERIFY_SUCCEEDED(pIndexedScope->GetResource(relativeName, &resource));
+        VERIFY_ARE_EQUAL(indexedIndex, resource.GetResourceIndexInSchema());
+        VERIFY_SUCCEEDED(pPlainScope->GetResource(relativeName, &resource));
+        VERIFY_ARE_EQUAL(plainIndex, resource.GetResourceIndexInSchema());
+    }
+
+    // Case, separator and leading-slash variants hit the index and agree with the walk.
+    static const PCWSTR variants[] = { L"img/res7", L"IMG/RES7", L"Img\\Res7", L"/Img/Res7" };
+    for (unsigned int i = 0; i < ARRAYSIZE(variants); i++)
+    {
+        int indexedIndex;
+        int plainIndex;
+        Log::Comment(tmp.Format(L"[ Looking up \"%s\" ]", variants[i]));
+        VERIFY_SUCCEEDED(GetResourceIndexForPath(pIndexed, variants[i], &indexedIndex));
+        VERIFY_SUCCEEDED(GetResourceIndexForPath(pPlain, variants[i], &plainIndex));
+        VERIFY_ARE_EQUAL(indexedIndex, plainIndex);
+    }
+
+    // Index misses fall back to the schema walk, which gives the same answer as a file without an index.
+    static const PCWSTR misses[] = { L"Img/Res999", L"Img", L"Res7", L"Img//Res7", L"Other/Res7" };
+    for (unsigned int i = 0; i < ARRAYSIZE(misses); i++)
+    {
+        int indexedIndex;
+        int plainIndex;
+        int probedIndex;
+        Log::Comment(tmp.Format(L"[ Looking up \"%s\" ]", misses[i]));
+        VERIFY_IS_FALSE(pNameIndex->TryFindItem(0, ResourceNameIndexSection::GetInitialPathHash(), misses[i], &probedIndex));
+
+        HRESULT indexedHr = GetResourceIndexForPath(pIndexed, misses[i], &indexedIndex);
+        HRESULT plainHr = GetResourceIndexForPath(pPlain, misses[i], &plainIndex);
+        VERIFY_ARE_EQUAL(plainHr, indexedHr);
+        VERIFY_ARE_EQUAL(plainIndex, indexedIndex);
+    }
+}
+
+void ResourceMapUnitTests::DescendentNameTests()
+{
+    String tmp;
+
+    TestHPri pri;
+    AutoDeletePtr<CoreProfile> pProfile;
+    VERIFY_SUCCEEDED(CoreProfile::ChooseDefaultProfile(&pProfile));
+
+    if (FAILED(pri.Init(pProfile)))
+    {
+        Log::Error(L"[ Couldn't init TestPri ]");
+        return;
+    }
+
+    PriSectionBuilder* pPriBuilder = pri.GetPriFileBuilder()->GetDescriptor();
+
+    HierarchicalSchemaSectionBuilder* pSchemaBuilder;
+    VERIFY_SUCCEEDED(HierarchicalSchemaSectionBuilder::CreateInstance(pPriBuilder, L"Descendents", L"Descendents", 1, &pSchemaBuilder));
+
+    int index;
+    HRESULT hr = pPriBuilder->AddSchemaBuilder(pSchemaBuilder, true, &index);
+    if (FAILED(hr) || (index < 0))
+    {
+        delete pSchemaBuilder;
+        Log::Error(tmp.Format(L"[ Failed to add schema builder (0x%x) ]", hr));
+        return;
+    }
+
+    ResourceMapSectionBuilder* pMapBuilder;
+    VERIFY_SUCCEEDED(pPriBuilder->GetOrAddPrimaryResourceMapBuilder(&pMapBuilder));
+
+    // Enough resources, spread over nested scopes, to span several name windows.
+    const int numResources = 300;
+    WCHAR name[40];
+    for (int i = 0; i < numResources; i++)
+    {
+        VERIFY_SUCCEEDED(StringCchPrintf(name, ARRAYSIZE(name), L"Dir%d/Sub%d/Res%d", i % 5, i % 3, i));
+        VERIFY_SUCCEEDED(pMapBuilder->AddCandidateWithInternalString(name, MrmEnvironment::ResourceValueType_Utf16String, name, 0));
+    }
+
+    if (FAILED(pri.Build()) || FAILED(pri.CreateReader(pProfile)))
+    {
+        Log::Error(L"[ Couldn't build and read back test PRI ]");
+        return;
+    }
+
+    const IResourceMapBase* pResources;
+    VERIFY_SUCCEEDED(pri.GetPriFile()->GetPrimaryResourceMap(&pResources));
+    const ResourceMapSubtree* pRoot = pResources->GetRootSubtree();
+    VERIFY_ARE_EQUAL(numResources, pRoot->GetNumDescendentResources());
+
+    // Forward, backward and strided access must all give the name the schema
+    // builds for that item on its own.
+    int order[3 * numResources];
+    for (int i = 0; i < numResources; i++)
+    {
+        order[i] = i;
+        order[numResources + i] = numResources - 1 - i;
+        order[(2 * numResources) + i] = (i * 37) % numResources;
+    }
+
+    for (unsigned int i = 0; i < ARRAYSIZE(order); i++)
+    {
+        NamedResourceResult resource;
+        StringResult gotName;
+        StringResult wantName;
+        VERIFY_SUCCEEDED(pRoot->GetDescendentResource(order[i], &resource));
+        VERIFY_SUCCEEDED(pRoot->GetDescendentResourceName(order[i], &gotName));
+        VERIFY(pResources->GetSchema()->TryGetRelativeItemName(0, resource.GetResourceIndexInSchema(), &wantName));
+        VERIFY_ARE_EQUAL(Def_Equal, DefString_Compare(gotName.GetRef(), wantName.GetRef()));
+    }
+
+    StringResult pastEnd;
+    VERIFY_FAILED(pRoot->GetDescendentResourceName(numResources, &pastEnd));
+}
+
 } // namespace UnitTests
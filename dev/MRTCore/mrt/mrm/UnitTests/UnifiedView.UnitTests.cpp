@@ -73,6 +73,12 @@ public:
     END_TEST_METHOD();
 
     TEST_METHOD(EnvironmentValidationTests);
+
+    TEST_METHOD(CaseInsensitiveIndexTests);
+
+    TEST_METHOD(ManyFilesLookupTests);
+
+    TEST_METHOD(LoadManyPriFilesTests);
 };
 
 bool UnifiedResourceViewUnitTests::ClassSetup()
@@ -1183,4 +1189,244 @@ void UnifiedResourceViewUnitTests::EnvironmentValidationTests()
     VERIFY_ARE_EQUAL(hr, HRESULT_FROM_WIN32(ERROR_MRM_UNKNOWN_QUALIFIER));
 }
 
+void UnifiedResourceViewUnitTests::CaseInsensitiveIndexTests()
+{
+    String tmp;
+
+    // Every character upper-cases to one that compares equal to it, so keys
+    // that compare equal hash alike.
+    for (UINT32 ch = 1; ch < 0x10000; ch++)
+    {
+        if ((ch >= 0xd800) && (ch < 0xe000))
+        {
+            continue;
+        }
+
+        WCHAR self[] = { static_cast<WCHAR>(ch), L'\0' };
+        WCHAR upper[] = { DefString_ToUpperOrdinal(static_cast<WCHAR>(ch)), L'\0' };
+        if (DefString_ICompare(self, upper) != Def_Equal)
+        {
+            VERIFY_FAIL(tmp.Format(L"U+%04X upper-cases to U+%04X, which doesn't compare equal", ch, upper[0]));
+        }
+    }
+
+    static const PCWSTR equivalent[][2] = {
+        { L"Resources", L"rESOURCES" },
+        { L"\x00e9t\x00e9", L"\x00c9T\x00c9" },
+        { L"\x041f\x0440\x0438\x0432\x0435\x0442", L"\x043f\x0420\x0418\x0412\x0415\x0422" },
+        { L"\x03b1\x03b2\x03b3", L"\x0391\x0392\x0393" },
+    };
+
+    for (unsigned int i = 0; i < ARRAYSIZE(equivalent); i++)
+    {
+        VERIFY_ARE_EQUAL(Def_Equal, DefString_ICompare(equivalent[i][0], equivalent[i][1]));
+        VERIFY_ARE_EQUAL(
+            CaseInsensitiveStringIndex::ComputeHash(equivalent[i][0]), CaseInsensitiveStringIndex::ComputeHash(equivalent[i][1]));
+    }
+
+    // Letters hash apart, in any alphabet.
+    VERIFY_ARE_NOT_EQUAL(CaseInsensitiveStringIndex::ComputeHash(L"A"), CaseInsensitiveStringIndex::ComputeHash(L"B"));
+    VERIFY_ARE_NOT_EQUAL(CaseInsensitiveStringIndex::ComputeHash(L"map"), CaseInsensitiveStringIndex::ComputeHash(L"mad"));
+    VERIFY_ARE_NOT_EQUAL(CaseInsensitiveStringIndex::ComputeHash(L"\x0430"), CaseInsensitiveStringIndex::ComputeHash(L"\x0431"));
+    VERIFY_ARE_NOT_EQUAL(CaseInsensitiveStringIndex::ComputeHash(L"\x03b1"), CaseInsensitiveStringIndex::ComputeHash(L"\x03b2"));
+    VERIFY_ARE_NOT_EQUAL(CaseInsensitiveStringIndex::ComputeHash(L"\x00e9"), CaseInsensitiveStringIndex::ComputeHash(L"\x00e8"));
+    VERIFY_ARE_NOT_EQUAL(CaseInsensitiveStringIndex::ComputeHash(L"\x4e2d"), CaseInsensitiveStringIndex::ComputeHash(L"\x6587"));
+
+    // Whatever the compare decides for the dotless i, long s and Kelvin sign,
+    // a key that matches can always be found through the index.
+    AutoDeletePtr<CaseInsensitiveStringIndex> pIndex;
+    VERIFY_SUCCEEDED(CaseInsensitiveStringIndex::CreateInstance(4, &pIndex));
+
+    static const PCWSTR keys[] = { L"Files/Icon.png", L"Strings/Settings", L"Kind" };
+    for (unsigned int i = 0; i < ARRAYSIZE(keys); i++)
+    {
+        VERIFY_SUCCEEDED(pIndex->Add(CaseInsensitiveStringIndex::ComputeHash(keys[i]), static_cast<int>(i)));
+    }
+
+    static const PCWSTR lookups[] = { L"files/\x0131" L"con.png", L"\x017ftrings/\x017f" L"ettings", L"\x212a" L"ind" };
+    for (unsigned int i = 0; i < ARRAYSIZE(lookups); i++)
+    {
+        UINT cursor = 0;
+        int value;
+        bool found = false;
+        while (pIndex->TryGetNext(CaseInsensitiveStringIndex::ComputeHash(lookups[i]), &cursor, &value))
+        {
+            found = found || (value == static_cast<int>(i));
+        }
+        VERIFY(found || (DefString_ICompare(lookups[i], keys[i]) != Def_Equal));
+    }
+}
+
+void UnifiedResourceViewUnitTests::ManyFilesLookupTests()
+{
+    const int numFiles = 64;
+    String tmp;
+
+    if (!SetupTestMethodOutputFolder(L"ManyFilesLookupTests"))
+    {
+        return;
+    }
+
+    AutoDeletePtr<CoreProfile> pProfile;
+    VERIFY_SUCCEEDED(CoreProfile::ChooseDefaultProfile(&pProfile));
+
+    AutoDeletePtr<UnifiedResourceView> pView;
+    VERIFY_SUCCEEDED(UnifiedResourceView::CreateInstance(pProfile, &pView));
+
+    // One small PRI per framework package, each with its own resource map
+    String* paths = new String[numFiles];
+    for (int i = 0; i < numFiles; i++)
+    {
+        String packageName;
+        packageName.Format(L"Microsoft.Framework.%03d", i);
+
+        AutoDeletePtr<PriFileBuilder> pBuilder;
+        VERIFY_SUCCEEDED(PriFileBuilder::CreateInstance((PCWSTR)packageName, 1, pProfile, &pBuilder));
+        VERIFY_SUCCEEDED(pBuilder->GetDescriptor()->AddCandidateWithString(
+            nullptr, L"Resources/Greeting", MrmEnvironment::ResourceValueType_Utf16String, (PCWSTR)packageName, nullptr));
+
+        VERIFY_IS_NOT_NULL(GetOutputFilePath(tmp.Format(L"Framework%03d.pri", i), paths[i]));
+        VERIFY_SUCCEEDED(pBuilder->WriteToFile((PCWSTR)paths[i]));
+
+        const ManagedResourceMap* pMap;
+        VERIFY_SUCCEEDED(pView->GetOrAddReferencedFile((PCWSTR)paths[i], nullptr, &pMap, nullptr));
+    }
+    VERIFY_ARE_EQUAL(numFiles, pView->GetNumReferencedFiles());
+
+    // Lookups by map name, in a different case than the one we built with
+    for (int i = 0; i < numFiles; i++)
+    {
+        const IResourceMapBase* pMap;
+        VERIFY_SUCCEEDED(pView->GetResourceMapById(tmp.Format(L"MICROSOFT.FRAMEWORK.%03d", i), &pMap));
+        VERIFY_IS_NOT_NULL(pMap);
+
+        const ManagedResourceMap* pExpected;
+        VERIFY_SUCCEEDED(pView->GetOrAddReferencedFile((PCWSTR)paths[i], nullptr, &pExpected, nullptr));
+        VERIFY_ARE_EQUAL(static_cast<const IResourceMapBase*>(pExpected), pMap);
+    }
+
+    const IResourceMapBase* pMissing;
+    VERIFY_ARE_EQUAL(HRESULT_FROM_WIN32(ERROR_NOT_FOUND), pView->GetResourceMapById(L"Microsoft.Framework.Missing", &pMissing));
+
+    // Lookups by file path, through the file manager and the view
+    for (int i = 0; i < numFiles; i++)
+    {
+        ManagedFile* pFile;
+        VERIFY_SUCCEEDED(pView->GetFileManager()->GetFile((PCWSTR)paths[i], &pFile));
+        VERIFY_IS_NOT_NULL(pFile);
+    }
+
+    // Removing a file moves the ones after it, so make sure they're still found
+    // at their new positions.
+    VERIFY_SUCCEEDED(pView->RemoveFileReference((PCWSTR)paths[0]));
+    for (int i = 1; i < numFiles; i++)
+    {
+        const ManagedResourceMap* pMap;
+        int index = -1;
+        VERIFY_SUCCEEDED(pView->GetOrAddReferencedFile((PCWSTR)paths[i], nullptr, &pMap, &index));
+        VERIFY_ARE_EQUAL(i - 1, index);
+    }
+    VERIFY_ARE_EQUAL(numFiles - 1, pView->GetNumReferencedFiles());
+
+    delete[] paths;
+}
+
+static void DeleteLoadedPriFilesInfo(_In_opt_ DynamicArray<UnifiedResourceView::PriFileInfo*>* pLoadedPriFilesInfo)
+{
+    if (pLoadedPriFilesInfo != nullptr)
+    {
+        for (UINT i = 0; i < pLoadedPriFilesInfo->Count(); i++)
+        {
+            UnifiedResourceView::PriFileInfo* pInfo;
+            if (SUCCEEDED(pLoadedPriFilesInfo->Get(i, &pInfo)))
+            {
+                delete pInfo;
+            }
+        }
+        delete pLoadedPriFilesInfo;
+    }
+}
+
+void UnifiedResourceViewUnitTests::LoadManyPriFilesTests()
+{
+    const int numFiles = 64;
+    String tmp;
+
+    if (!SetupTestMethodOutputFolder(L"LoadManyPriFilesTests"))
+    {
+        return;
+    }
+
+    AutoDeletePtr<CoreProfile> pProfile;
+    VERIFY_SUCCEEDED(CoreProfile::ChooseDefaultProfile(&pProfile));
+
+    StringResult* paths = new StringResult[numFiles];
+    DynamicArray<StringResult*> pathsCollection;
+    for (int i = 0; i < numFiles; i++)
+    {
+        String packageName;
+        packageName.Format(L"Microsoft.ResourcePack.%03d", i);
+
+        AutoDeletePtr<PriFileBuilder> pBuilder;
+        VERIFY_SUCCEEDED(PriFileBuilder::CreateInstance((PCWSTR)packageName, 1, pProfile, &pBuilder));
+        VERIFY_SUCCEEDED(pBuilder->GetDescriptor()->AddCandidateWithString(
+            nullptr, L"Resources/Greeting", MrmEnvironment::ResourceValueType_Utf16String, (PCWSTR)packageName, nullptr));
+
+        String path;
+        VERIFY_IS_NOT_NULL(GetOutputFilePath(tmp.Format(L"ResourcePack%03d.pri", i), path));
+        VERIFY_SUCCEEDED(pBuilder->WriteToFile((PCWSTR)path));
+
+        VERIFY_SUCCEEDED(paths[i].SetCopy((PCWSTR)path));
+        VERIFY_SUCCEEDED(pathsCollection.Add(&paths[i]));
+    }
+
+    AutoDeletePtr<UnifiedResourceView> pView;
+    VERIFY_SUCCEEDED(UnifiedResourceView::CreateInstance(pProfile, &pView));
+
+    DynamicArray<UnifiedResourceView::PriFileInfo*>* pLoadedPriFilesInfo = nullptr;
+    VERIFY_SUCCEEDED(pView->LoadPriFiles(EXPLICIT_LOAD, &pathsCollection, LoadPriFlags::Default, &pLoadedPriFilesInfo));
+
+    // Files are attached in input order no matter which order they were loaded in
+    VERIFY_ARE_EQUAL(static_cast<UINT>(numFiles), pLoadedPriFilesInfo->Count());
+    VERIFY_ARE_EQUAL(numFiles, pView->GetNumReferencedFiles());
+    for (int i = 0; i < numFiles; i++)
+    {
+        UnifiedResourceView::PriFileInfo* pInfo;
+        VERIFY_SUCCEEDED(pLoadedPriFilesInfo->Get(i, &pInfo));
+        VERIFY_IS_TRUE(pInfo->GetFileLoaded());
+        VERIFY_ARE_EQUAL(static_cast<UINT>(i), pInfo->GetInputFilesIndex());
+        VERIFY_ARE_EQUAL(i, pInfo->GetLoadedFileIndex());
+
+        const IResourceMapBase* pMap;
+        VERIFY_SUCCEEDED(pView->GetResourceMapById(tmp.Format(L"Microsoft.ResourcePack.%03d", i), &pMap));
+    }
+    DeleteLoadedPriFilesInfo(pLoadedPriFilesInfo);
+    pLoadedPriFilesInfo = nullptr;
+
+    // A missing file fails the whole batch with the same error wherever it is,
+    // including first, where preloading stops before opening anything else,
+    // and nothing is added to the view.
+    String missingPath;
+    VERIFY_IS_NOT_NULL(GetOutputFilePath(L"Missing.pri", missingPath));
+    StringResult missing;
+    VERIFY_SUCCEEDED(missing.SetCopy((PCWSTR)missingPath));
+
+    const UINT missingIndices[] = {0, numFiles / 2, numFiles};
+    for (int i = 0; i < ARRAYSIZE(missingIndices); i++)
+    {
+        AutoDeletePtr<UnifiedResourceView> pFailView;
+        VERIFY_SUCCEEDED(UnifiedResourceView::CreateInstance(pProfile, &pFailView));
+
+        VERIFY_SUCCEEDED(pathsCollection.Insert(&missing, missingIndices[i]));
+        VERIFY_ARE_EQUAL(
+            HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            pFailView->LoadPriFiles(EXPLICIT_LOAD, &pathsCollection, LoadPriFlags::Default, &pLoadedPriFilesInfo));
+        VERIFY_IS_NULL(pLoadedPriFilesInfo);
+        VERIFY_ARE_EQUAL(0, pFailView->GetNumReferencedFiles());
+        VERIFY_SUCCEEDED(pathsCollection.Delete(missingIndices[i]));
+    }
+
+    delete[] paths;
+}
+
 } // namespace UnitTests
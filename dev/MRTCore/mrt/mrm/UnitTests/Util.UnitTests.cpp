@@ -31,6 +31,7 @@ public:
     TEST_METHOD(UTF8StringsViaCodePoints);
     TEST_METHOD(AsciiStringsViaCodePoints);
     TEST_METHOD(InvalidCharactersReturnUtf16);
+    TEST_METHOD(SizesAndEncodingMatchWideCharToMultiByte);
 
 private:
     PWSTR GetEncodingNameString(_In_ DEFSTRING_ENCODING encoding);
@@ -608,6 +609,90 @@ void ChooseBestEncodingUnitTests::InvalidCharactersReturnUtf16()
     ValidateStringFromCodePoints(stringSix, ARRAYSIZE(stringSix), DEFSTRING_ENCODING_UTF16);
 }
 
+// The vectorized chooser must agree with the system encoder at every alignment, and
+// its UTF-8 size must be exactly what DefString_EncodeUtf16AsUtf8 writes.
+void ChooseBestEncodingUnitTests::SizesAndEncodingMatchWideCharToMultiByte()
+{
+    const size_t cchMax = 200;
+    __declspec(align(16)) WCHAR buffer[cchMax + 16];
+    char expected[(cchMax + 1) * 3];
+    char actual[(cchMax + 1) * 3];
+    UINT32 seed = 12345;
+
+    for (int n = 0; n < 20000; n++)
+    {
+        seed = (seed * 1103515245) + 12345;
+        size_t cchString = (seed >> 16) % cchMax;
+        size_t offset = (seed >> 8) % 8;
+        bool asciiOnly = ((n % 3) == 0);
+
+        PWSTR pString = &buffer[offset];
+        for (size_t i = 0; i < cchString; i++)
+        {
+            seed = (seed * 1103515245) + 12345;
+            UINT32 random = (seed >> 8);
+            UINT32 kind = (asciiOnly ? 0 : ((random % 16) < 10 ? 0 : (random % 4)));
+            switch (kind)
+            {
+            case 0:
+                pString[i] = static_cast<WCHAR>(1 + ((random >> 4) % 0x7f));
+                break;
+            case 1:
+                pString[i] = static_cast<WCHAR>(0x80 + ((random >> 4) % 0x780));
+                break;
+            case 2:
+                pString[i] = static_cast<WCHAR>(0x800 + ((random >> 4) % 0xf800));
+                break;
+            default:
+                pString[i] = static_cast<WCHAR>(0xd800 + ((random >> 4) % 0x400));
+                if ((i + 1) < cchString)
+                {
+                    pString[++i] = static_cast<WCHAR>(0xdc00 + ((random >> 14) % 0x400));
+                }
+                break;
+            }
+        }
+        pString[cchString] = L'\0';
+
+        int cbExpected = WideCharToMultiByte(
+            CP_UTF8, WC_ERR_INVALID_CHARS, pString, static_cast<int>(cchString + 1), expected, ARRAYSIZE(expected), nullptr, nullptr);
+
+        size_t cchUtf16IncludingNull;
+        size_t cbUtf8IncludingNull;
+        DEFSTRING_ENCODING encoding = DefString_ChooseBestEncodingWithSizes(pString, &cchUtf16IncludingNull, &cbUtf8IncludingNull);
+        VERIFY_ARE_EQUAL(cchString + 1, cchUtf16IncludingNull);
+        VERIFY_ARE_EQUAL(DefString_ChooseBestEncoding(pString), encoding);
+
+        if (cbExpected == 0)
+        {
+            // Unpaired surrogates, including a lead surrogate cut off by the end of the string.
+            VERIFY_ARE_EQUAL(DEFSTRING_ENCODING_UTF16, encoding);
+            VERIFY_ARE_EQUAL(0u, cbUtf8IncludingNull);
+            continue;
+        }
+
+        VERIFY_ARE_EQUAL(static_cast<size_t>(cbExpected), cbUtf8IncludingNull);
+        if (cbUtf8IncludingNull == cchUtf16IncludingNull)
+        {
+            VERIFY_ARE_EQUAL(DEFSTRING_ENCODING_ASCII, encoding);
+        }
+        else
+        {
+            VERIFY_ARE_EQUAL(
+                ((cchUtf16IncludingNull * sizeof(WCHAR)) <= cbUtf8IncludingNull) ? DEFSTRING_ENCODING_UTF16 : DEFSTRING_ENCODING_UTF8, encoding);
+        }
+
+        size_t cbWritten;
+        VERIFY_SUCCEEDED(DefString_EncodeUtf16AsUtf8(pString, cchUtf16IncludingNull, actual, cbUtf8IncludingNull, &cbWritten));
+        VERIFY_ARE_EQUAL(cbUtf8IncludingNull, cbWritten);
+        VERIFY_ARE_EQUAL(0, memcmp(expected, actual, cbWritten));
+
+        VERIFY_ARE_EQUAL(
+            HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER),
+            DefString_EncodeUtf16AsUtf8(pString, cchUtf16IncludingNull, actual, cbUtf8IncludingNull - 1, &cbWritten));
+    }
+}
+
 class StringConversionUnitTests : public WEX::TestClass<StringConversionUnitTests>
 {
 public:
@@ -616,8 +701,274 @@ public:
     TEST_METHOD(RoundTripThroughPublicFunctionAscii);
     TEST_METHOD(RoundTripThroughPublicFunctionUtf8);
     TEST_METHOD(InvalidUtf8);
+    TEST_METHOD(Utf8MatchesMultiByteToWideChar);
+    TEST_METHOD(AsciiMatchesByteWidening);
+    TEST_METHOD(Utf16ToUtf8MatchesWideCharToMultiByte);
+    TEST_METHOD(LongStringsMatchMultiByteToWideChar);
 };
 
+// Pieces the UTF-8 fuzz tests assemble strings from: ASCII, the first and last
+// well-formed sequence of each lead byte range, and the ill-formed neighbours of
+// each (overlongs, surrogates, values past U+10FFFF, stray continuation bytes
+// and truncated sequences).
+static const char* const c_utf8FuzzPieces[] = {
+    "a", "Z", "~", "\x7f", "\x01",
+    "\xc2\x80", "\xdf\xbf", "\xe0\xa0\x80", "\xe4\xb8\xad", "\xed\x9f\xbf", "\xee\x80\x80", "\xef\xbf\xbf",
+    "\xf0\x90\x80\x80", "\xf4\x8f\xbf\xbf",
+    "\xc0\xaf", "\xc1\xbf", "\xe0\x9f\xbf", "\xed\xa0\x80", "\xf0\x8f\xbf\xbf", "\xf4\x90\x80\x80", "\xf5\x80\x80\x80",
+    "\xff", "\x80", "\xbf", "\xc2", "\xe4\xb8", "\xf0\x90\x80",
+};
+
+// Builds a pseudo-random string of up to cbMax bytes (not null-terminated) and returns its length.
+static size_t BuildUtf8FuzzString(_Inout_ UINT32* pSeed, _Out_writes_(cbMax) char* pBuffer, _In_ size_t cbMax)
+{
+    size_t cb = 0;
+    *pSeed = (*pSeed * 1103515245) + 12345;
+    size_t numPieces = ((*pSeed >> 8) % 24) + 1;
+    for (size_t i = 0; i < numPieces; i++)
+    {
+        *pSeed = (*pSeed * 1103515245) + 12345;
+        UINT32 choice = (*pSeed >> 8);
+        if ((choice % 4) == 0)
+        {
+            // A run of ASCII long enough to reach the vector loops and their tails.
+            size_t cbRun = ((choice >> 4) % 70);
+            for (size_t j = 0; (j < cbRun) && (cb < cbMax); j++)
+            {
+                pBuffer[cb++] = static_cast<char>(' ' + ((choice + j) % 95));
+            }
+        }
+        else
+        {
+            PCSTR pPiece = c_utf8FuzzPieces[(choice >> 4) % ARRAYSIZE(c_utf8FuzzPieces)];
+            for (size_t j = 0; (pPiece[j] != '\0') && (cb < cbMax); j++)
+            {
+                pBuffer[cb++] = pPiece[j];
+            }
+        }
+    }
+    return cb;
+}
+
+// Differential test against the system decoder: every fuzzed string, and every
+// truncation of it, must succeed or fail the same way and produce the same text.
+// DefString_IsValidUtf8 must accept exactly the strings that convert.
+void StringConversionUnitTests::Utf8MatchesMultiByteToWideChar()
+{
+    const size_t cbMax = 512;
+    char buffer[cbMax + 1];
+    WCHAR expected[cbMax + 1];
+    UINT32 seed = 12345;
+
+    for (int n = 0; n < 20000; n++)
+    {
+        size_t cbString = BuildUtf8FuzzString(&seed, buffer, cbMax);
+        buffer[cbString] = '\0';
+
+        // Whole string including the null, then a prefix that may split a sequence.
+        size_t cbTests[] = {cbString + 1, (cbString / 2) + 1};
+        for (size_t t = 0; t < ARRAYSIZE(cbTests); t++)
+        {
+            int cchExpected =
+                MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, buffer, static_cast<int>(cbTests[t]), expected, ARRAYSIZE(expected));
+            HRESULT hrExpected = ((cchExpected > 0) ? S_OK : HRESULT_FROM_WIN32(GetLastError()));
+
+            size_t cchUtf16IncludingNull;
+            PWSTR pszUtf16;
+            HRESULT hr = DefString_ConvertUtf8ToUtf16(buffer, cbTests[t], &cchUtf16IncludingNull, &pszUtf16);
+            VERIFY_ARE_EQUAL(hrExpected, hr);
+            VERIFY_ARE_EQUAL(SUCCEEDED(hr), (DefString_IsValidUtf8(buffer, cbTests[t]) != FALSE));
+            if (FAILED(hr))
+            {
+                VERIFY_IS_NULL(pszUtf16);
+                VERIFY_ARE_EQUAL(cchUtf16IncludingNull, 0u);
+                continue;
+            }
+
+            VERIFY_IS_NOT_NULL(pszUtf16);
+            VERIFY_ARE_EQUAL(static_cast<size_t>(cchExpected), cchUtf16IncludingNull);
+            VERIFY_ARE_EQUAL(0, memcmp(expected, pszUtf16, cchUtf16IncludingNull * sizeof(WCHAR)));
+            _DefFree(pszUtf16);
+        }
+    }
+}
+
+// Differential test against the system encoder, including unpaired surrogates.
+void StringConversionUnitTests::Utf16ToUtf8MatchesWideCharToMultiByte()
+{
+    const size_t cchMax = 128;
+    WCHAR buffer[cchMax + 1];
+    char expected[(cchMax + 1) * 3];
+    UINT32 seed = 12345;
+
+    for (int n = 0; n < 20000; n++)
+    {
+        seed = (seed * 1103515245) + 12345;
+        size_t cchString = (seed >> 16) % cchMax;
+        for (size_t i = 0; i < cchString; i++)
+        {
+            seed = (seed * 1103515245) + 12345;
+            UINT32 random = (seed >> 8);
+            switch (random % 5)
+            {
+            case 0:
+                buffer[i] = static_cast<WCHAR>(1 + ((random >> 4) % 0x7f));
+                break;
+            case 1:
+                buffer[i] = static_cast<WCHAR>(0x80 + ((random >> 4) % 0x780));
+                break;
+            case 2:
+                buffer[i] = static_cast<WCHAR>(0x800 + ((random >> 4) % 0xf800));
+                break;
+            default:
+                // Mostly well-formed pairs, sometimes a lone or reversed surrogate.
+                buffer[i] = static_cast<WCHAR>(0xd800 + ((random >> 4) % 0x800));
+                if (((random & 0x8) == 0) && (buffer[i] < 0xdc00) && ((i + 1) < cchString))
+                {
+                    buffer[++i] = static_cast<WCHAR>(0xdc00 + ((random >> 16) % 0x400));
+                }
+                break;
+            }
+        }
+        buffer[cchString] = L'\0';
+
+        int cbExpected = WideCharToMultiByte(
+            CP_UTF8, WC_ERR_INVALID_CHARS, buffer, static_cast<int>(cchString + 1), expected, ARRAYSIZE(expected), nullptr, nullptr);
+        HRESULT hrExpected = ((cbExpected > 0) ? S_OK : HRESULT_FROM_WIN32(GetLastError()));
+
+        size_t cbUtf8IncludingNull;
+        PSTR pszUtf8;
+        HRESULT hr = DefString_ConvertUtf16ToUtf8(buffer, cchString + 1, &cbUtf8IncludingNull, &pszUtf8);
+        VERIFY_ARE_EQUAL(hrExpected, hr);
+        if (FAILED(hr))
+        {
+            VERIFY_IS_NULL(pszUtf8);
+            continue;
+        }
+
+        VERIFY_ARE_EQUAL(static_cast<size_t>(cbExpected), cbUtf8IncludingNull);
+        VERIFY_ARE_EQUAL(0, memcmp(expected, pszUtf8, cbUtf8IncludingNull));
+
+        // And back again.
+        size_t cchUtf16IncludingNull;
+        PWSTR pszUtf16;
+        VERIFY_SUCCEEDED(DefString_ConvertUtf8ToUtf16(pszUtf8, cbUtf8IncludingNull, &cchUtf16IncludingNull, &pszUtf16));
+        VERIFY_ARE_EQUAL(cchString + 1, cchUtf16IncludingNull);
+        VERIFY_ARE_EQUAL(0, memcmp(buffer, pszUtf16, cchUtf16IncludingNull * sizeof(WCHAR)));
+
+        _DefFree(pszUtf16);
+        _DefFree(pszUtf8);
+    }
+}
+
+// Every length and alignment around the vector widths, with and without bytes above 0x7f.
+void StringConversionUnitTests::AsciiMatchesByteWidening()
+{
+    const size_t cbMax = 200;
+    char buffer[cbMax + 16];
+    UINT32 seed = 12345;
+
+    for (size_t cb = 1; cb <= cbMax; cb++)
+    {
+        for (size_t offset = 0; offset < 16; offset += 5)
+        {
+            for (int highBytes = 0; highBytes < 2; highBytes++)
+            {
+                bool isAscii = true;
+                for (size_t i = 0; i < cb; i++)
+                {
+                    seed = (seed * 1103515245) + 12345;
+                    BYTE value = static_cast<BYTE>((seed >> 16) & ((highBytes != 0) ? 0xff : 0x7f));
+                    buffer[offset + i] = static_cast<char>(value);
+                    isAscii = isAscii && (value <= 0x7f);
+                }
+
+                PWSTR pszUtf16;
+                HRESULT hr = DefString_ConvertAsciiToUtf16(&buffer[offset], cb, &pszUtf16);
+#ifdef DBG
+                if (!isAscii)
+                {
+                    VERIFY_ARE_EQUAL(E_INVALIDARG, hr);
+                    VERIFY_IS_NULL(pszUtf16);
+                    continue;
+                }
+#endif
+                VERIFY_SUCCEEDED(hr);
+                for (size_t i = 0; i < cb; i++)
+                {
+                    // Zero-extended, never sign-extended.
+                    VERIFY_ARE_EQUAL(static_cast<WCHAR>(static_cast<BYTE>(buffer[offset + i])), pszUtf16[i]);
+                }
+                _DefFree(pszUtf16);
+            }
+        }
+    }
+}
+
+// Long runs of one script, so the conversions spend most of their time in their bulk paths,
+// and ASCII runs broken by a single non-ASCII character at every position near the start.
+void StringConversionUnitTests::LongStringsMatchMultiByteToWideChar()
+{
+    PCWSTR const c_pszSamples[] = {L"Resource string ", L"Caf\u00e9 cr\u00e8me ", L"\u4e2d\u6587\u5b57\u7b26\u4e32"};
+    const size_t lengths[] = {4, 16, 64, 256, 4096};
+
+    static WCHAR source[4096 + 1];
+    static char utf8[(4096 * 3) + 1];
+    static WCHAR expected[4096 + 1];
+
+    for (int s = 0; s < ARRAYSIZE(c_pszSamples); s++)
+    {
+        for (int l = 0; l < ARRAYSIZE(lengths); l++)
+        {
+            size_t cchSample = wcslen(c_pszSamples[s]);
+            for (size_t i = 0; i < lengths[l]; i++)
+            {
+                source[i] = c_pszSamples[s][i % cchSample];
+            }
+            source[lengths[l]] = L'\0';
+
+            // -1 converts the run as it is.
+            int numBreaks = ((s == 0) ? static_cast<int>((lengths[l] < 40) ? lengths[l] : 40) : 0);
+            for (int breakAt = -1; breakAt < numBreaks; breakAt++)
+            {
+                if (breakAt >= 0)
+                {
+                    source[breakAt] = L'\u00e9';
+                }
+
+                int cbUtf8 =
+                    WideCharToMultiByte(CP_UTF8, 0, source, static_cast<int>(lengths[l] + 1), utf8, sizeof(utf8), nullptr, nullptr);
+                VERIFY_IS_TRUE(cbUtf8 > 0);
+                int cchExpected = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, utf8, cbUtf8, expected, ARRAYSIZE(expected));
+                VERIFY_ARE_EQUAL(static_cast<int>(lengths[l] + 1), cchExpected);
+
+                size_t cchUtf16IncludingNull;
+                PWSTR pszUtf16;
+                VERIFY_SUCCEEDED(DefString_ConvertUtf8ToUtf16(utf8, cbUtf8, &cchUtf16IncludingNull, &pszUtf16));
+                VERIFY_ARE_EQUAL(static_cast<size_t>(cchExpected), cchUtf16IncludingNull);
+                VERIFY_ARE_EQUAL(0, memcmp(expected, pszUtf16, cchUtf16IncludingNull * sizeof(WCHAR)));
+                _DefFree(pszUtf16);
+
+                if (breakAt >= 0)
+                {
+                    source[breakAt] = c_pszSamples[s][breakAt % cchSample];
+                }
+            }
+
+            if (s == 0)
+            {
+                int cbAscii =
+                    WideCharToMultiByte(CP_UTF8, 0, source, static_cast<int>(lengths[l] + 1), utf8, sizeof(utf8), nullptr, nullptr);
+                VERIFY_ARE_EQUAL(static_cast<int>(lengths[l] + 1), cbAscii);
+                PWSTR pszUtf16;
+                VERIFY_SUCCEEDED(DefString_ConvertAsciiToUtf16(utf8, cbAscii, &pszUtf16));
+                VERIFY_ARE_EQUAL(0, memcmp(source, pszUtf16, cbAscii * sizeof(WCHAR)));
+                _DefFree(pszUtf16);
+            }
+        }
+    }
+}
+
 // Round trip through public function.
 void StringConversionUnitTests::RoundTripThroughPublicFunctionAscii()
 {
@@ -394,6 +394,21 @@ public:
         */
     virtual Atom::Index GetNumAtoms() const = 0;
 
+    /*!
+        * Adds the strings of the first numAtoms atoms to a checksum, as
+        * DefChecksum::ComputeAtomPoolChecksum would, stopping at the first
+        * string that can't be retrieved.  Pools that can do this without
+        * building each string override it; the default returns E_NOTIMPL.
+        */
+    virtual HRESULT ComputeStringsChecksum(
+        _In_ DEF_CHECKSUM partialChecksum,
+        _In_ Atom::Index /* numAtoms */,
+        _Out_ DEF_CHECKSUM* checksum) const
+    {
+        *checksum = partialChecksum;
+        return E_NOTIMPL;
+    }
+
     // Most pools currently don't implement this so default to a non-implementation.
     virtual HRESULT Clone(_Outptr_ IAtomPool** /* clonedPool */) { return E_NOTIMPL; }
 };
@@ -97,6 +97,23 @@ public:
         _In_opt_ PCWSTR stringToAdd,
         _Out_ Checksum* checksum);
 
+    /*!
+     * Adds the length prefix that ComputeStringChecksum adds for a non-NULL
+     * string of cchString characters.  Callers that produce a string in pieces
+     * can follow this with _DefComputeStringCrc32 over the pieces and the
+     * terminating NULL to get the same checksum without building the string.
+     *
+     * \param partialChecksum
+     * A partially calculated checksum.
+     *
+     * \param cchString
+     * The length of the string, not including the terminating NULL.
+     *
+     * \return Checksum
+     * Returns the updated checksum
+     */
+    static Checksum ComputeStringLengthChecksum(_In_ Checksum partialChecksum, _In_ UINT32 cchString);
+
     /*! 
      * Adds a supplied atom pool to a DEF checksum.  Adding an atom pool:
      * - Adds the description of the atom pool as a case-insensitive, NULL-terminated
@@ -236,7 +253,39 @@ public:
         return ComputeStringArrayChecksum(m_cs, flags, numStrings, strings, checksum);
     }
 
+    /*!
+     * Computes a 64-bit fingerprint of a data blob, for hashing in memory.
+     * Fingerprints are fast to compute and well mixed but are not stable
+     * across versions, so they must never be persisted.  Never returns 0,
+     * so callers can use 0 to mark an empty hash slot.
+     *
+     * \param data
+     * The data to be fingerprinted.
+     *
+     * \param dataSizeInBytes
+     * The size of data, in bytes.
+     *
+     * \return UINT64
+     * Returns the fingerprint.
+     */
+    static UINT64 ComputeFingerprint(_In_reads_bytes_(dataSizeInBytes) const void* data, _In_ size_t dataSizeInBytes);
+
+    /*!
+     * Computes the checksum of the size and contents of a file.
+     *
+     * Results are remembered for the life of the process, keyed by path,
+     * partial checksum and the identity of the file: volume, file ID, size,
+     * last write time and change time.  A file is only read again if any of
+     * those have changed.  Files whose times are too recent to be trusted,
+     * or that change while they're being read, are never remembered.
+     */
     static HRESULT ComputeFileChecksum(_In_ Checksum partialChecksum, _In_ PCWSTR fileToAdd, _Out_ Checksum* checksum);
+
+    // Forgets all remembered file checksums.
+    static void ClearFileChecksumMemo();
+
+    // Gets the number of file checksums that were answered from memory.
+    static UINT32 GetFileChecksumMemoHits();
 };
 
 DEFINE_ENUM_FLAG_OPERATORS(DefChecksum::ChecksumFlags);
@@ -197,4 +197,153 @@ protected:
     UINT m_nData;
 };
 
+// Hash index from case-insensitive string keys to small non-negative values,
+// typically positions in a DynamicArray.  Keys aren't stored, so callers must
+// check each candidate against the live key.  Candidates come back in no
+// particular order.
+class CaseInsensitiveStringIndex : public DefObject
+{
+public:
+    static HRESULT CreateInstance(_In_ UINT szInit, _Outptr_ CaseInsensitiveStringIndex** result)
+    {
+        *result = nullptr;
+
+        AutoDeletePtr<CaseInsensitiveStringIndex> pRtrn = new CaseInsensitiveStringIndex();
+        RETURN_IF_NULL_ALLOC(pRtrn);
+        RETURN_IF_FAILED(pRtrn->Resize(GetSizeForCount(szInit)));
+
+        *result = pRtrn.Detach();
+        return S_OK;
+    }
+
+    CaseInsensitiveStringIndex() : m_pSlots(nullptr), m_szSlots(0), m_nSlots(0) {}
+
+    ~CaseInsensitiveStringIndex() { Def_Free(m_pSlots); }
+
+    // Hashes the key upper-cased as DefString_ICompare does, so keys it
+    // considers equal always hash alike.
+    static UINT32 ComputeHash(_In_opt_ PCWSTR pKey, _In_ size_t cchMax = static_cast<size_t>(-1))
+    {
+        UINT32 hash = InitialHash;
+        for (size_t i = 0; (pKey != nullptr) && (i < cchMax) && (pKey[i] != L'\0'); i++)
+        {
+            hash = (hash ^ static_cast<UINT16>(DefString_ToUpperOrdinal(pKey[i]))) * HashPrime;
+        }
+        return hash;
+    }
+
+    UINT Count() const { return m_nSlots; }
+
+    HRESULT Add(_In_ UINT32 hash, _In_ int value)
+    {
+        RETURN_HR_IF(E_INVALIDARG, value < 0);
+
+        if ((m_nSlots + 1) * 2 > m_szSlots)
+        {
+            RETURN_IF_FAILED(Resize(m_szSlots * 2));
+        }
+
+        Insert(m_pSlots, m_szSlots, hash, value);
+        m_nSlots++;
+        return S_OK;
+    }
+
+    // Returns the next candidate for hash.  *pCursor must be zero on the
+    // first call.
+    bool TryGetNext(_In_ UINT32 hash, _Inout_ UINT* pCursor, _Out_ int* pValueOut) const
+    {
+        *pValueOut = -1;
+
+        for (; *pCursor < m_szSlots; (*pCursor)++)
+        {
+            const Slot& slot = m_pSlots[(hash + *pCursor) & (m_szSlots - 1)];
+            if (slot.value < 0)
+            {
+                break;
+            }
+
+            if (slot.hash == hash)
+            {
+                (*pCursor)++;
+                *pValueOut = slot.value;
+                return true;
+            }
+        }
+
+        *pCursor = m_szSlots;
+        return false;
+    }
+
+    void Reset()
+    {
+        for (UINT i = 0; i < m_szSlots; i++)
+        {
+            m_pSlots[i].value = -1;
+        }
+        m_nSlots = 0;
+    }
+
+protected:
+    static const UINT32 InitialHash = 0x811c9dc5;
+    static const UINT32 HashPrime = 0x01000193;
+    static const UINT MinSlots = 8;
+
+    struct Slot
+    {
+        UINT32 hash;
+        int value;
+    };
+
+    static UINT GetSizeForCount(_In_ UINT count)
+    {
+        UINT size = MinSlots;
+        while ((size < 0x40000000) && (size < count * 2))
+        {
+            size *= 2;
+        }
+        return size;
+    }
+
+    static void Insert(_Inout_updates_(szSlots) Slot* pSlots, _In_ UINT szSlots, _In_ UINT32 hash, _In_ int value)
+    {
+        UINT slot = hash & (szSlots - 1);
+        while (pSlots[slot].value >= 0)
+        {
+            slot = (slot + 1) & (szSlots - 1);
+        }
+        pSlots[slot].hash = hash;
+        pSlots[slot].value = value;
+    }
+
+    HRESULT Resize(_In_ UINT szNew)
+    {
+        RETURN_HR_IF(E_OUTOFMEMORY, szNew <= m_szSlots);
+
+        Slot* pNew = _DefArray_AllocZeroed(Slot, szNew);
+        RETURN_IF_NULL_ALLOC(pNew);
+
+        for (UINT i = 0; i < szNew; i++)
+        {
+            pNew[i].value = -1;
+        }
+
+        for (UINT i = 0; i < m_szSlots; i++)
+        {
+            if (m_pSlots[i].value >= 0)
+            {
+                Insert(pNew, szNew, m_pSlots[i].hash, m_pSlots[i].value);
+            }
+        }
+
+        Def_Free(m_pSlots);
+        m_pSlots = pNew;
+        m_szSlots = szNew;
+        return S_OK;
+    }
+
+    _Field_size_(m_szSlots) Slot* m_pSlots;
+    UINT m_szSlots;
+    UINT m_nSlots;
+};
+
 } // namespace Microsoft::Resources
\ No newline at end of file
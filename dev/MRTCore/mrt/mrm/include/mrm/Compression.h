@@ -0,0 +1,59 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+
+namespace Microsoft::Resources
+{
+
+/*!
+ * A small LZ77 codec for PRI data blocks.
+ *
+ * Compressed data is a series of sequences, each made up of a token byte,
+ * literal bytes and a back-reference:
+ * - The high nibble of the token is the number of literals and the low nibble
+ *   is the match length minus MinMatch.  A nibble of 15 is followed by bytes
+ *   that are added to it, up to and including the first byte that isn't 255.
+ * - The literals are copied to the output as is.
+ * - The back-reference is a 16-bit little-endian distance back into the
+ *   output, from 1 to MaxDistance, followed by any extra match length bytes.
+ *
+ * The last sequence has literals only and ends at the end of the input.
+ * Decompression checks every length and distance, so corrupt input fails
+ * instead of reading or writing out of bounds.
+ */
+struct DefCompression
+{
+    static const UINT32 MinMatch = 4;
+    static const UINT32 MaxDistance = 0xffff;
+
+    /*!
+     * Gets the largest size Compress can produce for cbData bytes of input.
+     */
+    static UINT32 GetMaxCompressedSize(_In_ UINT32 cbData) { return cbData + (cbData / 255) + 16; }
+
+    /*!
+     * Compresses pData into pOut.  Fails with ERROR_INSUFFICIENT_BUFFER if
+     * the output doesn't fit in cbOut bytes; a buffer of
+     * GetMaxCompressedSize(cbData) bytes is always big enough.
+     */
+    static HRESULT Compress(
+        _In_reads_bytes_(cbData) const BYTE* pData,
+        _In_ UINT32 cbData,
+        _Out_writes_bytes_to_(cbOut, *pcbWritten) BYTE* pOut,
+        _In_ UINT32 cbOut,
+        _Out_ UINT32* pcbWritten);
+
+    /*!
+     * Decompresses pCompressed into pOut, which must be exactly the size of
+     * the original data.  Fails with ERROR_MRM_INVALID_PRI_FILE if the
+     * compressed data is damaged or doesn't decompress to exactly cbOut bytes.
+     */
+    static HRESULT Decompress(
+        _In_reads_bytes_(cbCompressed) const BYTE* pCompressed,
+        _In_ UINT32 cbCompressed,
+        _Out_writes_bytes_all_(cbOut) BYTE* pOut,
+        _In_ UINT32 cbOut);
+};
+
+} // namespace Microsoft::Resources
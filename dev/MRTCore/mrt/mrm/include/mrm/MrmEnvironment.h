@@ -102,6 +102,11 @@ public:
     virtual const QUALIFIER_INFO* GetQualifierInfo() const = 0;
 
     virtual HRESULT GetQualifierInfo(_In_ INT32 evIndex, _Outptr_ const QUALIFIER_INFO** ppQualifierInfo) const = 0;
+
+    // Gets the checksum of this environment at a previous version, as computed by
+    // ComputeEnvironmentVersionChecksum.  Environments that don't change can
+    // remember the result.
+    virtual HRESULT GetChecksumForVersion(_In_ const IEnvironmentVersionInfo* pVersion, _Out_ DEF_CHECKSUM* pChecksumOut) const;
 };
 
 class MrmEnvironment : public IEnvironment
@@ -124,6 +129,13 @@ protected:
 
     IEnvironmentVersionInfo* m_pVersion;
 
+    static const int MaxCachedVersionChecksums = 4;
+
+    mutable _DEF_SRWLOCK m_versionChecksumLock;
+    mutable MRMFILE_ENVIRONMENT_VERSION_INFO m_versionChecksums[MaxCachedVersionChecksums];
+    mutable int m_numVersionChecksums;
+    mutable int m_nextVersionChecksum;
+
     MrmEnvironment() :
         m_pEnvironmentInitializer(nullptr),
         m_pQualifierTypeNames(nullptr),
@@ -134,8 +146,12 @@ protected:
         m_pConditionOperatorNames(nullptr),
         m_numQualifiers(0),
         m_pQualifiers(nullptr),
-        m_pVersion(nullptr)
-    {}
+        m_pVersion(nullptr),
+        m_numVersionChecksums(0),
+        m_nextVersionChecksum(0)
+    {
+        _DefInitializeSRWLock(&m_versionChecksumLock);
+    }
 
     HRESULT Init(_In_ AtomPoolGroup* pAtoms, _In_ const ENVIRONMENT_INITIALIZER* pInitializer, _In_ int major, _In_ int minor);
 
@@ -290,6 +306,10 @@ public:
     const IAtomPool* GetResourceValueLocatorNames() const { return m_pResourceValueLocatorNames; }
     const IAtomPool* GetConditionOperatorNames() const { return m_pConditionOperatorNames; }
 
+    // Remembers the last few version checksums, since every PRI file built for
+    // an older version of this environment asks for the same one.
+    HRESULT GetChecksumForVersion(_In_ const IEnvironmentVersionInfo* pVersion, _Out_ DEF_CHECKSUM* pChecksumOut) const;
+
     static HRESULT GetResourceItemType(_In_ PCWSTR pTypeName, _Out_ ResourceItemType* type);
 
     static HRESULT GetResourceValueType(_In_ PCWSTR pTypeName, _Out_ ResourceValueType* type);
@@ -209,6 +209,12 @@ HRESULT GetStringResultFromBlobResult(
 
 HRESULT GetBlobResultFromStringResult(_In_ StringResult* sourceString, _Inout_ BlobResult* destinationBlob);
 
+/*!
+     * Converts a StringResult to a nul-terminated UTF-8 string owned by
+     * destinationBlob.
+     */
+HRESULT GetUtf8BlobResultFromStringResult(_In_ StringResult* sourceString, _Inout_ BlobResult* destinationBlob);
+
 template<class IITEM, class ICOLLECTION>
 class ICollectionItemResult : public IITEM
 {
@@ -72,6 +72,31 @@ public:
     virtual UINT32 GetSectionQualifier() const = 0;
     virtual void SetSectionIndex(BaseFile::SectionIndex sectionIndex) = 0;
     virtual BaseFile::SectionIndex GetSectionIndex() const = 0;
+
+    // Optional layout hint: indices of the items in this section that are used
+    // at runtime, hottest first.  Sections that don't store indexed items ignore it.
+    virtual HRESULT SetHotItems(_In_ int numItems, _In_reads_opt_(numItems) const UINT32* pItemIndices)
+    {
+        UNREFERENCED_PARAMETER(numItems);
+        UNREFERENCED_PARAMETER(pItemIndices);
+        return S_OK;
+    }
+
+    // True if Build only reads this builder's own finalized state, so it can
+    // run on another thread while other sections are built.  Builders that
+    // compute anything lazily in Build, or read other builders, must not.
+    virtual bool CanBuildConcurrently() const { return false; }
+};
+
+// Receives a file from FileBuilder::GenerateFileContents as it is generated.
+// The header and TOC arrive first, then each section in file order and the
+// trailer; finally the completed header and TOC are written again at offset 0.
+class IFileBuilderSink
+{
+public:
+    virtual ~IFileBuilderSink() {}
+
+    virtual HRESULT Write(_In_ UINT32 offset, _In_reads_bytes_(cbData) const void* pData, _In_ UINT32 cbData) = 0;
 };
 
 // Build a UID-formatted file.
@@ -91,6 +116,22 @@ public:
         UINT32 m_cbSectionData;
     } SectionInfo;
 
+    // Sections and data items touched while the built file is in use, e.g.
+    // recorded during application startup, hottest first.
+    typedef struct _AccessProfile
+    {
+        typedef struct _ItemAccess
+        {
+            BaseFile::SectionIndex sectionIndex;
+            UINT32 itemIndex;
+        } ItemAccess;
+
+        int numSections;
+        _Field_size_opt_(numSections) const BaseFile::SectionIndex* pSections;
+        int numItems;
+        _Field_size_opt_(numItems) const ItemAccess* pItems;
+    } AccessProfile;
+
 private:
     BuildPhase m_phase;
     DEFFILE_MAGIC m_magic;
@@ -110,6 +151,16 @@ private:
     UINT32 m_cbSectionData;
     UINT32 m_nSectionDataUsed;
 
+    int m_numHotSections;
+    _Field_size_(m_numHotSections) BaseFile::SectionIndex* m_pHotSections;
+
+    bool m_parallelBuild;
+
+    IFileBuilderSink* m_pSink;
+    BYTE* m_pStreamHead;
+    BYTE* m_pScratch;
+    UINT32 m_cbScratch;
+
 protected:
     FileBuilder(DEFFILE_MAGIC magic);
 
@@ -132,12 +183,47 @@ public:
 
     HRESULT GetSectionData(INT32 sectionIndex, _Out_ const BYTE** data, _Out_ UINT32* pcbSectionData);
 
+    /*!
+     * Lays the file out for the supplied access profile: profiled sections
+     * are generated first, right after the header and TOC, and each section
+     * is given its profiled items so it can place their data first.  The
+     * format is unchanged; only offsets move.  Indices the file doesn't have
+     * are ignored.  Must be called after sections are added and before the
+     * file is finalized.
+     */
+    HRESULT SetAccessProfile(_In_ const AccessProfile* pProfile);
+
+    /*!
+     * Builds sections whose builders report CanBuildConcurrently on the
+     * thread pool, while the calling thread builds the rest in order.  Each
+     * section still gets the same slot in the file and the header and TOC
+     * are completed in order afterwards, so the output is identical to a
+     * serial build.  Ignored when streaming to a sink.
+     */
+    void SetParallelBuild(_In_ bool parallelBuild) { m_parallelBuild = parallelBuild; }
+
+    bool GetParallelBuild() const { return m_parallelBuild; }
+
     HRESULT GenerateFileContents(__deref_out void** ppBufferOut, __out_opt UINT32* pBufferLenOut);
 
     HRESULT GenerateFileContents(__out_bcount(cbBufferOut) VOID* pBufferOut, UINT32 cbBufferOut, __out_opt UINT32* pcbWrittenSize);
 
+    /*!
+     * Generates the file into pSink one section at a time, without holding
+     * the whole file in memory.  Each section is built in a scratch buffer
+     * sized for the largest section and written out as soon as it is done;
+     * the header and TOC are written again at the end.  The bytes are the
+     * same as from the other overloads.  Sections are built serially even if
+     * a parallel build was requested.  Unless the file was already generated
+     * in memory, the builder keeps no copy, so it can only be generated once.
+     */
+    HRESULT GenerateFileContents(_In_ IFileBuilderSink* pSink, _Out_opt_ UINT32* pcbWrittenSize);
+
     HRESULT WriteToFile(__in PCWSTR fileName);
 
+    // Like WriteToFile, but streams the file as described for GenerateFileContents(IFileBuilderSink*).
+    HRESULT StreamToFile(_In_ PCWSTR fileName);
+
     static FileBuilder* FromFile(__in PCWSTR fileName);
 
     UINT32 GetNumSections() { return m_nSections; }
@@ -182,12 +268,26 @@ public:
 private:
     virtual HRESULT StartGenerating(__out_bcount(cbDataOut) VOID* pDataOut, UINT32 cbDataOut);
 
+    HRESULT StartStreaming(_In_ IFileBuilderSink* pSink, _In_ UINT32 cbDataOut);
+
+    void InitFileHeader();
+
+    HRESULT EmitSection(_In_ BaseFile::SectionIndex sectionIndex);
+
+    void EndStreaming();
+
     virtual HRESULT StartSection(BaseFile::SectionIndex sectionIndex, _Out_ SectionInfo** result);
 
     virtual HRESULT FinishSection(BaseFile::SectionIndex sectionIndex, UINT32 cbGenerated);
 
     virtual HRESULT BuildAllSections();
 
+    HRESULT BuildSection(_In_ int index);
+
+    HRESULT GetBuildOrder(_Out_writes_(m_nSections) int* pOrder);
+
+    HRESULT BuildSectionsInParallel(_In_reads_(m_nSections) const int* pOrder);
+
     virtual HRESULT FinishGenerating();
 
     virtual HRESULT GenerateFileContentsInternal();
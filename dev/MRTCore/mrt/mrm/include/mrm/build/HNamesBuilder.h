@@ -12,6 +12,7 @@
 namespace Microsoft::Resources::Build
 {
 
+class HNamesNode;
 class ScopeInfo;
 class ItemInfo;
 class HierarchicalNamesBuilder;
@@ -24,6 +25,13 @@ public:
     virtual HRESULT AddItem(__in ItemInfo* pItem, __out int* pIndexOut) = 0;
 
     virtual const HierarchicalNamesConfig* GetConfig() const = 0;
+
+    // While names are added in bulk, scopes don't keep their children in
+    // order, so children are found through the global nodes instead.
+    virtual bool IsBulkAdding() const = 0;
+
+    virtual bool
+    TryFindChild(_In_ const ScopeInfo* pParent, _In_ PCWSTR pName, _Outptr_result_maybenull_ HNamesNode** ppChildOut) const = 0;
 };
 
 class HierarchicalNameSegment
@@ -494,6 +502,9 @@ public:
          */
     HRESULT GetOrAddItem(_In_ PCWSTR pName, _Out_ ItemInfo** result);
 
+    //! Puts children added out of order during a bulk add back in order.
+    void SortChildren();
+
 protected:
     DynamicArray<HNamesNode*>* m_pChildren;
 
@@ -577,6 +588,9 @@ public:
     static const UINT32 BuildAsciiOrUtf16 = 0x1;
     static const UINT32 BuildEncodingFlagsMask = 0x1;
     static const UINT32 BuildLargeHNamesNode = 0x2;
+    // Stores each scope's total descendent item count in its (otherwise reserved)
+    // flags field and marks the section with DEFFILE_HNAMES_FLAGS_DESCENDENT_ITEM_COUNTS.
+    static const UINT32 BuildDescendentItemCounts = 0x4;
 
     static HRESULT CreateInstance(_In_ UINT32 flags, _Outptr_ HierarchicalNamesBuilder** result);
     static HRESULT CreateInstance(_In_ UINT32 flags, _In_ AtomPoolGroup* pAtoms, _Outptr_ HierarchicalNamesBuilder** result);
@@ -717,6 +731,24 @@ public:
          */
     bool IsValidScopeIndex(__in int indexIn) const;
 
+    /*!
+         * Starts adding names in bulk.  Until EndBulkAdd is called, new
+         * children are appended to their scope and found through a hash
+         * index, instead of being kept sorted as they're added, and
+         * EndBulkAdd sorts each scope's children once.  Scopes are
+         * independent, so with many names they're sorted on the thread
+         * pool.  Scopes and items get the same indices as they would if
+         * added one at a time, so the built section is identical.
+         *
+         * Children aren't in order until the bulk add ends, but names
+         * can still be added and looked up.  Finalize ends a bulk add.
+         */
+    HRESULT BeginBulkAdd();
+
+    HRESULT EndBulkAdd();
+
+    bool IsBulkAdding() const { return (m_pBulkIndex != nullptr); }
+
     const HierarchicalNamesConfig* GetConfig() const { return this; }
 
     bool IsFinalized() const { return (m_numFinalizedNames == (int)GetNumNames()); }
@@ -749,6 +781,9 @@ private:
     IAtomPool* m_pScopeNames;
     IAtomPool* m_pItemNames;
 
+    // Children by parent and name during a bulk add; values are scope index * 2, or item index * 2 + 1.
+    CaseInsensitiveStringIndex* m_pBulkIndex;
+
     int m_numFinalizedNames;
     int m_cchFinalizedAsciiNames;
     int m_cchFinalizedUtf16Names;
@@ -795,6 +830,10 @@ protected:
 
     HRESULT AddItem(__in ItemInfo* pItem, __out int* pIndexOut);
 
+    static UINT32 GetChildHash(_In_ const ScopeInfo* pParent, _In_ PCWSTR pName);
+
+    bool TryFindChild(_In_ const ScopeInfo* pParent, _In_ PCWSTR pName, _Outptr_result_maybenull_ HNamesNode** ppChildOut) const;
+
     template<typename T>
     HRESULT BuildNameNode(
         _In_ HNamesNode* pNode,
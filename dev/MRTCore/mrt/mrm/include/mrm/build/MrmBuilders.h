@@ -211,6 +211,16 @@ public:
         _Out_writes_to_opt_(sizeItems, *pNumItemsWritten) int* pItemsOut,
         _Out_opt_ int* pNumItemsWritten) const;
 
+    HRESULT GetDescendentItemNames(
+        _In_ int scopeIndex,
+        _In_ int firstDescendent,
+        _In_ int maxNames,
+        _Inout_ HierarchicalNamesBatch* pNamesOut) const;
+
+    HRESULT InitDescendentCursor(_In_ int scopeIndex, _Out_ HierarchicalNamesCursor* pCursorOut) const;
+
+    bool TryGetNextDescendent(_Inout_ HierarchicalNamesCursor* pCursor, _Out_opt_ int* pScopeIndexOut, _Out_opt_ int* pItemIndexOut) const;
+
     HRESULT Clone(_Outptr_ IHierarchicalSchema** result) const;
 
     HRESULT GetSchemaBlobFromFileSection(_Inout_opt_ DEFFILE_SECTION_TYPEID* pSectionTypeResult, _Inout_opt_ BlobResult* pBlobResult) const;
@@ -508,6 +518,48 @@ private:
     HRESULT Init(_In_ HierarchicalSchemaSectionBuilder* schema);
 };
 
+class ResourceNameIndexSectionBuilder : public ISectionBuilder
+{
+public:
+    static HRESULT CreateInstance(_In_ HierarchicalSchemaSectionBuilder* schema, _Outptr_ ResourceNameIndexSectionBuilder** result);
+
+    virtual ~ResourceNameIndexSectionBuilder();
+
+    HierarchicalSchemaSectionBuilder* GetSchema() const { return m_schema; }
+
+    bool IsValid() const { return (m_schema != nullptr); }
+
+    HRESULT Finalize();
+
+    UINT32 GetMaxSizeInBytes() const;
+
+    HRESULT
+    Build(_Out_writes_bytes_(bufferSizeInBytes) VOID* buffer, _In_ UINT32 bufferSizeInBytes, _Out_opt_ UINT32* numBytesWritten) const;
+
+    DEFFILE_SECTION_TYPEID GetSectionType() const { return ResourceNameIndexSection::GetSectionTypeId(); }
+    UINT16 GetFlags() const { return 0; }
+    UINT16 GetSectionFlags() const { return 0; }
+    UINT32 GetSectionQualifier() const { return 0; }
+
+    void SetSectionIndex(_In_ BaseFile::SectionIndex sectionIndex) { m_sectionIndex = sectionIndex; }
+    BaseFile::SectionIndex GetSectionIndex() const { return m_sectionIndex; }
+
+private:
+    bool m_finalized;
+    BaseFile::SectionIndex m_sectionIndex;
+
+    HierarchicalSchemaSectionBuilder* m_schema;
+
+    UINT32 m_numFinalizedBuckets;
+    UINT32 m_numFinalizedEntries;
+    _Field_size_(m_numFinalizedBuckets + 1) UINT32* m_bucketStart;
+    _Field_size_(m_numFinalizedEntries) MRMFILE_NAME_INDEX_ENTRY* m_entries;
+
+    ResourceNameIndexSectionBuilder();
+
+    HRESULT Init(_In_ HierarchicalSchemaSectionBuilder* schema);
+};
+
 class IBuildInstanceReference;
 class DecisionInfoSectionBuilder;
 
@@ -1138,7 +1190,7 @@ public:
     ~OrchestratorDataReference() { delete m_metadata; }
 
     static HRESULT CreateInstance(
-        _In_ DEF_CHECKSUM valueHash,
+        _In_ UINT64 fingerprint,
         _In_reads_bytes_(valueSizeInBytes) const void* actualValue,
         _In_ size_t valueSizeInBytes,
         _In_ DataItemsSectionBuilder* pBuilder,
@@ -1157,7 +1209,7 @@ public:
 
     UINT8 GetLocatorType() const { return MRMFILE_MAP_VALUE_LOCATOR_DATA_ITEM; }
 
-    DEF_CHECKSUM GetValueHash() const { return m_valueHash; }
+    UINT64 GetFingerprint() const { return m_fingerprint; }
 
     const void* GetActualValue() const;
 
@@ -1167,7 +1219,7 @@ public:
 
 private:
     OrchestratorDataReference(
-        _In_ DEF_CHECKSUM valueHash,
+        _In_ UINT64 fingerprint,
         _In_ DataItemsSectionBuilder* pBuilder,
         _In_ DataItemsSectionBuilder::PrebuildItemReference* pPreBuildItemReference);
 
@@ -1176,63 +1228,78 @@ private:
     DataItemsSectionBuilder* m_disBuilder;
     DataItemsSectionBuilder::PrebuildItemReference m_innerReference;
 
-    DEF_CHECKSUM m_valueHash;
+    UINT64 m_fingerprint;
     BlobResult m_actualDataBlob;
     DynamicArray<UINT>* m_metadata;
 };
 
-class OrchestratorHashNode : public DefObject
+/*!
+ * Finds data references by value.  Entries live inline in open-addressed,
+ * linearly probed slot arrays along with the 64-bit fingerprint of their
+ * value, so a lookup touches one slot per probe and only compares values
+ * whose fingerprints match.  The map doesn't own the references.
+ *
+ * A concurrent map spreads its entries over several independently locked
+ * shards so it can be used from several threads at once; other maps do no
+ * locking at all.
+ */
+class OrchestratorHashMap : public DefObject
 {
 public:
-    static HRESULT CreateInstance(
-        _In_ DEF_CHECKSUM valueHash,
-        _In_ OrchestratorDataReference* dataReference,
-        _Outptr_ OrchestratorHashNode** result);
-
-    bool SetNext(_In_ OrchestratorHashNode* inputNode);
+    virtual ~OrchestratorHashMap();
 
-    ~OrchestratorHashNode() {}
+    static HRESULT CreateInstance(_In_ UINT32 initCapacity, _In_ bool concurrent, _Outptr_ OrchestratorHashMap** result);
 
-    OrchestratorDataReference* GetDataReference() const { return m_dataReference; }
-    DEF_CHECKSUM GetHash() const { return m_valueHash; }
-    OrchestratorHashNode* GetNext() const { return m_nextOrchHashNode; }
+    int Count() const;
 
-private:
-    OrchestratorHashNode(_In_ DEF_CHECKSUM valueHash, _In_ OrchestratorDataReference* dataReference);
+    bool IsConcurrent() const { return (m_numShards > 1); }
 
-    OrchestratorHashNode* m_nextOrchHashNode;
-    DEF_CHECKSUM m_valueHash;
-    OrchestratorDataReference* m_dataReference;
-};
+    // Adds a reference under its fingerprint.  Callers check for an existing match first.
+    HRESULT AddtoMap(_In_ OrchestratorDataReference* value);
 
-class OrchestratorHashMap : public DefObject
-{
-public:
-    virtual ~OrchestratorHashMap();
+    // Returns the reference whose value is exactly the supplied one, or nullptr.
+    OrchestratorDataReference* TryGetFromMap(
+        _In_ UINT64 fingerprint,
+        _In_reads_bytes_opt_(valueSizeInBytes) const void* value,
+        _In_ size_t valueSizeInBytes) const;
 
-    static HRESULT CreateInstance(_In_ int initCapacity, _In_ float loadFactor, _Outptr_ OrchestratorHashMap** result);
+private:
+    struct Slot
+    {
+        UINT64 fingerprint;
+        OrchestratorDataReference* dataReference;
+    };
 
-    int Count() const { return m_nodeCount; }
+    struct Shard
+    {
+        _DEF_SRWLOCK lock;
+        _Field_size_(numSlots) Slot* pSlots;
+        UINT32 numSlots;
+        UINT32 numEntries;
+    };
 
-    HRESULT AddtoMap(_In_ DEF_CHECKSUM key, _In_ OrchestratorDataReference* value);
+    static const UINT32 NumConcurrentShards = 16;
+    static const UINT32 MinSlotsPerShard = 16;
 
-    int HashCode(_In_ DEF_CHECKSUM key);
+    OrchestratorHashMap();
 
-    int HashCode(_In_ size_t newSize, _In_ DEF_CHECKSUM key);
+    HRESULT Init(_In_ UINT32 initCapacity, _In_ bool concurrent);
 
-    OrchestratorDataReference* TryGetFromMap(_In_ DEF_CHECKSUM key, _In_opt_ const void* value, _In_opt_ size_t valueSizeInBytes);
+    Shard* GetShard(_In_ UINT64 fingerprint) const { return &m_pShards[fingerprint & (m_numShards - 1)]; }
 
-private:
-    HRESULT ResizeMap();
+    // Call with the shard lock held, if there is one.
+    static OrchestratorDataReference* FindInShard(
+        _In_ const Shard* pShard,
+        _In_ UINT64 fingerprint,
+        _In_reads_bytes_(valueSizeInBytes) const void* value,
+        _In_ size_t valueSizeInBytes);
 
-    OrchestratorHashMap(_In_ int initCapacity, _In_ float loadFactor);
+    static HRESULT AddToShard(_Inout_ Shard* pShard, _In_ UINT64 fingerprint, _In_ OrchestratorDataReference* dataReference);
 
-    HRESULT Init(int initCapacity);
+    static HRESULT Grow(_Inout_ Shard* pShard);
 
-    int m_nodeCount;
-    int m_currentSize;
-    float m_loadFactor;
-    DynamicArray<OrchestratorHashNode*>* m_entries;
+    _Field_size_(m_numShards) Shard* m_pShards;
+    UINT32 m_numShards;
 };
 
 class DataItemOrchestrator : public DefObject
@@ -1251,6 +1318,15 @@ public:
 
     void DisableDeduplication();
 
+    /*!
+     * Lets several threads add data at once, e.g. one per indexer.  Only
+     * the orchestrator itself is made thread-safe: new items and new
+     * qualifier sets are added one at a time, while lookups of values that
+     * are already present proceed in parallel.  Must be called before
+     * anything is added.
+     */
+    HRESULT EnableConcurrentAdds();
+
     HRESULT GetValueSize(_In_ PCWSTR value, _Out_ size_t* size);
 
     virtual HRESULT AddDataAndCreateInstanceReference(
@@ -1278,11 +1354,10 @@ public:
         _Outptr_ IBuildInstanceReference** result);
 
     HRESULT OptimizeString(
-        _Out_writes_bytes_to_(convertedStringSize, *writtenBytesIncludingNull) char* convertedString,
-        _In_ PCWSTR value,
-        _Inout_ size_t* writtenBytesIncludingNull,
-        _In_ size_t convertedStringSize,
-        _In_ MrmEnvironment::ResourceValueType* optimalType);
+        _Out_writes_bytes_all_(convertedStringSize) char* convertedString,
+        _In_reads_(valueSizeInCharsIncludingNull) PCWSTR value,
+        _In_ size_t valueSizeInCharsIncludingNull,
+        _In_ size_t convertedStringSize);
 
     virtual HRESULT AddOptimizedStringAndCreateInstanceReference(
         _In_ MrmEnvironment::ResourceValueType originalType,
@@ -1302,6 +1377,17 @@ public:
 protected:
     HRESULT GetOrAddDataItemSectionBuilder(_In_ int qualifierSetIndex, _Out_ DataItemsSectionBuilder** result);
 
+    HRESULT GetOrAddQualifierSet(_In_ const IQualifierSet* qualifiers, _Out_ int* qualifierSetIndex);
+
+    // Returns a reference to an existing item with this value, or adds a new one.
+    // Strings are added with AddDataString, so value must be null-terminated UTF-16.
+    HRESULT AddDeduplicatedValue(
+        _In_reads_bytes_(valueSizeInBytes) const void* value,
+        _In_ size_t valueSizeInBytes,
+        _In_ bool isUtf16String,
+        _In_ int qualifierSetIndex,
+        _Outptr_ IBuildInstanceReference** result);
+
     DataItemOrchestrator(_In_ FileBuilder* fileBuilder, _In_ CoreProfile* profile, _In_ DecisionInfoSectionBuilder* decisionInfo);
 
     HRESULT Init();
@@ -1314,6 +1400,9 @@ protected:
     DynamicArray<DataItemsSectionBuilder*>* m_buildersByQualifierSet;
     MrmBuildConfiguration* m_buildConfiguration; // do not delete this here
     OrchestratorHashMap* m_OrchestratorHashMap;
+
+    // Serializes everything but duplicate lookups.  Taken before any map shard lock.
+    _DEF_SRWLOCK m_lock;
 };
 
 class PriSectionBuilder : public ISectionBuilder, public IResourceLinkBuilder
@@ -1519,6 +1608,8 @@ private:
 
     HRESULT AddAlternateSchemaBuilder();
 
+    HRESULT AddResourceNameIndexBuilder(_In_ HierarchicalSchemaSectionBuilder* pSchema);
+
     HRESULT GetCanAddCandidate(_In_opt_ PCWSTR schemaName, _In_ PCWSTR resourceName) const;
 
     HRESULT GetMapBuilderForAddCandidate(_In_opt_ PCWSTR schemaName, _Out_ ResourceMapSectionBuilder** result);
@@ -1554,6 +1645,7 @@ private:
     FileListBuilder* m_pFileListBuilder;
 
     DynamicArray<ResourceLinkSectionBuilder*>* m_linkBuilders;
+    DynamicArray<ResourceNameIndexSectionBuilder*>* m_nameIndexBuilders;
 
     MrmBuildConfiguration* m_pBuilderConfiguration; // do not delete this here
 };
@@ -21,32 +21,72 @@ namespace Microsoft::Resources::Build
      * @{
      */
 
-//
-// Memory linked list buffer
-// memory layout
-// MEM_LINKED_DATABLOB
-// BYTE[1M].
-typedef struct _MEM_LINKED_DATABLOB
-{
-    bool fIsGivenData;
-    UINT32 nSize;
-    BYTE* pData; // next address after the structure
-    struct _MEM_LINKED_DATABLOB* pNext;
-} MEM_LINKED_DATABLOB;
-
+/*!
+ * Accumulates data items, each padded to 32-bit alignment, into a blob.
+ *
+ * Data is copied into a short list of arena segments, each at least twice
+ * the size of the one before, so the blob is built with one copy per
+ * segment.  Segments never move, so references handed out by
+ * TryGetStringData and TryGetBlobData stay valid for the life of the
+ * builder.  Every item's offset and size are recorded, and items are
+ * indexed by content so existing data is found with a hash lookup.
+ */
 class DataBlobBuilder : public DefObject
 {
 protected:
-    MEM_LINKED_DATABLOB* m_pHeadDataList;
-    mutable MEM_LINKED_DATABLOB* m_pCurDataList;
+    struct Segment
+    {
+        _Field_size_part_(cbCapacity, cbUsed) BYTE* pData;
+        UINT32 offset; // offset of the first byte in the blob
+        UINT32 cbUsed;
+        UINT32 cbCapacity;
+    };
+
+    struct Item
+    {
+        UINT32 offset;
+        UINT32 cbData;
+    };
+
+    struct IndexSlot
+    {
+        UINT32 hash;
+        UINT32 itemPlusOne; // 0 for an empty slot
+    };
+
+    static const UINT32 InitialSegmentSize = 4 * 1024;
+    static const UINT32 InitialItemsSize = 64;
+    static const UINT32 MaxSegments = 32;
+
+    Segment m_segments[MaxSegments];
+    UINT32 m_numSegments;
     UINT32 m_offset;
-    static const UINT32 maxListBufferSize = 1024 * 1024; // 1M
+
+    _Field_size_part_(m_sizeItems, m_numItems) Item* m_pItems;
+    UINT32 m_numItems;
+    UINT32 m_sizeItems;
+
+    _Field_size_(m_numIndexSlots) IndexSlot* m_pIndexSlots;
+    UINT32 m_numIndexSlots;
 
 protected:
     DataBlobBuilder();
 
     HRESULT Init();
 
+    // Returns the segment holding the blob offset, or nullptr if it's past the end.
+    const Segment* GetSegmentForOffset(_In_ UINT32 offset) const;
+
+    // Returns a new item's storage, with its padding already zeroed.
+    HRESULT AllocItem(_In_ UINT32 cbData, _Outptr_result_bytebuffer_(cbData) BYTE** ppData, _Out_ UINT32* pOffset);
+
+    // Finds an item with the same contents, or the empty index slot where it belongs.
+    IndexSlot* FindIndexSlot(_In_reads_bytes_(cbData) const BYTE* pData, _In_ UINT32 cbData, _In_ UINT32 hash) const;
+
+    HRESULT GrowIndex();
+
+    static UINT32 HashData(_In_reads_bytes_(cbData) const BYTE* pData, _In_ UINT32 cbData);
+
 public:
     /*!
         * \name Constructors & Destructors
@@ -67,20 +107,32 @@ public:
     virtual HRESULT AddData(__in_bcount(cbData) const BYTE* pData, __in UINT32 cbData, __out UINT32* pWrittenOffset);
 
     /*!
-        * Appends the specified data to the data segment as
-        * a reference, and
+        * Appends the specified data to the data segment and
         * returns the offset at which it was added.  Does not
         * check to see if the value is already in the buffer.
+        * The data is copied, so callers needn't keep it alive.
         */
     virtual HRESULT AddDataAsReference(__in_bcount(cbData) const BYTE* pData, __in UINT32 cbData, __out UINT32* pWrittenOffset);
 
     /*!
-         * Iterates through the data list entries and returns true if the given pData with size cbData 
-         * is present at offset dataBlobBuilderOffset.
+         * Returns the offset of an item with the same contents as
+         * the specified data, adding the data if there isn't one.
+         */
+    HRESULT GetOrAddData(__in_bcount(cbData) const BYTE* pData, __in UINT32 cbData, __out UINT32* pOffset);
+
+    /*!
+         * Returns true if an item with the given contents, and size cbData, 
+         * was added at offset dataBlobBuilderOffset.
          * Returns false otherwise.
          */
     bool TryFindData(__in_bcount(cbData) const BYTE* pData, __in UINT32 cbData, __in UINT32 dataBlobBuilderOffset) const;
 
+    /*!
+         * Returns true and the offset of the first item with the
+         * given contents, if there is one.
+         */
+    bool TryFindExistingData(__in_bcount(cbData) const BYTE* pData, __in UINT32 cbData, __out UINT32* pOffset) const;
+
     bool TryGetStringData(__in UINT32 offset, __inout StringResult* pStringOut) const;
 
     bool TryGetBlobData(__in UINT32 offset, __in UINT32 cbData, __inout BlobResult* pBlobOut) const;
@@ -162,6 +214,8 @@ private:
     {
         int offset;
         int cbData;
+        int align;
+        int layoutOffset; // offset in the built section, set by Finalize
     };
 
     int m_numSmallItems;
@@ -186,11 +240,36 @@ private:
     static const unsigned int InitialLargeItemSize = 32;
     static const unsigned int InitialLargeItemDataCapacity = 1024;
 
+    int m_numHotItems;
+    __ecount(m_numHotItems) UINT32* m_pHotItems;
+
+    // Size of the small and large item data as laid out by Finalize.
+    int m_cbSmallItemLayoutUsed;
+    int m_cbLargeItemLayoutUsed;
+
+    bool m_compressed;
+
     DataItemsSectionBuilder();
 
     HRESULT EnsureLargeItemCapacity(__in int cbTotal);
     HRESULT EnsureSmallItemCapacity(__in int cbTotal);
 
+    HRESULT ComputeLayout();
+
+    HRESULT BuildItemData(
+        __in_ecount(numItems) const struct ItemRef* pItems,
+        __in int numItems,
+        __in_bcount(cbItemData) const BYTE* pItemData,
+        __in int cbItemData,
+        __out_bcount(cbLayout) BYTE* pLayout,
+        __in int cbLayout) const;
+
+    UINT32 GetUncompressedSizeInBytes() const;
+
+    HRESULT BuildUncompressed(__out_bcount(cbBuffer) VOID* pBuffer, __in UINT32 cbBuffer, __out_opt UINT32* pcbWrittenOut) const;
+
+    HRESULT BuildCompressed(__out_bcount(cbBuffer) VOID* pBuffer, __in UINT32 cbBuffer, __out_opt UINT32* pcbWrittenOut) const;
+
 public:
     /*!
         * \name Constructors & Destructors
@@ -270,6 +349,26 @@ public:
 
     HRESULT GetDataBlob(_In_ int itemIndex, _Inout_ BlobResult* pBlobResult) const;
 
+    /*!
+         * Places the data for the listed items (built item indices, hottest
+         * first) ahead of the data for other items, so the items used at
+         * startup share as few pages as possible.  Item indices don't change.
+         */
+    HRESULT SetHotItems(_In_ int numItems, _In_reads_opt_(numItems) const UINT32* pItemIndices);
+
+    // Target size of the uncompressed blocks in a compressed section.
+    static const int CompressedBlockSize = 16 * 1024;
+
+    /*!
+         * Builds a compressed data items section, which stores the item
+         * data in independently compressed blocks so a reader only has to
+         * decompress the block that holds the item it wants.  Item indices
+         * don't change.
+         */
+    void SetCompressed(_In_ bool compressed) { m_compressed = compressed; }
+
+    bool IsCompressed() const { return m_compressed; }
+
     /*!
          * \name ISectionBuilder Implementation
          * @{
@@ -283,7 +382,10 @@ public:
 
     HRESULT Build(__out_bcount(cbBuffer) VOID* pBuffer, __in UINT32 cbBuffer, __out_opt UINT32* pcbWrittenOut) const;
 
-    DEFFILE_SECTION_TYPEID GetSectionType() const { return gDataItemsSectionType; }
+    // Build only copies out the item tables and data fixed by Finalize.
+    bool CanBuildConcurrently() const { return true; }
+
+    DEFFILE_SECTION_TYPEID GetSectionType() const { return (m_compressed ? gCompressedDataItemsSectionType : gDataItemsSectionType); }
 
     UINT16 GetFlags() const { return 0; }
     UINT16 GetSectionFlags() const { return 0; }
@@ -39,6 +39,12 @@ public:
     }
 
     static HRESULT SetResult(_In_ PCWSTR pString, _Inout_ StringResult* pStringOut) { return pStringOut->SetRef(pString); }
+
+    // Folds a character for hashing, so that characters StringsMatch treats as equal always fold alike.
+    static UINT32 FoldChar(_In_ WCHAR ch, _In_ DEFCOMPAREOPTIONS options)
+    {
+        return ((options == DEFCOMPAREOPTIONS::DefCompare_CaseInsensitive) ? DefString_ToUpperOrdinal(ch) : ch);
+    }
 };
 
 /*!
@@ -58,11 +64,120 @@ private:
     UINT m_sizeChars;
     TCH* m_pChars;
 
+    // Every suffix of every string in the pool, hashed.  Suffixes that a lookup
+    // can't tell apart are indexed once, at the lowest offset, which is the
+    // offset a scan of the pool would find.
+    struct IndexSlot
+    {
+        UINT32 hash;
+        UINT32 offset; // 0 for an empty slot
+    };
+
+    _Field_size_(m_sizeIndex) IndexSlot* m_pIndex;
+    UINT32 m_sizeIndex;
+    UINT32 m_numIndexed;
+
 protected:
     typedef PoolStringOps<TSC, TCH> StringOps;
 
 protected:
-    TWriteableStringPool() {}
+    TWriteableStringPool() : m_pIndex(nullptr), m_sizeIndex(0), m_numIndexed(0) {}
+
+    static const UINT32 InitialIndexSize = 64;
+    static const UINT32 HashPrime = 0x01000193;
+
+    // Suffix hashes are built back to front: the hash of the characters after
+    // the first one, folded, is extended by one character at a time and then
+    // mixed with the exact first character, which must match.
+    static UINT32 ExtendRestHash(_In_ UINT32 restHash, _In_ UINT32 foldedChar) { return (restHash * HashPrime) + foldedChar + 1; }
+
+    static UINT32 GetSuffixHash(_In_ TCH first, _In_ UINT32 restHash)
+    {
+        UINT32 hash = restHash ^ (static_cast<UINT32>(first) * 0x9e3779b1);
+        hash ^= (hash >> 16);
+        hash *= 0x85ebca6b;
+        hash ^= (hash >> 13);
+        return hash;
+    }
+
+    bool SuffixMatches(_In_ UINT32 offset, _In_ TSC pString) const
+    {
+        return (m_pChars[offset] == pString[0]) && StringOps::StringsMatch(pString, &m_pChars[offset], m_comparison);
+    }
+
+    // Returns the index slot of the suffix that matches pString, or the empty slot where it belongs.
+    IndexSlot* FindIndexSlot(_In_ TSC pString, _In_ UINT32 hash) const
+    {
+        UINT32 mask = m_sizeIndex - 1;
+        for (UINT32 i = (hash & mask);; i = ((i + 1) & mask))
+        {
+            IndexSlot* pSlot = &m_pIndex[i];
+            if ((pSlot->offset == 0) || ((pSlot->hash == hash) && SuffixMatches(pSlot->offset, pString)))
+            {
+                return pSlot;
+            }
+        }
+    }
+
+    // Makes room to index numNew more suffixes, keeping the index at most half full.
+    HRESULT EnsureIndexSize(_In_ UINT32 numNew)
+    {
+        RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW), numNew > ((UINT32_MAX / 4) - m_numIndexed));
+
+        UINT32 newSize = ((m_sizeIndex > 0) ? m_sizeIndex : InitialIndexSize);
+        while (((m_numIndexed + numNew) * 2) > newSize)
+        {
+            newSize *= 2;
+        }
+
+        if (newSize == m_sizeIndex)
+        {
+            return S_OK;
+        }
+
+        IndexSlot* pNewIndex = _DefArray_AllocZeroed(IndexSlot, newSize);
+        RETURN_IF_NULL_ALLOC(pNewIndex);
+
+        // Hashes are kept in the slots, so nothing needs to be rehashed.
+        for (UINT32 i = 0; i < m_sizeIndex; i++)
+        {
+            if (m_pIndex[i].offset != 0)
+            {
+                UINT32 index = (m_pIndex[i].hash & (newSize - 1));
+                while (pNewIndex[index].offset != 0)
+                {
+                    index = ((index + 1) & (newSize - 1));
+                }
+                pNewIndex[index] = m_pIndex[i];
+            }
+        }
+
+        _DefFree(m_pIndex);
+        m_pIndex = pNewIndex;
+        m_sizeIndex = newSize;
+        return S_OK;
+    }
+
+    // Indexes the suffixes of a string just added to the pool.  The index must
+    // already have room for cchString more suffixes.
+    void IndexString(_In_ UINT32 offset, _In_ UINT32 cchString)
+    {
+        UINT32 restHash = 0;
+        for (UINT32 i = offset + cchString; i > offset; i--)
+        {
+            TCH first = m_pChars[i - 1];
+            UINT32 hash = GetSuffixHash(first, restHash);
+            IndexSlot* pSlot = FindIndexSlot(&m_pChars[i - 1], hash);
+            if (pSlot->offset == 0)
+            {
+                pSlot->hash = hash;
+                pSlot->offset = i - 1;
+                m_numIndexed++;
+            }
+
+            restHash = ExtendRestHash(restHash, StringOps::FoldChar(first, m_comparison));
+        }
+    }
 
     /*! 
          * Protected constructor for \ref TWriteableStringPool that initializes
@@ -219,6 +334,13 @@ public:
             _DefFree(m_pChars);
         }
         m_pChars = NULL;
+
+        if (m_pIndex != nullptr)
+        {
+            _DefFree(m_pIndex);
+            m_pIndex = nullptr;
+        }
+        m_sizeIndex = m_numIndexed = 0;
     }
 
     /*!@}*/
@@ -258,7 +380,8 @@ public:
         }
 
         cchString = StringOps::StringLength(pString) + 1;
-        if (FAILED(ExtendToFit(static_cast<UINT32>(m_numChars + cchString))))
+        if (FAILED(ExtendToFit(static_cast<UINT32>(m_numChars + cchString))) ||
+            FAILED(EnsureIndexSize(static_cast<UINT32>(cchString - 1))))
         {
             return -1;
         }
@@ -270,6 +393,7 @@ public:
             return -1;
         }
 
+        IndexString(offset, static_cast<UINT32>(cchString - 1));
         m_numChars += static_cast<UINT32>(cchString);
         return offset;
     }
@@ -332,13 +456,21 @@ public:
             return true;
         }
 
-        for (int i = 1; i < static_cast<int>(m_numChars); i++)
+        if (m_numIndexed > 0)
         {
-            if ((pString[0] == m_pChars[i]) && StringOps::StringsMatch(pString, &m_pChars[i], m_comparison))
+            // Same answer as scanning the pool for the first matching suffix.
+            UINT32 restHash = 0;
+            for (size_t i = StringOps::StringLength(pString); i > 1; i--)
+            {
+                restHash = ExtendRestHash(restHash, StringOps::FoldChar(pString[i - 1], m_comparison));
+            }
+
+            const IndexSlot* pSlot = FindIndexSlot(pString, GetSuffixHash(pString[0], restHash));
+            if (pSlot->offset != 0)
             {
                 if (pOffsetRtrn)
                 {
-                    *pOffsetRtrn = i;
+                    *pOffsetRtrn = static_cast<int>(pSlot->offset);
                 }
                 return true;
             }
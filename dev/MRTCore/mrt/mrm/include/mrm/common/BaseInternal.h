@@ -95,6 +95,14 @@ extern "C"
         _In_ size_t maxCharsToCompare,
         _In_ DEFCOMPAREOPTIONS options);
 
+    /*!
+     * Upper-cases one UTF-16 code unit with the ordinal mapping that
+     * DefString_CompareWithOptions uses for DefCompare_CaseInsensitive, so
+     * strings that compare equal ignoring case upper-case to the same units.
+     * The mapping is locale-independent; use it to hash case-insensitive keys.
+     */
+    WCHAR DefString_ToUpperOrdinal(_In_ WCHAR ch);
+
     BOOLEAN DefString_IsPrefixWithOptions(_In_ PCWSTR desiredPrefix, _In_ PCWSTR fullString, _In_ DEFCOMPAREOPTIONS options);
 
     BOOLEAN DefString_IsSuffixWithOptions(_In_ PCWSTR desiredSuffix, _In_ PCWSTR fullString, _In_ DEFCOMPAREOPTIONS options);
@@ -107,20 +115,44 @@ extern "C"
 
     DEFSTRING_ENCODING DefString_ChooseBestEncoding(_In_ PCWSTR utf16String);
 
-    // Convert to UTF-16 from ASCII and UTF-8.
-    // We don't need the other direction here, because the tools that write these strings can call existing system helpers.
+    // Also returns the string's size in UTF-16 chars and in UTF-8 bytes, both including the nul terminator.
+    // The UTF-8 size is 0 if the string holds an invalid code point, in which case UTF-16 is chosen.
+    DEFSTRING_ENCODING DefString_ChooseBestEncodingWithSizes(
+        _In_ PCWSTR utf16String,
+        _Out_ size_t* stringSizeInUtf16CharsIncludingNull,
+        _Out_ size_t* stringSizeInBytesIncludingNull);
+
+    // Writes a UTF-16 string as UTF-8 into the supplied buffer, without allocating.  Fails with
+    // ERROR_NO_UNICODE_TRANSLATION for unpaired surrogates and ERROR_INSUFFICIENT_BUFFER if it doesn't fit.
+    HRESULT DefString_EncodeUtf16AsUtf8(
+        _In_reads_(stringSizeInUtf16CharsIncludingNull) PCWSTR utf16String,
+        _In_ size_t stringSizeInUtf16CharsIncludingNull,
+        _Out_writes_bytes_to_(bufferSizeInBytes, *writtenSizeInBytesIncludingNull) PSTR buffer,
+        _In_ size_t bufferSizeInBytes,
+        _Out_ size_t* writtenSizeInBytesIncludingNull);
+
+    // Convert to UTF-16 from ASCII and UTF-8, and from UTF-16 to UTF-8 for callers that want UTF-8 output.
     // These functions operate on string sizes that include the nul terminator since that is what our pipeline deals with.
     HRESULT DefString_ConvertAsciiToUtf16(
         _In_reads_z_(stringSizeInAsciiCharsIncludingNull) PCSTR asciiString,
         _Pre_satisfies_(stringSizeInAsciiCharsIncludingNull > 0) size_t stringSizeInAsciiCharsIncludingNull,
         _Outptr_ PWSTR* result);
 
+    // Checks bytes for well-formed UTF-8 without converting them.
+    BOOLEAN DefString_IsValidUtf8(_In_reads_bytes_(cbString) PCSTR pszString, _In_ size_t cbString);
+
     HRESULT DefString_ConvertUtf8ToUtf16(
         _In_reads_z_(stringSizeInBytesIncludingNull) PCSTR utf8String,
         _Pre_satisfies_(stringSizeInBytesIncludingNull > 0) size_t stringSizeInBytesIncludingNull,
         _Out_ size_t* resultStringSizeInUtf16CharsIncludingNull,
         _Outptr_ PWSTR* result);
 
+    HRESULT DefString_ConvertUtf16ToUtf8(
+        _In_reads_z_(stringSizeInUtf16CharsIncludingNull) PCWSTR utf16String,
+        _Pre_satisfies_(stringSizeInUtf16CharsIncludingNull > 0) size_t stringSizeInUtf16CharsIncludingNull,
+        _Out_ size_t* resultStringSizeInBytesIncludingNull,
+        _Outptr_ PSTR* result);
+
 #define DefString_Compare(S1, S2) DefString_CompareWithOptions((S1), (S2), DefCompare_Default)
 #define DefString_ICompare(S1, S2) DefString_CompareWithOptions((S1), (S2), DefCompare_CaseInsensitive)
 #define DefString_CchCompare(S1, S2, N) DefString_CchCompareWithOptions((S1), (S2), DefCompare_Default)
@@ -46,6 +46,23 @@ extern "C"
 
     HRESULT _DefGetFileSizeEx(__in HANDLE hFile, __out PLARGE_INTEGER pFileSize);
 
+    // Identifies a file and the version of its contents.  Times are in 100ns
+    // units since 1601, like a FILETIME.  The change time moves whenever the
+    // data or metadata changes, including when the last write time is set.
+    typedef struct _DEF_FILE_IDENTITY
+    {
+        ULONGLONG VolumeId;
+        ULONGLONG FileId;
+        ULONGLONG FileSize;
+        ULONGLONG LastWriteTime;
+        ULONGLONG ChangeTime;
+    } DEF_FILE_IDENTITY, *PDEF_FILE_IDENTITY;
+
+    HRESULT _DefGetFileIdentity(__in HANDLE hFile, __out PDEF_FILE_IDENTITY pIdentity);
+
+    // Gets the current time, in the same units as DEF_FILE_IDENTITY.
+    ULONGLONG _DefGetSystemTime();
+
     DEFRESULT _DefGetLastError();
 
     HRESULT _DefMapViewOfFile(
@@ -62,6 +79,18 @@ extern "C"
 
     BOOLEAN _DefUnmapViewOfFile(__in PVOID pBaseAddress);
 
+    // A range of mapped memory to bring in ahead of use.
+    typedef struct _DEF_MEMORY_RANGE
+    {
+        PVOID VirtualAddress;
+        SIZE_T NumberOfBytes;
+    } DEF_MEMORY_RANGE, *PDEF_MEMORY_RANGE;
+
+    // Asks the memory manager to read the given ranges of a mapped view in with
+    // as few I/Os as possible.  This is only a hint; platforms that can't
+    // prefetch return S_OK without doing anything.
+    HRESULT _DefPrefetchVirtualMemory(__in_ecount(NumberOfRanges) PDEF_MEMORY_RANGE pRanges, __in ULONG NumberOfRanges);
+
     UINT32 _DefComputeCrc32(__in UINT32 partialCrc, __in_bcount(cbBuf) const BYTE* pBuf, __in UINT32 cbBuf);
 
     UINT32
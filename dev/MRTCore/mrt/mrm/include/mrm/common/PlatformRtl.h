@@ -85,6 +85,16 @@ typedef BOOLEAN __BOOL;
 #define _DefReleaseSRWLockExclusive RtlReleaseSRWLockExclusive
 #define _DefReleaseSRWLockShared RtlReleaseSRWLockShared
 
+// Publishing lazily created objects without a lock
+#define _DefReadAcquire ReadAcquire
+#define _DefWriteRelease WriteRelease
+#define _DefReadPointerAcquire ReadPointerAcquire
+#define _DefWritePointerRelease WritePointerRelease
+
+// Timing
+#define _DefQueryPerformanceCounter RtlQueryPerformanceCounter
+#define _DefQueryPerformanceFrequency RtlQueryPerformanceFrequency
+
 //no message notification at rtl level
 #define _DefSendNotifyMessage(A, B, C, D)
 #define _DefRegisterWindowMessage(A) 0
@@ -92,6 +92,16 @@ extern "C"
 #define _DefReleaseSRWLockExclusive ReleaseSRWLockExclusive
 #define _DefReleaseSRWLockShared ReleaseSRWLockShared
 
+// Publishing lazily created objects without a lock
+#define _DefReadAcquire ReadAcquire
+#define _DefWriteRelease WriteRelease
+#define _DefReadPointerAcquire ReadPointerAcquire
+#define _DefWritePointerRelease WritePointerRelease
+
+// Timing
+#define _DefQueryPerformanceCounter QueryPerformanceCounter
+#define _DefQueryPerformanceFrequency QueryPerformanceFrequency
+
 #define TOWIDE2(x) L##x
 #define TOWIDE(x) TOWIDE2(x)
 
@@ -46,6 +46,24 @@ extern "C"
         ' ',
     };
 
+    __declspec(selectany) extern const DEFFILE_SECTION_TYPEID gCompressedDataItemsSectionType = {
+        '[',
+        'm',
+        'r',
+        'm',
+        '_',
+        'd',
+        'a',
+        't',
+        'a',
+        'i',
+        't',
+        'e',
+        'm',
+        'z',
+        ']',
+    };
+
     /*
       * NOTE:   These structures are all intended to be mapped directly into memory.  Always
       * use types with fixed sizes (e.g. INT32 instead of INT) and be careful to maintain natural
@@ -97,6 +115,36 @@ extern "C"
         return header->numLargeItems;
     }
 
+    /*!
+      * Describes a compressed file data items section.  Layout in memory is:
+     *      DATAITEMS_HEADER            hdr
+     *      DATA_ITEM_SMALL             smallItems[hdr.numSmallItems]
+     *      DATA_ITEM_LARGE             largeItems[hdr.numLargItems]
+     *      DATAITEMS_BLOCKS_HEADER     blocksHdr
+     *      DATAITEMS_BLOCK             blocks[blocksHdr.numBlocks]
+     *      BYTE*                       compressedData[blocksHdr.cbCompressedData]
+     *      PAD
+     *
+     * Item offsets and hdr.cbData describe the item data as an uncompressed
+     * section would store it.  That data is split into blocks on item
+     * boundaries, so every item lies in exactly one block, and each block is
+     * compressed on its own with DefCompression.  A block whose cbCompressed
+     * equals its cbUncompressed is stored as is.
+     */
+    typedef struct _DEFFILE_DATAITEMS_BLOCKS_HEADER
+    {
+        UINT32 numBlocks; //!< Number of compressed blocks
+        UINT32 cbCompressedData; //!< Size of all of the compressed blocks, in bytes
+    } DEFFILE_DATAITEMS_BLOCKS_HEADER;
+
+    typedef struct _DEFFILE_DATAITEMS_BLOCK
+    {
+        UINT32 uncompressedOffset; //!< Offset of the block in the uncompressed item data
+        UINT32 cbUncompressed;
+        UINT32 compressedOffset; //!< Offset of the block in the compressed data
+        UINT32 cbCompressed;
+    } DEFFILE_DATAITEMS_BLOCK;
+
 #ifdef __cplusplus
 }
 #endif
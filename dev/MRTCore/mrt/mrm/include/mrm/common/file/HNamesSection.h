@@ -180,6 +180,10 @@ extern "C"
     } DEFFILE_HNAMES_HEADER_EX, *PDEFFILE_HNAMES_HEADER_EX;
 
     __declspec(selectany) extern const UINT32 DEFFILE_HNAMES_FLAGS_LARGE = 0x0001;
+
+    // If set, the (otherwise unused) flags field of each scope holds the total number
+    // of items below that scope, so readers can count descendents without walking them.
+    __declspec(selectany) extern const UINT32 DEFFILE_HNAMES_FLAGS_DESCENDENT_ITEM_COUNTS = 0x0002;
     __declspec(selectany) extern const UINT32 DEFFILE_MAX_STANDARD_SIZE = 0xffff;
 
     __declspec(selectany) extern const DEFFILE_SECTION_TYPEID gHierarchicalNamesSectionType = {
@@ -591,6 +591,35 @@ extern "C"
     __declspec(selectany) extern const DEFFILE_SECTION_TYPEID
         gResourceLinkSectionType = {'[', 'm', 'r', 'm', '_', 'r', 'e', 's', '_', 'l', 'i', 'n', 'k', ']', ' '};
 
+    /*
+     * Header for an optional MRM resource name index section, which maps a hash
+     * of the case-folded full path of each item in a schema to the item index.
+     * File layout is:
+     *      NAME_INDEX_HEADER           hdr
+     *      UINT32                      bucketStart[hdr.numBuckets + 1]
+     *      NAME_INDEX_ENTRY            entries[hdr.numEntries]
+     *
+     * Entries are grouped by bucket (pathHash % numBuckets); the entries for bucket
+     * N are entries[bucketStart[N]] through entries[bucketStart[N + 1] - 1].
+     */
+
+    typedef struct _MRMFILE_NAME_INDEX_HEADER
+    {
+        UINT16 schemaSectionIndex; //!< Index of the schema section in the current file
+        UINT16 flags; //!< Reserved, must be 0
+        UINT32 numBuckets; //!< Number of hash buckets
+        UINT32 numEntries; //!< Number of indexed items
+    } MRMFILE_NAME_INDEX_HEADER, *PMRMFILE_NAME_INDEX_HEADER;
+
+    typedef struct _MRMFILE_NAME_INDEX_ENTRY
+    {
+        UINT32 pathHash; //!< Hash of the full path of the item
+        UINT32 itemIndex; //!< Index of the item in the schema
+    } MRMFILE_NAME_INDEX_ENTRY, *PMRMFILE_NAME_INDEX_ENTRY;
+
+    __declspec(selectany) extern const DEFFILE_SECTION_TYPEID
+        gResourceNameIndexSectionType = {'[', 'm', 'r', 'm', '_', 'n', 'a', 'm', 'e', '_', 'i', 'd', 'x', ']', ' '};
+
     /*!
      * Header for a decision info section of an MRM file.
      * File layout is:
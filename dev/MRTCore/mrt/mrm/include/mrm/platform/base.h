@@ -647,6 +647,9 @@ public:
     static const UINT32 UseDeduplicationFlag = 0x80;
     static const UINT32 UseGranularResourceSplittingFlag = 0x100;
     static const UINT32 SplitLanguageVariantsFlag = 0x200;
+    static const UINT32 UseResourceNameIndexFlag = 0x400;
+    static const UINT32 UseCompressedDataItemsFlag = 0x800;
+    static const UINT32 UseDescendentItemCountsFlag = 0x1000;
 
     static const UINT32 Windows8ConfigurationFlags = 0;
 
@@ -673,6 +676,9 @@ public:
     bool UseDeduplication() const { return ((m_flags & UseDeduplicationFlag) != 0); }
     bool UseGranularResourceSplitting() const { return ((m_flags & UseGranularResourceSplittingFlag) != 0); }
     bool SplitLanguageVariants() const { return ((m_flags & SplitLanguageVariantsFlag) != 0); }
+    bool UseResourceNameIndex() const { return ((m_flags & UseResourceNameIndexFlag) != 0); }
+    bool UseCompressedDataItems() const { return ((m_flags & UseCompressedDataItemsFlag) != 0); }
+    bool UseDescendentItemCounts() const { return ((m_flags & UseDescendentItemCountsFlag) != 0); }
 
 protected:
     MrmBuildConfiguration(_In_ DEFFILE_MAGIC fileMagicNumber, _In_ UINT32 flags) : m_magic(fileMagicNumber), m_flags(flags) {}
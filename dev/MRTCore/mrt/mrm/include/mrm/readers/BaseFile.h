@@ -62,6 +62,17 @@ protected:
 
     // Internal values for "m_flags"
     static const UINT32 BaseFileOwnsDataFlag = 0x010000;
+    static const UINT32 BaseFileIsMappedFlag = 0x020000;
+
+    // Largest single read issued while loading a file.
+    static const ULONG MaxReadSize = 0x40000000;
+
+    // How much of the start and end of a newly mapped file to prefetch.
+    static const size_t PrefetchHeaderSize = 0x10000;
+    static const size_t PrefetchTrailerSize = 0x1000;
+
+    // Most ranges passed to one prefetch request by PrefetchSections.
+    static const UINT MaxPrefetchRanges = 16;
 
 public:
     typedef DEFFILE_SECTION_INDEX SectionIndex;
@@ -78,6 +89,10 @@ public:
     static const UINT32 LoadFileFlag = 0x0002;
     static const UINT32 ValidFlags = (MapFileFlag | LoadFileFlag);
 
+    // Sizes and offsets in a DEF file are 32 bits, so nothing past this many
+    // bytes into a file can be part of its DEF data.
+    static const UINT64 MaxFileDataSize = MAXUINT32;
+
     typedef enum
     {
         IsAtomPoolSection = DEFFILE_IS_ATOM_POOL_SECTION,
@@ -112,6 +127,12 @@ public:
 
     HRESULT GetSectionData(_In_ int index, _Out_ const void** data, _Out_ UINT32* pcbSectionSizeOut) const;
 
+    /*!
+        * Asks the platform to read in every section of any of the given types
+        * ahead of use.  Does nothing unless the file is mapped.
+        */
+    HRESULT PrefetchSections(_In_reads_(numTypes) const DEFFILE_SECTION_TYPEID* pTypes, _In_ int numTypes) const;
+
     /*!
         * Gets the section index for the first section with the specified section type
         */
@@ -183,6 +204,8 @@ public:
 
     static inline bool IsAligned(int size, int boundary = DefaultAlignment) { return (size == PadData(size, boundary)); }
 
+    static inline UINT64 PadData64(UINT64 size, UINT32 boundary = DefaultAlignment) { return ((size + boundary - 1) / boundary) * boundary; }
+
     static inline int PadSectionData(int size) { return PadData(size, DefaultAlignment); }
 
     /*!
@@ -228,12 +251,12 @@ public:
         {
             return NULL;
         }
-        return ((DEFFILE_SECTION_TRAILER*)(((BYTE*)pHdr) + PadSectionData(pHdr->cbSectionTotal) - sizeof(DEFFILE_SECTION_TRAILER)));
+        return ((DEFFILE_SECTION_TRAILER*)(((BYTE*)pHdr) + PadData64(pHdr->cbSectionTotal) - sizeof(DEFFILE_SECTION_TRAILER)));
     }
 
     static inline DEFFILE_TRAILER* GetFileTrailer(__in DEFFILE_HEADER* pHdr)
     {
-        return ((DEFFILE_TRAILER*)(((BYTE*)pHdr) + PadSectionData(pHdr->cbTotal) - sizeof(DEFFILE_TRAILER)));
+        return ((DEFFILE_TRAILER*)(((BYTE*)pHdr) + PadData64(pHdr->cbTotal) - sizeof(DEFFILE_TRAILER)));
     }
 
     static HRESULT LoadFileData(
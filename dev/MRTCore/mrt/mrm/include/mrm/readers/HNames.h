@@ -105,6 +105,57 @@ public:
     virtual bool TryGetItemInfo(__in int itemIndex, __inout StringResult* pNameOut) const = 0;
 };
 
+// Position in a depth-first walk of the descendents of a scope.  A cursor
+// owns no resources, so it can be copied to save a position and resumed
+// later against the same names.
+struct HierarchicalNamesCursor
+{
+    int rootScopeIndex;
+    // scope whose children are being visited, or -1 once the walk is over
+    int scopeIndex;
+    UINT32 nextChild;
+    UINT32 depth;
+    // fails if the walk stopped because the names are malformed
+    HRESULT status;
+};
+
+// A batch of names built in a single pass over the names tree.  All of the
+// names share one buffer, so names returned by TryGetName are only valid
+// until the batch is modified or deleted.
+class HierarchicalNamesBatch : public DefObject
+{
+public:
+    static HRESULT CreateInstance(_Outptr_ HierarchicalNamesBatch** result);
+
+    ~HierarchicalNamesBatch();
+
+    int GetNumNames() const { return static_cast<int>(m_numNames); }
+
+    _Success_(return ) bool TryGetName(_In_ int index, _Out_ PCWSTR* pNameOut, _Out_opt_ int* pItemIndexOut = nullptr) const;
+
+    // Appends a name of cchName characters and returns a buffer of cchName + 1
+    // characters to hold it.  The buffer is only valid until the next AddName.
+    HRESULT AddName(_In_ int itemIndex, _In_ int cchName, _Outptr_result_buffer_(cchName + 1) PWSTR* ppNameOut);
+
+    void Reset()
+    {
+        m_numNames = 0;
+        m_cchUsed = 0;
+    }
+
+private:
+    _Field_size_(m_cchAllocated) WCHAR* m_pChars;
+    UINT32 m_cchUsed;
+    UINT32 m_cchAllocated;
+
+    _Field_size_(m_sizeNames) UINT32* m_pNameOffsets;
+    _Field_size_(m_sizeNames) int* m_pItemIndices;
+    UINT32 m_numNames;
+    UINT32 m_sizeNames;
+
+    HierarchicalNamesBatch();
+};
+
 class HierarchicalNames : public IHierarchicalNames, public FileSectionBase, public HierarchicalNamesConfig
 {
 public:
@@ -176,10 +227,9 @@ public:
 
     _Success_(return ) bool TryGetRelativeScopeName(_In_ int relativeToScope, _Inout_ int scopeIndex, _Inout_ StringResult* pNameOut) const;
 
-    HRESULT GetNumDescendents(_In_ int scopeIndex, _Out_opt_ int* pNumScopes, _Out_opt_ int* pNumItems) const
-    {
-        return GetNumDescendents(scopeIndex, 0, pNumScopes, pNumItems);
-    }
+    // Counting only items is constant time for names built with per-scope
+    // descendent counts; anything else walks the subtree.
+    HRESULT GetNumDescendents(_In_ int scopeIndex, _Out_opt_ int* pNumScopes, _Out_opt_ int* pNumItems) const;
 
     HRESULT GetDescendents(
         _In_ int scopeIndex,
@@ -190,7 +240,67 @@ public:
         _Out_writes_to_opt_(sizeItems, *pNumItemsWritten) int* pItemsOut,
         _Out_opt_ int* pNumItemsWritten) const;
 
+    HRESULT InitDescendentCursor(_In_ int scopeIndex, _Out_ HierarchicalNamesCursor* pCursorOut) const;
+
+    // Returns the next descendent in the order used by GetDescendents, as either
+    // a scope or an item index.  Returns false at the end of the walk or if the
+    // names are malformed; check the status of the cursor to tell them apart.
+    // The walk climbs back up through each scope's name node, so it also stops
+    // on names whose scopes don't point at the node that names them; callers
+    // can use GetDescendents, which handles those, instead.
+    _Success_(return ) bool TryGetNextDescendent(
+        _Inout_ HierarchicalNamesCursor* pCursor,
+        _Out_opt_ int* pScopeIndexOut,
+        _Out_opt_ int* pItemIndexOut) const;
+
+    // Appends the names, relative to scopeIndex, of up to maxNames descendent
+    // items starting at firstDescendent.  Descendents are numbered in the order
+    // reported by GetDescendents.  Parent prefixes are built once per scope, so
+    // the cost is linear in the size of the names produced.
+    HRESULT GetDescendentItemNames(
+        _In_ int scopeIndex,
+        _In_ int firstDescendent,
+        _In_ int maxNames,
+        _Inout_ HierarchicalNamesBatch* pNamesOut) const;
+
+    // Enables a bounded cache of the most recently requested names.  A size
+    // of 0 disables the cache.  Names are hashed into sets of NameCacheWays
+    // entries, each evicting its least recently used name, so the size is
+    // rounded up to a multiple of NameCacheWays.
+    HRESULT SetNameCacheSize(_In_ int maxNames) const;
+
+    static const int MaxNameCacheSize = 256;
+    static const int NameCacheWays = 4;
+
+    // Adds the full name of a node to a checksum exactly as
+    // DefChecksum::ComputeStringChecksum would, reading each segment in place
+    // instead of building the name.  Returns false, leaving the checksum
+    // unchanged, for names that TryGetName would reject and for the rare names
+    // that can't be streamed; use TryGetName for those.
+    _Success_(return ) bool TryComputeNameChecksum(
+        _In_ int nodeIndex,
+        _In_ DEF_CHECKSUM partialChecksum,
+        _Out_ DEF_CHECKSUM* pChecksumOut) const;
+
+    static const int MaxStreamedNameDepth = 64;
+
 private:
+    struct NameCacheEntry
+    {
+        int nodeIndex;
+        int relativeToScope;
+        volatile LONG lastUsed;
+        PWSTR pName;
+    };
+
+    struct NameSegment
+    {
+        PCSTR pAsciiName;
+        PCWSTR pUtf16Name;
+        int cchName;
+        bool separatorBefore;
+    };
+
     bool m_largeNode;
     DEFFILE_HNAMES_HEADER_EX m_header;
     const DEFFILE_HNAMES_HEADER_EX* m_pHeader;
@@ -207,15 +317,62 @@ private:
     IAtomPool* m_pScopeNames;
     IAtomPool* m_pItemNames;
 
+    mutable _DEF_SRWLOCK m_nameCacheLock;
+    mutable _Field_size_(m_nameCacheSize) NameCacheEntry* m_pNameCache;
+    mutable LONG m_nameCacheSize;
+    mutable volatile LONG m_nameCacheClock;
+
     HierarchicalNames();
 
+    _Success_(return ) bool TryGetCachedName(_In_ int nodeIndex, _In_ int relativeToScope, _Inout_ StringResult* pNameOut) const;
+
+    void CacheName(_In_ int nodeIndex, _In_ int relativeToScope, _In_ PCWSTR pName) const;
+
+    // Returns the first entry of the set that holds the name; the cache lock must be held.
+    NameCacheEntry* GetNameCacheSet(_In_ int nodeIndex, _In_ int relativeToScope) const;
+
+    void FreeNameCache() const;
+
+    // Recursive walks used when a cursor can't walk the names.
+    HRESULT GetNumDescendentsByWalk(_In_ int scopeIndex, _In_ UINT32 currentDepth, _Out_opt_ int* pNumScopes, _Out_opt_ int* pNumItems)
+        const;
+
+    HRESULT GetDescendentsByWalk(
+        _In_ int scopeIndex,
+        _In_ UINT32 currentDepth,
+        _In_ int sizeScopes,
+        _Out_writes_to_opt_(sizeScopes, *pNumScopesWritten) int* pScopesOut,
+        _Out_opt_ int* pNumScopesWritten,
+        _In_ int sizeItems,
+        _Out_writes_to_opt_(sizeItems, *pNumItemsWritten) int* pItemsOut,
+        _Out_opt_ int* pNumItemsWritten) const;
+
+    HRESULT AppendDescendentItemNames(
+        _In_ int scopeIndex,
+        _In_ UINT32 currentDepth,
+        _Inout_updates_(cchPrefixMax) WCHAR* pPrefix,
+        _In_ int cchPrefix,
+        _In_ int cchPrefixMax,
+        _Inout_ int* pNextDescendent,
+        _In_ int firstDescendent,
+        _In_ int endDescendent,
+        _Inout_ HierarchicalNamesBatch* pNamesOut) const;
+
     HRESULT Init(
         _In_ const DEFFILE_SECTION_TYPEID& type,
         _In_opt_ const IFileSection* pSection,
         _In_reads_bytes_(cbData) const void* pData,
         _In_ int cbData);
 
-    HRESULT GetNumDescendents(_In_ int scopeIndex, _In_ UINT32 currentDepth, _Out_opt_ int* pNumScopes, _Out_opt_ int* pNumItems) const;
+    DEFFILE_HNAMES_SCOPE_LARGE GetScopeLarge(_In_ int scopeIndex) const
+    {
+        return (m_largeNode ? m_pScopesLarge[scopeIndex] : HNAMES_SCOPE_TO_HNAMES_SCOPE_LARGE(&m_pScopes[scopeIndex]));
+    }
+
+    DEFFILE_HNAMES_NODE_LARGE GetNodeLarge(_In_ int nodeIndex) const
+    {
+        return (m_largeNode ? m_pNodesLarge[nodeIndex] : HNAMES_NODE_TO_HNAMES_NODE_LARGE(&m_pNodes[nodeIndex]));
+    }
 
     HRESULT GetAsciiName(_In_ int firstChar, _In_ int cchName, _Out_ PCSTR* result) const
     {
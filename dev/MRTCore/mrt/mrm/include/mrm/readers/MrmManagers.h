@@ -274,6 +274,14 @@ public:
         _In_ LoadPriFlags flags,
         _Outptr_ ManagedFile** result);
 
+    // Opens, maps and validates a file without adding it to a manager and
+    // without tracing failures, so it's safe to call from a worker thread.
+    static HRESULT CreatePreloadedInstance(
+        _In_ const PriFileManager* pManager,
+        _In_ const NormalizedFilePath* pNormalizedPath,
+        _In_opt_ PCWSTR pPackageRoot,
+        _Outptr_ ManagedFile** result);
+
     // This New method is temporary scaffolding that makes it easier to slide
     // the updated infrastructure under the existing API surface.  It will go
     // away once we move fully to the new infrastructure.
@@ -302,12 +310,31 @@ public:
     UINT64 GetLastModifiedDate() const { return m_fileLastModifiedDate; }
     size_t GetSizeInBytes() const { return m_fileSizeInBytes; }
 
+    // Checksum of the file on disk, which is only read again if it has changed.
+    // While the manager has a loaded file budget it's taken as each file is
+    // loaded, and reloading a file fails with ERROR_FILE_INVALID if it no
+    // longer matches.
+    HRESULT GetFileChecksum(_Out_ UINT32* checksum) const;
+
     bool IsLoaded() const { return (m_pBaseFile != nullptr); }
 
     HRESULT Load() { return InnerLoad(); }
 
     HRESULT Unload() { return InnerUnload(); }
 
+    // A pinned file is never unloaded to keep the manager within its loaded
+    // file budget.  Pins nest.
+    void Pin() const;
+    void Unpin() const;
+    bool IsPinned() const { return (m_pinCount > 0); }
+
+    // Once a file has handed out a pointer into its sections it is referenced,
+    // and it stays loaded until it's explicitly unloaded.
+    bool IsReferenced() const { return m_isReferenced; }
+
+    // True if the file is loaded, owns its mapping and is neither pinned nor referenced.
+    bool CanEvict() const { return (m_pMyBaseFile != nullptr) && (m_pinCount == 0) && !m_isReferenced; }
+
     int GetNumFiles() const { return m_pBaseFile->GetNumFiles(); }
 
     bool LoadFailed() const { return m_loadFailed; }
@@ -395,6 +422,22 @@ protected:
 
     PWSTR m_pPackageRoot;
 
+    mutable int m_pinCount;
+    mutable bool m_isReferenced;
+    mutable bool m_wasUnloaded;
+
+    // Checksum of the contents last loaded, which a reload must match.
+    mutable bool m_haveLoadedChecksum;
+    mutable UINT32 m_loadedChecksum;
+
+    // Set while the file counts against its manager's loaded file budget.
+    mutable bool m_isCounted;
+
+    // Links in the manager's list of files that could be unloaded, most
+    // recently used first.
+    mutable const ManagedFile* m_pLruPrev;
+    mutable const ManagedFile* m_pLruNext;
+
     ManagedFile(_In_ const PriFileManager* pManager, _In_ int globalIndex);
 
     ManagedFile(_In_ const MrmFile* pBaseFile);
@@ -408,6 +451,27 @@ protected:
     virtual HRESULT InnerLoad() const;
 
     virtual HRESULT InnerUnload() const;
+
+    // Loads the file if it isn't loaded and notes the access.  Callers that
+    // hand out pointers into the file pass reference = true.
+    HRESULT EnsureLoaded(_In_ bool reference) const;
+
+    // Files in a manager are shared between threads, so publishing a load,
+    // unloading, pinning and noting accesses happen under the manager's load
+    // lock.  Files that aren't in a manager yet are only seen by the thread
+    // creating them.
+    bool IsShared() const { return (m_pManager != nullptr) && (m_globalIndex >= 0); }
+
+    // The manager's load lock if the file is shared, otherwise nullptr.
+    _DEF_SRWLOCK* GetLoadLock() const;
+
+    // NoteAccess and UnloadIfLoaded expect the caller to hold the load lock if
+    // the file is shared.
+    void NoteAccess(_In_ bool reference) const;
+
+    HRESULT UnloadIfLoaded() const;
+
+    friend class PriFileManager;
 };
 
 class PriFileManager : public IFileSectionResolver
@@ -446,6 +510,17 @@ public:
         _In_ LoadPriFlags flags,
         _Out_ ManagedFile** result) const;
 
+    // As above, but uses *ppPreloadedFile (from ManagedFile::CreatePreloadedInstance)
+    // instead of loading the file again if the file has to be added.  On
+    // success *ppPreloadedFile is set to nullptr if the manager took it.
+    HRESULT
+    GetOrAddFile(
+        _In_ const NormalizedFilePath* pNormalizedPath,
+        _In_opt_ PCWSTR pPackageRoot,
+        _In_ LoadPriFlags flags,
+        _Inout_opt_ ManagedFile** ppPreloadedFile,
+        _Out_ ManagedFile** result) const;
+
     HRESULT AddFile(_In_ PCWSTR pPath, _In_opt_ PCWSTR pPackageRoot, _In_ bool fPreload, _Out_ ManagedFile** result);
 
     HRESULT
@@ -463,6 +538,58 @@ public:
 
     HRESULT SetDefaultFileFlags(_In_ UINT32 flags);
 
+    struct LoadedFileStats
+    {
+        UINT64 numEvictions;
+        UINT64 numReloads;
+        UINT64 totalReloadMicroseconds;
+        UINT64 maxReloadMicroseconds;
+    };
+
+    /*!
+         * Limits the files kept loaded.  Whenever a file is loaded and the
+         * budget is exceeded, the least recently used files are unloaded
+         * until it fits; they're reloaded on next access.  Zero means no
+         * limit, which is the default.
+         *
+         * Only files nobody holds pointers into are unloaded: a file is
+         * kept loaded while it's pinned, and from the time any of its
+         * sections is handed out until it's explicitly unloaded.  Files
+         * that don't own their mapping are never unloaded.
+         */
+    HRESULT SetLoadedFileBudget(_In_ UINT64 maxLoadedBytes, _In_ int maxLoadedFiles);
+
+    HRESULT TrimLoadedFiles();
+
+    void GetLoadedFileStats(_Out_ LoadedFileStats* pStats) const;
+
+    /*!
+         * Caches UTF-16 copies of the UTF-8 and ASCII strings looked up in
+         * each file's data items sections, up to cbBudget bytes per section,
+         * so repeated lookups don't decode them again.  The budget applies to
+         * sections of files that are already loaded as well as to those used
+         * later.  Zero, the default, disables caching for sections used from
+         * then on; a section that already has a cache keeps it.
+         */
+    HRESULT SetDecodedStringCacheBudget(_In_ UINT32 cbBudget);
+
+    UINT32 GetDecodedStringCacheBudget() const { return static_cast<UINT32>(_DefReadAcquire(&m_cbDecodedStringCacheBudget)); }
+
+    bool HasLoadedFileBudget() const { return (_DefReadAcquire(&m_hasLoadedFileBudget) != 0); }
+
+    // Serializes publishing loads, unloading and pinning the files in this
+    // manager, along with their recency and the loaded file stats.
+    _DEF_SRWLOCK* GetLoadLock() const { return &m_loadLock; }
+
+    // Called by ManagedFile with the load lock held after it loads;
+    // reloadTicks is the time taken if the file had been unloaded before.
+    void NoteFileLoaded(_In_ const ManagedFile* pFile, _In_ bool isReload, _In_ UINT64 reloadTicks) const;
+
+    // Called by ManagedFile with the load lock held.
+    void NoteFileAccessed(_In_ const ManagedFile* pFile) const;
+
+    void NoteFileUnloaded(_In_ const ManagedFile* pFile) const;
+
     /*
          * IFileSectionResolver methods
          */
@@ -538,13 +665,55 @@ private:
 
     UINT32 m_defaultFileFlags;
     mutable DynamicArray<FileManagerFileInfo>* m_pFiles;
+    mutable CaseInsensitiveStringIndex* m_pFilesByPath;
     mutable MrmFileResolver* m_pFileResolver;
 
     UnifiedEnvironment* m_pEnvironment;
 
-    PriFileManager() : m_pFiles(nullptr), m_pFileResolver(nullptr), m_pEnvironment(nullptr) {}
+    UINT64 m_maxLoadedBytes;
+    int m_maxLoadedFiles;
+    volatile LONG m_hasLoadedFileBudget;
+    UINT64 m_perfFrequency;
+    mutable _DEF_SRWLOCK m_loadLock;
+    mutable LoadedFileStats m_loadedFileStats;
+
+    // Files counted against the budget, and the ones among them that could
+    // be unloaded, most recently used first.
+    mutable UINT64 m_loadedBytes;
+    mutable int m_numLoadedFiles;
+    mutable const ManagedFile* m_pLruHead;
+    mutable const ManagedFile* m_pLruTail;
+    volatile LONG m_cbDecodedStringCacheBudget;
+
+    PriFileManager() :
+        m_pFiles(nullptr),
+        m_pFilesByPath(nullptr),
+        m_pFileResolver(nullptr),
+        m_pEnvironment(nullptr),
+        m_maxLoadedBytes(0),
+        m_maxLoadedFiles(0),
+        m_hasLoadedFileBudget(0),
+        m_perfFrequency(0),
+        m_loadedFileStats({}),
+        m_loadedBytes(0),
+        m_numLoadedFiles(0),
+        m_pLruHead(nullptr),
+        m_pLruTail(nullptr),
+        m_cbDecodedStringCacheBudget(0)
+    {}
 
     HRESULT Init(_In_ UnifiedEnvironment* pEnvironment);
+
+    // Callers hold the load lock.
+    HRESULT TrimLoadedFiles(_In_opt_ const ManagedFile* pKeep) const;
+
+    void UnlinkLoadedFile(_In_ const ManagedFile* pFile) const;
+
+    bool TryFindFile(_In_ PCWSTR pNormalizedPath, _Out_ ManagedFile** result) const;
+
+    HRESULT AddFileInfo(_In_ ManagedFile* pFile, _Out_ int* pIndexOut) const;
+
+    HRESULT RebuildFileIndex() const;
 };
 
 class ManagedSchema : public IHierarchicalSchema
@@ -654,6 +823,30 @@ public:
             scopeIndex, sizeScopes, pScopesOut, pNumScopesWritten, sizeItems, pItemsOut, pNumItemsWritten);
     }
 
+    HRESULT GetDescendentItemNames(
+        _In_ int scopeIndex,
+        _In_ int firstDescendent,
+        _In_ int maxNames,
+        _Inout_ HierarchicalNamesBatch* pNamesOut) const
+    {
+        return m_pCurrentSchema->GetDescendentItemNames(scopeIndex, firstDescendent, maxNames, pNamesOut);
+    }
+
+    HRESULT InitDescendentCursor(_In_ int scopeIndex, _Out_ HierarchicalNamesCursor* pCursorOut) const
+    {
+        return m_pCurrentSchema->InitDescendentCursor(scopeIndex, pCursorOut);
+    }
+
+    bool TryGetNextDescendent(_Inout_ HierarchicalNamesCursor* pCursor, _Out_opt_ int* pScopeIndexOut, _Out_opt_ int* pItemIndexOut) const
+    {
+        return m_pCurrentSchema->TryGetNextDescendent(pCursor, pScopeIndexOut, pItemIndexOut);
+    }
+
+    HRESULT GetChecksumForVersion(_In_ const IHierarchicalSchemaVersionInfo* pVersion, _Out_ DEF_CHECKSUM* pChecksumOut) const
+    {
+        return m_pCurrentSchema->GetChecksumForVersion(pVersion, pChecksumOut);
+    }
+
     HRESULT Clone(_Outptr_ IHierarchicalSchema**) const;
 
     HRESULT GetSchemaBlobFromFileSection(
@@ -681,6 +874,7 @@ private:
 };
 
 class UnifiedResourceView;
+struct PreloadedPriFile;
 
 class ManagedResourceMap : public IResourceMapBase, public ResourceMapSubtree
 {
@@ -725,6 +919,9 @@ public:
 
     HRESULT GetResource(_In_ PCWSTR pPath, _Inout_ NamedResourceResult* pItemOut) const;
 
+    // Name indexes describe a single file's schema, not the merged managed schema.
+    const ResourceNameIndexSection* GetNameIndex() const { return nullptr; }
+
     int GetTotalNumResourceValues() const;
 
     HRESULT SetDecisionInfoOverride(_In_ const IDecisionInfo* pOverrideDecisionInfo, _In_ const RemapUInt16* pOverrideDecisionMap) const;
@@ -905,6 +1102,10 @@ public:
 
     bool TryGetReverseFileMap(_Outptr_opt_ const ReverseFileMap** ppMapOut) const;
 
+    // Changes whenever files or resource maps are added or removed, so
+    // callers can tell when anything they cached from the view is stale.
+    UINT64 GetGeneration() const { return m_generation; }
+
 protected:
     CoreProfile* m_pProfile;
 
@@ -919,12 +1120,30 @@ protected:
     DynamicArray<ManagedSchema*>* m_pSchemas;
     DynamicArray<ManagedResourceMap*>* m_pMaps;
 
+    // Indexes into the arrays above, keyed by file path and by schema
+    // simple and unique ID.
+    CaseInsensitiveStringIndex* m_pReferencedFilesByPath;
+    CaseInsensitiveStringIndex* m_pSchemasBySimpleId;
+    CaseInsensitiveStringIndex* m_pSchemasByUniqueId;
+    CaseInsensitiveStringIndex* m_pMapsBySimpleId;
+    CaseInsensitiveStringIndex* m_pMapsByUniqueId;
+
     UnifiedViewFileInfo* m_pAppFile;
 
+    UINT64 m_generation;
+
     UnifiedResourceView(_In_ CoreProfile* pProfile);
 
     HRESULT Init();
 
+    HRESULT RebuildReferencedFileIndex();
+
+    static const UINT MinPriFilesToPreload = 2;
+
+    HRESULT PreloadPriFiles(
+        _In_ DynamicArray<StringResult*>* pFilePathsCollection,
+        _Outptr_result_maybenull_ PreloadedPriFile** ppPreloadedFiles);
+
     bool TryFindReferencedFile(
         _In_ PCWSTR pPath,
         _In_opt_ PCWSTR pPackageRoot,
@@ -253,11 +253,32 @@ public:
         _Out_writes_to_opt_(sizeItems, *pNumItemsWritten) int* pItemsOut,
         _Out_opt_ int* pNumItemsWritten) const = 0;
 
+    virtual HRESULT GetDescendentItemNames(
+        _In_ int scopeIndex,
+        _In_ int firstDescendent,
+        _In_ int maxNames,
+        _Inout_ HierarchicalNamesBatch* pNamesOut) const = 0;
+
+    virtual HRESULT InitDescendentCursor(_In_ int scopeIndex, _Out_ HierarchicalNamesCursor* pCursorOut) const = 0;
+
+    virtual bool TryGetNextDescendent(
+        _Inout_ HierarchicalNamesCursor* pCursor,
+        _Out_opt_ int* pScopeIndexOut,
+        _Out_opt_ int* pItemIndexOut) const = 0;
+
     virtual HRESULT Clone(_Outptr_ IHierarchicalSchema** result) const = 0;
 
     virtual HRESULT GetSchemaBlobFromFileSection(
         _Inout_opt_ DEFFILE_SECTION_TYPEID* pSectionTypeResult,
         _Inout_opt_ BlobResult* pBlobResult) const = 0;
+
+    // Gets the checksum of this schema at a previous version, as computed by
+    // ComputeHierarchicalSchemaVersionChecksum.  Schemas that don't change
+    // can remember the result.
+    virtual HRESULT GetChecksumForVersion(_In_ const IHierarchicalSchemaVersionInfo* pVersion, _Out_ DEF_CHECKSUM* pChecksumOut) const
+    {
+        return ComputeHierarchicalSchemaVersionChecksum(this, pVersion, pChecksumOut);
+    }
 };
 
 class StaticHierarchicalSchemaDescription : public IHierarchicalSchemaDescription
@@ -460,13 +481,49 @@ public:
         return m_pNames->GetDescendents(scopeIndex, sizeScopes, pScopesOut, pNumScopesWritten, sizeItems, pItemsOut, pNumItemsWritten);
     }
 
+    HRESULT GetDescendentItemNames(
+        _In_ int scopeIndex,
+        _In_ int firstDescendent,
+        _In_ int maxNames,
+        _Inout_ HierarchicalNamesBatch* pNamesOut) const
+    {
+        return m_pNames->GetDescendentItemNames(scopeIndex, firstDescendent, maxNames, pNamesOut);
+    }
+
+    HRESULT SetNameCacheSize(_In_ int maxNames) const { return m_pNames->SetNameCacheSize(maxNames); }
+
+    HRESULT InitDescendentCursor(_In_ int scopeIndex, _Out_ HierarchicalNamesCursor* pCursorOut) const
+    {
+        return m_pNames->InitDescendentCursor(scopeIndex, pCursorOut);
+    }
+
+    bool TryGetNextDescendent(_Inout_ HierarchicalNamesCursor* pCursor, _Out_opt_ int* pScopeIndexOut, _Out_opt_ int* pItemIndexOut) const
+    {
+        return m_pNames->TryGetNextDescendent(pCursor, pScopeIndexOut, pItemIndexOut);
+    }
+
     HRESULT Clone(_Outptr_ IHierarchicalSchema** result) const;
 
     virtual HRESULT GetSchemaBlobFromFileSection(
         _Inout_opt_ DEFFILE_SECTION_TYPEID* pSectionTypeResult,
         _Inout_opt_ BlobResult* pBlobResult) const;
 
+    // Remembers the last few version checksums, so that matching many
+    // resource packs against the same schema only walks the names once.
+    HRESULT GetChecksumForVersion(_In_ const IHierarchicalSchemaVersionInfo* pVersion, _Out_ DEF_CHECKSUM* pChecksumOut) const;
+
+    static const int MaxCachedVersionChecksums = 4;
+
 private:
+    struct VersionChecksumCacheEntry
+    {
+        UINT16 major;
+        UINT16 minor;
+        int numScopes;
+        int numItems;
+        DEF_CHECKSUM checksum;
+    };
+
     BYTE* m_pMyBuffer;
 
     MRMFILE_HSCHEMA_HEADER_EX m_header;
@@ -482,6 +539,11 @@ private:
     const void* m_pSectionData;
     int m_cbSection;
 
+    mutable _DEF_SRWLOCK m_versionChecksumLock;
+    mutable VersionChecksumCacheEntry m_versionChecksums[MaxCachedVersionChecksums];
+    mutable int m_numVersionChecksums;
+    mutable int m_nextVersionChecksum;
+
     HierarchicalSchema();
 
     HRESULT Init(
@@ -548,8 +610,16 @@ public:
         _Out_opt_ UINT16* extraDataOut,
         _Out_opt_ UINT16* pDetailOut) const;
 
+    // Fails with ERROR_MRM_RESOURCE_TYPE_MISMATCH if the value isn't a string.
+    HRESULT GetStringValue(_Inout_ StringResult* pStringOut) const;
     bool TryGetStringValue(_Inout_ StringResult* pStringOut) const;
 
+    // Gets a string value as nul-terminated UTF-8.  Well-formed strings stored as UTF-8 or
+    // ASCII are returned as stored; everything else is converted, and fails with
+    // ERROR_NO_UNICODE_TRANSLATION if it can't be.  Fails with ERROR_MRM_RESOURCE_TYPE_MISMATCH
+    // if the value isn't a string.
+    HRESULT GetStringValueUtf8(_Inout_ BlobResult* pUtf8Out) const;
+
     bool TryGetBlobValue(_Inout_ BlobResult* pBlobOut) const;
 
     HRESULT GetQualifiers(_Inout_ QualifierSetResult* pQualifiersOut) const;
@@ -606,6 +676,7 @@ protected:
 
 class IEnvironment;
 class ResourceMapSubtree;
+class ResourceNameIndexSection;
 
 class IRawResourceMap : public DefObject
 {
@@ -687,6 +758,8 @@ public:
 
     virtual HRESULT GetResource(_In_ PCWSTR pPath, _Inout_ NamedResourceResult* pItemOut) const = 0;
 
+    virtual const ResourceNameIndexSection* GetNameIndex() const = 0;
+
     virtual int GetTotalNumResourceValues() const = 0;
 
     virtual HRESULT SetDecisionInfoOverride(_In_ const IDecisionInfo* pOverrideDecisionInfo, _In_ const RemapUInt16* pOverrideDecisionMap)
@@ -779,7 +852,19 @@ protected:
 
     HRESULT GetOrUpdateDescendentScopes() const;
 
-    HRESULT GetOrUpdateDescendents() const;
+    // Makes m_pDescendentNames hold the window of names that contains index.
+    HRESULT GetOrUpdateDescendentNames(_In_ int index) const;
+
+    void ResetDescendents() const;
+
+    HRESULT MaterializeDescendents(_In_ bool wantScopes) const;
+
+    // Maps a descendent ordinal to its index in the schema.  In-order access
+    // streams from a cursor; anything else falls back to a materialized list.
+    // Callers must hold m_descendentLock.
+    HRESULT GetDescendentIndex(_In_ bool wantScope, _In_ int index, _Out_ int* pIndexInSchemaOut) const;
+
+    bool TryGetResourceIndexFromNameIndex(_In_ PCWSTR pPath, _Out_ int* pItemIndexOut) const;
 
     const IResourceMapBase* m_pFullMap;
     const IHierarchicalSchema* m_pSchema;
@@ -790,9 +875,33 @@ protected:
     mutable int m_numDescendentScopes;
     mutable _Field_size_(m_numDescendentResources) int* m_pDescendentResources;
     mutable _Field_size_(m_numDescendentScopes) int* m_pDescendentScopes;
+    mutable HierarchicalNamesBatch* m_pDescendentNames;
+    mutable int m_firstDescendentName;
+
+    // Descendent names are built this many at a time, so enumerating them
+    // builds each parent prefix about once without keeping every name in
+    // the subtree.
+    static const int DescendentNamesWindow = 64;
+
+    struct DescendentWalk
+    {
+        HierarchicalNamesCursor cursor;
+        int index;
+        int indexInSchema;
+    };
+
+    mutable DescendentWalk m_resourceWalk;
+    mutable DescendentWalk m_scopeWalk;
+
+    // Guards the descendent state above and the scope path hash, which are
+    // computed on demand by const methods of a possibly shared subtree.
+    mutable _DEF_SRWLOCK m_descendentLock;
 
     UINT64 m_initGeneration;
     mutable UINT16 m_currentMinorVersion;
+
+    mutable int m_scopePathHashIndex;
+    mutable UINT32 m_scopePathHash;
 };
 
 class IFileSectionResolver;
@@ -875,6 +984,8 @@ public:
 
     HRESULT GetResource(_In_ PCWSTR pPath, _Inout_ NamedResourceResult* pItemOut) const;
 
+    const ResourceNameIndexSection* GetNameIndex() const { return m_nameIndex; }
+
     int GetTotalNumResourceValues() const;
 
     HRESULT SetDecisionInfoOverride(_In_ const IDecisionInfo* pOverrideDecisionInfo, _In_ const RemapUInt16* pOverrideDecisionMap) const;
@@ -923,12 +1034,13 @@ protected:
     const IHierarchicalSchema* m_pSchema;
     const IDecisionInfo* m_pDecisionInfo;
     const IResourceLinks* m_links;
+    const ResourceNameIndexSection* m_nameIndex;
 
     ResourceMapFileData* m_pFileData;
 
     bool HaveLinks() const { return (m_links != nullptr); }
 
-    ResourceMapBase() : m_pFileData(nullptr) {}
+    ResourceMapBase() : m_nameIndex(nullptr), m_pFileData(nullptr) {}
 
     HRESULT Init(
         _In_ const IFileSectionResolver* pPackageResources,
@@ -1075,6 +1187,68 @@ private:
         _In_ UINT32 dataSizeInBytes);
 };
 
+/*!
+ * Optional index which maps a hash of the full path of each item in a schema
+ * to the item index, so a named resource can be found with a single probe
+ * instead of a per-segment walk of the names tree.  Every hit is verified
+ * against the schema, so a miss only means the caller should fall back to
+ * HierarchicalSchema::Contains.
+ */
+class ResourceNameIndexSection : public FileSectionBase, public HierarchicalNamesConfig
+{
+public:
+    static HRESULT CreateFromSection(
+        _In_ const IFileSectionResolver* sectionResolver,
+        _In_ const IFileSection* const section,
+        _Outptr_ ResourceNameIndexSection** result);
+
+    static HRESULT CreateInstance(
+        _In_opt_ const IFileSectionResolver* sectionResolver,
+        _In_ const DEFFILE_SECTION_TYPEID& type,
+        _In_reads_bytes_(dataSizeInBytes) const BYTE* rawData,
+        _In_ int dataSizeInBytes,
+        _Outptr_ ResourceNameIndexSection** result);
+
+    virtual ~ResourceNameIndexSection() {}
+
+    const IHierarchicalSchema* GetSchema() const { return m_schema; }
+
+    int GetNumEntries() const { return m_header->numEntries; }
+
+    bool TryFindItem(_In_ int relativeToScope, _In_ UINT32 scopePathHash, _In_ PCWSTR path, _Out_ int* itemIndex) const;
+
+    static UINT32 GetInitialPathHash() { return InitialPathHash; }
+
+    static UINT32 ComputePathHash(_In_ UINT32 partialHash, _In_opt_ PCWSTR path);
+
+    static const DEFFILE_SECTION_TYPEID GetSectionTypeId();
+
+private:
+    static const UINT32 InitialPathHash = 0x811c9dc5;
+    static const UINT32 PathHashPrime = 0x01000193;
+
+    static UINT32 HashChar(_In_ UINT32 partialHash, _In_ WCHAR ch)
+    {
+        return (partialHash ^ static_cast<UINT16>(ch)) * PathHashPrime;
+    }
+
+    bool NamesMatch(_In_ PCWSTR storedName, _In_ PCWSTR requestedName) const;
+
+    _Field_size_(1) const MRMFILE_NAME_INDEX_HEADER* m_header;
+    _Field_size_(m_header->numBuckets + 1) const UINT32* m_bucketStart;
+    _Field_size_(m_header->numEntries) const MRMFILE_NAME_INDEX_ENTRY* m_entries;
+
+    const IHierarchicalSchema* m_schema;
+
+    ResourceNameIndexSection() : m_header(nullptr), m_bucketStart(nullptr), m_entries(nullptr), m_schema(nullptr) {}
+
+    HRESULT Init(
+        _In_ const DEFFILE_SECTION_TYPEID& sectionType,
+        _In_opt_ const IFileSectionResolver* sections,
+        _In_reads_bytes_(dataSizeInBytes) const BYTE* rawData,
+        _In_ UINT32 dataSizeInBytes);
+};
+
 class PriDescriptor : public FileSectionBase
 {
 public:
@@ -1436,6 +1610,10 @@ public:
 
     HRESULT GetDataItemsSection(_In_ int fileIndex, _In_ BaseFile::SectionIndex sectionIndex, _Out_ FileDataItemsSection** result) const;
 
+    // Enables the decoded string cache on the data items sections that are
+    // already in use; sections created later get the manager's budget then.
+    HRESULT EnableDecodedStringCaches(_In_ UINT32 cbBudget) const;
+
     HRESULT GetDataSection(_In_ int fileIndex, _In_ BaseFile::SectionIndex sectionIndex, _Out_ FileDataSection** result) const;
 
     HRESULT GetReverseFileMapSection(_In_ int fileIndex, _In_ BaseFile::SectionIndex sectionIndex, _Out_ ReverseFileMap** result) const;
@@ -1467,9 +1645,19 @@ public:
     int GetNumFiles() const;
 
 protected:
+    // Sections by type, built from the TOC at open.
+    typedef struct _SectionTypeEntry
+    {
+        DEFFILE_SECTION_TYPEID type;
+        int firstSection;
+    } SectionTypeEntry;
+
     mutable const BaseFile* m_pBaseFile;
     mutable const BaseFile* m_pMyBaseFile;
     mutable MrmFileSection* m_pSections;
+    _Field_size_(m_numSectionTypes) SectionTypeEntry* m_pSectionTypes;
+    int m_numSectionTypes;
+    int* m_pNextSectionOfType;
     mutable PriFileManager* m_pPriFileManager;
     mutable MrmFileResolver* m_pFileResolver;
     UnifiedEnvironment* m_pEnvironment;
@@ -1478,6 +1666,9 @@ protected:
         m_pBaseFile(nullptr),
         m_pMyBaseFile(nullptr),
         m_pSections(nullptr),
+        m_pSectionTypes(nullptr),
+        m_numSectionTypes(0),
+        m_pNextSectionOfType(nullptr),
         m_pPriFileManager(nullptr),
         m_pFileResolver(nullptr),
         m_pEnvironment(nullptr)
@@ -1495,6 +1686,8 @@ protected:
 
     void ReleaseSections();
 
+    SectionTypeEntry* FindSectionType(_In_ const DEFFILE_SECTION_TYPEID& sectionType) const;
+
     HRESULT InitializeAndGetSection(_In_ BaseFile::SectionIndex sectionIndex, _Out_ MrmFileSection** result) const;
 
 private:
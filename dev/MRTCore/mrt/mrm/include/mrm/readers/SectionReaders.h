@@ -31,6 +31,82 @@ public:
     static const DEFFILE_SECTION_TYPEID GetSectionTypeId() { return gDataSectionType; }
 };
 
+/*!
+ * UTF-16 copies of strings decoded from a compact encoding, keyed by item
+ * index and encoding (see MakeKey).  Callers are handed a reference to the cached copy, so entries are
+ * never evicted: once the byte budget is used up, further strings simply
+ * aren't cached.  Entries are spread over several independently locked
+ * shards so concurrent lookups rarely contend.
+ */
+class DecodedStringCache : public DefObject
+{
+public:
+    struct Stats
+    {
+        UINT64 numHits;
+        UINT64 numMisses;
+        UINT64 cbUsed;
+        UINT64 cbBudget;
+        UINT32 numEntries;
+    };
+
+    static HRESULT CreateInstance(_In_ UINT32 cbBudget, _Outptr_ DecodedStringCache** result);
+
+    ~DecodedStringCache();
+
+    // The same item decodes differently in different encodings, so both are
+    // part of the key.
+    static UINT64 MakeKey(_In_ UINT32 index, _In_ DEFSTRING_ENCODING encoding)
+    {
+        return ((static_cast<UINT64>(encoding) << 32) | index);
+    }
+
+    // Looks up a string and counts the hit or miss.
+    bool TryGet(_In_ UINT64 key, _Outptr_result_maybenull_ PCWSTR* result) const;
+
+    // On success the cache takes ownership of pValue and returns the cached
+    // string, which is an earlier copy if another thread added the key first.
+    // Fails, leaving pValue with the caller, if it doesn't fit in the budget.
+    bool TryAdd(_In_ UINT64 key, _In_ PWSTR pValue, _In_ size_t cchValue, _Outptr_result_maybenull_ PCWSTR* result);
+
+    void GetStats(_Out_ Stats* pStats) const;
+
+protected:
+    struct Slot
+    {
+        UINT64 key;
+        PWSTR pValue;
+    };
+
+    struct Shard
+    {
+        _DEF_SRWLOCK lock;
+        _Field_size_(numSlots) Slot* pSlots;
+        UINT32 numSlots;
+        UINT32 numEntries;
+        volatile LONG64 numHits;
+        volatile LONG64 numMisses;
+    };
+
+    static const UINT32 NumShards = 8;
+    static const UINT32 InitialSlotsPerShard = 16;
+
+    UINT64 m_cbBudget;
+    volatile LONG64 m_cbUsed;
+    mutable Shard m_shards[NumShards];
+
+    DecodedStringCache(_In_ UINT32 cbBudget);
+
+    HRESULT Init();
+
+    static UINT32 Hash(_In_ UINT64 key) { return (static_cast<UINT32>(key ^ (key >> 32)) * 2654435761u); }
+
+    // Finds the key's slot, or the empty slot where it belongs.  Call with the shard lock held.
+    static Slot* FindSlot(_In_ const Shard* pShard, _In_ UINT32 hash, _In_ UINT64 key);
+
+    static HRESULT Grow(_Inout_ Shard* pShard);
+};
+
 class FileDataItemsSection : public FileSectionBase
 {
 protected:
@@ -40,27 +116,92 @@ protected:
     _Field_size_(m_pHeader->numLargeItems) const DEFFILE_DATA_ITEM_LARGE* m_pLargeItems;
     _Field_size_bytes_(m_pHeader->cbData) const BYTE* m_pData;
 
+    // Compressed sections only
+    const DEFFILE_DATAITEMS_BLOCKS_HEADER* m_pBlocksHeader;
+    _Field_size_(m_pBlocksHeader->numBlocks) const DEFFILE_DATAITEMS_BLOCK* m_pBlocks;
+    _Field_size_bytes_(m_pBlocksHeader->cbCompressedData) const BYTE* m_pCompressedData;
+
+    struct BlockCacheEntry
+    {
+        int blockIndex;
+        UINT32 lastUsed;
+        UINT32 cbCapacity;
+        BYTE* pData;
+    };
+
+    static const int BlockCacheSize = 4;
+
+    mutable _DEF_SRWLOCK m_blockCacheLock;
+    mutable BlockCacheEntry m_blockCache[BlockCacheSize];
+    mutable UINT32 m_blockCacheClock;
+
+    DecodedStringCache* volatile m_pStringCache;
+
     FileDataItemsSection& operator=(const FileDataSection&) {}
 
-    FileDataItemsSection() : m_pHeader(nullptr), m_pSmallItems(nullptr), m_pLargeItems(nullptr), m_pData(nullptr) {}
+    FileDataItemsSection();
 
-    HRESULT Init(_In_opt_ const IFileSection* pSection, _In_reads_bytes_(cbData) const void* pData, _In_ int cbData);
+    HRESULT Init(
+        _In_ const DEFFILE_SECTION_TYPEID& type,
+        _In_opt_ const IFileSection* pSection,
+        _In_reads_bytes_(cbData) const void* pData,
+        _In_ int cbData);
+
+    HRESULT ValidateHeader(_In_reads_bytes_(cbData) const void* pData, _In_ UINT32 cbData, _In_ bool isCompressed);
 
-    HRESULT ValidateHeader(_In_reads_bytes_(cbData) const void* pData, _In_ UINT32 cbData);
+    HRESULT ValidateBlocks() const;
+
+    HRESULT GetItemLocation(_In_ UINT32 index, _Out_ size_t* pOffset, _Out_ size_t* pcbItemData) const;
+
+    HRESULT GetCompressedItemData(_In_ size_t offset, _In_ size_t cbItemData, _Inout_ BlobResult* pData) const;
+
+    DecodedStringCache* GetStringCache() const
+    {
+        return static_cast<DecodedStringCache*>(_DefReadPointerAcquire(reinterpret_cast<PVOID const volatile*>(&m_pStringCache)));
+    }
 
 public:
     static HRESULT CreateInstance(_In_reads_bytes_(cbData) const void* pData, _In_ int cbData, _Outptr_ FileDataItemsSection** result);
+    static HRESULT CreateInstance(
+        _In_ const DEFFILE_SECTION_TYPEID& type,
+        _In_reads_bytes_(cbData) const void* pData,
+        _In_ int cbData,
+        _Outptr_ FileDataItemsSection** result);
     static HRESULT CreateInstance(_In_ IFileSection* pSection, _Outptr_ FileDataItemsSection** result);
 
-    virtual ~FileDataItemsSection() {}
+    virtual ~FileDataItemsSection();
 
     int GetNumItems() const { return (m_pHeader->numSmallItems + GetNumberOfLargeItems(m_pHeader)); }
 
+    bool IsCompressed() const { return (m_pBlocksHeader != nullptr); }
+
+    // Compressed sections have no item data to point into, so this fails
+    // with ERROR_NOT_SUPPORTED for them; use the BlobResult overload.
     HRESULT
     GetItemDataRef(_In_ UINT32 index, _Outptr_result_bytebuffer_(*pcbDataOut) const BYTE** result, _Out_opt_ UINT32* pcbDataOut) const;
+
+    // Items in compressed sections are decompressed and returned as a copy.
     HRESULT GetItemDataRef(_In_ UINT32 index, _Inout_ BlobResult* pData) const;
 
+    /*!
+     * Gets an item as a UTF-16 string, decoding it from the supplied encoding.
+     * With the decoded string cache enabled, UTF-8 and ASCII items are decoded
+     * once and later requests return a reference to the cached copy, which
+     * lives as long as the section.
+     */
+    HRESULT GetItemDataAsString(_In_ UINT32 index, _In_ DEFSTRING_ENCODING encoding, _Inout_ StringResult* pStringOut) const;
+
+    /*!
+     * Enables the decoded string cache, holding up to cbBudget bytes of
+     * decoded strings.  Does nothing if the cache is already enabled.
+     */
+    HRESULT EnableDecodedStringCache(_In_ UINT32 cbBudget);
+
+    // Returns false if the decoded string cache isn't enabled.
+    bool TryGetDecodedStringCacheStats(_Out_ DecodedStringCache::Stats* pStats) const;
+
     static const DEFFILE_SECTION_TYPEID GetSectionTypeId() { return gDataItemsSectionType; }
+    static const DEFFILE_SECTION_TYPEID GetCompressedSectionTypeId() { return gCompressedDataItemsSectionType; }
 };
 
 } // namespace Microsoft::Resources
\ No newline at end of file
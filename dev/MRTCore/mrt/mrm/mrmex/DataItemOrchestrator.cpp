@@ -6,6 +6,8 @@
 namespace Microsoft::Resources::Build
 {
 
+static const UINT32 InitialDeduplicationCapacity = 1024;
+
 HRESULT DataItemOrchestrator::CreateInstance(
     _In_ FileBuilder* fileBuilder,
     _In_ CoreProfile* profile,
@@ -34,17 +36,100 @@ DataItemOrchestrator::DataItemOrchestrator(
     m_buildersByQualifierSet(nullptr),
     m_buildConfiguration(profile->GetBuildConfiguration()),
     m_OrchestratorHashMap(nullptr)
-{}
+{
+    _DefInitializeSRWLock(&m_lock);
+}
 
 HRESULT DataItemOrchestrator::Init()
 {
     RETURN_IF_FAILED(DynamicArray<DataItemsSectionBuilder*>::CreateInstance(10, &m_allBuilders));
     RETURN_IF_FAILED(DynamicArray<DataItemsSectionBuilder*>::CreateInstance(10, &m_buildersByQualifierSet));
-    RETURN_IF_FAILED(OrchestratorHashMap::CreateInstance(1019, 0.75, &m_OrchestratorHashMap));
+    RETURN_IF_FAILED(OrchestratorHashMap::CreateInstance(InitialDeduplicationCapacity, false, &m_OrchestratorHashMap));
 
     return S_OK;
 }
 
+HRESULT DataItemOrchestrator::EnableConcurrentAdds()
+{
+    RETURN_HR_IF(E_DEF_ALREADY_INITIALIZED, m_finalized);
+
+    if (m_OrchestratorHashMap->IsConcurrent())
+    {
+        return S_OK;
+    }
+
+    // Nothing has been added yet, so no other thread can be using the old map.
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_INVALID_OPERATION), (m_OrchestratorHashMap->Count() > 0) || (m_allBuilders->Count() > 0));
+
+    OrchestratorHashMap* concurrentMap;
+    RETURN_IF_FAILED(OrchestratorHashMap::CreateInstance(InitialDeduplicationCapacity, true, &concurrentMap));
+
+    delete m_OrchestratorHashMap;
+    m_OrchestratorHashMap = concurrentMap;
+    return S_OK;
+}
+
+HRESULT DataItemOrchestrator::GetOrAddQualifierSet(_In_ const IQualifierSet* qualifiers, _Out_ int* qualifierSetIndex)
+{
+    AutoReaderWriterLock autoLock(&m_lock);
+    return m_decisionInfo->GetOrAddQualifierSet(qualifiers, qualifierSetIndex);
+}
+
+HRESULT DataItemOrchestrator::AddDeduplicatedValue(
+    _In_reads_bytes_(valueSizeInBytes) const void* value,
+    _In_ size_t valueSizeInBytes,
+    _In_ bool isUtf16String,
+    _In_ int qualifierSetIndex,
+    _Outptr_ IBuildInstanceReference** result)
+{
+    *result = nullptr;
+    RETURN_HR_IF(E_INVALIDARG, valueSizeInBytes > UINT32_MAX);
+
+    UINT64 fingerprint = DefChecksum::ComputeFingerprint(value, valueSizeInBytes);
+
+    // Most values in a large build are duplicates, so look for one before serializing with other adds.
+    OrchestratorDataReference* dataRefereceFromMap = m_OrchestratorHashMap->TryGetFromMap(fingerprint, value, valueSizeInBytes);
+
+    if (dataRefereceFromMap == nullptr)
+    {
+        AutoReaderWriterLock autoLock(&m_lock);
+
+        if (m_OrchestratorHashMap->IsConcurrent())
+        {
+            // Another thread may have added the same value since we looked.
+            dataRefereceFromMap = m_OrchestratorHashMap->TryGetFromMap(fingerprint, value, valueSizeInBytes);
+        }
+
+        if (dataRefereceFromMap == nullptr)
+        {
+            DataItemsSectionBuilder* dataItemSectionBuilder;
+            RETURN_IF_FAILED(GetOrAddDataItemSectionBuilder(qualifierSetIndex, &dataItemSectionBuilder));
+
+            DataItemsSectionBuilder::PrebuildItemReference preBuildReference = {};
+            if (isUtf16String)
+            {
+                RETURN_IF_FAILED(dataItemSectionBuilder->AddDataString(static_cast<PCWSTR>(value), &preBuildReference));
+            }
+            else
+            {
+                RETURN_IF_FAILED(dataItemSectionBuilder->AddDataItem(value, static_cast<UINT32>(valueSizeInBytes), &preBuildReference));
+            }
+
+            AutoDeletePtr<OrchestratorDataReference> autoBuildInstanceReference;
+            RETURN_IF_FAILED(OrchestratorDataReference::CreateInstance(
+                fingerprint, value, valueSizeInBytes, dataItemSectionBuilder, &preBuildReference, &autoBuildInstanceReference));
+
+            RETURN_IF_FAILED(m_OrchestratorHashMap->AddtoMap(autoBuildInstanceReference));
+
+            *result = autoBuildInstanceReference.Detach();
+            return S_OK;
+        }
+    }
+
+    // duplication found
+    return OrchestratorDataReference::CloneDataReference(dataRefereceFromMap, (OrchestratorDataReference**)result);
+}
+
 DataItemOrchestrator::~DataItemOrchestrator()
 {
     if (m_allBuilders != nullptr)
@@ -106,6 +191,7 @@ HRESULT DataItemOrchestrator::GetOrAddDataItemSectionBuilder(_In_ int qualifierS
     {
         AutoDeletePtr<DataItemsSectionBuilder> autoBuilder;
         RETURN_IF_FAILED(DataItemsSectionBuilder::CreateInstance(&autoBuilder));
+        autoBuilder->SetCompressed(m_buildConfiguration->UseCompressedDataItems());
         RETURN_IF_FAILED(m_fileBuilder->AddSection(autoBuilder));
         RETURN_IF_FAILED(m_allBuilders->Add(autoBuilder));
 
@@ -136,33 +222,12 @@ HRESULT DataItemOrchestrator::AddDataAndCreateInstanceReference(
 
     if (m_buildConfiguration->UseDeduplication())
     {
-        DEF_CHECKSUM defCheckSum = DefChecksum::ComputeChecksum(0, (const BYTE*)value, valueSizeInBytes);
-
-        OrchestratorDataReference* dataRefereceFromMap = m_OrchestratorHashMap->TryGetFromMap(defCheckSum, value, valueSizeInBytes);
-
-        if (dataRefereceFromMap == nullptr)
-        {
-            DataItemsSectionBuilder* dataItemSectionBuilder;
-            RETURN_IF_FAILED(GetOrAddDataItemSectionBuilder(qualifierSetIndex, &dataItemSectionBuilder));
-
-            RETURN_IF_FAILED(dataItemSectionBuilder->AddDataItem(value, valueSizeInBytes, &preBuildReference));
-
-            AutoDeletePtr<OrchestratorDataReference> autoBuildInstanceReference;
-            RETURN_IF_FAILED(OrchestratorDataReference::CreateInstance(
-                defCheckSum, value, valueSizeInBytes, dataItemSectionBuilder, &preBuildReference, &autoBuildInstanceReference));
-
-            RETURN_IF_FAILED(m_OrchestratorHashMap->AddtoMap(defCheckSum, autoBuildInstanceReference));
-
-            buildInstanceReference = autoBuildInstanceReference.Detach();
-        }
-        else //duplication found
-        {
-            RETURN_IF_FAILED(
-                OrchestratorDataReference::CloneDataReference(dataRefereceFromMap, (OrchestratorDataReference**)&buildInstanceReference));
-        }
+        RETURN_IF_FAILED(AddDeduplicatedValue(value, valueSizeInBytes, false, qualifierSetIndex, &buildInstanceReference));
     }
     else
     {
+        AutoReaderWriterLock autoLock(&m_lock);
+
         DataItemsSectionBuilder* dataItemSectionBuilder;
         RETURN_IF_FAILED(GetOrAddDataItemSectionBuilder(qualifierSetIndex, &dataItemSectionBuilder));
 
@@ -185,7 +250,7 @@ HRESULT DataItemOrchestrator::AddDataAndCreateInstanceReference(
 {
     *result = nullptr;
     int qualifierSetIndex;
-    RETURN_IF_FAILED(m_decisionInfo->GetOrAddQualifierSet(qualifiers, &qualifierSetIndex));
+    RETURN_IF_FAILED(GetOrAddQualifierSet(qualifiers, &qualifierSetIndex));
 
     *qualifierIndex = qualifierSetIndex;
 
@@ -208,33 +273,12 @@ HRESULT DataItemOrchestrator::AddStringAndCreateInstanceReference(
 
     if (m_buildConfiguration->UseDeduplication())
     {
-        DEF_CHECKSUM defCheckSum;
-        RETURN_IF_FAILED(DefChecksum::ComputeStringChecksum(0, true, value, &defCheckSum));
-        OrchestratorDataReference* dataRefereceFromMap = m_OrchestratorHashMap->TryGetFromMap(defCheckSum, value, valueLength);
-
-        if (dataRefereceFromMap == nullptr)
-        {
-            DataItemsSectionBuilder* dataItemSectionBuilder;
-            RETURN_IF_FAILED(GetOrAddDataItemSectionBuilder(qualifierSetIndex, &dataItemSectionBuilder));
-
-            RETURN_IF_FAILED(dataItemSectionBuilder->AddDataString(value, &preBuildReference));
-
-            AutoDeletePtr<OrchestratorDataReference> autoBuildInstanceReference;
-            RETURN_IF_FAILED(OrchestratorDataReference::CreateInstance(
-                defCheckSum, value, valueLength, dataItemSectionBuilder, &preBuildReference, &autoBuildInstanceReference));
-
-            RETURN_IF_FAILED(m_OrchestratorHashMap->AddtoMap(defCheckSum, autoBuildInstanceReference));
-
-            buildInstanceReference = autoBuildInstanceReference.Detach();
-        }
-        else //duplication found
-        {
-            RETURN_IF_FAILED(
-                OrchestratorDataReference::CloneDataReference(dataRefereceFromMap, (OrchestratorDataReference**)&buildInstanceReference));
-        }
+        RETURN_IF_FAILED(AddDeduplicatedValue(value, valueLength, true, qualifierSetIndex, &buildInstanceReference));
     }
     else
     {
+        AutoReaderWriterLock autoLock(&m_lock);
+
         DataItemsSectionBuilder* dataItemSectionBuilder;
         RETURN_IF_FAILED(GetOrAddDataItemSectionBuilder(qualifierSetIndex, &dataItemSectionBuilder));
 
@@ -257,51 +301,26 @@ HRESULT DataItemOrchestrator::AddStringAndCreateInstanceReference(
     *result = nullptr;
 
     int qualifierSetIndex;
-    RETURN_IF_FAILED(m_decisionInfo->GetOrAddQualifierSet(qualifiers, &qualifierSetIndex));
+    RETURN_IF_FAILED(GetOrAddQualifierSet(qualifiers, &qualifierSetIndex));
 
     *qualifierIndex = qualifierSetIndex;
 
     return AddStringAndCreateInstanceReference(value, *qualifierIndex, result);
 }
 
+// ASCII is a subset of UTF-8, so strings of either encoding are written the same way.
+// convertedStringSize is the exact UTF-8 size from DefString_ChooseBestEncodingWithSizes.
 HRESULT DataItemOrchestrator::OptimizeString(
-    _Out_writes_bytes_to_(convertedStringSize, *writtenBytesIncludingNull) char* convertedString,
-    _In_ PCWSTR value,
-    _Inout_ size_t* writtenBytesIncludingNull,
-    _In_ size_t convertedStringSize,
-    _In_ MrmEnvironment::ResourceValueType* optimalType)
+    _Out_writes_bytes_all_(convertedStringSize) char* convertedString,
+    _In_reads_(valueSizeInCharsIncludingNull) PCWSTR value,
+    _In_ size_t valueSizeInCharsIncludingNull,
+    _In_ size_t convertedStringSize)
 {
-    _Analysis_assume_(*writtenBytesIncludingNull < convertedStringSize);
-    DEF_ASSERT(*writtenBytesIncludingNull < convertedStringSize);
+    size_t writtenBytesIncludingNull;
+    RETURN_IF_FAILED(DefString_EncodeUtf16AsUtf8(
+        value, valueSizeInCharsIncludingNull, convertedString, convertedStringSize, &writtenBytesIncludingNull));
+    RETURN_HR_IF(E_UNEXPECTED, writtenBytesIncludingNull != convertedStringSize);
 
-    if (MrmEnvironment::IsAsciiResourceValueType(*optimalType))
-    {
-        // WideCharToMultiByte supports only ANSI, not pure ASCII. So hand-roll an implementation here.
-        for (size_t i = 0; i < *writtenBytesIncludingNull; i++)
-        {
-            DEF_ASSERT(value[i] <= 127); // Established by the encoding chooser.
-            convertedString[i] = static_cast<char>(value[i]);
-        }
-
-        convertedString[*writtenBytesIncludingNull] = '\0';
-        *writtenBytesIncludingNull =
-            *writtenBytesIncludingNull + 1; // Count the null terminator here since WideCharToMultiByte returns the size with it included.
-    }
-    else
-    {
-        int convertedSize = WideCharToMultiByte(
-            CP_UTF8,
-            0,
-            value,
-            static_cast<int>(*writtenBytesIncludingNull + 1),
-            convertedString,
-            static_cast<int>(convertedStringSize),
-            nullptr,
-            nullptr);
-        RETURN_LAST_ERROR_IF(convertedSize == 0);
-
-        *writtenBytesIncludingNull = static_cast<size_t>(convertedSize);
-    }
     return S_OK;
 }
 
@@ -316,129 +335,55 @@ HRESULT DataItemOrchestrator::AddOptimizedStringAndCreateInstanceReference(
     RETURN_HR_IF(E_DEF_ALREADY_INITIALIZED, m_finalized);
     RETURN_HR_IF(E_DEF_INCOMPATIBLE_VALUE_TYPE, !MrmEnvironment::IsUtf16ResourceValueType(originalType));
 
-    DataItemsSectionBuilder::PrebuildItemReference preBuildReference = {};
-
-    if (m_buildConfiguration->UseDeduplication())
+    // Override the provided resource value type with the optimal one.
+    size_t valueSizeInCharsIncludingNull;
+    size_t writtenBytesIncludingNull;
+    *optimalType = MrmEnvironment::ConvertToBestValueType(
+        originalType, DefString_ChooseBestEncodingWithSizes(value, &valueSizeInCharsIncludingNull, &writtenBytesIncludingNull));
+
+    // The actual value stored in OrchestratorDataReference needs to be consistent with the converted value added to
+    // dataItemSectionBuilder, so the string is converted before looking for a duplicate.
+    // The encoding chooser measured the converted string, so it's written straight into a buffer of its exact size.
+    BlobResult convertedStringResult;
+    char* convertedString = nullptr;
+    if (!MrmEnvironment::IsUtf16ResourceValueType(*optimalType))
     {
-        DEF_CHECKSUM defCheckSum = 0;
-        OrchestratorDataReference* buildInstanceReference = nullptr;
+        RETURN_IF_FAILED(convertedStringResult.SetEmptyContents(writtenBytesIncludingNull, (void**)&convertedString));
 
-        // Override the provided resource value type with the optimal one.
-        *optimalType = MrmEnvironment::ConvertToBestValueType(originalType, DefString_ChooseBestEncoding(value));
+        RETURN_IF_FAILED(OptimizeString(convertedString, value, valueSizeInCharsIncludingNull, writtenBytesIncludingNull));
+    }
 
-        if (!MrmEnvironment::IsUtf16ResourceValueType(*optimalType))
-        {
-            // The input can be optimized.
-            // The actual value stored in OrchestratorDataReference needs to be consistent with the converted value added to dataItemSectionBuilder.
-            // Therefore we convert the stirng at first so we can check its check sum and serach for a duplicaiton,
-            // then create OrchestratorDataReference instance to store the converted string.
-
-            // We know that the new string is less than the size of the existing one, else we wouldn't bother converting it.
-            size_t writtenBytesIncludingNull = wcslen(value);
-            size_t convertedStringSize = (writtenBytesIncludingNull + 1) * sizeof(wchar_t);
-            BlobResult convertedStringResult;
-            char* convertedString;
-            RETURN_IF_FAILED(convertedStringResult.SetEmptyContents(convertedStringSize, (void**)&convertedString));
-
-            RETURN_IF_FAILED(OptimizeString(convertedString, value, &writtenBytesIncludingNull, convertedStringSize, optimalType));
-
-            // Converting finished. Check duplication.
-            defCheckSum = DefChecksum::ComputeChecksum(
-                0, reinterpret_cast<const BYTE*>(convertedString), static_cast<UINT32>(writtenBytesIncludingNull));
-            buildInstanceReference =
-                m_OrchestratorHashMap->TryGetFromMap(defCheckSum, convertedString, static_cast<UINT32>(writtenBytesIncludingNull));
-
-            if (buildInstanceReference == nullptr) // The input value is an unique one.
-            {
-                DataItemsSectionBuilder* dataItemSectionBuilder;
-                RETURN_IF_FAILED(GetOrAddDataItemSectionBuilder(qualifierSetIndex, &dataItemSectionBuilder));
-
-                RETURN_IF_FAILED(dataItemSectionBuilder->AddDataItem(
-                    convertedString, static_cast<UINT32>(writtenBytesIncludingNull), &preBuildReference));
-
-                AutoDeletePtr<OrchestratorDataReference> autoBuildInstanceReference;
-                RETURN_IF_FAILED(OrchestratorDataReference::CreateInstance(
-                    defCheckSum,
-                    convertedString,
-                    static_cast<size_t>(writtenBytesIncludingNull),
-                    dataItemSectionBuilder,
-                    &preBuildReference,
-                    &autoBuildInstanceReference));
-
-                RETURN_IF_FAILED(m_OrchestratorHashMap->AddtoMap(defCheckSum, autoBuildInstanceReference));
-
-                *result = autoBuildInstanceReference.Detach();
-                return S_OK;
-            } // End of if (buildInstanceReference == nullptr)
-            else // A duplication found.
-            {
-                return OrchestratorDataReference::CloneDataReference(buildInstanceReference, (OrchestratorDataReference**)result);
-            }
-        } // End of if(!MrmEnvironment::IsUtf16ResourceValueType(*optimalType))
-        else // The input value do not need to be optimized.
+    if (m_buildConfiguration->UseDeduplication())
+    {
+        if (convertedString != nullptr)
         {
-            RETURN_IF_FAILED(DefChecksum::DefChecksum::ComputeStringChecksum(0, true, value, &defCheckSum));
-
-            size_t valueLength;
-            RETURN_IF_FAILED(GetValueSize(value, &valueLength)); // Use safe calculations to get the value length.
+            return AddDeduplicatedValue(convertedString, writtenBytesIncludingNull, false, qualifierSetIndex, result);
+        }
 
-            buildInstanceReference = m_OrchestratorHashMap->TryGetFromMap(defCheckSum, value, valueLength);
-            if (buildInstanceReference == nullptr) // The input value is an unique one.
-            {
-                DataItemsSectionBuilder* dataItemSectionBuilder;
-                RETURN_IF_FAILED(GetOrAddDataItemSectionBuilder(qualifierSetIndex, &dataItemSectionBuilder));
+        size_t valueLength;
+        RETURN_IF_FAILED(GetValueSize(value, &valueLength)); // Use safe calculations to get the value length.
 
-                RETURN_IF_FAILED(dataItemSectionBuilder->AddDataString(value, &preBuildReference));
+        return AddDeduplicatedValue(value, valueLength, true, qualifierSetIndex, result);
+    }
 
-                AutoDeletePtr<OrchestratorDataReference> autoBuildInstanceReference;
-                RETURN_IF_FAILED(OrchestratorDataReference::CreateInstance(
-                    defCheckSum, value, valueLength, dataItemSectionBuilder, &preBuildReference, &autoBuildInstanceReference));
+    AutoReaderWriterLock autoLock(&m_lock);
 
-                RETURN_IF_FAILED(m_OrchestratorHashMap->AddtoMap(defCheckSum, autoBuildInstanceReference));
+    DataItemsSectionBuilder* dataItemSectionBuilder;
+    RETURN_IF_FAILED(GetOrAddDataItemSectionBuilder(qualifierSetIndex, &dataItemSectionBuilder));
 
-                *result = autoBuildInstanceReference.Detach();
-                return S_OK;
-            }
-            else // Duplication found
-            {
-                return OrchestratorDataReference::CloneDataReference(buildInstanceReference, (OrchestratorDataReference**)result);
-            }
-        } // End of else. End of non-optimized string deduplication process.
-    } // End of deduplication process
-    else // Deduplication disabled.
+    DataItemsSectionBuilder::PrebuildItemReference preBuildReference = {};
+    if (convertedString != nullptr)
     {
-        DataItemsSectionBuilder* dataItemSectionBuilder;
-        RETURN_IF_FAILED(GetOrAddDataItemSectionBuilder(qualifierSetIndex, &dataItemSectionBuilder));
-
-        // Override the provided resource value type with the optimal one.
-        *optimalType = MrmEnvironment::ConvertToBestValueType(originalType, DefString_ChooseBestEncoding(value));
-
-        if (!MrmEnvironment::IsUtf16ResourceValueType(*optimalType))
-        {
-            // We know that the new string is less than the size of the existing one, else we wouldn't bother converting it.
-            size_t writtenBytesIncludingNull = wcslen(value);
-            size_t convertedStringSize = (writtenBytesIncludingNull + 1) * sizeof(wchar_t);
-            BlobResult convertedStringResult;
-            char* convertedString;
-            RETURN_IF_FAILED(convertedStringResult.SetEmptyContents(convertedStringSize, (void**)&convertedString));
-
-            RETURN_IF_FAILED(OptimizeString(convertedString, value, &writtenBytesIncludingNull, convertedStringSize, optimalType));
-
-            RETURN_IF_FAILED(
-                dataItemSectionBuilder->AddDataItem(convertedString, static_cast<UINT32>(writtenBytesIncludingNull), &preBuildReference));
-        }
-        else
-        {
-            RETURN_IF_FAILED(dataItemSectionBuilder->AddDataString(value, &preBuildReference));
-        }
-
-        IBuildInstanceReference* buildInstanceReference;
-        RETURN_IF_FAILED(DataItemsBuildInstanceReference::CreateInstance(
-            dataItemSectionBuilder, &preBuildReference, (DataItemsBuildInstanceReference**)&buildInstanceReference));
+        RETURN_IF_FAILED(
+            dataItemSectionBuilder->AddDataItem(convertedString, static_cast<UINT32>(writtenBytesIncludingNull), &preBuildReference));
+    }
+    else
+    {
+        RETURN_IF_FAILED(dataItemSectionBuilder->AddDataString(value, &preBuildReference));
+    }
 
-        *result = buildInstanceReference;
-    } // End of non-deduplication process
-    return S_OK;
+    return DataItemsBuildInstanceReference::CreateInstance(
+        dataItemSectionBuilder, &preBuildReference, (DataItemsBuildInstanceReference**)result);
 }
 
 HRESULT DataItemOrchestrator::GetValueSize(_In_ PCWSTR value, _Out_ size_t* size)
@@ -463,7 +408,7 @@ HRESULT DataItemOrchestrator::AddOptimizedStringAndCreateInstanceReference(
     *result = nullptr;
 
     int qualifierSetIndex;
-    RETURN_IF_FAILED(m_decisionInfo->GetOrAddQualifierSet(qualifiers, &qualifierSetIndex));
+    RETURN_IF_FAILED(GetOrAddQualifierSet(qualifiers, &qualifierSetIndex));
 
     *qualifierIndex = qualifierSetIndex;
 
@@ -479,7 +424,7 @@ void DataItemOrchestrator::DisableDeduplication()
 }
 
 HRESULT OrchestratorDataReference::CreateInstance(
-    _In_ DEF_CHECKSUM valueHash,
+    _In_ UINT64 fingerprint,
     _In_reads_bytes_(valueSizeInBytes) const void* actualValue,
     _In_ size_t valueSizeInBytes,
     _In_ DataItemsSectionBuilder* builder,
@@ -490,7 +435,8 @@ HRESULT OrchestratorDataReference::CreateInstance(
 
     RETURN_HR_IF(E_INVALIDARG, (builder == nullptr) || (preBuildItemReference == nullptr));
 
-    AutoDeletePtr<OrchestratorDataReference> orchestratorDataRef = new OrchestratorDataReference(valueHash, builder, preBuildItemReference);
+    AutoDeletePtr<OrchestratorDataReference> orchestratorDataRef =
+        new OrchestratorDataReference(fingerprint, builder, preBuildItemReference);
     RETURN_IF_NULL_ALLOC(orchestratorDataRef);
     RETURN_IF_FAILED(orchestratorDataRef->Init(actualValue, valueSizeInBytes));
 
@@ -500,10 +446,10 @@ HRESULT OrchestratorDataReference::CreateInstance(
 }
 
 OrchestratorDataReference::OrchestratorDataReference(
-    _In_ DEF_CHECKSUM valueHash,
+    _In_ UINT64 fingerprint,
     _In_ DataItemsSectionBuilder* builder,
     _In_ DataItemsSectionBuilder::PrebuildItemReference* preBuildItemReference) :
-    m_valueHash(valueHash), m_disBuilder(builder)
+    m_fingerprint(fingerprint), m_disBuilder(builder)
 {
     m_innerReference.index = preBuildItemReference->index;
     m_innerReference.isLarge = preBuildItemReference->isLarge;
@@ -527,7 +473,12 @@ OrchestratorDataReference::CloneDataReference(_In_ OrchestratorDataReference* so
     size_t actualBlobSize = sourceDataRef->GetActualValueSize();
 
     RETURN_IF_FAILED(OrchestratorDataReference::CreateInstance(
-        sourceDataRef->m_valueHash, actualBlobData, actualBlobSize, sourceDataRef->m_disBuilder, &sourceDataRef->m_innerReference, result));
+        sourceDataRef->m_fingerprint,
+        actualBlobData,
+        actualBlobSize,
+        sourceDataRef->m_disBuilder,
+        &sourceDataRef->m_innerReference,
+        result));
 
     return S_OK;
 }
@@ -593,233 +544,195 @@ const void* OrchestratorDataReference::GetActualValue() const
 
 size_t OrchestratorDataReference::GetActualValueSize() const { return m_actualDataBlob.GetSize(); }
 
-HRESULT OrchestratorHashNode::CreateInstance(
-    _In_ DEF_CHECKSUM valueHash,
-    _In_ OrchestratorDataReference* dataReference,
-    _Outptr_ OrchestratorHashNode** result)
-{
-    *result = nullptr;
-    RETURN_HR_IF_NULL(E_INVALIDARG, dataReference);
-
-    OrchestratorHashNode* hashNode = new OrchestratorHashNode(valueHash, dataReference);
-    RETURN_IF_NULL_ALLOC(hashNode);
-
-    *result = hashNode;
-    return S_OK;
-}
-
-OrchestratorHashNode::OrchestratorHashNode(_In_ DEF_CHECKSUM valueHash, _In_ OrchestratorDataReference* dataReference) :
-    m_valueHash(valueHash), m_dataReference(dataReference), m_nextOrchHashNode(nullptr)
-{}
-
-bool OrchestratorHashNode::SetNext(_In_ OrchestratorHashNode* inputNode)
-{
-    m_nextOrchHashNode = inputNode;
-    return true;
-}
+OrchestratorHashMap::OrchestratorHashMap() : m_pShards(nullptr), m_numShards(0) {}
 
 OrchestratorHashMap::~OrchestratorHashMap()
 {
-    if (m_entries != nullptr)
+    if (m_pShards != nullptr)
     {
-        for (int entryIndex = 0; entryIndex < m_currentSize; entryIndex++)
+        for (UINT32 i = 0; i < m_numShards; i++)
         {
-            OrchestratorHashNode* node = nullptr;
-            m_entries->TryGet(entryIndex, &node);
-            while (node != nullptr)
+            if (m_pShards[i].pSlots != nullptr)
             {
-                OrchestratorHashNode* nodeToBeDeleted = node;
-                node = node->GetNext();
-                delete nodeToBeDeleted;
-                nodeToBeDeleted = nullptr;
+                Def_Free(m_pShards[i].pSlots);
             }
         }
-
-        delete m_entries;
+        Def_Free(m_pShards);
+        m_pShards = nullptr;
     }
 }
 
-OrchestratorHashMap::OrchestratorHashMap(_In_ int initCapacity, _In_ float loadFactor) :
-    m_currentSize(initCapacity), m_nodeCount(0), m_loadFactor(loadFactor)
-{}
-
-HRESULT OrchestratorHashMap::Init(int initCapacity)
+HRESULT OrchestratorHashMap::Init(_In_ UINT32 initCapacity, _In_ bool concurrent)
 {
-    RETURN_IF_FAILED(DynamicArray<OrchestratorHashNode*>::CreateInstance(initCapacity, &m_entries));
+    UINT32 numShards = (concurrent ? NumConcurrentShards : 1);
+
+    // Start each shard big enough to hold its share of initCapacity without growing.
+    UINT32 numSlots = MinSlotsPerShard;
+    while (((numSlots / 4) * 3 < (initCapacity / numShards)) && (numSlots <= (UINT32_MAX / 2)))
+    {
+        numSlots *= 2;
+    }
+
+    m_pShards = _DefArray_AllocZeroed(Shard, numShards);
+    RETURN_IF_NULL_ALLOC(m_pShards);
+    m_numShards = numShards;
+
+    for (UINT32 i = 0; i < m_numShards; i++)
+    {
+        _DefInitializeSRWLock(&m_pShards[i].lock);
+        m_pShards[i].pSlots = _DefArray_AllocZeroed(Slot, numSlots);
+        RETURN_IF_NULL_ALLOC(m_pShards[i].pSlots);
+        m_pShards[i].numSlots = numSlots;
+    }
+
     return S_OK;
 }
 
-HRESULT OrchestratorHashMap::CreateInstance(_In_ int initCapacity, _In_ float loadFactor, _Outptr_ OrchestratorHashMap** result)
+HRESULT OrchestratorHashMap::CreateInstance(_In_ UINT32 initCapacity, _In_ bool concurrent, _Outptr_ OrchestratorHashMap** result)
 {
     *result = nullptr;
 
-    AutoDeletePtr<OrchestratorHashMap> orchsHashMap = new OrchestratorHashMap(initCapacity, loadFactor);
+    AutoDeletePtr<OrchestratorHashMap> orchsHashMap = new OrchestratorHashMap();
     RETURN_IF_NULL_ALLOC(orchsHashMap);
-    RETURN_IF_FAILED(orchsHashMap->Init(initCapacity));
+    RETURN_IF_FAILED(orchsHashMap->Init(initCapacity, concurrent));
 
     *result = orchsHashMap.Detach();
     return S_OK;
 }
 
-int OrchestratorHashMap::HashCode(_In_ DEF_CHECKSUM key)
+int OrchestratorHashMap::Count() const
 {
-    int index = key % m_currentSize;
-    return index;
-}
-
-int OrchestratorHashMap::HashCode(_In_ size_t newSize, _In_ DEF_CHECKSUM key)
-{
-    int index = key % newSize;
-    return index;
-}
-
-HRESULT OrchestratorHashMap::AddtoMap(_In_ DEF_CHECKSUM key, _In_ OrchestratorDataReference* dataReference)
-{
-    RETURN_HR_IF_NULL(E_INVALIDARG, dataReference);
-
-    int valueIndex = HashCode(key);
-    OrchestratorHashNode* existingNode = nullptr;
-    m_entries->TryGet(valueIndex, &existingNode);
-
-    AutoDeletePtr<OrchestratorHashNode> newHashNode;
-    RETURN_IF_FAILED(OrchestratorHashNode::CreateInstance(key, dataReference, &newHashNode));
-
-    RETURN_IF_FAILED(m_entries->ExtendAndSet(valueIndex, newHashNode, &existingNode));
-    OrchestratorHashNode* newLocalHasNode = newHashNode.Detach();
-
-    if (existingNode != nullptr)
-    {
-        newLocalHasNode->SetNext(existingNode);
-    }
-
-    m_nodeCount++;
-
-    if (m_nodeCount > m_currentSize * m_loadFactor)
+    UINT32 count = 0;
+    for (UINT32 i = 0; i < m_numShards; i++)
     {
-        RETURN_IF_FAILED(ResizeMap());
+        if (IsConcurrent())
+        {
+            AutoReaderWriterLock autoLock(&m_pShards[i].lock, true);
+            count += m_pShards[i].numEntries;
+        }
+        else
+        {
+            count += m_pShards[i].numEntries;
+        }
     }
-
-    return S_OK;
+    return static_cast<int>(count);
 }
 
-HRESULT OrchestratorHashMap::ResizeMap()
+OrchestratorDataReference* OrchestratorHashMap::FindInShard(
+    _In_ const Shard* pShard,
+    _In_ UINT64 fingerprint,
+    _In_reads_bytes_(valueSizeInBytes) const void* value,
+    _In_ size_t valueSizeInBytes)
 {
-    int oldindex = 0;
-    int newIndex = 0;
-    DEF_CHECKSUM key = 0;
-    OrchestratorHashNode* nodeToMove = nullptr;
-    OrchestratorHashNode* nestNodeInOldMap = nullptr;
-    OrchestratorHashNode* existingNodeInNewMap = nullptr;
-    OrchestratorDataReference* dataReference = nullptr;
-    DynamicArray<OrchestratorHashNode*>* oldMapEntry = m_entries;
-    AutoDeletePtr<DynamicArray<OrchestratorHashNode*>> newMapEntry;
-
-    RETURN_IF_FAILED(DynamicArray<OrchestratorHashNode*>::CreateInstance(m_currentSize * 2, &newMapEntry));
-
-    for (oldindex = 0; oldindex < m_currentSize; oldindex++)
+    // The low bits of the fingerprint pick the shard, so probe with the high ones.
+    UINT32 mask = pShard->numSlots - 1;
+    for (UINT32 index = (static_cast<UINT32>(fingerprint >> 32) & mask); pShard->pSlots[index].fingerprint != 0;
+         index = ((index + 1) & mask))
     {
-        nestNodeInOldMap = nullptr;
-        if (!oldMapEntry->TryGet(oldindex, &nestNodeInOldMap))
+        const Slot* pSlot = &pShard->pSlots[index];
+        if (pSlot->fingerprint != fingerprint)
         {
             continue;
         }
 
-        while (nestNodeInOldMap != nullptr)
+        // Matching fingerprints almost always mean matching values, but only identical values can be shared.
+        OrchestratorDataReference* dataReference = pSlot->dataReference;
+        if ((dataReference->GetActualValueSize() == valueSizeInBytes) &&
+            ((valueSizeInBytes == 0) || (memcmp(dataReference->GetActualValue(), value, valueSizeInBytes) == 0)))
         {
-            //move the odeNode pointer
-            nodeToMove = nestNodeInOldMap;
-            nestNodeInOldMap = nestNodeInOldMap->GetNext();
-
-            //set this node's nextpoint to null
-            nodeToMove->SetNext(nullptr);
+            return dataReference;
+        }
+    }
 
-            //Calculate new index by the hash from its reference
-            dataReference = nodeToMove->GetDataReference();
-            key = dataReference->GetValueHash();
-            size_t newsize = 0;
-            RETURN_IF_FAILED(SizeTAdd(m_currentSize, m_currentSize, &newsize));
+    return nullptr;
+}
 
-            newIndex = HashCode(newsize, key);
+HRESULT OrchestratorHashMap::Grow(_Inout_ Shard* pShard)
+{
+    UINT32 numOldSlots = pShard->numSlots;
+    Slot* pOldSlots = pShard->pSlots;
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW), numOldSlots > (UINT32_MAX / 2));
 
-            //put the new node(actually not a totally new one)
-            //check if the position is null
-            existingNodeInNewMap = nullptr;
-            newMapEntry->TryGet(newIndex, &existingNodeInNewMap);
+    Slot* pNewSlots = _DefArray_AllocZeroed(Slot, numOldSlots * 2);
+    RETURN_IF_NULL_ALLOC(pNewSlots);
 
-            if (existingNodeInNewMap == nullptr) //the new position is empty, put the node in there
-            {
-                RETURN_IF_FAILED(newMapEntry->ExtendAndSet(newIndex, nodeToMove));
-            }
-            else //the new position is not empty, put the new node in front of the existing node.
+    // Fingerprints are stored with the entries, so nothing is rehashed.
+    UINT32 mask = (numOldSlots * 2) - 1;
+    for (UINT32 i = 0; i < numOldSlots; i++)
+    {
+        if (pOldSlots[i].fingerprint != 0)
+        {
+            UINT32 index = (static_cast<UINT32>(pOldSlots[i].fingerprint >> 32) & mask);
+            while (pNewSlots[index].fingerprint != 0)
             {
-                nodeToMove->SetNext(existingNodeInNewMap);
-                RETURN_IF_FAILED(newMapEntry->ExtendAndSet(newIndex, nodeToMove));
+                index = ((index + 1) & mask);
             }
-            //Finish adding one node continue check.
+            pNewSlots[index] = pOldSlots[i];
         }
     }
 
-    m_entries = newMapEntry.Detach();
-    delete oldMapEntry;
-    m_currentSize = m_currentSize * 2;
+    pShard->pSlots = pNewSlots;
+    pShard->numSlots = numOldSlots * 2;
+    Def_Free(pOldSlots);
     return S_OK;
 }
 
-OrchestratorDataReference* OrchestratorHashMap::TryGetFromMap(
-    _In_ DEF_CHECKSUM key,
-    _In_opt_ const void* value,
-    _In_opt_ size_t valueSizeInBytes)
+HRESULT OrchestratorHashMap::AddToShard(_Inout_ Shard* pShard, _In_ UINT64 fingerprint, _In_ OrchestratorDataReference* dataReference)
 {
-    if ((value == nullptr) || (valueSizeInBytes > SIZE_T_MAX))
+    // Keep the shard at most three quarters full so probe sequences stay short.
+    if ((pShard->numEntries + 1) > ((pShard->numSlots / 4) * 3))
     {
-        return nullptr;
+        RETURN_IF_FAILED(Grow(pShard));
     }
 
-    int valueIndex = HashCode(key);
-    int ifEqual = 1;
+    UINT32 mask = pShard->numSlots - 1;
+    UINT32 index = (static_cast<UINT32>(fingerprint >> 32) & mask);
+    while (pShard->pSlots[index].fingerprint != 0)
+    {
+        index = ((index + 1) & mask);
+    }
 
-    // get the entry of the value
-    OrchestratorHashNode* existingNodeInCurrentMap = nullptr;
+    pShard->pSlots[index].fingerprint = fingerprint;
+    pShard->pSlots[index].dataReference = dataReference;
+    pShard->numEntries++;
+    return S_OK;
+}
 
-    (void)m_entries->Get(valueIndex, &existingNodeInCurrentMap);
+HRESULT OrchestratorHashMap::AddtoMap(_In_ OrchestratorDataReference* dataReference)
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, dataReference);
+
+    UINT64 fingerprint = dataReference->GetFingerprint();
+    RETURN_HR_IF(E_INVALIDARG, fingerprint == 0);
 
-    // if it is nullptr, there is no exsiting node in that position.
-    // Return nullptr means new node can be added to this position.
-    if (existingNodeInCurrentMap == nullptr)
+    Shard* pShard = GetShard(fingerprint);
+    if (IsConcurrent())
     {
-        return nullptr;
+        AutoReaderWriterLock autoLock(&pShard->lock);
+        return AddToShard(pShard, fingerprint, dataReference);
     }
 
-    // If the entry is not nullptr, need to check the link on this entry.
-    while (existingNodeInCurrentMap != nullptr)
-    {
-        // Firstly, check if there is any same hash code in the link.
-        if (existingNodeInCurrentMap->GetHash() == key)
-        {
-            // A node with the same hash code found
-            // Secondly, check if they have the same hash value.
-            // Only if so, they can be considered as duplicate values.
-            OrchestratorDataReference* dataReference = existingNodeInCurrentMap->GetDataReference();
-
-            // if the input value has the same size with the existing value, check the actual values.
-            // if they have different size, consider as different value.
-            if (valueSizeInBytes == dataReference->GetActualValueSize())
-            {
-                const void* existingValue = dataReference->GetActualValue();
-                ifEqual = memcmp(value, existingValue, valueSizeInBytes);
-            }
+    return AddToShard(pShard, fingerprint, dataReference);
+}
 
-            if (ifEqual == 0)
-            {
-                // A true duplication found, return the existing dataReference.
-                return dataReference;
-            }
-        }
+OrchestratorDataReference* OrchestratorHashMap::TryGetFromMap(
+    _In_ UINT64 fingerprint,
+    _In_reads_bytes_opt_(valueSizeInBytes) const void* value,
+    _In_ size_t valueSizeInBytes) const
+{
+    if ((value == nullptr) || (fingerprint == 0))
+    {
+        return nullptr;
+    }
 
-        existingNodeInCurrentMap = existingNodeInCurrentMap->GetNext();
+    Shard* pShard = GetShard(fingerprint);
+    if (IsConcurrent())
+    {
+        AutoReaderWriterLock autoLock(&pShard->lock, true);
+        return FindInShard(pShard, fingerprint, value, valueSizeInBytes);
     }
 
-    return nullptr;
+    return FindInShard(pShard, fingerprint, value, valueSizeInBytes);
 }
 
-} // namespace Microsoft::Resources::Build
\ No newline at end of file
+} // namespace Microsoft::Resources::Build
@@ -8,6 +8,7 @@
 //------------------------------------------------------------------
 
 #include "StdAfx.h"
+#include "mrm/Compression.h"
 
 namespace Microsoft::Resources::Build
 {
@@ -19,18 +20,21 @@ namespace Microsoft::Resources::Build
 /*
 ** Private constructor.
 */
-DataBlobBuilder::DataBlobBuilder() : m_offset(0), m_pHeadDataList(NULL) {}
+DataBlobBuilder::DataBlobBuilder() :
+    m_numSegments(0), m_offset(0), m_pItems(nullptr), m_numItems(0), m_sizeItems(0), m_pIndexSlots(nullptr), m_numIndexSlots(0)
+{
+    ZeroMemory(m_segments, sizeof(m_segments));
+}
 
 HRESULT DataBlobBuilder::Init()
 {
-    m_pHeadDataList = reinterpret_cast<MEM_LINKED_DATABLOB*>(_DefArray_Alloc(BYTE, maxListBufferSize + sizeof(MEM_LINKED_DATABLOB)));
-    RETURN_IF_NULL_ALLOC(m_pHeadDataList);
+    m_pItems = _DefArray_Alloc(Item, InitialItemsSize);
+    RETURN_IF_NULL_ALLOC(m_pItems);
+    m_sizeItems = InitialItemsSize;
 
-    m_pHeadDataList->fIsGivenData = false;
-    m_pHeadDataList->nSize = 0;
-    m_pHeadDataList->pNext = NULL;
-    m_pHeadDataList->pData = reinterpret_cast<BYTE*>(m_pHeadDataList + 1);
-    m_pCurDataList = m_pHeadDataList;
+    m_pIndexSlots = _DefArray_AllocZeroed(IndexSlot, InitialItemsSize * 2);
+    RETURN_IF_NULL_ALLOC(m_pIndexSlots);
+    m_numIndexSlots = InitialItemsSize * 2;
 
     return S_OK;
 }
@@ -55,45 +59,166 @@ HRESULT DataBlobBuilder::CreateInstance(_Outptr_ DataBlobBuilder** result)
 */
 DataBlobBuilder::~DataBlobBuilder()
 {
-    while (m_pHeadDataList)
+    for (UINT32 i = 0; i < m_numSegments; i++)
+    {
+        _DefFree(m_segments[i].pData);
+    }
+    m_numSegments = 0;
+
+    if (m_pItems != nullptr)
+    {
+        _DefFree(m_pItems);
+        m_pItems = nullptr;
+    }
+
+    if (m_pIndexSlots != nullptr)
     {
-        m_pCurDataList = m_pHeadDataList->pNext;
-        _DefFree(m_pHeadDataList);
-        m_pHeadDataList = m_pCurDataList;
+        _DefFree(m_pIndexSlots);
+        m_pIndexSlots = nullptr;
     }
 }
 
-/*!
-      * Appends the specified data to the data segment as
-      * a reference, and
-      * returns the offset at which it was added.  Does not
-      * check to see if the value is already in the buffer.
-      */
-HRESULT DataBlobBuilder::AddDataAsReference(__in_bcount(cbData) const BYTE* pData, __in UINT32 cbData, __out UINT32* pWrittenOffset)
+UINT32 DataBlobBuilder::HashData(_In_reads_bytes_(cbData) const BYTE* pData, _In_ UINT32 cbData)
 {
-    RETURN_HR_IF(E_INVALIDARG, (pWrittenOffset == nullptr) || (pData == nullptr) || (cbData == 0));
-
-    MEM_LINKED_DATABLOB* pNewDataList = reinterpret_cast<MEM_LINKED_DATABLOB*>(_DefArray_Alloc(BYTE, sizeof(MEM_LINKED_DATABLOB)));
-    RETURN_IF_NULL_ALLOC(pNewDataList);
+    return static_cast<UINT32>(DefChecksum::ComputeFingerprint(pData, cbData));
+}
 
-    pNewDataList->fIsGivenData = true;
-    pNewDataList->nSize = 0;
-    pNewDataList->pNext = NULL;
-    pNewDataList->pData = const_cast<BYTE*>(pData);
-    m_pCurDataList->pNext = pNewDataList;
-    m_pCurDataList = m_pCurDataList->pNext;
+const DataBlobBuilder::Segment* DataBlobBuilder::GetSegmentForOffset(_In_ UINT32 offset) const
+{
+    // Later segments are bigger, so search from the end.
+    for (UINT32 i = m_numSegments; i > 0; i--)
+    {
+        const Segment* pSegment = &m_segments[i - 1];
+        if (offset >= pSegment->offset)
+        {
+            return ((offset - pSegment->offset) < pSegment->cbUsed) ? pSegment : nullptr;
+        }
+    }
+    return nullptr;
+}
 
-    *pWrittenOffset = m_offset;
+HRESULT DataBlobBuilder::AllocItem(_In_ UINT32 cbData, _Outptr_result_bytebuffer_(cbData) BYTE** ppData, _Out_ UINT32* pOffset)
+{
+    *ppData = nullptr;
+    *pOffset = 0;
 
     // We might want to let the next caller specify the padding
     // they need instead of just assuming that everybody needs
     // 32-bit alignment.
-    m_pCurDataList->nSize += _DEFFILE_PAD(cbData, 4);
-    m_offset += _DEFFILE_PAD(cbData, 4);
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW), cbData > (UINT32_MAX - 3));
+    UINT32 cbPadded = _DEFFILE_PAD(cbData, 4);
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW), cbPadded > (UINT32_MAX - m_offset));
+
+    Segment* pSegment = ((m_numSegments > 0) ? &m_segments[m_numSegments - 1] : nullptr);
+    if ((pSegment == nullptr) || (cbPadded > (pSegment->cbCapacity - pSegment->cbUsed)))
+    {
+        // Start a new segment at least twice the size of the last one, and big enough for the item.
+        RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW), m_numSegments >= MaxSegments);
+
+        UINT32 cbSegment = ((pSegment == nullptr) ? InitialSegmentSize : pSegment->cbCapacity);
+        cbSegment = ((cbSegment > (UINT32_MAX / 2)) ? UINT32_MAX : (cbSegment * 2));
+        cbSegment = max(cbSegment, cbPadded);
+
+        BYTE* pData = _DefArray_Alloc(BYTE, cbSegment);
+        RETURN_IF_NULL_ALLOC(pData);
+
+        pSegment = &m_segments[m_numSegments++];
+        pSegment->pData = pData;
+        pSegment->offset = m_offset;
+        pSegment->cbUsed = 0;
+        pSegment->cbCapacity = cbSegment;
+    }
+
+    if (m_numItems >= m_sizeItems)
+    {
+        RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW), m_sizeItems > (UINT32_MAX / (2 * sizeof(Item))));
+
+        Item* pNewItems = _DefArray_Alloc(Item, m_sizeItems * 2);
+        RETURN_IF_NULL_ALLOC(pNewItems);
+        memcpy(pNewItems, m_pItems, m_numItems * sizeof(Item));
+        _DefFree(m_pItems);
+        m_pItems = pNewItems;
+        m_sizeItems *= 2;
+    }
 
+    BYTE* pItemData = &pSegment->pData[pSegment->cbUsed];
+    ZeroMemory(&pItemData[cbData], cbPadded - cbData);
+
+    m_pItems[m_numItems].offset = m_offset;
+    m_pItems[m_numItems].cbData = cbData;
+    m_numItems++;
+
+    *ppData = pItemData;
+    *pOffset = m_offset;
+    pSegment->cbUsed += cbPadded;
+    m_offset += cbPadded;
+    return S_OK;
+}
+
+DataBlobBuilder::IndexSlot*
+DataBlobBuilder::FindIndexSlot(_In_reads_bytes_(cbData) const BYTE* pData, _In_ UINT32 cbData, _In_ UINT32 hash) const
+{
+    UINT32 mask = m_numIndexSlots - 1;
+    for (UINT32 index = (hash & mask);; index = ((index + 1) & mask))
+    {
+        IndexSlot* pSlot = &m_pIndexSlots[index];
+        if (pSlot->itemPlusOne == 0)
+        {
+            return pSlot;
+        }
+
+        const Item* pItem = &m_pItems[pSlot->itemPlusOne - 1];
+        if ((pSlot->hash == hash) && (pItem->cbData == cbData))
+        {
+            const Segment* pSegment = GetSegmentForOffset(pItem->offset);
+            if ((pSegment != nullptr) && (memcmp(&pSegment->pData[pItem->offset - pSegment->offset], pData, cbData) == 0))
+            {
+                return pSlot;
+            }
+        }
+    }
+}
+
+HRESULT DataBlobBuilder::GrowIndex()
+{
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW), m_numIndexSlots > (UINT32_MAX / (2 * sizeof(IndexSlot))));
+
+    UINT32 numNewSlots = m_numIndexSlots * 2;
+    IndexSlot* pNewSlots = _DefArray_AllocZeroed(IndexSlot, numNewSlots);
+    RETURN_IF_NULL_ALLOC(pNewSlots);
+
+    // Hashes are kept in the slots, so nothing needs to be rehashed.
+    UINT32 mask = numNewSlots - 1;
+    for (UINT32 i = 0; i < m_numIndexSlots; i++)
+    {
+        if (m_pIndexSlots[i].itemPlusOne != 0)
+        {
+            UINT32 index = (m_pIndexSlots[i].hash & mask);
+            while (pNewSlots[index].itemPlusOne != 0)
+            {
+                index = ((index + 1) & mask);
+            }
+            pNewSlots[index] = m_pIndexSlots[i];
+        }
+    }
+
+    _DefFree(m_pIndexSlots);
+    m_pIndexSlots = pNewSlots;
+    m_numIndexSlots = numNewSlots;
     return S_OK;
 }
 
+/*!
+      * Appends the specified data to the data segment and
+      * returns the offset at which it was added.  Does not
+      * check to see if the value is already in the buffer.
+      * The data is copied, so callers needn't keep it alive.
+      */
+HRESULT DataBlobBuilder::AddDataAsReference(__in_bcount(cbData) const BYTE* pData, __in UINT32 cbData, __out UINT32* pWrittenOffset)
+{
+    return AddData(pData, cbData, pWrittenOffset);
+}
+
 /*!
       * Copies the specified data to the data segment and
       * returns the offset at which it was added.  Does not
@@ -103,37 +228,41 @@ HRESULT DataBlobBuilder::AddData(__in_bcount(cbData) const BYTE* pData, __in UIN
 {
     RETURN_HR_IF(E_INVALIDARG, (pWrittenOffset == nullptr) || (pData == nullptr) || (cbData == 0));
 
-    // it doesn't handle data that is beyond maxListBufferSize (1M) or
-    // it is given data pointer to another instance bundle
-    if ((m_pCurDataList->nSize + _DEFFILE_PAD(cbData, 4) > maxListBufferSize) || m_pCurDataList->fIsGivenData)
+    // Keep the index at most half full, and grow it first so a failure leaves the builder unchanged.
+    if (((m_numItems + 1) * 2) > m_numIndexSlots)
     {
-        return HRESULT_FROM_WIN32(ERROR_RANGE_NOT_FOUND);
+        RETURN_IF_FAILED(GrowIndex());
     }
 
-    MEM_LINKED_DATABLOB* pNewDataList =
-        reinterpret_cast<MEM_LINKED_DATABLOB*>(_DefArray_AllocZeroed(BYTE, _DEFFILE_PAD(cbData, 4) + sizeof(MEM_LINKED_DATABLOB)));
-    RETURN_IF_NULL_ALLOC(pNewDataList);
-
-    pNewDataList->fIsGivenData = false;
-    pNewDataList->nSize = 0;
-    pNewDataList->pNext = NULL;
-    pNewDataList->pData = reinterpret_cast<BYTE*>(pNewDataList + 1);
-    m_pCurDataList->pNext = pNewDataList;
-    m_pCurDataList = m_pCurDataList->pNext;
+    UINT32 hash = HashData(pData, cbData);
+    IndexSlot* pSlot = FindIndexSlot(pData, cbData, hash);
 
-    // Copy the given data and note the offset.
-    memcpy_s(&(m_pCurDataList->pData[m_pCurDataList->nSize]), (maxListBufferSize - m_pCurDataList->nSize), pData, cbData);
-    *pWrittenOffset = m_offset;
+    BYTE* pItemData;
+    RETURN_IF_FAILED(AllocItem(cbData, &pItemData, pWrittenOffset));
+    memcpy(pItemData, pData, cbData);
 
-    // We might want to let the next caller specify the padding
-    // they need instead of just assuming that everybody needs
-    // 32-bit alignment.
-    m_pCurDataList->nSize += _DEFFILE_PAD(cbData, 4);
-    m_offset += _DEFFILE_PAD(cbData, 4);
+    // The index only needs the first copy of any value.
+    if (pSlot->itemPlusOne == 0)
+    {
+        pSlot->hash = hash;
+        pSlot->itemPlusOne = m_numItems;
+    }
 
     return S_OK;
 }
 
+HRESULT DataBlobBuilder::GetOrAddData(__in_bcount(cbData) const BYTE* pData, __in UINT32 cbData, __out UINT32* pOffset)
+{
+    RETURN_HR_IF(E_INVALIDARG, (pOffset == nullptr) || (pData == nullptr) || (cbData == 0));
+
+    if (TryFindExistingData(pData, cbData, pOffset))
+    {
+        return S_OK;
+    }
+
+    return AddData(pData, cbData, pOffset);
+}
+
 bool DataBlobBuilder::TryFindData(__in_bcount(cbData) const BYTE* pData, __in UINT32 cbData, __in UINT32 dataBlobBuilderOffset) const
 {
     if ((pData == nullptr) || (cbData == 0))
@@ -141,62 +270,69 @@ bool DataBlobBuilder::TryFindData(__in_bcount(cbData) const BYTE* pData, __in UI
         return false;
     }
 
-    UINT32 nOffset = 0;
-    bool bFound = false;
-    MEM_LINKED_DATABLOB* pDataListItr = m_pHeadDataList;
-    while (pDataListItr)
+    // Items are recorded in offset order.
+    UINT32 low = 0;
+    UINT32 high = m_numItems;
+    while (low < high)
     {
-        if ((pDataListItr->nSize == _DEFFILE_PAD(cbData, 4)) && (nOffset == dataBlobBuilderOffset))
+        UINT32 mid = low + ((high - low) / 2);
+        if (m_pItems[mid].offset < dataBlobBuilderOffset)
         {
-            if (memcmp(pData, pDataListItr->pData, cbData) == 0)
-            {
-                bFound = true;
-                break;
-            }
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
         }
-        nOffset += _DEFFILE_PAD(pDataListItr->nSize, 4);
-        pDataListItr = pDataListItr->pNext;
     }
-    return bFound;
+
+    if ((low >= m_numItems) || (m_pItems[low].offset != dataBlobBuilderOffset) ||
+        (_DEFFILE_PAD(m_pItems[low].cbData, 4) != _DEFFILE_PAD(cbData, 4)))
+    {
+        return false;
+    }
+
+    const Segment* pSegment = GetSegmentForOffset(dataBlobBuilderOffset);
+    return ((pSegment != nullptr) && (memcmp(pData, &pSegment->pData[dataBlobBuilderOffset - pSegment->offset], cbData) == 0));
 }
 
-bool DataBlobBuilder::TryGetStringData(__in UINT32 wantOffset, __inout StringResult* pStringOut) const
+bool DataBlobBuilder::TryFindExistingData(__in_bcount(cbData) const BYTE* pData, __in UINT32 cbData, __out UINT32* pOffset) const
 {
-    UINT32 offset = 0;
-    MEM_LINKED_DATABLOB* pEntry = m_pHeadDataList;
+    *pOffset = 0;
+    if ((pData == nullptr) || (cbData == 0))
+    {
+        return false;
+    }
 
-    while (pEntry)
+    const IndexSlot* pSlot = FindIndexSlot(pData, cbData, HashData(pData, cbData));
+    if (pSlot->itemPlusOne == 0)
     {
-        if (wantOffset < (offset + pEntry->nSize))
-        {
-            return SUCCEEDED(pStringOut->SetRef((PCWSTR)&pEntry->pData[wantOffset - offset]));
-        }
-        offset += pEntry->nSize;
-        pEntry = pEntry->pNext;
+        return false;
     }
-    return false;
+
+    *pOffset = m_pItems[pSlot->itemPlusOne - 1].offset;
+    return true;
 }
 
-bool DataBlobBuilder::TryGetBlobData(__in UINT32 wantOffset, __in UINT32 cbData, __inout BlobResult* pBlobOut) const
+bool DataBlobBuilder::TryGetStringData(__in UINT32 wantOffset, __inout StringResult* pStringOut) const
 {
-    UINT32 offset = 0;
-    MEM_LINKED_DATABLOB* pEntry = m_pHeadDataList;
+    const Segment* pSegment = GetSegmentForOffset(wantOffset);
+    if (pSegment == nullptr)
+    {
+        return false;
+    }
+    return SUCCEEDED(pStringOut->SetRef((PCWSTR)&pSegment->pData[wantOffset - pSegment->offset]));
+}
 
-    while (pEntry)
+bool DataBlobBuilder::TryGetBlobData(__in UINT32 wantOffset, __in UINT32 cbData, __inout BlobResult* pBlobOut) const
+{
+    const Segment* pSegment = GetSegmentForOffset(wantOffset);
+    if ((pSegment == nullptr) || (cbData > (pSegment->cbUsed - (wantOffset - pSegment->offset))))
     {
-        if (wantOffset < (offset + pEntry->nSize))
-        {
-            if ((wantOffset + cbData) > (offset + pEntry->nSize))
-            {
-                // can't stitch together a value from adjacent buffers
-                return false;
-            }
-            return SUCCEEDED(pBlobOut->SetRef(&pEntry->pData[wantOffset - offset], cbData));
-        }
-        offset += pEntry->nSize;
-        pEntry = pEntry->pNext;
+        // Items never span segments
+        return false;
     }
-    return false;
+    return SUCCEEDED(pBlobOut->SetRef(&pSegment->pData[wantOffset - pSegment->offset], cbData));
 }
 
 /*
@@ -218,22 +354,16 @@ HRESULT DataBlobBuilder::BuildDataBlob(__out_bcount(cbBuffer) VOID* pBuffer, __i
 
     RETURN_HR_IF(E_INVALIDARG, (pBuffer == nullptr) || (cbBuffer < m_offset));
 
-    UINT32 cbWritten = 0;
-    m_pCurDataList = m_pHeadDataList;
+    // Segments are laid out back to back, so each one is a single copy straight into the destination.
     BYTE* pDestBuffer = reinterpret_cast<BYTE*>(pBuffer);
-
-    while (m_pCurDataList)
+    for (UINT32 i = 0; i < m_numSegments; i++)
     {
-
-        memcpy_s(&pDestBuffer[cbWritten], cbBuffer - cbWritten, m_pCurDataList->pData, m_pCurDataList->nSize);
-
-        cbWritten += m_pCurDataList->nSize;
-        m_pCurDataList = m_pCurDataList->pNext;
+        memcpy(&pDestBuffer[m_segments[i].offset], m_segments[i].pData, m_segments[i].cbUsed);
     }
 
     if (pcbWritten)
     {
-        *pcbWritten = cbWritten;
+        *pcbWritten = m_offset;
     }
 
     return S_OK;
@@ -297,7 +427,12 @@ DataItemsSectionBuilder::DataItemsSectionBuilder() :
     m_cbLargeItemDataUsed(0),
     m_cbLargeItemDataCapacity(0),
     m_pLargeItemData(NULL),
-    m_pLargeItems(NULL)
+    m_pLargeItems(NULL),
+    m_numHotItems(0),
+    m_pHotItems(NULL),
+    m_cbSmallItemLayoutUsed(0),
+    m_cbLargeItemLayoutUsed(0),
+    m_compressed(false)
 {}
 
 HRESULT DataItemsSectionBuilder::CreateInstance(_Outptr_ DataItemsSectionBuilder** result)
@@ -340,6 +475,13 @@ DataItemsSectionBuilder::~DataItemsSectionBuilder()
         Def_Free(m_pLargeItemData);
         m_pLargeItemData = NULL;
     }
+
+    m_numHotItems = 0;
+    if (m_pHotItems != NULL)
+    {
+        Def_Free(m_pHotItems);
+        m_pHotItems = NULL;
+    }
 }
 
 HRESULT DataItemsSectionBuilder::AddDataItem(
@@ -380,6 +522,8 @@ HRESULT DataItemsSectionBuilder::AddDataItem(
 
         m_pSmallItems[m_numSmallItems].offset = startOffset;
         m_pSmallItems[m_numSmallItems].cbData = cbData;
+        m_pSmallItems[m_numSmallItems].align = align;
+        m_pSmallItems[m_numSmallItems].layoutOffset = startOffset;
 
         pRefOut->isLarge = false;
         pRefOut->index = m_numSmallItems;
@@ -413,6 +557,8 @@ HRESULT DataItemsSectionBuilder::AddDataItem(
 
         m_pLargeItems[m_numLargeItems].offset = startOffset;
         m_pLargeItems[m_numLargeItems].cbData = cbData;
+        m_pLargeItems[m_numLargeItems].align = align;
+        m_pLargeItems[m_numLargeItems].layoutOffset = startOffset;
 
         pRefOut->isLarge = true;
         pRefOut->index = m_numLargeItems;
@@ -491,6 +637,122 @@ HRESULT DataItemsSectionBuilder::GetDataBlob(_In_ int itemIndex, _Inout_ BlobRes
     return S_OK;
 }
 
+HRESULT DataItemsSectionBuilder::SetHotItems(_In_ int numItems, _In_reads_opt_(numItems) const UINT32* pItemIndices)
+{
+    RETURN_HR_IF(E_INVALIDARG, (numItems < 0) || ((numItems > 0) && (pItemIndices == nullptr)));
+
+    UINT32* pNewItems = NULL;
+    if (numItems > 0)
+    {
+        pNewItems = _DefArray_AllocZeroed(UINT32, numItems);
+        RETURN_IF_NULL_ALLOC(pNewItems);
+
+        errno_t err = memcpy_s(pNewItems, numItems * sizeof(UINT32), pItemIndices, numItems * sizeof(UINT32));
+        if (err != 0)
+        {
+            Def_Free(pNewItems);
+            RETURN_IF_FAILED(ErrnoToHResult(err));
+        }
+    }
+
+    if (m_pHotItems != NULL)
+    {
+        Def_Free(m_pHotItems);
+    }
+    m_pHotItems = pNewItems;
+    m_numHotItems = numItems;
+
+    m_finalized = false;
+    return S_OK;
+}
+
+HRESULT DataItemsSectionBuilder::ComputeLayout()
+{
+    for (int i = 0; i < m_numSmallItems; i++)
+    {
+        m_pSmallItems[i].layoutOffset = m_pSmallItems[i].offset;
+    }
+    for (int i = 0; i < m_numLargeItems; i++)
+    {
+        m_pLargeItems[i].layoutOffset = m_pLargeItems[i].offset;
+    }
+    m_cbSmallItemLayoutUsed = m_cbSmallItemDataUsed;
+    m_cbLargeItemLayoutUsed = m_cbLargeItemDataUsed;
+
+    int numItems = m_numSmallItems + m_numLargeItems;
+    if ((m_numHotItems == 0) || (numItems == 0))
+    {
+        return S_OK;
+    }
+
+    unique_deffree_ptr<bool> placed(_DefArray_AllocZeroed(bool, numItems));
+    RETURN_IF_NULL_ALLOC(placed);
+
+    // Hot items first, in profile order, then everything else in index order.
+    int cbSmallUsed = 0;
+    int cbLargeUsed = 0;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        int count = ((pass == 0) ? m_numHotItems : numItems);
+        for (int i = 0; i < count; i++)
+        {
+            UINT32 itemIndex = ((pass == 0) ? m_pHotItems[i] : static_cast<UINT32>(i));
+            if ((itemIndex >= static_cast<UINT32>(numItems)) || placed.get()[itemIndex])
+            {
+                continue;
+            }
+            placed.get()[itemIndex] = true;
+
+            bool isSmall = (itemIndex < static_cast<UINT32>(m_numSmallItems));
+            struct ItemRef* pItem = (isSmall ? &m_pSmallItems[itemIndex] : &m_pLargeItems[itemIndex - m_numSmallItems]);
+            int* pcbUsed = (isSmall ? &cbSmallUsed : &cbLargeUsed);
+
+            pItem->layoutOffset = _DEFFILE_PAD(*pcbUsed, pItem->align);
+            *pcbUsed = pItem->layoutOffset + pItem->cbData;
+        }
+    }
+
+    // Reordering can add alignment padding.  If that pushes small items past
+    // the limit for 16-bit offsets, leave them in their original order.
+    if (cbSmallUsed > DEFFILE_SMALL_DATA_ITEM_MAX_SIZE)
+    {
+        for (int i = 0; i < m_numSmallItems; i++)
+        {
+            m_pSmallItems[i].layoutOffset = m_pSmallItems[i].offset;
+        }
+        cbSmallUsed = m_cbSmallItemDataUsed;
+    }
+
+    m_cbSmallItemLayoutUsed = cbSmallUsed;
+    m_cbLargeItemLayoutUsed = cbLargeUsed;
+    return S_OK;
+}
+
+HRESULT DataItemsSectionBuilder::BuildItemData(
+    __in_ecount(numItems) const struct ItemRef* pItems,
+    __in int numItems,
+    __in_bcount(cbItemData) const BYTE* pItemData,
+    __in int cbItemData,
+    __out_bcount(cbLayout) BYTE* pLayout,
+    __in int cbLayout) const
+{
+    // pad bytes between items must be zero
+    ZeroMemory(pLayout, cbLayout);
+
+    for (int i = 0; i < numItems; i++)
+    {
+        RETURN_HR_IF(
+            E_DEFFILE_BUILD_SECTION_DATA_TOO_LARGE,
+            (pItems[i].offset + pItems[i].cbData > cbItemData) || (pItems[i].layoutOffset + pItems[i].cbData > cbLayout));
+
+        errno_t err =
+            memcpy_s(&pLayout[pItems[i].layoutOffset], cbLayout - pItems[i].layoutOffset, &pItemData[pItems[i].offset], pItems[i].cbData);
+        RETURN_IF_FAILED(ErrnoToHResult(err));
+    }
+
+    return S_OK;
+}
+
 /*!
      * \name ISectionBuilder Implementation
      * @{
@@ -498,23 +760,57 @@ HRESULT DataItemsSectionBuilder::GetDataBlob(_In_ int itemIndex, _Inout_ BlobRes
 
 HRESULT DataItemsSectionBuilder::Finalize()
 {
+    RETURN_IF_FAILED(ComputeLayout());
     m_finalized = true;
     return S_OK;
 }
 
 UINT32 DataItemsSectionBuilder::GetMaxSizeInBytes() const
 {
+    UINT32 maxSize = GetUncompressedSizeInBytes();
+    if (!m_compressed)
+    {
+        return maxSize;
+    }
+
+    // Worst case is one block per item plus one for trailing padding, none of which compress.
+    UINT32 cbTables = sizeof(DEFFILE_DATAITEMS_HEADER) + (m_numSmallItems * sizeof(DEFFILE_DATA_ITEM_SMALL)) +
+                      (m_numLargeItems * sizeof(DEFFILE_DATA_ITEM_LARGE));
+    UINT32 cbItemData = maxSize - cbTables;
+    UINT32 maxBlocks = m_numSmallItems + m_numLargeItems + 1;
+
+    maxSize = cbTables + sizeof(DEFFILE_DATAITEMS_BLOCKS_HEADER) + (maxBlocks * sizeof(DEFFILE_DATAITEMS_BLOCK)) +
+              DefCompression::GetMaxCompressedSize(cbItemData) + (maxBlocks * DefCompression::GetMaxCompressedSize(0));
+    return _DEFFILE_PAD(maxSize, BaseFile::Align64Bit);
+}
+
+UINT32 DataItemsSectionBuilder::GetUncompressedSizeInBytes() const
+{
+    // Hot items can change the padding, so this is only exact once finalized.
+    int cbSmallData = (m_finalized ? m_cbSmallItemLayoutUsed : m_cbSmallItemDataUsed);
+    int cbLargeData = (m_finalized ? m_cbLargeItemLayoutUsed : m_cbLargeItemDataUsed);
+
     UINT32 maxSize = sizeof(DEFFILE_DATAITEMS_HEADER) + (m_numSmallItems * sizeof(DEFFILE_DATA_ITEM_SMALL)) +
-                     (m_numLargeItems * sizeof(DEFFILE_DATA_ITEM_LARGE)) + m_cbSmallItemDataUsed;
+                     (m_numLargeItems * sizeof(DEFFILE_DATA_ITEM_LARGE)) + cbSmallData;
     // align to 64 bits before the large items section
-    maxSize = _DEFFILE_PAD(maxSize, BaseFile::Align64Bit) + _DEFFILE_PAD(m_cbLargeItemDataUsed, BaseFile::Align64Bit);
+    maxSize = _DEFFILE_PAD(maxSize, BaseFile::Align64Bit) + _DEFFILE_PAD(cbLargeData, BaseFile::Align64Bit);
     return maxSize;
 }
 
 HRESULT DataItemsSectionBuilder::Build(__out_bcount(cbBuffer) VOID* pBuffer, __in UINT32 cbBuffer, __out_opt UINT32* pcbWrittenOut) const
+{
+    if (m_compressed)
+    {
+        return BuildCompressed(pBuffer, cbBuffer, pcbWrittenOut);
+    }
+    return BuildUncompressed(pBuffer, cbBuffer, pcbWrittenOut);
+}
+
+HRESULT
+DataItemsSectionBuilder::BuildUncompressed(__out_bcount(cbBuffer) VOID* pBuffer, __in UINT32 cbBuffer, __out_opt UINT32* pcbWrittenOut) const
 {
     RETURN_HR_IF_NULL(E_INVALIDARG, pBuffer);
-    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER), cbBuffer < GetMaxSizeInBytes());
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER), cbBuffer < GetUncompressedSizeInBytes());
 
     SectionBuilderParser data;
     RETURN_IF_FAILED(data.Set(pBuffer, cbBuffer));
@@ -559,7 +855,7 @@ HRESULT DataItemsSectionBuilder::Build(__out_bcount(cbBuffer) VOID* pBuffer, __i
             for (int i = 0; i < m_numSmallItems; i++)
             {
                 pItems[i].cbData = static_cast<UINT16>(m_pSmallItems[i].cbData);
-                pItems[i].offset = static_cast<UINT16>(m_pSmallItems[i].offset);
+                pItems[i].offset = static_cast<UINT16>(m_pSmallItems[i].layoutOffset);
             }
         }
     }
@@ -571,7 +867,7 @@ HRESULT DataItemsSectionBuilder::Build(__out_bcount(cbBuffer) VOID* pBuffer, __i
 
         // Large data starts at the first 64-bit boundary after the small data.
         UINT32 dataOffset = static_cast<UINT32>(
-            _DEFFILE_PAD(data.UsedBufferSizeInBytes() + m_cbSmallItemDataUsed, BaseFile::Align64Bit) - data.UsedBufferSizeInBytes());
+            _DEFFILE_PAD(data.UsedBufferSizeInBytes() + m_cbSmallItemLayoutUsed, BaseFile::Align64Bit) - data.UsedBufferSizeInBytes());
 
         __analysis_assume(m_sizeLargeItems >= m_numLargeItems);
 
@@ -580,35 +876,51 @@ HRESULT DataItemsSectionBuilder::Build(__out_bcount(cbBuffer) VOID* pBuffer, __i
             for (int i = 0; i < m_numLargeItems; i++)
             {
                 pItems[i].cbData = static_cast<UINT32>(m_pLargeItems[i].cbData);
-                pItems[i].offset = static_cast<UINT32>(m_pLargeItems[i].offset + dataOffset);
+                pItems[i].offset = static_cast<UINT32>(m_pLargeItems[i].layoutOffset + dataOffset);
             }
         }
     }
 
     size_t used = data.UsedBufferSizeInBytes();
 
-    if (m_cbSmallItemDataUsed > 0)
+    if (m_cbSmallItemLayoutUsed > 0)
     {
-        BYTE* pData = _SECTION_BUILDER_NEXT_ARRAY(data, m_cbSmallItemDataUsed, BYTE, &hr);
+        BYTE* pData = _SECTION_BUILDER_NEXT_ARRAY(data, m_cbSmallItemLayoutUsed, BYTE, &hr);
         RETURN_IF_FAILED(hr);
 
-        errno_t err = memcpy_s(pData, m_cbSmallItemDataUsed, m_pSmallItemData, m_cbSmallItemDataUsed);
-        // ErrnoFailed will set status if something failed.  Just fall through regardless.
-        RETURN_IF_FAILED(ErrnoToHResult(err));
+        if (m_numHotItems == 0)
+        {
+            errno_t err = memcpy_s(pData, m_cbSmallItemLayoutUsed, m_pSmallItemData, m_cbSmallItemDataUsed);
+            // ErrnoFailed will set status if something failed.  Just fall through regardless.
+            RETURN_IF_FAILED(ErrnoToHResult(err));
+        }
+        else
+        {
+            RETURN_IF_FAILED(
+                BuildItemData(m_pSmallItems, m_numSmallItems, m_pSmallItemData, m_cbSmallItemDataUsed, pData, m_cbSmallItemLayoutUsed));
+        }
     }
 
-    if (m_cbLargeItemDataUsed > 0)
+    if (m_cbLargeItemLayoutUsed > 0)
     {
         // large data must be aligned to 64-bit boundary
         _SECTION_BUILDER_PAD(&data, BaseFile::Align64Bit, &hr);
 
-        BYTE* pData = _SECTION_BUILDER_NEXT_ARRAY(data, m_cbLargeItemDataUsed, BYTE, &hr);
+        BYTE* pData = _SECTION_BUILDER_NEXT_ARRAY(data, m_cbLargeItemLayoutUsed, BYTE, &hr);
         RETURN_IF_FAILED(hr);
 
-        errno_t err = memcpy_s(pData, m_cbLargeItemDataUsed, m_pLargeItemData, m_cbLargeItemDataUsed);
+        if (m_numHotItems == 0)
+        {
+            errno_t err = memcpy_s(pData, m_cbLargeItemLayoutUsed, m_pLargeItemData, m_cbLargeItemDataUsed);
 
-        // ErrnoFailed will set status if something failed.  Just fall through regardless.
-        RETURN_IF_FAILED(ErrnoToHResult(err));
+            // ErrnoFailed will set status if something failed.  Just fall through regardless.
+            RETURN_IF_FAILED(ErrnoToHResult(err));
+        }
+        else
+        {
+            RETURN_IF_FAILED(
+                BuildItemData(m_pLargeItems, m_numLargeItems, m_pLargeItemData, m_cbLargeItemDataUsed, pData, m_cbLargeItemLayoutUsed));
+        }
     }
 
     _SECTION_BUILDER_PAD(&data, &hr);
@@ -624,6 +936,149 @@ HRESULT DataItemsSectionBuilder::Build(__out_bcount(cbBuffer) VOID* pBuffer, __i
     return S_OK;
 }
 
+struct ItemSpan
+{
+    UINT32 start;
+    UINT32 end;
+};
+
+static int __cdecl CompareItemSpans(_In_ void* /* context */, _In_ const void* elem1, _In_ const void* elem2)
+{
+    const ItemSpan* pSpan1 = reinterpret_cast<const ItemSpan*>(elem1);
+    const ItemSpan* pSpan2 = reinterpret_cast<const ItemSpan*>(elem2);
+    return ((pSpan1->start < pSpan2->start) ? -1 : ((pSpan1->start > pSpan2->start) ? 1 : 0));
+}
+
+HRESULT
+DataItemsSectionBuilder::BuildCompressed(__out_bcount(cbBuffer) VOID* pBuffer, __in UINT32 cbBuffer, __out_opt UINT32* pcbWrittenOut) const
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, pBuffer);
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER), cbBuffer < GetMaxSizeInBytes());
+    RETURN_HR_IF(E_DEF_NOT_READY, !m_finalized);
+
+    if (pcbWrittenOut != NULL)
+    {
+        *pcbWrittenOut = 0;
+    }
+
+    // Lay the section out exactly as an uncompressed one, then compress the item data.
+    UINT32 cbUncompressed = GetUncompressedSizeInBytes();
+    unique_deffree_ptr<BYTE> uncompressed(_DefArray_AllocZeroed(BYTE, cbUncompressed));
+    RETURN_IF_NULL_ALLOC(uncompressed);
+
+    UINT32 cbBuilt = 0;
+    RETURN_IF_FAILED(BuildUncompressed(uncompressed.get(), cbUncompressed, &cbBuilt));
+
+    const DEFFILE_DATAITEMS_HEADER* pHdr = reinterpret_cast<const DEFFILE_DATAITEMS_HEADER*>(uncompressed.get());
+    const DEFFILE_DATA_ITEM_SMALL* pSmallItems = reinterpret_cast<const DEFFILE_DATA_ITEM_SMALL*>(pHdr + 1);
+    const DEFFILE_DATA_ITEM_LARGE* pLargeItems = reinterpret_cast<const DEFFILE_DATA_ITEM_LARGE*>(pSmallItems + m_numSmallItems);
+    UINT32 cbTables = static_cast<UINT32>(reinterpret_cast<const BYTE*>(pLargeItems + m_numLargeItems) - uncompressed.get());
+    const BYTE* pItemData = uncompressed.get() + cbTables;
+    UINT32 cbItemData = pHdr->cbData;
+    RETURN_HR_IF(E_DEFFILE_BUILD_SECTION_DATA_TOO_LARGE, (cbTables + cbItemData) > cbBuilt);
+
+    // Cut blocks only between items, so that any item can be read from a single block.
+    int numItems = m_numSmallItems + m_numLargeItems;
+    unique_deffree_ptr<ItemSpan> spans(_DefArray_AllocZeroed(ItemSpan, numItems + 1));
+    RETURN_IF_NULL_ALLOC(spans);
+    for (int i = 0; i < m_numSmallItems; i++)
+    {
+        spans.get()[i].start = pSmallItems[i].offset;
+        spans.get()[i].end = pSmallItems[i].offset + pSmallItems[i].cbData;
+    }
+    for (int i = 0; i < m_numLargeItems; i++)
+    {
+        spans.get()[m_numSmallItems + i].start = pLargeItems[i].offset;
+        spans.get()[m_numSmallItems + i].end = pLargeItems[i].offset + pLargeItems[i].cbData;
+    }
+    qsort_s(spans.get(), numItems, sizeof(ItemSpan), CompareItemSpans, nullptr);
+
+    unique_deffree_ptr<DEFFILE_DATAITEMS_BLOCK> blocks(_DefArray_AllocZeroed(DEFFILE_DATAITEMS_BLOCK, numItems + 1));
+    RETURN_IF_NULL_ALLOC(blocks);
+
+    UINT32 numBlocks = 0;
+    UINT32 blockStart = 0;
+    UINT32 maxEnd = 0;
+    for (int i = 0; i < numItems; i++)
+    {
+        maxEnd = max(maxEnd, spans.get()[i].end);
+        UINT32 nextStart = ((i + 1 < numItems) ? spans.get()[i + 1].start : cbItemData);
+        if ((nextStart >= maxEnd) && (maxEnd < cbItemData) && ((maxEnd - blockStart) >= static_cast<UINT32>(CompressedBlockSize)))
+        {
+            blocks.get()[numBlocks].uncompressedOffset = blockStart;
+            blocks.get()[numBlocks].cbUncompressed = maxEnd - blockStart;
+            numBlocks++;
+            blockStart = maxEnd;
+        }
+    }
+    if (blockStart < cbItemData)
+    {
+        blocks.get()[numBlocks].uncompressedOffset = blockStart;
+        blocks.get()[numBlocks].cbUncompressed = cbItemData - blockStart;
+        numBlocks++;
+    }
+
+    SectionBuilderParser data;
+    RETURN_IF_FAILED(data.Set(pBuffer, cbBuffer));
+
+    HRESULT hr = S_OK;
+    BYTE* pTables = _SECTION_BUILDER_NEXT_ARRAY(data, cbTables, BYTE, &hr);
+    RETURN_IF_FAILED(hr);
+    errno_t err = memcpy_s(pTables, cbTables, uncompressed.get(), cbTables);
+    RETURN_IF_FAILED(ErrnoToHResult(err));
+
+    DEFFILE_DATAITEMS_BLOCKS_HEADER* pBlocksHdr = _SECTION_BUILDER_NEXT(data, DEFFILE_DATAITEMS_BLOCKS_HEADER, &hr);
+    RETURN_IF_FAILED(hr);
+    pBlocksHdr->numBlocks = numBlocks;
+    pBlocksHdr->cbCompressedData = 0;
+
+    DEFFILE_DATAITEMS_BLOCK* pBlocks = nullptr;
+    if (numBlocks > 0)
+    {
+        pBlocks = _SECTION_BUILDER_NEXT_ARRAY(data, numBlocks, DEFFILE_DATAITEMS_BLOCK, &hr);
+        RETURN_IF_FAILED(hr);
+    }
+
+    size_t compressedStart = data.UsedBufferSizeInBytes();
+    for (UINT32 i = 0; i < numBlocks; i++)
+    {
+        DEFFILE_DATAITEMS_BLOCK* pBlock = &blocks.get()[i];
+        const BYTE* pBlockData = &pItemData[pBlock->uncompressedOffset];
+        BYTE* pOut = static_cast<BYTE*>(pBuffer) + data.UsedBufferSizeInBytes();
+        UINT32 cbLeft = static_cast<UINT32>(cbBuffer - data.UsedBufferSizeInBytes());
+
+        // Keep the block as is unless compressing actually makes it smaller.
+        UINT32 cbCompressed = 0;
+        hr = DefCompression::Compress(pBlockData, pBlock->cbUncompressed, pOut, min(cbLeft, pBlock->cbUncompressed - 1), &cbCompressed);
+        if (hr == HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER))
+        {
+            err = memcpy_s(pOut, cbLeft, pBlockData, pBlock->cbUncompressed);
+            RETURN_IF_FAILED(ErrnoToHResult(err));
+            cbCompressed = pBlock->cbUncompressed;
+            hr = S_OK;
+        }
+        RETURN_IF_FAILED(hr);
+
+        pBlock->compressedOffset = static_cast<UINT32>(data.UsedBufferSizeInBytes() - compressedStart);
+        pBlock->cbCompressed = cbCompressed;
+        pBlocks[i] = *pBlock;
+
+        // Move past the data we just wrote
+        (void)_SECTION_BUILDER_NEXT_ARRAY(data, cbCompressed, BYTE, &hr);
+        RETURN_IF_FAILED(hr);
+    }
+    pBlocksHdr->cbCompressedData = static_cast<UINT32>(data.UsedBufferSizeInBytes() - compressedStart);
+
+    _SECTION_BUILDER_PAD(&data, &hr);
+    RETURN_IF_FAILED(hr);
+
+    if (pcbWrittenOut != NULL)
+    {
+        *pcbWrittenOut = static_cast<UINT32>(data.UsedBufferSizeInBytes());
+    }
+    return S_OK;
+}
+
 HRESULT DataItemsSectionBuilder::EnsureLargeItemCapacity(__in int cbTotal)
 {
     // ensure space for item
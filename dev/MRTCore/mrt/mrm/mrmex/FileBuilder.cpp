@@ -20,7 +20,14 @@ FileBuilder::FileBuilder(__in DEFFILE_MAGIC magic) :
     m_pToc(NULL),
     m_pSectionData(NULL),
     m_cbSectionData(0),
-    m_nSectionDataUsed(0)
+    m_nSectionDataUsed(0),
+    m_numHotSections(0),
+    m_pHotSections(NULL),
+    m_parallelBuild(false),
+    m_pSink(NULL),
+    m_pStreamHead(NULL),
+    m_pScratch(NULL),
+    m_cbScratch(0)
 {}
 
 FileBuilder::~FileBuilder()
@@ -35,6 +42,18 @@ FileBuilder::~FileBuilder()
     {
         _DefFree(m_pSections);
     }
+
+    if (m_pHotSections)
+    {
+        _DefFree(m_pHotSections);
+    }
+
+    EndStreaming();
+
+    if (m_pStreamHead)
+    {
+        _DefFree(m_pStreamHead);
+    }
 }
 
 HRESULT FileBuilder::CreateInstance(__in DEFFILE_MAGIC magic, __in BaseFile::SectionCount sizeSections, _Outptr_ FileBuilder** result)
@@ -91,6 +110,7 @@ HRESULT FileBuilder::AddSection(__in ISectionBuilder* pSectionBuilder)
     pSection->m_pSectionBuilder = pSectionBuilder;
 
     // no actual data until section is written
+    pSection->m_pTocEntry = NULL;
     pSection->m_pHeader = NULL;
     pSection->m_pTrailer = NULL;
     pSection->m_pSectionData = NULL;
@@ -110,6 +130,60 @@ HRESULT FileBuilder::GetSectionData(__in INT32 sectionIndex, _Out_ const BYTE**
     return S_OK;
 }
 
+HRESULT FileBuilder::SetAccessProfile(_In_ const AccessProfile* pProfile)
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, pProfile);
+    RETURN_HR_IF(E_INVALIDARG, (pProfile->numSections < 0) || ((pProfile->numSections > 0) && (pProfile->pSections == nullptr)));
+    RETURN_HR_IF(E_INVALIDARG, (pProfile->numItems < 0) || ((pProfile->numItems > 0) && (pProfile->pItems == nullptr)));
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_INVALID_OPERATION), m_phase > Building);
+
+    unique_deffree_ptr<BaseFile::SectionIndex> hotSections;
+    if (pProfile->numSections > 0)
+    {
+        hotSections.reset(_DefArray_AllocZeroed(BaseFile::SectionIndex, pProfile->numSections));
+        RETURN_IF_NULL_ALLOC(hotSections);
+        errno_t err = memcpy_s(
+            hotSections.get(),
+            pProfile->numSections * sizeof(BaseFile::SectionIndex),
+            pProfile->pSections,
+            pProfile->numSections * sizeof(BaseFile::SectionIndex));
+        RETURN_IF_FAILED(ErrnoToHResult(err));
+    }
+
+    // Hand each section its own items, in profile order.
+    if (m_nSections > 0)
+    {
+        unique_deffree_ptr<UINT32> items;
+        if (pProfile->numItems > 0)
+        {
+            items.reset(_DefArray_AllocZeroed(UINT32, pProfile->numItems));
+            RETURN_IF_NULL_ALLOC(items);
+        }
+
+        for (int i = 0; i < m_nSections; i++)
+        {
+            int numItems = 0;
+            for (int j = 0; j < pProfile->numItems; j++)
+            {
+                if (pProfile->pItems[j].sectionIndex == i)
+                {
+                    items.get()[numItems++] = pProfile->pItems[j].itemIndex;
+                }
+            }
+            RETURN_IF_FAILED(m_pSections[i].m_pSectionBuilder->SetHotItems(numItems, items.get()));
+        }
+    }
+
+    if (m_pHotSections != NULL)
+    {
+        _DefFree(m_pHotSections);
+    }
+    m_pHotSections = hotSections.release();
+    m_numHotSections = pProfile->numSections;
+
+    return S_OK;
+}
+
 HRESULT FileBuilder::GetMaxSize(_Out_ UINT32* size)
 {
     UINT32 maxSize;
@@ -150,14 +224,7 @@ HRESULT FileBuilder::StartGenerating(__out_bcount(cbDataOut) VOID* pDataOut, __i
     m_nSectionDataUsed = 0;
     m_cbSectionData = cbDataOut - BaseFile::GetStructureOverhead(m_nSections);
 
-    pHeader->magic = m_magic;
-    pHeader->majorVersion = DEFFILE_VERSION_MAJOR;
-    pHeader->minorVersion = DEFFILE_VERSION_MINOR;
-    pHeader->cbTotal = m_cbData; // Adjusted to actual value by FinishGenerating.
-    pHeader->sizeToc = 0; // Adjusted as sections are generated.
-    pHeader->descriptorIndex = m_descriptorIndex;
-    pHeader->tocOffset = BaseFile::PadSectionData(sizeof(DEFFILE_HEADER));
-    pHeader->sectionDataOffset = BaseFile::PadSectionData((pHeader->tocOffset + m_nSections * sizeof(DEFFILE_TOC_ENTRY)));
+    InitFileHeader();
 
     pTrailer = BaseFile::GetFileTrailer(pHeader);
     pTrailer->marker = DEFFILE_FILE_END_MARKER;
@@ -168,14 +235,77 @@ HRESULT FileBuilder::StartGenerating(__out_bcount(cbDataOut) VOID* pDataOut, __i
     return S_OK;
 }
 
+HRESULT FileBuilder::StartStreaming(_In_ IFileBuilderSink* pSink, _In_ UINT32 cbDataOut)
+{
+    RETURN_HR_IF(E_INVALIDARG, (pSink == nullptr) || (m_nSections < 1) || (cbDataOut < BaseFile::GetStructureOverhead(m_nSections)));
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_INVALID_OPERATION), m_phase != Finalizing);
+
+    // Only the header and TOC stay in memory.  Sections are generated one at
+    // a time into a scratch buffer big enough for the largest of them.
+    UINT32 cbHead = BaseFile::GetStructureOverhead(m_nSections) - sizeof(DEFFILE_TRAILER);
+    unique_deffree_ptr<BYTE> head(_DefArray_AllocZeroed(BYTE, cbHead));
+    RETURN_IF_NULL_ALLOC(head);
+
+    UINT32 cbScratch = 0;
+    for (int i = 0; i < m_nSections; i++)
+    {
+        UINT32 cbSlot = BaseFile::PadData(m_pSections[i].m_pSectionBuilder->GetMaxSizeInBytes()) + BaseFile::GetSectionStructureOverhead();
+        cbScratch = max(cbScratch, cbSlot);
+    }
+
+    unique_deffree_ptr<BYTE> scratch(_DefArray_Alloc(BYTE, cbScratch));
+    RETURN_IF_NULL_ALLOC(scratch);
+
+    m_phase = Generating;
+    m_pSink = pSink;
+    m_pStreamHead = head.release();
+    m_pScratch = scratch.release();
+    m_cbScratch = cbScratch;
+    m_cbData = BaseFile::TruncData(cbDataOut);
+    m_pHeader = reinterpret_cast<DEFFILE_HEADER*>(m_pStreamHead);
+    m_pToc = (DEFFILE_TOC_ENTRY*)&m_pHeader[1];
+    m_pSectionData = NULL;
+    m_nSectionDataUsed = 0;
+    m_cbSectionData = cbDataOut - BaseFile::GetStructureOverhead(m_nSections);
+
+    InitFileHeader();
+
+    // Reserve the start of the file; FinishGenerating writes the final header and TOC over it.
+    return m_pSink->Write(0, m_pStreamHead, cbHead);
+}
+
+void FileBuilder::InitFileHeader()
+{
+    m_pHeader->magic = m_magic;
+    m_pHeader->majorVersion = DEFFILE_VERSION_MAJOR;
+    m_pHeader->minorVersion = DEFFILE_VERSION_MINOR;
+    m_pHeader->cbTotal = m_cbData; // Adjusted to actual value by FinishGenerating.
+    m_pHeader->sizeToc = 0; // Adjusted as sections are generated.
+    m_pHeader->descriptorIndex = m_descriptorIndex;
+    m_pHeader->tocOffset = BaseFile::PadSectionData(sizeof(DEFFILE_HEADER));
+    m_pHeader->sectionDataOffset = BaseFile::PadSectionData((m_pHeader->tocOffset + m_nSections * sizeof(DEFFILE_TOC_ENTRY)));
+}
+
+void FileBuilder::EndStreaming()
+{
+    if (m_pScratch)
+    {
+        _DefFree(m_pScratch);
+        m_pScratch = NULL;
+        m_cbScratch = 0;
+    }
+    m_pSink = NULL;
+}
+
 HRESULT FileBuilder::StartSection(__in BaseFile::SectionIndex sectionIndex, _Out_ FileBuilder::SectionInfo** result)
 {
     *result = nullptr;
 
     RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_INVALID_OPERATION), m_phase != Generating);
-    RETURN_HR_IF(E_INVALIDARG, (sectionIndex >= m_nSections) || (m_pSections[sectionIndex].m_pSectionData != nullptr));
+    RETURN_HR_IF(E_INVALIDARG, (sectionIndex >= m_nSections) || (m_pSections[sectionIndex].m_pTocEntry != nullptr));
 
     FileBuilder::SectionInfo* pSection;
+    BYTE* pSlot;
     UINT32 cbSectionData;
     UINT32 cbTotal, sectionMaxSize;
 
@@ -198,8 +328,20 @@ HRESULT FileBuilder::StartSection(__in BaseFile::SectionIndex sectionIndex, _Out
         cbSectionData = cbTotal - BaseFile::GetSectionStructureOverhead();
     }
 
+    if (m_pSink == nullptr)
+    {
+        pSlot = &m_pSectionData[m_nSectionDataUsed];
+    }
+    else
+    {
+        // Fresh scratch for every section, just like the zeroed image.
+        RETURN_HR_IF(E_DEFFILE_BUILD_SECTION_DATA_TOO_LARGE, cbTotal > m_cbScratch);
+        memset(m_pScratch, 0, cbTotal);
+        pSlot = m_pScratch;
+    }
+
     pSection->m_pTocEntry = &m_pToc[sectionIndex];
-    pSection->m_pHeader = (DEFFILE_SECTION_HEADER*)&m_pSectionData[m_nSectionDataUsed];
+    pSection->m_pHeader = (DEFFILE_SECTION_HEADER*)pSlot;
     pSection->m_pSectionData = (BYTE*)&pSection->m_pHeader[1];
     pSection->m_cbSectionData = cbSectionData;
     pSection->m_pTrailer = (DEFFILE_SECTION_TRAILER*)&pSection->m_pSectionData[cbSectionData];
@@ -263,7 +405,7 @@ HRESULT FileBuilder::FinishSection(__in BaseFile::SectionIndex sectionIndex, __i
         pSection->m_pTrailer->cbSectionTotal = pSection->m_pHeader->cbSectionTotal;
         pSection->m_pTocEntry->cbSectionTotal = pSection->m_pHeader->cbSectionTotal;
 
-        extent = (UINT32)(((BYTE*)&pOldTrailer[1]) - m_pSectionData);
+        extent = pSection->m_pTocEntry->offset + (UINT32)(((BYTE*)&pOldTrailer[1]) - ((BYTE*)pSection->m_pHeader));
         if (extent == m_nSectionDataUsed)
         {
             // we're at the end of the space that's been reserved so far so we can give back
@@ -300,7 +442,7 @@ HRESULT FileBuilder::FinishGenerating()
 
     for (i = 0; i < m_nSections; i++)
     {
-        if (m_pSections[i].m_pSectionData == NULL)
+        if (m_pSections[i].m_pTocEntry == NULL)
         {
             return E_INVALIDARG;
         }
@@ -309,10 +451,22 @@ HRESULT FileBuilder::FinishGenerating()
     m_pHeader->sizeToc = (UINT16)m_nSections;
     m_pHeader->cbTotal = BaseFile::GetStructureOverhead(m_nSections) + BaseFile::PadSectionData(m_nSectionDataUsed);
 
-    pTrailer = BaseFile::GetFileTrailer(m_pHeader);
-    pTrailer->marker = DEFFILE_FILE_END_MARKER;
-    pTrailer->magic = m_pHeader->magic;
-    pTrailer->cbTotal = m_pHeader->cbTotal;
+    if (m_pSink == nullptr)
+    {
+        pTrailer = BaseFile::GetFileTrailer(m_pHeader);
+        pTrailer->marker = DEFFILE_FILE_END_MARKER;
+        pTrailer->magic = m_pHeader->magic;
+        pTrailer->cbTotal = m_pHeader->cbTotal;
+    }
+    else
+    {
+        DEFFILE_TRAILER trailer = {DEFFILE_FILE_END_MARKER, m_pHeader->cbTotal, m_pHeader->magic};
+        UINT32 trailerOffset = static_cast<UINT32>(BaseFile::PadData64(m_pHeader->cbTotal)) - sizeof(trailer);
+        UINT32 cbHead = (UINT32)(((BYTE*)&m_pToc[m_nSections]) - ((BYTE*)m_pHeader));
+
+        RETURN_IF_FAILED(m_pSink->Write(trailerOffset, &trailer, sizeof(trailer)));
+        RETURN_IF_FAILED(m_pSink->Write(0, m_pHeader, cbHead));
+    }
 
     m_phase = Done;
     return S_OK;
@@ -335,24 +489,200 @@ HRESULT FileBuilder::FinalizeAllSections()
     return S_OK;
 }
 
+HRESULT FileBuilder::GetBuildOrder(_Out_writes_(m_nSections) int* pOrder)
+{
+    // Profiled sections go first, right after the header and TOC, so the
+    // pages touched at startup are contiguous.  The TOC still lists sections
+    // by index, so readers can't tell the difference.
+    unique_deffree_ptr<bool> placed(_DefArray_AllocZeroed(bool, m_nSections));
+    RETURN_IF_NULL_ALLOC(placed);
+
+    int numPlaced = 0;
+    for (int i = 0; i < m_numHotSections; i++)
+    {
+        BaseFile::SectionIndex sectionIndex = m_pHotSections[i];
+        if ((sectionIndex < m_nSections) && !placed.get()[sectionIndex])
+        {
+            pOrder[numPlaced++] = sectionIndex;
+            placed.get()[sectionIndex] = true;
+        }
+    }
+
+    for (int i = 0; i < m_nSections; i++)
+    {
+        if (!placed.get()[i])
+        {
+            pOrder[numPlaced++] = i;
+        }
+    }
+
+    return S_OK;
+}
+
 HRESULT FileBuilder::BuildAllSections()
 {
     RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_INVALID_OPERATION), m_phase != Generating);
 
+    unique_deffree_ptr<int> order(_DefArray_Alloc(int, m_nSections));
+    RETURN_IF_NULL_ALLOC(order);
+    RETURN_IF_FAILED(GetBuildOrder(order.get()));
+
+    if (m_parallelBuild && (m_nSections > 1) && (m_pSink == nullptr))
+    {
+        return BuildSectionsInParallel(order.get());
+    }
+
     for (int i = 0; i < m_nSections; i++)
     {
-        BaseFile::SectionIndex sectionIndex = m_pSections[i].m_pSectionBuilder->GetSectionIndex();
-        FileBuilder::SectionInfo* pSectionInfo;
-        UINT32 cbWritten = 0;
-        RETURN_IF_FAILED(StartSection(sectionIndex, &pSectionInfo));
+        RETURN_IF_FAILED(BuildSection(order.get()[i]));
+    }
+
+    return S_OK;
+}
 
-        RETURN_IF_FAILED(m_pSections[i].m_pSectionBuilder->Build(pSectionInfo->m_pSectionData, pSectionInfo->m_cbSectionData, &cbWritten));
-        RETURN_IF_FAILED(FinishSection(sectionIndex, cbWritten));
+// Sections handed out to thread pool callbacks by BuildSectionsInParallel.
+struct SectionBuildBatch
+{
+    FileBuilder::SectionInfo** ppSections;
+    HRESULT* pResults;
+    UINT32* pcbWritten;
+    const int* pConcurrent; // build order positions of the sections that can be built concurrently
+    LONG numConcurrent;
+    volatile LONG nextConcurrent;
+};
+
+static void BuildSectionAt(_Inout_ SectionBuildBatch* pBatch, _In_ int i)
+{
+    FileBuilder::SectionInfo* pSection = pBatch->ppSections[i];
+    pBatch->pResults[i] = pSection->m_pSectionBuilder->Build(pSection->m_pSectionData, pSection->m_cbSectionData, &pBatch->pcbWritten[i]);
+}
+
+static void BuildNextSections(_Inout_ SectionBuildBatch* pBatch)
+{
+    LONG i;
+    while ((i = InterlockedIncrement(&pBatch->nextConcurrent) - 1) < pBatch->numConcurrent)
+    {
+        BuildSectionAt(pBatch, pBatch->pConcurrent[i]);
+    }
+}
+
+static VOID CALLBACK BuildSectionsCallback(_Inout_ PTP_CALLBACK_INSTANCE, _Inout_opt_ PVOID pContext, _Inout_ PTP_WORK)
+{
+    BuildNextSections(static_cast<SectionBuildBatch*>(pContext));
+}
+
+HRESULT FileBuilder::BuildSectionsInParallel(_In_reads_(m_nSections) const int* pOrder)
+{
+    unique_deffree_ptr<SectionInfo*> sections(_DefArray_AllocZeroed(SectionInfo*, m_nSections));
+    unique_deffree_ptr<HRESULT> results(_DefArray_AllocZeroed(HRESULT, m_nSections));
+    unique_deffree_ptr<UINT32> cbWritten(_DefArray_AllocZeroed(UINT32, m_nSections));
+    unique_deffree_ptr<int> concurrent(_DefArray_AllocZeroed(int, m_nSections));
+    RETURN_IF_NULL_ALLOC(sections);
+    RETURN_IF_NULL_ALLOC(results);
+    RETURN_IF_NULL_ALLOC(cbWritten);
+    RETURN_IF_NULL_ALLOC(concurrent);
+
+    // A section's slot depends only on its maximum size and the slots before
+    // it, never on what the sections actually write, so reserving every slot
+    // up front gives the layout a serial build produces.  The sections then
+    // fill in their own disjoint slots concurrently.
+    LONG numConcurrent = 0;
+    for (int i = 0; i < m_nSections; i++)
+    {
+        ISectionBuilder* pBuilder = m_pSections[pOrder[i]].m_pSectionBuilder;
+        RETURN_IF_FAILED(StartSection(pBuilder->GetSectionIndex(), &sections.get()[i]));
+        if (pBuilder->CanBuildConcurrently())
+        {
+            concurrent.get()[numConcurrent++] = i;
+        }
+    }
+
+    SectionBuildBatch batch = {sections.get(), results.get(), cbWritten.get(), concurrent.get(), numConcurrent, 0};
+    bool hasSerialSections = (numConcurrent < m_nSections);
+
+    // The calling thread works through the list too, so if the thread pool
+    // isn't available the sections are just built here.
+    PTP_WORK pWork = (numConcurrent > 0) ? CreateThreadpoolWork(BuildSectionsCallback, &batch, nullptr) : nullptr;
+    if (pWork != nullptr)
+    {
+        for (LONG i = (hasSerialSections ? 0 : 1); i < numConcurrent; i++)
+        {
+            SubmitThreadpoolWork(pWork);
+        }
+    }
+
+    // Sections that can't run alongside each other are built here, in order,
+    // while the pool works on the rest.  They may read the concurrent
+    // sections' builders, but those are never changed by Build.
+    if (hasSerialSections)
+    {
+        for (int i = 0; i < m_nSections; i++)
+        {
+            if (!sections.get()[i]->m_pSectionBuilder->CanBuildConcurrently())
+            {
+                BuildSectionAt(&batch, i);
+            }
+        }
+    }
+
+    BuildNextSections(&batch);
+
+    if (pWork != nullptr)
+    {
+        WaitForThreadpoolWorkCallbacks(pWork, FALSE);
+        CloseThreadpoolWork(pWork);
+    }
+
+    // Trailers, sizes and TOC entries are fixed up in build order, as in a
+    // serial build, so the first failure reported is the same one too.
+    for (int i = 0; i < m_nSections; i++)
+    {
+        RETURN_IF_FAILED(results.get()[i]);
+        RETURN_IF_FAILED(FinishSection(sections.get()[i]->m_pSectionBuilder->GetSectionIndex(), cbWritten.get()[i]));
     }
 
     return S_OK;
 }
 
+HRESULT FileBuilder::BuildSection(_In_ int index)
+{
+    BaseFile::SectionIndex sectionIndex = m_pSections[index].m_pSectionBuilder->GetSectionIndex();
+    FileBuilder::SectionInfo* pSectionInfo;
+    UINT32 cbWritten = 0;
+    RETURN_IF_FAILED(StartSection(sectionIndex, &pSectionInfo));
+
+    RETURN_IF_FAILED(m_pSections[index].m_pSectionBuilder->Build(pSectionInfo->m_pSectionData, pSectionInfo->m_cbSectionData, &cbWritten));
+    RETURN_IF_FAILED(FinishSection(sectionIndex, cbWritten));
+
+    if (m_pSink != nullptr)
+    {
+        RETURN_IF_FAILED(EmitSection(sectionIndex));
+    }
+
+    return S_OK;
+}
+
+HRESULT FileBuilder::EmitSection(_In_ BaseFile::SectionIndex sectionIndex)
+{
+    SectionInfo* pSection = &m_pSections[sectionIndex];
+    UINT32 cbHead = (UINT32)(((BYTE*)&m_pToc[m_nSections]) - ((BYTE*)m_pHeader));
+
+    // Sections are streamed in the order they are laid out, so this one's slot
+    // runs to the end of the space used so far.  The whole slot goes out,
+    // including anything past the relocated trailer, so the file matches one
+    // generated in memory byte for byte.
+    UINT32 cbSlot = m_nSectionDataUsed - pSection->m_pTocEntry->offset;
+    RETURN_IF_FAILED(m_pSink->Write(cbHead + pSection->m_pTocEntry->offset, pSection->m_pHeader, cbSlot));
+
+    // The scratch buffer is about to be reused, so the section's data is no longer available.
+    pSection->m_pHeader = NULL;
+    pSection->m_pTrailer = NULL;
+    pSection->m_pSectionData = NULL;
+    pSection->m_cbSectionData = 0;
+
+    return S_OK;
+}
+
 HRESULT FileBuilder::GenerateFileContentsInternal()
 {
     UINT32 cbBuffer = 0;
@@ -429,6 +759,89 @@ HRESULT FileBuilder::GenerateFileContents(__out_bcount(cbBufferOut) VOID* pBuffe
     return S_OK;
 }
 
+HRESULT FileBuilder::GenerateFileContents(_In_ IFileBuilderSink* pSink, _Out_opt_ UINT32* pcbWrittenSize)
+{
+    if (pcbWrittenSize != nullptr)
+    {
+        *pcbWrittenSize = 0;
+    }
+
+    RETURN_HR_IF_NULL(E_INVALIDARG, pSink);
+
+    if (nullptr == m_pData)
+    {
+        RETURN_IF_FAILED(FinalizeAllSections());
+
+        UINT32 cbMax = 0;
+        RETURN_IF_FAILED(GetMaxSize(&cbMax));
+
+        auto endStreaming = wil::scope_exit([&] { EndStreaming(); });
+        RETURN_IF_FAILED(StartStreaming(pSink, cbMax));
+        RETURN_IF_FAILED(BuildAllSections());
+        RETURN_IF_FAILED(FinishGenerating());
+
+        if (pcbWrittenSize != nullptr)
+        {
+            *pcbWrittenSize = m_pHeader->cbTotal;
+        }
+        return S_OK;
+    }
+
+    // Already generated in memory.
+    RETURN_IF_FAILED(pSink->Write(0, m_pData, m_cbData));
+
+    if (pcbWrittenSize != nullptr)
+    {
+        *pcbWrittenSize = m_cbData;
+    }
+
+    return S_OK;
+}
+
+// Writes a streamed file at the offsets the builder asks for.
+class FileBuilderFileSink : public IFileBuilderSink
+{
+public:
+    FileBuilderFileSink(_In_ HANDLE hFile) : m_hFile(hFile) {}
+
+    virtual HRESULT Write(_In_ UINT32 offset, _In_reads_bytes_(cbData) const void* pData, _In_ UINT32 cbData)
+    {
+        LARGE_INTEGER position;
+        position.QuadPart = offset;
+        RETURN_LAST_ERROR_IF(SetFilePointerEx(m_hFile, position, NULL, FILE_BEGIN) == 0);
+
+        DWORD cbWritten = 0;
+        RETURN_LAST_ERROR_IF(WriteFile(m_hFile, pData, cbData, &cbWritten, NULL) == 0);
+        RETURN_HR_IF(E_DEFFILE_UNABLE_TO_WRITE, cbWritten != cbData);
+        return S_OK;
+    }
+
+private:
+    HANDLE m_hFile;
+};
+
+HRESULT FileBuilder::StreamToFile(_In_ PCWSTR pFileName)
+{
+    RETURN_HR_IF(E_INVALIDARG, DefString_IsEmpty(pFileName));
+
+    wil::unique_handle hfile(CreateFile(pFileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL));
+    RETURN_LAST_ERROR_IF(hfile.get() == INVALID_HANDLE_VALUE);
+
+    auto cleanupOnFailure = wil::scope_exit([&] {
+        hfile.reset();
+        DeleteFile(pFileName);
+    });
+
+    FileBuilderFileSink sink(hfile.get());
+    UINT32 cbWritten = 0;
+    RETURN_IF_FAILED(GenerateFileContents(&sink, &cbWritten));
+    RETURN_HR_IF(E_DEFFILE_FILE_DATA_EMPTY, cbWritten == 0);
+    RETURN_LAST_ERROR_IF(FlushFileBuffers(hfile.get()) == 0);
+
+    cleanupOnFailure.release();
+    return S_OK;
+}
+
 HRESULT FileBuilder::WriteToFile(__in PCWSTR pFileName)
 {
     RETURN_HR_IF(E_INVALIDARG, DefString_IsEmpty(pFileName));
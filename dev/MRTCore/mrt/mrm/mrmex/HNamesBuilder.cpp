@@ -260,6 +260,21 @@ bool ScopeInfo::TryGetChild(_In_ const HierarchicalNameSegment* pName, _Outptr_o
         *ppChildOut = nullptr;
     }
 
+    if (m_pGlobalNodes->IsBulkAdding())
+    {
+        HNamesNode* pChild = nullptr;
+        if (!m_pGlobalNodes->TryFindChild(this, pName->GetName(), &pChild))
+        {
+            return false;
+        }
+
+        if (ppChildOut != nullptr)
+        {
+            *ppChildOut = pChild;
+        }
+        return true;
+    }
+
     int startSearch = -1;
     int endSearch = -1;
     int insert = -1;
@@ -646,6 +661,16 @@ HRESULT ScopeInfo::GetOrAddChildNode(_In_ HNamesNode* newNode, _Out_ HNamesNode*
 {
     *foundNode = nullptr;
 
+    if (m_pGlobalNodes->IsBulkAdding())
+    {
+        // Children are sorted when the bulk add ends.
+        if (!m_pGlobalNodes->TryFindChild(this, newNode->GetName(), foundNode))
+        {
+            RETURN_IF_FAILED(m_pChildren->Add(newNode));
+        }
+        return S_OK;
+    }
+
     int startSearch = -1;
     int endSearch = -1;
     int insert = -1;
@@ -672,6 +697,22 @@ HRESULT ScopeInfo::GetOrAddChildNode(_In_ HNamesNode* newNode, _Out_ HNamesNode*
     return S_OK;
 }
 
+static int __cdecl CompareChildNodes(_In_ void* /* context */, _In_ const void* elem1, _In_ const void* elem2)
+{
+    const HNamesNode* pNode1 = *reinterpret_cast<HNamesNode* const*>(elem1);
+    const HNamesNode* pNode2 = *reinterpret_cast<HNamesNode* const*>(elem2);
+    return pNode1->CompareTo(pNode2);
+}
+
+void ScopeInfo::SortChildren()
+{
+    // Names are unique within a scope, so this is the order GetOrAddChildNode keeps.
+    if (m_pChildren->Count() > 1)
+    {
+        qsort_s(m_pChildren->GetAll(), m_pChildren->Count(), sizeof(HNamesNode*), CompareChildNodes, nullptr);
+    }
+}
+
 class HNamesNodeAtomPool : public IAtomPool
 {
 public:
@@ -847,6 +888,7 @@ HierarchicalNamesBuilder::HierarchicalNamesBuilder(_In_ UINT32 flags) :
     m_numFinalizedNames(-1),
     m_pScopeNames(nullptr),
     m_pItemNames(nullptr),
+    m_pBulkIndex(nullptr),
     m_flags(flags),
     m_pAllScopes(nullptr),
     m_pAllItems(nullptr),
@@ -921,17 +963,185 @@ HierarchicalNamesBuilder::~HierarchicalNamesBuilder()
 
     delete m_pScopeNames;
     delete m_pItemNames;
+    delete m_pBulkIndex;
 
     m_pRootScope = nullptr;
     m_pAllScopes = nullptr;
     m_pAllItems = nullptr;
     m_pScopeNames = nullptr;
     m_pItemNames = nullptr;
+    m_pBulkIndex = nullptr;
+}
+
+HRESULT HierarchicalNamesBuilder::AddScope(__in ScopeInfo* pScope, __out int* pIndexOut)
+{
+    if (IsBulkAdding() && (pScope->GetParentScope() != nullptr))
+    {
+        int value = static_cast<int>(m_pAllScopes->Count() * 2);
+        RETURN_IF_FAILED(m_pBulkIndex->Add(GetChildHash(pScope->GetParentScope(), pScope->GetName()), value));
+    }
+    return m_pAllScopes->Add(pScope, pIndexOut);
+}
+
+HRESULT HierarchicalNamesBuilder::AddItem(__in ItemInfo* pItem, __out int* pIndexOut)
+{
+    if (IsBulkAdding())
+    {
+        int value = static_cast<int>((m_pAllItems->Count() * 2) + 1);
+        RETURN_IF_FAILED(m_pBulkIndex->Add(GetChildHash(pItem->GetParentScope(), pItem->GetName()), value));
+    }
+    return m_pAllItems->Add(pItem, pIndexOut);
 }
 
-HRESULT HierarchicalNamesBuilder::AddScope(__in ScopeInfo* pScope, __out int* pIndexOut) { return m_pAllScopes->Add(pScope, pIndexOut); }
+// Uses the ordinal fold shared with CaseInsensitiveStringIndex, so localized names that compare equal share a bucket.
+UINT32 HierarchicalNamesBuilder::GetChildHash(_In_ const ScopeInfo* pParent, _In_ PCWSTR pName)
+{
+    return CaseInsensitiveStringIndex::ComputeHash(pName) ^ (static_cast<UINT32>(pParent->GetIndex()) * 0x9e3779b1);
+}
+
+bool HierarchicalNamesBuilder::TryFindChild(
+    _In_ const ScopeInfo* pParent,
+    _In_ PCWSTR pName,
+    _Outptr_result_maybenull_ HNamesNode** ppChildOut) const
+{
+    *ppChildOut = nullptr;
 
-HRESULT HierarchicalNamesBuilder::AddItem(__in ItemInfo* pItem, __out int* pIndexOut) { return m_pAllItems->Add(pItem, pIndexOut); }
+    // Same match as ScopeInfo::FindSearchRange and FindInsertionPoint: same initial and same name, ignoring case.
+    WCHAR initial = GetSegmentInitialChar(pName);
+    UINT cursor = 0;
+    int value;
+    while (m_pBulkIndex->TryGetNext(GetChildHash(pParent, pName), &cursor, &value))
+    {
+        HNamesNode* pNode = nullptr;
+        if ((value & 1) != 0)
+        {
+            ItemInfo* pItem;
+            pNode = (m_pAllItems->TryGet(value >> 1, &pItem) ? pItem : nullptr);
+        }
+        else
+        {
+            ScopeInfo* pScope;
+            pNode = (m_pAllScopes->TryGet(value >> 1, &pScope) ? pScope : nullptr);
+        }
+
+        if ((pNode != nullptr) && (pNode->GetParentScope() == pParent) && (pNode->GetInitialChar() == initial) &&
+            (CompareSegments(pNode->GetName(), pName) == Def_Equal))
+        {
+            *ppChildOut = pNode;
+            return true;
+        }
+    }
+    return false;
+}
+
+HRESULT HierarchicalNamesBuilder::BeginBulkAdd()
+{
+    if (IsBulkAdding())
+    {
+        return S_OK;
+    }
+
+    AutoDeletePtr<CaseInsensitiveStringIndex> pIndex;
+    RETURN_IF_FAILED(CaseInsensitiveStringIndex::CreateInstance(m_pAllScopes->Count() + m_pAllItems->Count(), &pIndex));
+
+    // Index everything added so far; the root scope has no parent.
+    for (UINT i = 1; i < m_pAllScopes->Count(); i++)
+    {
+        ScopeInfo* pScope;
+        RETURN_IF_FAILED(m_pAllScopes->Get(i, &pScope));
+        RETURN_IF_FAILED(pIndex->Add(GetChildHash(pScope->GetParentScope(), pScope->GetName()), static_cast<int>(i * 2)));
+    }
+
+    for (UINT i = 0; i < m_pAllItems->Count(); i++)
+    {
+        ItemInfo* pItem;
+        RETURN_IF_FAILED(m_pAllItems->Get(i, &pItem));
+        RETURN_IF_FAILED(pIndex->Add(GetChildHash(pItem->GetParentScope(), pItem->GetName()), static_cast<int>((i * 2) + 1)));
+    }
+
+    m_pBulkIndex = pIndex.Detach();
+    return S_OK;
+}
+
+// Below this many names, handing scopes to the thread pool costs more than sorting them here.
+static const UINT ParallelSortMinNames = 4 * 1024;
+
+// Scopes handed out to thread pool callbacks by SortScopesInParallel.
+struct ScopeSortBatch
+{
+    ScopeInfo** ppScopes;
+    LONG numScopes;
+    volatile LONG nextScope;
+};
+
+static void SortNextScopes(_Inout_ ScopeSortBatch* pBatch)
+{
+    LONG i;
+    while ((i = InterlockedIncrement(&pBatch->nextScope) - 1) < pBatch->numScopes)
+    {
+        pBatch->ppScopes[i]->SortChildren();
+    }
+}
+
+static VOID CALLBACK SortScopesCallback(_Inout_ PTP_CALLBACK_INSTANCE, _Inout_opt_ PVOID pContext, _Inout_ PTP_WORK)
+{
+    SortNextScopes(static_cast<ScopeSortBatch*>(pContext));
+}
+
+static void SortScopesInParallel(_Inout_updates_(numScopes) ScopeInfo** ppScopes, _In_ UINT numScopes)
+{
+    ScopeSortBatch batch = {ppScopes, static_cast<LONG>(numScopes), 0};
+
+    // Each scope only sorts its own children, so scopes can be sorted in any
+    // order on any thread.  The calling thread works through the list too,
+    // so if the thread pool isn't available the scopes are just sorted here.
+    PTP_WORK pWork = CreateThreadpoolWork(SortScopesCallback, &batch, nullptr);
+    if (pWork != nullptr)
+    {
+        SYSTEM_INFO systemInfo;
+        GetSystemInfo(&systemInfo);
+        UINT numHelpers = min(numScopes, static_cast<UINT>(systemInfo.dwNumberOfProcessors)) - 1;
+        for (UINT i = 0; i < numHelpers; i++)
+        {
+            SubmitThreadpoolWork(pWork);
+        }
+    }
+
+    SortNextScopes(&batch);
+
+    if (pWork != nullptr)
+    {
+        WaitForThreadpoolWorkCallbacks(pWork, FALSE);
+        CloseThreadpoolWork(pWork);
+    }
+}
+
+HRESULT HierarchicalNamesBuilder::EndBulkAdd()
+{
+    if (!IsBulkAdding())
+    {
+        return S_OK;
+    }
+
+    UINT numScopes = m_pAllScopes->Count();
+    if ((numScopes > 1) && ((numScopes + m_pAllItems->Count()) >= ParallelSortMinNames))
+    {
+        SortScopesInParallel(m_pAllScopes->GetAll(), numScopes);
+    }
+    else
+    {
+        for (UINT i = 0; i < numScopes; i++)
+        {
+            ScopeInfo* pScope;
+            RETURN_IF_FAILED(m_pAllScopes->Get(i, &pScope));
+            pScope->SortChildren();
+        }
+    }
+
+    delete m_pBulkIndex;
+    m_pBulkIndex = nullptr;
+    return S_OK;
+}
 
 int HierarchicalNamesBuilder::GetNumRootScopes() const { return m_pRootScope->GetNumChildScopes(); }
 
@@ -1224,6 +1434,8 @@ bool HierarchicalNamesBuilder::AssignChildNameIndices(__in ScopeInfo* pScope, __
 
 HRESULT HierarchicalNamesBuilder::Finalize()
 {
+    RETURN_IF_FAILED(EndBulkAdd());
+
     m_pRootScope->SetNameIndex(0);
 
     int nextIndex = 1;
@@ -1435,6 +1647,7 @@ HRESULT HierarchicalNamesBuilder::Build(__out_bcount(cbBuffer) VOID* pBuffer, UI
     RETURN_IF_FAILED(data.Set(pBuffer, cbBuffer));
 
     bool useExtendedHNames = (m_cchFinalizedAsciiNames > 0); // ASCII schema requires using the extended HNAMES header.
+    bool storeDescendentCounts = ((m_flags & BuildDescendentItemCounts) != 0);
     void* pHeaderUnknownType;
     HRESULT hr = S_OK;
 
@@ -1474,6 +1687,7 @@ HRESULT HierarchicalNamesBuilder::Build(__out_bcount(cbBuffer) VOID* pBuffer, UI
 
         pHeaderEx->cchLongestPath = static_cast<UINT16>(m_cchLongestFinalizedName);
         pHeaderEx->flags = (m_flags & BuildLargeHNamesNode) ? DEFFILE_HNAMES_FLAGS_LARGE : 0;
+        pHeaderEx->flags |= (storeDescendentCounts ? DEFFILE_HNAMES_FLAGS_DESCENDENT_ITEM_COUNTS : 0);
         pHeaderEx->numNodes = GetNumNames();
         pHeaderEx->numScopes = GetNumScopes();
         pHeaderEx->numItems = GetNumItems();
@@ -1487,6 +1701,7 @@ HRESULT HierarchicalNamesBuilder::Build(__out_bcount(cbBuffer) VOID* pBuffer, UI
 
         pHeader->cchLongestPath = static_cast<UINT16>(m_cchLongestFinalizedName);
         pHeader->flags = (m_flags & BuildLargeHNamesNode) ? DEFFILE_HNAMES_FLAGS_LARGE : 0;
+        pHeader->flags |= (storeDescendentCounts ? DEFFILE_HNAMES_FLAGS_DESCENDENT_ITEM_COUNTS : 0);
         pHeader->numNodes = GetNumNames();
         pHeader->numScopes = GetNumScopes();
         pHeader->numItems = GetNumItems();
@@ -1551,7 +1766,8 @@ HRESULT HierarchicalNamesBuilder::Build(__out_bcount(cbBuffer) VOID* pBuffer, UI
             pFileScopeLarge->nameNodeIndex = pScope->GetNameIndex();
             pFileScopeLarge->numChildNames = pScope->GetNumChildren();
             pFileScopeLarge->firstChildNameNode = ((pChild != nullptr) ? pChild->GetNameIndex() : 0);
-            pFileScopeLarge->flags = 0;
+            // descendent item count, if requested; ancestors are added below
+            pFileScopeLarge->flags = (storeDescendentCounts ? pScope->GetNumChildItems() : 0);
         }
         else
         {
@@ -1561,7 +1777,26 @@ HRESULT HierarchicalNamesBuilder::Build(__out_bcount(cbBuffer) VOID* pBuffer, UI
             pFileScope->nameNodeIndex = static_cast<UINT16>(pScope->GetNameIndex());
             pFileScope->numChildNames = static_cast<UINT16>(pScope->GetNumChildren());
             pFileScope->firstChildNameNode = static_cast<UINT16>(((pChild != nullptr) ? pChild->GetNameIndex() : 0));
-            pFileScope->flags = 0;
+            pFileScope->flags = (storeDescendentCounts ? static_cast<UINT16>(pScope->GetNumChildItems()) : 0);
+        }
+    }
+
+    // Now add the items directly in each scope to the counts of all of its ancestors.
+    for (int i = 0; storeDescendentCounts && (i < m_pAllScopes->Count()); i++)
+    {
+        ScopeInfo* pScope;
+        RETURN_IF_FAILED(m_pAllScopes->Get(i, &pScope));
+
+        for (ScopeInfo* pAncestor = pScope->GetParentScope(); pAncestor != nullptr; pAncestor = pAncestor->GetParentScope())
+        {
+            if (m_flags & BuildLargeHNamesNode)
+            {
+                pScopesLarge[pAncestor->GetIndex()].flags += pScope->GetNumChildItems();
+            }
+            else
+            {
+                pScopes[pAncestor->GetIndex()].flags += static_cast<UINT16>(pScope->GetNumChildItems());
+            }
         }
     }
 
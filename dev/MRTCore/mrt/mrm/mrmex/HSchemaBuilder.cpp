@@ -113,6 +113,10 @@ HRESULT HierarchicalSchemaSectionBuilder::Init(
     UINT32 namesBuildFlags =
         (((m_buildFlags & MrmBuildConfiguration::UseOptimalSchemaEncodingFlag) == 0) ? HierarchicalNamesBuilder::BuildUtf16Only :
                                                                                        HierarchicalNamesBuilder::BuildAsciiOrUtf16);
+    if ((m_buildFlags & MrmBuildConfiguration::UseDescendentItemCountsFlag) != 0)
+    {
+        namesBuildFlags |= HierarchicalNamesBuilder::BuildDescendentItemCounts;
+    }
 
     RETURN_IF_FAILED(HierarchicalNamesBuilder::CreateInstance(namesBuildFlags, pPriBuilder->GetAtoms(), &m_pNames));
 
@@ -142,6 +146,10 @@ HierarchicalSchemaSectionBuilder::Init(
     UINT32 namesBuildFlags =
         (((m_buildFlags & MrmBuildConfiguration::UseOptimalSchemaEncodingFlag) == 0) ? HierarchicalNamesBuilder::BuildUtf16Only :
                                                                                        HierarchicalNamesBuilder::BuildAsciiOrUtf16);
+    if ((m_buildFlags & MrmBuildConfiguration::UseDescendentItemCountsFlag) != 0)
+    {
+        namesBuildFlags |= HierarchicalNamesBuilder::BuildDescendentItemCounts;
+    }
 
     RETURN_IF_FAILED(HierarchicalNamesBuilder::CreateInstance(namesBuildFlags, pPriBuilder->GetAtoms(), &m_pNames));
 
@@ -462,6 +470,39 @@ HRESULT HierarchicalSchemaSectionBuilder::GetDescendents(
     return E_NOTIMPL;
 }
 
+HRESULT HierarchicalSchemaSectionBuilder::GetDescendentItemNames(
+    int /*scopeIndex*/,
+    int /*firstDescendent*/,
+    int /*maxNames*/,
+    HierarchicalNamesBatch* /*pNamesOut*/) const
+{
+    return E_NOTIMPL;
+}
+
+HRESULT HierarchicalSchemaSectionBuilder::InitDescendentCursor(int /*scopeIndex*/, HierarchicalNamesCursor* pCursorOut) const
+{
+    pCursorOut->rootScopeIndex = -1;
+    pCursorOut->scopeIndex = -1;
+    pCursorOut->nextChild = 0;
+    pCursorOut->depth = 0;
+    pCursorOut->status = E_NOTIMPL;
+    return E_NOTIMPL;
+}
+
+bool HierarchicalSchemaSectionBuilder::TryGetNextDescendent(HierarchicalNamesCursor* /*pCursor*/, int* pScopeIndexOut, int* pItemIndexOut) const
+{
+    if (pScopeIndexOut != nullptr)
+    {
+        *pScopeIndexOut = -1;
+    }
+
+    if (pItemIndexOut != nullptr)
+    {
+        *pItemIndexOut = -1;
+    }
+    return false;
+}
+
 const IHierarchicalSchemaVersionInfo* HierarchicalSchemaSectionBuilder::GetVersionInfo(int index) const
 {
     if (m_pPreviousSchema)
@@ -583,6 +624,9 @@ HRESULT HierarchicalSchemaSectionBuilder::ReadSchemaDescription(const IHierarchi
 
     StringResult name;
 
+    // Names come in index order rather than name order, so add them in bulk and sort once.
+    RETURN_IF_FAILED(m_pNames->BeginBulkAdd());
+
     const IAtomPool* pOldPool = pDescription->GetScopeNames();
     // start at 1 because scope 0, the root scope, always has
     // an empty name.
@@ -617,7 +661,7 @@ HRESULT HierarchicalSchemaSectionBuilder::ReadSchemaDescription(const IHierarchi
         }
     }
 
-    return S_OK;
+    return m_pNames->EndBulkAdd();
 }
 
 bool HierarchicalSchemaSectionBuilder::IsFinalized() const
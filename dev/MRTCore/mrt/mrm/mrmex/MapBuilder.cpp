@@ -426,7 +426,7 @@ public:
     HRESULT
     InitDataLocator(_In_ DataBlobBuilder* pDataBuilder, _In_ PCWSTR pString, _In_ int typeIndex, _Out_ MRMFILE_MAP_VALUE_LARGE* pValueOut)
     {
-        // Add our string to the internal data and note the offset
+        // Add our string to the internal data, or find an identical one already there, and note the offset
         size_t cbString = (wcslen(pString) + 1) * sizeof(WCHAR);
         UINT32 stringOffset = 0;
 
@@ -435,7 +435,7 @@ public:
             return E_OUTOFMEMORY;
         }
 
-        RETURN_IF_FAILED(pDataBuilder->AddData(reinterpret_cast<const BYTE*>(pString), static_cast<UINT32>(cbString), &stringOffset));
+        RETURN_IF_FAILED(pDataBuilder->GetOrAddData(reinterpret_cast<const BYTE*>(pString), static_cast<UINT32>(cbString), &stringOffset));
 
         pValueOut->resourceValueTypeOffset = static_cast<UINT8>(typeIndex);
         pValueOut->valueLocatorType = MRMFILE_MAP_VALUE_LOCATOR_INTERNAL;
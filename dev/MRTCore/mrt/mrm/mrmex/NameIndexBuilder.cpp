@@ -0,0 +1,213 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "stdafx.h"
+
+namespace Microsoft::Resources::Build
+{
+
+HRESULT
+ResourceNameIndexSectionBuilder::CreateInstance(_In_ HierarchicalSchemaSectionBuilder* schema, _Outptr_ ResourceNameIndexSectionBuilder** result)
+{
+    *result = nullptr;
+
+    AutoDeletePtr<ResourceNameIndexSectionBuilder> rtrn = new ResourceNameIndexSectionBuilder();
+    RETURN_IF_NULL_ALLOC(rtrn);
+    RETURN_IF_FAILED(rtrn->Init(schema));
+
+    *result = rtrn.Detach();
+    return S_OK;
+}
+
+ResourceNameIndexSectionBuilder::~ResourceNameIndexSectionBuilder()
+{
+    if (m_bucketStart != nullptr)
+    {
+        Def_Free(m_bucketStart);
+        m_bucketStart = nullptr;
+    }
+
+    if (m_entries != nullptr)
+    {
+        Def_Free(m_entries);
+        m_entries = nullptr;
+    }
+}
+
+HRESULT ResourceNameIndexSectionBuilder::Finalize()
+{
+    if (m_finalized)
+    {
+        return S_OK;
+    }
+
+    // Item indices aren't stable until the schema is finalized.
+    RETURN_IF_FAILED(m_schema->Finalize());
+
+    const IAtomPool* itemNames = m_schema->GetItemNames();
+    RETURN_HR_IF_NULL(E_DEF_NOT_READY, itemNames);
+
+    UINT32 numEntries = static_cast<UINT32>(m_schema->GetNumItems());
+    UINT32 numBuckets = ((numEntries > 0) ? numEntries : 1);
+
+    UINT32* bucketStart = _DefArray_AllocZeroed(UINT32, numBuckets + 1);
+    RETURN_IF_NULL_ALLOC(bucketStart);
+
+    MRMFILE_NAME_INDEX_ENTRY* entries = _DefArray_AllocZeroed(MRMFILE_NAME_INDEX_ENTRY, ((numEntries > 0) ? numEntries : 1));
+    UINT32* hashes = _DefArray_AllocZeroed(UINT32, ((numEntries > 0) ? numEntries : 1));
+
+    HRESULT hr = (((entries != nullptr) && (hashes != nullptr)) ? S_OK : E_OUTOFMEMORY);
+
+    // First pass hashes every item name and counts the entries in each bucket.
+    StringResult name;
+    for (UINT32 i = 0; SUCCEEDED(hr) && (i < numEntries); i++)
+    {
+        if (!itemNames->TryGetString(static_cast<Atom::Index>(i), &name))
+        {
+            hr = E_FAIL;
+            break;
+        }
+
+        hashes[i] = ResourceNameIndexSection::ComputePathHash(ResourceNameIndexSection::GetInitialPathHash(), name.GetRef());
+        bucketStart[hashes[i] % numBuckets]++;
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        // Turn the counts into the end of each bucket, then fill each bucket
+        // from the back so that entries within a bucket are in item order
+        // and bucketStart ends up holding the start of each bucket.
+        for (UINT32 i = 1; i < numBuckets; i++)
+        {
+            bucketStart[i] += bucketStart[i - 1];
+        }
+
+        for (UINT32 i = numEntries; i > 0; i--)
+        {
+            UINT32 bucket = hashes[i - 1] % numBuckets;
+            MRMFILE_NAME_INDEX_ENTRY* entry = &entries[--bucketStart[bucket]];
+            entry->pathHash = hashes[i - 1];
+            entry->itemIndex = i - 1;
+        }
+
+        bucketStart[numBuckets] = numEntries;
+    }
+
+    if (hashes != nullptr)
+    {
+        Def_Free(hashes);
+    }
+
+    if (FAILED(hr))
+    {
+        Def_Free(bucketStart);
+        if (entries != nullptr)
+        {
+            Def_Free(entries);
+        }
+        return hr;
+    }
+
+    if (m_bucketStart != nullptr)
+    {
+        Def_Free(m_bucketStart);
+    }
+
+    if (m_entries != nullptr)
+    {
+        Def_Free(m_entries);
+    }
+
+    m_bucketStart = bucketStart;
+    m_entries = entries;
+    m_numFinalizedBuckets = numBuckets;
+    m_numFinalizedEntries = numEntries;
+    m_finalized = true;
+
+    return S_OK;
+}
+
+UINT32 ResourceNameIndexSectionBuilder::GetMaxSizeInBytes() const
+{
+    if (!m_finalized)
+    {
+        return 0;
+    }
+
+    UINT32 size = sizeof(MRMFILE_NAME_INDEX_HEADER);
+    size += ((m_numFinalizedBuckets + 1) * sizeof(UINT32));
+    size += (m_numFinalizedEntries * sizeof(MRMFILE_NAME_INDEX_ENTRY));
+    return size;
+}
+
+HRESULT
+ResourceNameIndexSectionBuilder::Build(
+    _Out_writes_bytes_(bufferSizeInBytes) VOID* buffer,
+    _In_ UINT32 bufferSizeInBytes,
+    _Out_opt_ UINT32* numBytesWritten) const
+{
+    RETURN_HR_IF(E_DEF_NOT_READY, !m_finalized);
+
+    if (numBytesWritten != nullptr)
+    {
+        *numBytesWritten = 0;
+    }
+
+    if (m_schema->GetSectionIndex() == BaseFile::SectionIndexNone)
+    {
+        return E_DEF_NOT_READY;
+    }
+
+    SectionBuilderParser data;
+    RETURN_IF_FAILED(data.Set(buffer, bufferSizeInBytes));
+
+    HRESULT hr = S_OK;
+    MRMFILE_NAME_INDEX_HEADER* header = _SECTION_BUILDER_NEXT(data, MRMFILE_NAME_INDEX_HEADER, &hr);
+    UINT32* bucketStart = _SECTION_BUILDER_NEXT_ARRAY(data, m_numFinalizedBuckets + 1, UINT32, &hr);
+    MRMFILE_NAME_INDEX_ENTRY* entries = _SECTION_BUILDER_NEXT_ARRAY(data, m_numFinalizedEntries, MRMFILE_NAME_INDEX_ENTRY, &hr);
+    RETURN_IF_FAILED(hr);
+
+    header->schemaSectionIndex = static_cast<UINT16>(m_schema->GetSectionIndex());
+    header->flags = 0;
+    header->numBuckets = m_numFinalizedBuckets;
+    header->numEntries = m_numFinalizedEntries;
+
+    memcpy_s(bucketStart, (m_numFinalizedBuckets + 1) * sizeof(UINT32), m_bucketStart, (m_numFinalizedBuckets + 1) * sizeof(UINT32));
+
+    if (m_numFinalizedEntries > 0)
+    {
+        memcpy_s(
+            entries,
+            m_numFinalizedEntries * sizeof(MRMFILE_NAME_INDEX_ENTRY),
+            m_entries,
+            m_numFinalizedEntries * sizeof(MRMFILE_NAME_INDEX_ENTRY));
+    }
+
+    if (numBytesWritten != nullptr)
+    {
+        *numBytesWritten = GetMaxSizeInBytes();
+    }
+
+    return S_OK;
+}
+
+ResourceNameIndexSectionBuilder::ResourceNameIndexSectionBuilder() :
+    m_finalized(false),
+    m_sectionIndex(BaseFile::SectionIndexNone),
+    m_schema(nullptr),
+    m_numFinalizedBuckets(0),
+    m_numFinalizedEntries(0),
+    m_bucketStart(nullptr),
+    m_entries(nullptr)
+{}
+
+HRESULT ResourceNameIndexSectionBuilder::Init(_In_ HierarchicalSchemaSectionBuilder* schema)
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, schema);
+
+    m_schema = schema;
+
+    return S_OK;
+}
+
+} // namespace Microsoft::Resources::Build
@@ -29,6 +29,7 @@ PriSectionBuilder::PriSectionBuilder(_In_opt_ FileBuilder* pFileBuilder) :
     m_dataItems(nullptr),
     m_pFileListBuilder(nullptr),
     m_linkBuilders(nullptr),
+    m_nameIndexBuilders(nullptr),
     m_pBuilderConfiguration(nullptr)
 {}
 
@@ -86,6 +87,21 @@ PriSectionBuilder::~PriSectionBuilder()
         m_linkBuilders = nullptr;
     }
 
+    if (m_nameIndexBuilders != nullptr)
+    {
+        for (int i = 0; i < m_nameIndexBuilders->Count(); i++)
+        {
+            ResourceNameIndexSectionBuilder* nameIndex;
+            if (SUCCEEDED(m_nameIndexBuilders->Get(i, &nameIndex)))
+            {
+                delete nameIndex;
+            }
+        }
+
+        delete m_nameIndexBuilders;
+        m_nameIndexBuilders = nullptr;
+    }
+
     delete m_pFileListBuilder;
     m_pFileListBuilder = nullptr;
 
@@ -845,6 +861,12 @@ HRESULT PriSectionBuilder::AddSchemaBuilder(_In_ HierarchicalSchemaSectionBuilde
     RETURN_IF_FAILED(m_pSchemas->Add(pSchema, &indexRtrn));
     RETURN_IF_FAILED(m_pFileBuilder->AddSection(pSchema));
 
+    // A name index can only describe a schema that is written to this file.
+    if (m_pBuilderConfiguration->UseResourceNameIndex() && !m_pBuilderConfiguration->UseSchemaReference())
+    {
+        RETURN_IF_FAILED(AddResourceNameIndexBuilder(pSchema));
+    }
+
     if (isDefault)
     {
         if (m_pPrimarySchemaName != nullptr)
@@ -1072,6 +1094,26 @@ PriSectionBuilder::GetOrAddResourceLinkBuilder(_In_ ResourceMapSectionBuilder* m
     return S_OK;
 }
 
+HRESULT PriSectionBuilder::AddResourceNameIndexBuilder(_In_ HierarchicalSchemaSectionBuilder* pSchema)
+{
+    if (m_nameIndexBuilders == nullptr)
+    {
+        RETURN_IF_FAILED(DynamicArray<ResourceNameIndexSectionBuilder*>::CreateInstance(2, &m_nameIndexBuilders));
+    }
+
+    ResourceNameIndexSectionBuilder* nameIndex;
+    RETURN_IF_FAILED(ResourceNameIndexSectionBuilder::CreateInstance(pSchema, &nameIndex));
+
+    HRESULT hr = m_nameIndexBuilders->Add(nameIndex, nullptr);
+    if (FAILED(hr))
+    {
+        delete nameIndex;
+        return hr;
+    }
+
+    return m_pFileBuilder->AddSection(nameIndex);
+}
+
 HRESULT PriSectionBuilder::AddFileListSectionBuilder(_In_ FileListBuilder* pFileListSectionBuilder)
 {
     if (m_pFileListBuilder != nullptr)
@@ -1422,7 +1464,12 @@ HRESULT PriFileBuilder::CreateInstance(
 
 PriFileBuilder::~PriFileBuilder() { delete m_pDescriptor; }
 
-PriFileBuilder::PriFileBuilder(DEFFILE_MAGIC magic) : FileBuilder(magic), m_pDescriptor(nullptr) {}
+PriFileBuilder::PriFileBuilder(DEFFILE_MAGIC magic) : FileBuilder(magic), m_pDescriptor(nullptr)
+{
+    // Data items sections hold most of a PRI's bytes and build independently,
+    // so let them build alongside the schema, map and other sections.
+    SetParallelBuild(true);
+}
 
 HRESULT PriFileBuilder::VerifyFilePath(_In_ PCWSTR pszFilePath)
 {
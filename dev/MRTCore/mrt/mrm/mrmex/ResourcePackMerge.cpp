@@ -189,8 +189,9 @@ HRESULT ResourcePackMerge::WriteToFile(_In_ PCWSTR pszOutputFile)
 
     bFinalized = true;
 
-    // Write to the file of the merged opearation.
-    RETURN_IF_FAILED(m_pFileBuilder->WriteToFile(pszOutputFile));
+    // Write to the file of the merged opearation.  Resource packs can be
+    // large, so stream the sections out rather than building the whole file in memory.
+    RETURN_IF_FAILED(m_pFileBuilder->StreamToFile(pszOutputFile));
 
     return S_OK;
 }
@@ -91,30 +91,61 @@ HRESULT BaseFile::InitFromData(__in_bcount(cbData) const void* pData, __in size_
     return S_OK;
 }
 
+// Gets the number of bytes of a file that can hold DEF data, which is never
+// more than the format can address or than fits in memory.
+static HRESULT GetFileDataSize(_In_ HANDLE hFile, _Out_ size_t* pcbDataOut)
+{
+    LARGE_INTEGER fileLen = {0};
+
+    *pcbDataOut = 0;
+
+    RETURN_IF_FAILED(_DefGetFileSizeEx(hFile, &fileLen));
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), fileLen.QuadPart < 0);
+
+    UINT64 cbData = static_cast<UINT64>(fileLen.QuadPart);
+    if (cbData > BaseFile::MaxFileDataSize)
+    {
+        cbData = BaseFile::MaxFileDataSize;
+    }
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_FILE_TOO_LARGE), cbData > SIZE_MAX);
+
+    *pcbDataOut = static_cast<size_t>(cbData);
+    return S_OK;
+}
+
 HRESULT
 BaseFile::LoadFileData(_In_ PCWSTR pFileName, _Out_ size_t* pcbDataOut, _Outptr_result_buffer_maybenull_(*pcbDataOut) VOID** ppDataOut)
 {
     unique_DefHandle hFile;
-    DWORD cbData = 0;
-    DWORD cbRead = 0;
-    LARGE_INTEGER fileLen = {0};
+    size_t cbData = 0;
 
     DEF_ASSERT((pcbDataOut != NULL) && (ppDataOut != NULL));
 
     *pcbDataOut = 0;
     *ppDataOut = nullptr;
 
-    RETURN_IF_FAILED((_DefCreateFile(pFileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, &hFile)));
+    // The whole file is read front to back, so let the cache manager read ahead.
+    RETURN_IF_FAILED((_DefCreateFile(
+        pFileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, &hFile)));
 
-    RETURN_IF_FAILED(_DefGetFileSizeEx(hFile.get(), &fileLen));
+    RETURN_IF_FAILED(GetFileDataSize(hFile.get(), &cbData));
 
-    cbData = (UINT32)fileLen.LowPart;
     unique_deffree_ptr<VOID> pBaseFileData(_DefBlob_AllocZeroed(cbData));
     RETURN_IF_NULL_ALLOC(pBaseFileData.get());
 
-    RETURN_IF_FAILED(_DefReadFile(hFile.get(), pBaseFileData.get(), cbData, &cbRead));
+    // Reads are limited to 32 bits, so big files take more than one.
+    BYTE* pNext = static_cast<BYTE*>(pBaseFileData.get());
+    size_t cbRemaining = cbData;
+    while (cbRemaining > 0)
+    {
+        ULONG cbToRead = static_cast<ULONG>((cbRemaining > MaxReadSize) ? MaxReadSize : cbRemaining);
+        ULONG cbRead = 0;
+        RETURN_IF_FAILED(_DefReadFile(hFile.get(), pNext, cbToRead, &cbRead));
+        RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), cbRead != cbToRead);
 
-    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), cbRead != cbData);
+        pNext += cbRead;
+        cbRemaining -= cbRead;
+    }
 
     *pcbDataOut = cbData;
     *ppDataOut = pBaseFileData.release();
@@ -128,19 +159,37 @@ BaseFile::MapFileData(_In_ PCWSTR pFileName, _Out_ size_t* pcbDataOut, _Outptr_r
     unique_DefHandle hFile;
     unique_DefHandle hMapping;
     PVOID pBaseFileData = NULL;
-    LARGE_INTEGER fileLen = {0};
+    size_t cbData = 0;
 
     DEF_ASSERT((pcbDataOut != NULL) && (ppDataOut != NULL));
 
     *pcbDataOut = 0;
     *ppDataOut = nullptr;
 
-    RETURN_IF_FAILED(_DefCreateFile(pFileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, &hFile));
-    RETURN_IF_FAILED(_DefGetFileSizeEx(hFile.get(), &fileLen));
+    // Lookups jump around the file, so read-ahead past each fault is mostly wasted.
+    RETURN_IF_FAILED(_DefCreateFile(
+        pFileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, &hFile));
+    RETURN_IF_FAILED(GetFileDataSize(hFile.get(), &cbData));
     RETURN_IF_FAILED(_DefCreateFileMapping(hFile.get(), NULL, PAGE_READONLY, 0, 0, NULL, &hMapping));
-    RETURN_IF_FAILED(_DefMapViewOfFile(hMapping.get(), FILE_MAP_READ, 0, 0, 0, &pBaseFileData));
+    RETURN_IF_FAILED(_DefMapViewOfFile(hMapping.get(), FILE_MAP_READ, 0, 0, cbData, &pBaseFileData));
+
+    // Validation reads the header and table of contents at the front and the
+    // trailer at the end right away, so bring those in together.
+    DEF_MEMORY_RANGE ranges[2];
+    ULONG numRanges = 0;
+    ranges[numRanges].VirtualAddress = pBaseFileData;
+    ranges[numRanges].NumberOfBytes = ((cbData < PrefetchHeaderSize) ? cbData : PrefetchHeaderSize);
+    numRanges++;
+    if (cbData > PrefetchHeaderSize)
+    {
+        size_t cbTail = (((cbData - PrefetchHeaderSize) < PrefetchTrailerSize) ? (cbData - PrefetchHeaderSize) : PrefetchTrailerSize);
+        ranges[numRanges].VirtualAddress = static_cast<BYTE*>(pBaseFileData) + (cbData - cbTail);
+        ranges[numRanges].NumberOfBytes = cbTail;
+        numRanges++;
+    }
+    (void)_DefPrefetchVirtualMemory(ranges, numRanges);
 
-    *pcbDataOut = fileLen.QuadPart;
+    *pcbDataOut = cbData;
     *ppDataOut = pBaseFileData;
 
     return S_OK;
@@ -155,7 +204,7 @@ void BaseFile::UnmapFileData(_In_ const VOID* pData)
 HRESULT BaseFile::UnmapFileData()
 {
     RETURN_HR_IF_NULL(E_DEF_NOT_READY, m_pHeader);
-    RETURN_HR_IF(E_DEF_NOT_READY, ((m_flags & (BaseFileOwnsDataFlag | MapFileFlag)) != (BaseFileOwnsDataFlag | MapFileFlag)));
+    RETURN_HR_IF(E_DEF_NOT_READY, ((m_flags & (BaseFileOwnsDataFlag | BaseFileIsMappedFlag)) != (BaseFileOwnsDataFlag | BaseFileIsMappedFlag)));
 
     UnmapFileData(m_pHeader);
     m_pHeader = NULL;
@@ -219,7 +268,7 @@ HRESULT BaseFile::Init(__in UINT32 flags, __in PCWSTR pFileName)
     hr = InitFromData(data.pcData, cbData);
     if (SUCCEEDED(hr))
     {
-        m_flags = (flags | BaseFileOwnsDataFlag);
+        m_flags = (flags | BaseFileOwnsDataFlag | (isMapped ? BaseFileIsMappedFlag : 0));
     }
     else if (isMapped)
     {
@@ -343,13 +392,13 @@ HRESULT BaseFile::GetSectionHeader(__in int index, _Out_ const DEFFILE_SECTION_H
     }
 
     DEF_ASSERT(m_pHeader->sizeToc != 0);
-    UINT32 cbOtherSectionSize = m_pHeader->tocOffset + sizeof(DEFFILE_TRAILER);
-    cbOtherSectionSize += (sizeof(DEFFILE_TOC_ENTRY) * m_pHeader->sizeToc);
-    cbOtherSectionSize += ((m_pHeader->sizeToc - 1) * BaseFile::GetSectionStructureOverhead());
+    UINT64 cbOtherSectionSize = static_cast<UINT64>(m_pHeader->tocOffset) + sizeof(DEFFILE_TRAILER);
+    cbOtherSectionSize += (static_cast<UINT64>(sizeof(DEFFILE_TOC_ENTRY)) * m_pHeader->sizeToc);
+    cbOtherSectionSize += (static_cast<UINT64>(m_pHeader->sizeToc - 1) * BaseFile::GetSectionStructureOverhead());
 
     RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), cbOtherSectionSize >= m_pHeader->cbTotal);
 
-    UINT32 maxSize = m_pHeader->cbTotal - cbOtherSectionSize;
+    UINT64 maxSize = m_pHeader->cbTotal - cbOtherSectionSize;
     RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), pSectionHeader->cbSectionTotal > maxSize);
 
     *header = pSectionHeader;
@@ -372,6 +421,42 @@ BaseFile::GetSectionData(_In_ int index, _Out_ const void** data, _Out_ UINT32*
     return S_OK;
 }
 
+HRESULT BaseFile::PrefetchSections(_In_reads_(numTypes) const DEFFILE_SECTION_TYPEID* pTypes, _In_ int numTypes) const
+{
+    RETURN_HR_IF_NULL(E_DEF_NOT_READY, m_pHeader);
+    RETURN_HR_IF(E_INVALIDARG, (pTypes == nullptr) || (numTypes < 0));
+
+    if ((m_flags & BaseFileIsMappedFlag) == 0)
+    {
+        // Loaded files are already in memory.
+        return S_OK;
+    }
+
+    DEF_MEMORY_RANGE ranges[MaxPrefetchRanges];
+    ULONG numRanges = 0;
+    for (int i = 0; (i < m_pHeader->sizeToc) && (numRanges < ARRAYSIZE(ranges)); i++)
+    {
+        const DEFFILE_TOC_ENTRY* pToc = &m_pToc[i];
+        if (pToc->cbSectionTotal == 0)
+        {
+            continue;
+        }
+
+        for (int t = 0; t < numTypes; t++)
+        {
+            if (SectionTypesEqual(pToc->type, pTypes[t]))
+            {
+                ranges[numRanges].VirtualAddress = GetSectionHeader(m_pHeader, pToc);
+                ranges[numRanges].NumberOfBytes = pToc->cbSectionTotal;
+                numRanges++;
+                break;
+            }
+        }
+    }
+
+    return _DefPrefetchVirtualMemory(ranges, numRanges);
+}
+
 bool BaseFile::IsIdentical(__in const BaseFile* pOther) const
 {
     if (pOther == NULL)
@@ -411,6 +496,9 @@ HRESULT BaseFile::ValidateStructure(__in_bcount(cbData) const void* pData, __in
     RETURN_HR_IF(
         HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), (cbData < minSize) || (cbData < pHeader->cbTotal) || (pHeader->cbTotal < minSize));
 
+    // The trailer sits at the padded end of the file, so that has to be in range too.
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), PadData64(pHeader->cbTotal) > cbData);
+
     // Header is potentially valid.  Look for a matching trailer.
     pTrailer = GetFileTrailer(pHeader);
     RETURN_HR_IF(
@@ -419,10 +507,11 @@ HRESULT BaseFile::ValidateStructure(__in_bcount(cbData) const void* pData, __in
             (pHeader->cbTotal != pTrailer->cbTotal));
 
     // Okay, this sure _looks_ like a DEF file.  Do we have a TOC?
-    size_t cbToc = sizeof(DEFFILE_TOC_ENTRY) * pHeader->sizeToc;
-    minSize = pHeader->tocOffset + cbToc + sizeof(DEFFILE_TRAILER);
+    // Sums of 32-bit sizes and offsets are done in 64 bits so they can't wrap.
+    UINT64 cbToc = static_cast<UINT64>(sizeof(DEFFILE_TOC_ENTRY)) * pHeader->sizeToc;
+    UINT64 minTotalSize = pHeader->tocOffset + cbToc + sizeof(DEFFILE_TRAILER);
     // Don't have enough room for the header, TOC & trailer?
-    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), pHeader->cbTotal < minSize);
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), pHeader->cbTotal < minTotalSize);
 
     // Is the TOC plausible
     // TOC clobbers the header or is improperly aligned?
@@ -459,7 +548,8 @@ HRESULT BaseFile::ValidateStructure(__in_bcount(cbData) const void* pData, __in
                 HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE),
                 (pCurrentToc->offset > cbSectionData) ||
                     (pCurrentToc->cbSectionTotal < sizeof(DEFFILE_SECTION_HEADER) + sizeof(DEFFILE_SECTION_TRAILER)) ||
-                    (pCurrentToc->cbSectionTotal > cbSectionData) || (pCurrentToc->offset + pCurrentToc->cbSectionTotal > cbSectionData));
+                    (pCurrentToc->cbSectionTotal > cbSectionData) ||
+                    (static_cast<UINT64>(pCurrentToc->offset) + pCurrentToc->cbSectionTotal > cbSectionData));
         }
     }
 
@@ -561,7 +651,7 @@ BaseFile::~BaseFile()
     // Delete m_pHeader if BaseFile owns them.
     if (m_pHeader && (m_flags & BaseFileOwnsDataFlag))
     {
-        if (m_flags & MapFileFlag)
+        if (m_flags & BaseFileIsMappedFlag)
         {
             UnmapFileData();
         }
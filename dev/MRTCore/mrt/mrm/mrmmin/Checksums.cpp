@@ -53,31 +53,22 @@ DefChecksum::ComputeStringChecksum(
         *checksum = ComputeChecksum(partialChecksum, NULL, 0);
         return S_OK;
     }
-    StringResult str;
-    RETURN_IF_FAILED(str.Init(pString));
-    if (caseInsensitive)
-    {
-        size_t size = 0;
-        PWSTR pStr;
-        RETURN_IF_FAILED(str.GetWritableRef(&pStr, &size));
-        if (pStr == NULL)
-        {
-            return S_OK;
-        }
-        while ((*pStr) != L'\0')
-        {
-            (*pStr) = towlower(*pStr);
-            pStr++;
-        }
-    }
     size_t length;
-    RETURN_IF_FAILED(str.GetLength(&length));
-    length = (length + 1) * sizeof(WCHAR); // include terminating NULL
-    *checksum = ComputeChecksum(partialChecksum, reinterpret_cast<const BYTE*>(str.GetRef()), static_cast<UINT32>(length));
+    RETURN_IF_FAILED(_DefStringCchLength(pString, _DEF_STRSAFE_MAX_CCH, &length));
+
+    // Same as ComputeChecksum over a lowercased copy of the string, without the copy.
+    UINT32 crc = ComputeStringLengthChecksum(partialChecksum, static_cast<UINT32>(length));
+    *checksum = _DefComputeStringCrc32(crc, caseInsensitive, pString, static_cast<UINT32>(length + 1)); // include terminating NULL
 
     return S_OK;
 }
 
+DefChecksum::Checksum DefChecksum::ComputeStringLengthChecksum(__in Checksum partialChecksum, __in UINT32 cchString)
+{
+    UINT32 cbString = (cchString + 1) * sizeof(WCHAR);
+    return _DefComputeCrc32(partialChecksum, reinterpret_cast<const BYTE*>(&cbString), sizeof(UINT32));
+}
+
 HRESULT
 DefChecksum::ComputeAtomPoolChecksum(__in Checksum partialChecksum, __in_opt const IAtomPool* pPool, _Out_ DefChecksum::Checksum* checksum)
 {
@@ -121,6 +112,13 @@ DefChecksum::ComputeAtomPoolChecksum(
     RETURN_IF_FAILED(ComputeStringChecksum(partialChecksum, true, pPool->GetDescription(), &crc));
     crc = ComputeUInt32Checksum(crc, (pPool->GetIsCaseInsensitive() ? 1 : 0));
     crc = ComputeUInt32Checksum(crc, size);
+
+    HRESULT hr = pPool->ComputeStringsChecksum(crc, size, checksum);
+    if (hr != E_NOTIMPL)
+    {
+        return hr;
+    }
+
     for (UINT32 i = 0; i < size; i++)
     {
         if (!pPool->TryGetString(i, &atomStr))
@@ -224,9 +222,174 @@ HRESULT DefChecksum::ComputeStringArrayChecksum(
     return S_OK;
 }
 
+UINT64 DefChecksum::ComputeFingerprint(_In_reads_bytes_(dataSizeInBytes) const void* data, _In_ size_t dataSizeInBytes)
+{
+    // MurmurHash64A, which mixes in a word at a time.
+    const UINT64 multiplier = 0xc6a4a7935bd1e995ull;
+    const BYTE* pData = static_cast<const BYTE*>(data);
+    UINT64 hash = 0x9e3779b97f4a7c15ull ^ (static_cast<UINT64>(dataSizeInBytes) * multiplier);
+
+    size_t cbRemaining = dataSizeInBytes;
+    for (; cbRemaining >= sizeof(UINT64); cbRemaining -= sizeof(UINT64), pData += sizeof(UINT64))
+    {
+        UINT64 word;
+        memcpy(&word, pData, sizeof(word));
+        word *= multiplier;
+        word ^= (word >> 47);
+        word *= multiplier;
+
+        hash ^= word;
+        hash *= multiplier;
+    }
+
+    if (cbRemaining > 0)
+    {
+        UINT64 word = 0;
+        memcpy(&word, pData, cbRemaining);
+        hash ^= word;
+        hash *= multiplier;
+    }
+
+    hash ^= (hash >> 47);
+    hash *= multiplier;
+    hash ^= (hash >> 47);
+
+    return ((hash != 0) ? hash : 1);
+}
+
 // When calculating the hash of an external file, we will read it in chunks of this size
 #define FILE_CHECKSUM_CHUNK_SIZE 32 * 1024
 
+struct FileChecksumMemoEntry
+{
+    PWSTR pPath;
+    DEF_FILE_IDENTITY identity;
+    DefChecksum::Checksum partialChecksum;
+    DefChecksum::Checksum checksum;
+    UINT32 lastUsed;
+};
+
+static const int FileChecksumMemoSize = 32;
+
+// File times can be as coarse as two seconds, so a write that lands in the
+// same tick as a checksum might not move them.  Only remember files whose
+// times are at least this old (in 100ns units).
+static const ULONGLONG FileChecksumMemoMinAge = 3 * 10000000ULL;
+
+// Zero-initialized, which is an unowned SRW lock.
+static _DEF_SRWLOCK g_fileChecksumMemoLock;
+static FileChecksumMemoEntry g_fileChecksumMemo[FileChecksumMemoSize];
+static UINT32 g_fileChecksumMemoClock;
+static UINT32 g_fileChecksumMemoHits;
+
+static bool FileIdentitiesEqual(_In_ const DEF_FILE_IDENTITY* pIdentity1, _In_ const DEF_FILE_IDENTITY* pIdentity2)
+{
+    return (memcmp(pIdentity1, pIdentity2, sizeof(DEF_FILE_IDENTITY)) == 0);
+}
+
+static bool TryGetMemoizedFileChecksum(
+    _In_ PCWSTR pPath,
+    _In_ const DEF_FILE_IDENTITY* pIdentity,
+    _In_ DefChecksum::Checksum partialChecksum,
+    _Out_ DefChecksum::Checksum* pChecksum)
+{
+    AutoReaderWriterLock autoLock(&g_fileChecksumMemoLock);
+
+    for (int i = 0; i < FileChecksumMemoSize; i++)
+    {
+        FileChecksumMemoEntry* pEntry = &g_fileChecksumMemo[i];
+        if ((pEntry->pPath != nullptr) && (pEntry->partialChecksum == partialChecksum) && FileIdentitiesEqual(&pEntry->identity, pIdentity) &&
+            DefString_IEqual(pEntry->pPath, pPath))
+        {
+            *pChecksum = pEntry->checksum;
+            pEntry->lastUsed = ++g_fileChecksumMemoClock;
+            g_fileChecksumMemoHits++;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void MemoizeFileChecksum(
+    _In_ PCWSTR pPath,
+    _In_ HANDLE hFile,
+    _In_ const DEF_FILE_IDENTITY* pIdentity,
+    _In_ DefChecksum::Checksum partialChecksum,
+    _In_ DefChecksum::Checksum checksum)
+{
+    // Don't remember the file if it changed while we read it, or if it could
+    // still change without its times moving.
+    DEF_FILE_IDENTITY identityAfter;
+    if (FAILED(_DefGetFileIdentity(hFile, &identityAfter)) || !FileIdentitiesEqual(pIdentity, &identityAfter))
+    {
+        return;
+    }
+
+    ULONGLONG now = _DefGetSystemTime();
+    ULONGLONG newest = max(pIdentity->LastWriteTime, pIdentity->ChangeTime);
+    if ((newest > now) || ((now - newest) < FileChecksumMemoMinAge))
+    {
+        return;
+    }
+
+    PWSTR pCopy;
+    if (FAILED(DefString_Dup(pPath, &pCopy)))
+    {
+        // The memo is only an optimization
+        return;
+    }
+
+    AutoReaderWriterLock autoLock(&g_fileChecksumMemoLock);
+
+    // Replace what we had for this path, which is stale, otherwise an empty
+    // entry or the least recently used one.
+    FileChecksumMemoEntry* pVictim = nullptr;
+    for (int i = 0; i < FileChecksumMemoSize; i++)
+    {
+        FileChecksumMemoEntry* pEntry = &g_fileChecksumMemo[i];
+        if ((pEntry->pPath != nullptr) && (pEntry->partialChecksum == partialChecksum) && DefString_IEqual(pEntry->pPath, pPath))
+        {
+            pVictim = pEntry;
+            break;
+        }
+        if ((pVictim == nullptr) || (pEntry->pPath == nullptr) || ((pVictim->pPath != nullptr) && (pEntry->lastUsed < pVictim->lastUsed)))
+        {
+            pVictim = pEntry;
+        }
+    }
+
+    if (pVictim->pPath != nullptr)
+    {
+        Def_Free(pVictim->pPath);
+    }
+    pVictim->pPath = pCopy;
+    pVictim->identity = *pIdentity;
+    pVictim->partialChecksum = partialChecksum;
+    pVictim->checksum = checksum;
+    pVictim->lastUsed = ++g_fileChecksumMemoClock;
+}
+
+void DefChecksum::ClearFileChecksumMemo()
+{
+    AutoReaderWriterLock autoLock(&g_fileChecksumMemoLock);
+
+    for (int i = 0; i < FileChecksumMemoSize; i++)
+    {
+        if (g_fileChecksumMemo[i].pPath != nullptr)
+        {
+            Def_Free(g_fileChecksumMemo[i].pPath);
+        }
+        ZeroMemory(&g_fileChecksumMemo[i], sizeof(g_fileChecksumMemo[i]));
+    }
+    g_fileChecksumMemoHits = 0;
+}
+
+UINT32 DefChecksum::GetFileChecksumMemoHits()
+{
+    AutoReaderWriterLock autoLock(&g_fileChecksumMemoLock, true);
+    return g_fileChecksumMemoHits;
+}
+
 HRESULT
 DefChecksum::ComputeFileChecksum(_In_ Checksum partialChecksum, _In_ PCWSTR fileToAdd, _Out_ DefChecksum::Checksum* checksum)
 {
@@ -235,32 +398,53 @@ DefChecksum::ComputeFileChecksum(_In_ Checksum partialChecksum, _In_ PCWSTR file
     unique_DefHandle fileHandle;
     LARGE_INTEGER fileLength = {};
 
-    RETURN_IF_FAILED(_DefCreateFile(fileToAdd, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 0, &fileHandle));
+    RETURN_IF_FAILED(_DefCreateFile(
+        fileToAdd, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, &fileHandle));
 
     RETURN_IF_FAILED(_DefGetFileSizeEx(fileHandle.get(), &fileLength));
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), fileLength.QuadPart < 0);
+
+    // Some file systems can't identify files; those are always read.
+    DEF_FILE_IDENTITY identity;
+    bool haveIdentity = SUCCEEDED(_DefGetFileIdentity(fileHandle.get(), &identity));
+    if (haveIdentity && TryGetMemoizedFileChecksum(fileToAdd, &identity, partialChecksum, checksum))
+    {
+        return S_OK;
+    }
+    DefChecksum::Checksum initialChecksum = partialChecksum;
 
-    // Only process if the file is smaller than 4GB
+    // Files under 4GB hash a 32-bit length so their checksums don't change.
     if (0 == fileLength.HighPart)
     {
         DWORD dataSizeInBytes = fileLength.LowPart;
         partialChecksum = ComputeChecksum(partialChecksum, reinterpret_cast<const BYTE*>(&dataSizeInBytes), sizeof(dataSizeInBytes));
+    }
+    else
+    {
+        UINT64 dataSizeInBytes = static_cast<UINT64>(fileLength.QuadPart);
+        partialChecksum = ComputeChecksum(partialChecksum, reinterpret_cast<const BYTE*>(&dataSizeInBytes), sizeof(dataSizeInBytes));
+    }
 
-        unique_deffree_ptr<unsigned char> buffer(_DefArray_Alloc(unsigned char, FILE_CHECKSUM_CHUNK_SIZE));
-        RETURN_IF_NULL_ALLOC(buffer);
+    unique_deffree_ptr<unsigned char> buffer(_DefArray_Alloc(unsigned char, FILE_CHECKSUM_CHUNK_SIZE));
+    RETURN_IF_NULL_ALLOC(buffer);
 
-        DWORD bytesRead = 0;
-        DWORD remainingBytesInFile = dataSizeInBytes;
-        DWORD bytesToCopy = min(remainingBytesInFile, FILE_CHECKSUM_CHUNK_SIZE);
+    DWORD bytesRead = 0;
+    UINT64 remainingBytesInFile = static_cast<UINT64>(fileLength.QuadPart);
+    DWORD bytesToCopy = static_cast<DWORD>(min(remainingBytesInFile, static_cast<UINT64>(FILE_CHECKSUM_CHUNK_SIZE)));
 
-        while (bytesToCopy > 0)
-        {
-            RETURN_IF_FAILED(_DefReadFile(fileHandle.get(), buffer.get(), bytesToCopy, &bytesRead));
-            RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), bytesToCopy != bytesRead);
+    while (bytesToCopy > 0)
+    {
+        RETURN_IF_FAILED(_DefReadFile(fileHandle.get(), buffer.get(), bytesToCopy, &bytesRead));
+        RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), bytesToCopy != bytesRead);
 
-            partialChecksum = ComputeChecksum(partialChecksum, buffer.get(), bytesRead);
-            remainingBytesInFile -= bytesRead;
-            bytesToCopy = min(remainingBytesInFile, FILE_CHECKSUM_CHUNK_SIZE);
-        }
+        partialChecksum = ComputeChecksum(partialChecksum, buffer.get(), bytesRead);
+        remainingBytesInFile -= bytesRead;
+        bytesToCopy = static_cast<DWORD>(min(remainingBytesInFile, static_cast<UINT64>(FILE_CHECKSUM_CHUNK_SIZE)));
+    }
+
+    if (haveIdentity)
+    {
+        MemoizeFileChecksum(fileToAdd, fileHandle.get(), &identity, initialChecksum, partialChecksum);
     }
 
     *checksum = partialChecksum;
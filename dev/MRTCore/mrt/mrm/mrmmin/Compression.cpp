@@ -0,0 +1,220 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "StdAfx.h"
+#include "mrm/Compression.h"
+
+namespace Microsoft::Resources
+{
+
+static const UINT32 HashBits = 12;
+static const UINT32 HashTableSize = (1 << HashBits);
+static const UINT32 MaxNibble = 15;
+
+static inline UINT32 Read32(_In_reads_bytes_(4) const BYTE* pData)
+{
+    UINT32 value;
+    memcpy(&value, pData, sizeof(value));
+    return value;
+}
+
+static inline UINT32 HashSequence(_In_ UINT32 sequence) { return ((sequence * 2654435761u) >> (32 - HashBits)); }
+
+static HRESULT WriteExtraLength(_Out_writes_bytes_(cbOut) BYTE* pOut, _In_ UINT32 cbOut, _Inout_ UINT32* pOffset, _In_ UINT32 length)
+{
+    UINT32 offset = *pOffset;
+    while (length >= 255)
+    {
+        RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER), offset >= cbOut);
+        pOut[offset++] = 255;
+        length -= 255;
+    }
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER), offset >= cbOut);
+    pOut[offset++] = static_cast<BYTE>(length);
+
+    *pOffset = offset;
+    return S_OK;
+}
+
+// Writes one sequence.  A matchLength of 0 writes the final, literal-only sequence.
+static HRESULT WriteSequence(
+    _Out_writes_bytes_(cbOut) BYTE* pOut,
+    _In_ UINT32 cbOut,
+    _Inout_ UINT32* pOffset,
+    _In_reads_bytes_(numLiterals) const BYTE* pLiterals,
+    _In_ UINT32 numLiterals,
+    _In_ UINT32 distance,
+    _In_ UINT32 matchLength)
+{
+    UINT32 offset = *pOffset;
+    UINT32 matchCode = ((matchLength > 0) ? (matchLength - DefCompression::MinMatch) : 0);
+
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER), offset >= cbOut);
+    pOut[offset++] = static_cast<BYTE>((min(numLiterals, MaxNibble) << 4) | min(matchCode, MaxNibble));
+
+    if (numLiterals >= MaxNibble)
+    {
+        RETURN_IF_FAILED(WriteExtraLength(pOut, cbOut, &offset, numLiterals - MaxNibble));
+    }
+
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER), (cbOut - offset) < numLiterals);
+    if (numLiterals > 0)
+    {
+        memcpy(&pOut[offset], pLiterals, numLiterals);
+        offset += numLiterals;
+    }
+
+    if (matchLength > 0)
+    {
+        RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER), (cbOut - offset) < 2);
+        pOut[offset++] = static_cast<BYTE>(distance & 0xff);
+        pOut[offset++] = static_cast<BYTE>(distance >> 8);
+
+        if (matchCode >= MaxNibble)
+        {
+            RETURN_IF_FAILED(WriteExtraLength(pOut, cbOut, &offset, matchCode - MaxNibble));
+        }
+    }
+
+    *pOffset = offset;
+    return S_OK;
+}
+
+static bool TryReadExtraLength(_In_reads_bytes_(cbIn) const BYTE* pIn, _In_ UINT32 cbIn, _Inout_ UINT32* pOffset, _Inout_ UINT32* pLength)
+{
+    BYTE next;
+    do
+    {
+        if ((*pOffset >= cbIn) || (*pLength > (UINT32_MAX - 255)))
+        {
+            return false;
+        }
+        next = pIn[(*pOffset)++];
+        *pLength += next;
+    } while (next == 255);
+
+    return true;
+}
+
+HRESULT DefCompression::Compress(
+    _In_reads_bytes_(cbData) const BYTE* pData,
+    _In_ UINT32 cbData,
+    _Out_writes_bytes_to_(cbOut, *pcbWritten) BYTE* pOut,
+    _In_ UINT32 cbOut,
+    _Out_ UINT32* pcbWritten)
+{
+    *pcbWritten = 0;
+    RETURN_HR_IF(E_INVALIDARG, ((pData == nullptr) && (cbData > 0)) || (pOut == nullptr));
+
+    // Most recent position (plus one, so zero means empty) of each hashed 4-byte sequence.
+    unique_deffree_ptr<UINT32> hashTable(_DefArray_AllocZeroed(UINT32, HashTableSize));
+    RETURN_IF_NULL_ALLOC(hashTable);
+
+    UINT32 offset = 0;
+    UINT32 pos = 0;
+    UINT32 literalStart = 0;
+
+    while ((cbData >= MinMatch) && (pos <= (cbData - MinMatch)))
+    {
+        UINT32 sequence = Read32(&pData[pos]);
+        UINT32* pSlot = &hashTable.get()[HashSequence(sequence)];
+        UINT32 candidate = *pSlot;
+        *pSlot = pos + 1;
+
+        if ((candidate == 0) || ((pos - (candidate - 1)) > MaxDistance) || (Read32(&pData[candidate - 1]) != sequence))
+        {
+            pos++;
+            continue;
+        }
+
+        UINT32 matchStart = candidate - 1;
+        UINT32 matchLength = MinMatch;
+        while (((pos + matchLength) < cbData) && (pData[matchStart + matchLength] == pData[pos + matchLength]))
+        {
+            matchLength++;
+        }
+
+        RETURN_IF_FAILED(
+            WriteSequence(pOut, cbOut, &offset, &pData[literalStart], pos - literalStart, pos - matchStart, matchLength));
+
+        pos += matchLength;
+        literalStart = pos;
+    }
+
+    RETURN_IF_FAILED(WriteSequence(pOut, cbOut, &offset, &pData[literalStart], cbData - literalStart, 0, 0));
+
+    *pcbWritten = offset;
+    return S_OK;
+}
+
+HRESULT DefCompression::Decompress(
+    _In_reads_bytes_(cbCompressed) const BYTE* pCompressed,
+    _In_ UINT32 cbCompressed,
+    _Out_writes_bytes_all_(cbOut) BYTE* pOut,
+    _In_ UINT32 cbOut)
+{
+    RETURN_HR_IF(E_INVALIDARG, ((pCompressed == nullptr) && (cbCompressed > 0)) || ((pOut == nullptr) && (cbOut > 0)));
+
+    UINT32 in = 0;
+    UINT32 out = 0;
+
+    while (in < cbCompressed)
+    {
+        BYTE token = pCompressed[in++];
+
+        UINT32 numLiterals = (token >> 4);
+        if (numLiterals == MaxNibble)
+        {
+            RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), !TryReadExtraLength(pCompressed, cbCompressed, &in, &numLiterals));
+        }
+
+        RETURN_HR_IF(
+            HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), (numLiterals > (cbCompressed - in)) || (numLiterals > (cbOut - out)));
+        if (numLiterals > 0)
+        {
+            memcpy(&pOut[out], &pCompressed[in], numLiterals);
+            in += numLiterals;
+            out += numLiterals;
+        }
+
+        if (in == cbCompressed)
+        {
+            // last sequence has no match
+            break;
+        }
+
+        RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), (cbCompressed - in) < 2);
+        UINT32 distance = (pCompressed[in] | (pCompressed[in + 1] << 8));
+        in += 2;
+
+        UINT32 matchLength = (token & 0x0f);
+        if (matchLength == MaxNibble)
+        {
+            RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), !TryReadExtraLength(pCompressed, cbCompressed, &in, &matchLength));
+        }
+        matchLength += MinMatch;
+
+        RETURN_HR_IF(
+            HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), (distance == 0) || (distance > out) || (matchLength > (cbOut - out)));
+
+        const BYTE* pMatch = &pOut[out - distance];
+        if (distance >= matchLength)
+        {
+            memcpy(&pOut[out], pMatch, matchLength);
+        }
+        else
+        {
+            // Overlapping match repeats the last distance bytes, so copy forward a byte at a time.
+            for (UINT32 i = 0; i < matchLength; i++)
+            {
+                pOut[out + i] = pMatch[i];
+            }
+        }
+        out += matchLength;
+    }
+
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), out != cbOut);
+    return S_OK;
+}
+
+} // namespace Microsoft::Resources
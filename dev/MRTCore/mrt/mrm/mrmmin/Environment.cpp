@@ -309,6 +309,57 @@ MrmEnvironment::~MrmEnvironment()
     m_pVersion = nullptr;
 }
 
+HRESULT IEnvironment::GetChecksumForVersion(_In_ const IEnvironmentVersionInfo* pVersion, _Out_ DEF_CHECKSUM* pChecksumOut) const
+{
+    return ComputeEnvironmentVersionChecksum(this, pVersion, pChecksumOut);
+}
+
+static bool VersionSizesMatch(_In_ const MRMFILE_ENVIRONMENT_VERSION_INFO* pHave, _In_ const IEnvironmentVersionInfo* pWant)
+{
+    return (pHave->major == pWant->GetMajorVersion()) && (pHave->minor == pWant->GetMinorVersion()) &&
+           (pHave->numQualifierTypes == pWant->GetNumQualifierTypes()) && (pHave->numQualifiers == pWant->GetNumQualifiers()) &&
+           (pHave->numItemTypes == pWant->GetNumItemTypes()) && (pHave->numResourceValueTypes == pWant->GetNumResourceValueTypes()) &&
+           (pHave->numResourceValueLocators == pWant->GetNumResourceValueLocators()) &&
+           (pHave->numConditionOperators == pWant->GetNumConditionOperators());
+}
+
+HRESULT MrmEnvironment::GetChecksumForVersion(_In_ const IEnvironmentVersionInfo* pVersion, _Out_ DEF_CHECKSUM* pChecksumOut) const
+{
+    RETURN_HR_IF(E_INVALIDARG, (pVersion == nullptr) || (pChecksumOut == nullptr));
+    *pChecksumOut = 0;
+
+    {
+        AutoReaderWriterLock autoLock(&m_versionChecksumLock, true);
+        for (int i = 0; i < m_numVersionChecksums; i++)
+        {
+            if (VersionSizesMatch(&m_versionChecksums[i], pVersion))
+            {
+                *pChecksumOut = m_versionChecksums[i].checksum;
+                return S_OK;
+            }
+        }
+    }
+
+    // Compute outside the lock; if two threads race, both get the same answer.
+    DEF_CHECKSUM checksum;
+    RETURN_IF_FAILED(ComputeEnvironmentVersionChecksum(this, pVersion, &checksum));
+
+    {
+        AutoReaderWriterLock autoLock(&m_versionChecksumLock);
+        pVersion->GetVersionInfo(&m_versionChecksums[m_nextVersionChecksum]);
+        m_versionChecksums[m_nextVersionChecksum].checksum = checksum;
+
+        m_nextVersionChecksum = (m_nextVersionChecksum + 1) % MaxCachedVersionChecksums;
+        if (m_numVersionChecksums < MaxCachedVersionChecksums)
+        {
+            m_numVersionChecksums++;
+        }
+    }
+
+    *pChecksumOut = checksum;
+    return S_OK;
+}
+
 HRESULT MrmEnvironment::Init(
     _In_ AtomPoolGroup* pAtoms,
     _In_ const ENVIRONMENT_INITIALIZER* pEnvironmentInitializer,
@@ -852,7 +903,7 @@ bool CheckEnvironmentVersionIsCompatible(_In_ const IEnvironment* pHaveEnvironme
 
     DefChecksum::Checksum cs = 0;
     return (
-        SUCCEEDED(ComputeEnvironmentVersionChecksum(pHaveEnvironment, pWantVersion, &cs)) && (cs == pWantVersion->GetVersionChecksum()));
+        SUCCEEDED(pHaveEnvironment->GetChecksumForVersion(pWantVersion, &cs)) && (cs == pWantVersion->GetVersionChecksum()));
 }
 
 /*! 
@@ -1115,7 +1166,7 @@ bool EnvironmentReference::CheckIsCompatible(_In_ const IEnvironment* pEnvironme
     }
 
     DefChecksum::Checksum cs = 0;
-    return (SUCCEEDED(ComputeEnvironmentVersionChecksum(pEnvironment, this, &cs)) && (cs == m_ref.version.checksum));
+    return (SUCCEEDED(pEnvironment->GetChecksumForVersion(this, &cs)) && (cs == m_ref.version.checksum));
 }
 
 bool EnvironmentReference::CheckIsIdentical(
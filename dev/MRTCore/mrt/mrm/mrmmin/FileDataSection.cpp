@@ -81,12 +81,219 @@ _Use_decl_annotations_ HRESULT FileDataSection::GetDataRef(UINT32 offset, UINT32
     return S_OK;
 }
 
-_Use_decl_annotations_ HRESULT FileDataItemsSection::Init(const IFileSection* pSection, const void* pData, int cbData)
+DecodedStringCache::DecodedStringCache(_In_ UINT32 cbBudget) : m_cbBudget(cbBudget), m_cbUsed(0)
+{
+    for (UINT32 i = 0; i < NumShards; i++)
+    {
+        _DefInitializeSRWLock(&m_shards[i].lock);
+        m_shards[i].pSlots = nullptr;
+        m_shards[i].numSlots = 0;
+        m_shards[i].numEntries = 0;
+        m_shards[i].numHits = 0;
+        m_shards[i].numMisses = 0;
+    }
+}
+
+DecodedStringCache::~DecodedStringCache()
+{
+    for (UINT32 i = 0; i < NumShards; i++)
+    {
+        if (m_shards[i].pSlots != nullptr)
+        {
+            for (UINT32 j = 0; j < m_shards[i].numSlots; j++)
+            {
+                if (m_shards[i].pSlots[j].pValue != nullptr)
+                {
+                    _DefFree(m_shards[i].pSlots[j].pValue);
+                }
+            }
+            Def_Free(m_shards[i].pSlots);
+            m_shards[i].pSlots = nullptr;
+        }
+    }
+}
+
+HRESULT DecodedStringCache::Init()
+{
+    for (UINT32 i = 0; i < NumShards; i++)
+    {
+        m_shards[i].pSlots = _DefArray_AllocZeroed(Slot, InitialSlotsPerShard);
+        RETURN_IF_NULL_ALLOC(m_shards[i].pSlots);
+        m_shards[i].numSlots = InitialSlotsPerShard;
+    }
+    return S_OK;
+}
+
+_Use_decl_annotations_ HRESULT DecodedStringCache::CreateInstance(UINT32 cbBudget, DecodedStringCache** result)
+{
+    *result = nullptr;
+    RETURN_HR_IF(E_INVALIDARG, cbBudget == 0);
+
+    AutoDeletePtr<DecodedStringCache> pRtrn = new DecodedStringCache(cbBudget);
+    RETURN_IF_NULL_ALLOC(pRtrn);
+    RETURN_IF_FAILED(pRtrn->Init());
+
+    *result = pRtrn.Detach();
+    return S_OK;
+}
+
+_Use_decl_annotations_ DecodedStringCache::Slot* DecodedStringCache::FindSlot(const Shard* pShard, UINT32 hash, UINT64 key)
+{
+    // The low bits of the hash pick the shard, so probe with the high ones.
+    UINT32 mask = pShard->numSlots - 1;
+    UINT32 index = ((hash >> 16) & mask);
+    while ((pShard->pSlots[index].pValue != nullptr) && (pShard->pSlots[index].key != key))
+    {
+        index = ((index + 1) & mask);
+    }
+    return &pShard->pSlots[index];
+}
+
+_Use_decl_annotations_ HRESULT DecodedStringCache::Grow(Shard* pShard)
+{
+    UINT32 numOldSlots = pShard->numSlots;
+    Slot* pOldSlots = pShard->pSlots;
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW), numOldSlots > (UINT32_MAX / 2));
+
+    Slot* pNewSlots = _DefArray_AllocZeroed(Slot, numOldSlots * 2);
+    RETURN_IF_NULL_ALLOC(pNewSlots);
+
+    pShard->pSlots = pNewSlots;
+    pShard->numSlots = numOldSlots * 2;
+    for (UINT32 i = 0; i < numOldSlots; i++)
+    {
+        if (pOldSlots[i].pValue != nullptr)
+        {
+            *FindSlot(pShard, Hash(pOldSlots[i].key), pOldSlots[i].key) = pOldSlots[i];
+        }
+    }
+
+    Def_Free(pOldSlots);
+    return S_OK;
+}
+
+_Use_decl_annotations_ bool DecodedStringCache::TryGet(UINT64 key, PCWSTR* result) const
+{
+    UINT32 hash = Hash(key);
+    Shard* pShard = &m_shards[hash % NumShards];
+
+    AutoReaderWriterLock autoLock(&pShard->lock, true);
+    *result = FindSlot(pShard, hash, key)->pValue;
+    InterlockedIncrement64((*result != nullptr) ? &pShard->numHits : &pShard->numMisses);
+    return (*result != nullptr);
+}
+
+_Use_decl_annotations_ bool DecodedStringCache::TryAdd(UINT64 key, PWSTR pValue, size_t cchValue, PCWSTR* result)
+{
+    *result = nullptr;
+
+    if (cchValue > (m_cbBudget / sizeof(WCHAR)))
+    {
+        return false;
+    }
+
+    // Reserve the space up front so the shards don't need to agree on the total.
+    LONG64 cbValue = static_cast<LONG64>(cchValue * sizeof(WCHAR));
+    if ((InterlockedExchangeAdd64(&m_cbUsed, cbValue) + cbValue) > static_cast<LONG64>(m_cbBudget))
+    {
+        InterlockedExchangeAdd64(&m_cbUsed, -cbValue);
+        return false;
+    }
+
+    UINT32 hash = Hash(key);
+    Shard* pShard = &m_shards[hash % NumShards];
+
+    AutoReaderWriterLock autoLock(&pShard->lock);
+    Slot* pSlot = FindSlot(pShard, hash, key);
+    if (pSlot->pValue != nullptr)
+    {
+        // Another thread got here first.
+        InterlockedExchangeAdd64(&m_cbUsed, -cbValue);
+        _DefFree(pValue);
+        *result = pSlot->pValue;
+        return true;
+    }
+
+    // Keep the table at most half full.
+    if (((pShard->numEntries + 1) * 2) > pShard->numSlots)
+    {
+        if (FAILED(Grow(pShard)))
+        {
+            InterlockedExchangeAdd64(&m_cbUsed, -cbValue);
+            return false;
+        }
+        pSlot = FindSlot(pShard, hash, key);
+    }
+
+    pSlot->key = key;
+    pSlot->pValue = pValue;
+    pShard->numEntries++;
+
+    *result = pValue;
+    return true;
+}
+
+_Use_decl_annotations_ void DecodedStringCache::GetStats(Stats* pStats) const
+{
+    *pStats = {};
+    pStats->cbUsed = static_cast<UINT64>(m_cbUsed);
+    pStats->cbBudget = m_cbBudget;
+
+    for (UINT32 i = 0; i < NumShards; i++)
+    {
+        AutoReaderWriterLock autoLock(&m_shards[i].lock, true);
+        pStats->numHits += m_shards[i].numHits;
+        pStats->numMisses += m_shards[i].numMisses;
+        pStats->numEntries += m_shards[i].numEntries;
+    }
+}
+
+FileDataItemsSection::FileDataItemsSection() :
+    m_pHeader(nullptr),
+    m_pSmallItems(nullptr),
+    m_pLargeItems(nullptr),
+    m_pData(nullptr),
+    m_pBlocksHeader(nullptr),
+    m_pBlocks(nullptr),
+    m_pCompressedData(nullptr),
+    m_blockCacheClock(0),
+    m_pStringCache(nullptr)
+{
+    _DefInitializeSRWLock(&m_blockCacheLock);
+
+    for (int i = 0; i < BlockCacheSize; i++)
+    {
+        m_blockCache[i].blockIndex = -1;
+        m_blockCache[i].lastUsed = 0;
+        m_blockCache[i].cbCapacity = 0;
+        m_blockCache[i].pData = nullptr;
+    }
+}
+
+FileDataItemsSection::~FileDataItemsSection()
+{
+    for (int i = 0; i < BlockCacheSize; i++)
+    {
+        if (m_blockCache[i].pData != nullptr)
+        {
+            Def_Free(m_blockCache[i].pData);
+            m_blockCache[i].pData = nullptr;
+        }
+    }
+
+    delete m_pStringCache;
+}
+
+_Use_decl_annotations_ HRESULT
+FileDataItemsSection::Init(const DEFFILE_SECTION_TYPEID& type, const IFileSection* pSection, const void* pData, int cbData)
 {
     SectionParser data;
 
-    RETURN_IF_FAILED(FileSectionBase::Init(pSection, pData, cbData, gDataItemsSectionType));
-    RETURN_IF_FAILED(ValidateHeader(pData, cbData));
+    bool isCompressed = BaseFile::SectionTypesEqual(type, gCompressedDataItemsSectionType);
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), !isCompressed && !BaseFile::SectionTypesEqual(type, gDataItemsSectionType));
+
+    RETURN_IF_FAILED(FileSectionBase::Init(pSection, pData, cbData, type));
+    RETURN_IF_FAILED(ValidateHeader(pData, cbData, isCompressed));
     RETURN_IF_FAILED(data.Set(pData, cbData));
 
     HRESULT hr = S_OK;
@@ -101,7 +308,23 @@ _Use_decl_annotations_ HRESULT FileDataItemsSection::Init(const IFileSection* pS
         {
             m_pLargeItems = _SECTION_PARSER_NEXT_ARRAY(data, GetNumberOfLargeItems(m_pHeader), DEFFILE_DATA_ITEM_LARGE, &hr);
         }
-        if (m_pHeader->cbData > 0)
+        if (isCompressed)
+        {
+            m_pBlocksHeader = _SECTION_PARSER_NEXT(data, DEFFILE_DATAITEMS_BLOCKS_HEADER, &hr);
+            if ((m_pBlocksHeader != nullptr) && (m_pBlocksHeader->numBlocks > 0))
+            {
+                m_pBlocks = _SECTION_PARSER_NEXT_ARRAY(data, m_pBlocksHeader->numBlocks, DEFFILE_DATAITEMS_BLOCK, &hr);
+            }
+            if ((m_pBlocksHeader != nullptr) && (m_pBlocksHeader->cbCompressedData > 0))
+            {
+                m_pCompressedData = _SECTION_PARSER_NEXT_ARRAY(data, m_pBlocksHeader->cbCompressedData, BYTE, &hr);
+            }
+            if (SUCCEEDED(hr))
+            {
+                hr = ValidateBlocks();
+            }
+        }
+        else if (m_pHeader->cbData > 0)
         {
             m_pData = _SECTION_PARSER_NEXT_ARRAY(data, m_pHeader->cbData, BYTE, &hr);
         }
@@ -111,12 +334,18 @@ _Use_decl_annotations_ HRESULT FileDataItemsSection::Init(const IFileSection* pS
 }
 
 _Use_decl_annotations_ HRESULT FileDataItemsSection::CreateInstance(const void* pData, int cbData, FileDataItemsSection** result)
+{
+    return CreateInstance(gDataItemsSectionType, pData, cbData, result);
+}
+
+_Use_decl_annotations_ HRESULT
+FileDataItemsSection::CreateInstance(const DEFFILE_SECTION_TYPEID& type, const void* pData, int cbData, FileDataItemsSection** result)
 {
     *result = nullptr;
 
     AutoDeletePtr<FileDataItemsSection> pRtrn = new FileDataItemsSection();
     RETURN_IF_NULL_ALLOC(pRtrn);
-    RETURN_IF_FAILED(pRtrn->Init(NULL, pData, cbData));
+    RETURN_IF_FAILED(pRtrn->Init(type, NULL, pData, cbData));
 
     *result = pRtrn.Detach();
     return S_OK;
@@ -133,27 +362,49 @@ _Use_decl_annotations_ HRESULT FileDataItemsSection::CreateInstance(IFileSection
 
     AutoDeletePtr<FileDataItemsSection> pRtrn = new FileDataItemsSection();
     RETURN_IF_NULL_ALLOC(pRtrn);
-    RETURN_IF_FAILED(pRtrn->Init(pSection, pData, cbData));
+    RETURN_IF_FAILED(pRtrn->Init(pSection->GetSectionType(), pSection, pData, cbData));
 
     *result = pRtrn.Detach();
     return S_OK;
 }
 
-_Use_decl_annotations_ HRESULT FileDataItemsSection::ValidateHeader(const void* pData, UINT32 cbData)
+_Use_decl_annotations_ HRESULT FileDataItemsSection::ValidateHeader(const void* pData, UINT32 cbData, bool isCompressed)
 {
     const DEFFILE_DATAITEMS_HEADER* pHdr = static_cast<const DEFFILE_DATAITEMS_HEADER*>(pData);
 
     RETURN_HR_IF(E_INVALIDARG, (pHdr == nullptr) || (cbData < sizeof(DEFFILE_DATAITEMS_HEADER)));
 
+    // Compressed item data is checked against the block table once that's parsed.
     size_t minSize = sizeof(DEFFILE_DATAITEMS_HEADER) + (pHdr->numSmallItems * sizeof(DEFFILE_DATA_ITEM_SMALL)) +
-                     (GetNumberOfLargeItems(pHdr) * sizeof(DEFFILE_DATA_ITEM_LARGE)) + pHdr->cbData;
+                     (GetNumberOfLargeItems(pHdr) * sizeof(DEFFILE_DATA_ITEM_LARGE)) +
+                     (isCompressed ? sizeof(DEFFILE_DATAITEMS_BLOCKS_HEADER) : pHdr->cbData);
     RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), minSize > cbData);
     return S_OK;
 }
 
-_Use_decl_annotations_ HRESULT FileDataItemsSection::GetItemDataRef(UINT32 index, const BYTE** result, UINT32* pcbDataOut) const
+HRESULT FileDataItemsSection::ValidateBlocks() const
 {
-    *result = nullptr;
+    // Blocks must cover the item data exactly, in order, and fit in the compressed data.
+    UINT32 uncompressedOffset = 0;
+    for (UINT32 i = 0; i < m_pBlocksHeader->numBlocks; i++)
+    {
+        const DEFFILE_DATAITEMS_BLOCK* pBlock = &m_pBlocks[i];
+        RETURN_HR_IF(
+            HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE),
+            (pBlock->uncompressedOffset != uncompressedOffset) || (pBlock->cbUncompressed == 0) ||
+                (pBlock->cbUncompressed > (m_pHeader->cbData - uncompressedOffset)) || (pBlock->cbCompressed == 0) ||
+                (pBlock->cbCompressed > pBlock->cbUncompressed) || (pBlock->compressedOffset > m_pBlocksHeader->cbCompressedData) ||
+                (pBlock->cbCompressed > (m_pBlocksHeader->cbCompressedData - pBlock->compressedOffset)));
+        uncompressedOffset += pBlock->cbUncompressed;
+    }
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), uncompressedOffset != m_pHeader->cbData);
+    return S_OK;
+}
+
+_Use_decl_annotations_ HRESULT FileDataItemsSection::GetItemLocation(UINT32 index, size_t* pOffset, size_t* pcbItemData) const
+{
+    *pOffset = 0;
+    *pcbItemData = 0;
 
     size_t offset = 0;
     size_t cbItemData = 0;
@@ -179,6 +430,21 @@ _Use_decl_annotations_ HRESULT FileDataItemsSection::GetItemDataRef(UINT32 index
         return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
     }
 
+    *pOffset = offset;
+    *pcbItemData = cbItemData;
+    return S_OK;
+}
+
+_Use_decl_annotations_ HRESULT FileDataItemsSection::GetItemDataRef(UINT32 index, const BYTE** result, UINT32* pcbDataOut) const
+{
+    *result = nullptr;
+
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED), IsCompressed());
+
+    size_t offset = 0;
+    size_t cbItemData = 0;
+    RETURN_IF_FAILED(GetItemLocation(index, &offset, &cbItemData));
+
     if (pcbDataOut != nullptr)
     {
         *pcbDataOut = static_cast<UINT32>(cbItemData);
@@ -190,6 +456,14 @@ _Use_decl_annotations_ HRESULT FileDataItemsSection::GetItemDataRef(UINT32 index
 
 _Use_decl_annotations_ HRESULT FileDataItemsSection::GetItemDataRef(UINT32 index, BlobResult* pData) const
 {
+    if (IsCompressed())
+    {
+        size_t offset = 0;
+        size_t cbItemData = 0;
+        RETURN_IF_FAILED(GetItemLocation(index, &offset, &cbItemData));
+        return GetCompressedItemData(offset, cbItemData, pData);
+    }
+
     UINT32 cbData;
     const BYTE* pLocalData;
     RETURN_IF_FAILED(GetItemDataRef(index, &pLocalData, &cbData));
@@ -201,4 +475,147 @@ _Use_decl_annotations_ HRESULT FileDataItemsSection::GetItemDataRef(UINT32 index
     return S_OK;
 }
 
+_Use_decl_annotations_ HRESULT
+FileDataItemsSection::GetItemDataAsString(UINT32 index, DEFSTRING_ENCODING encoding, StringResult* pStringOut) const
+{
+    DecodedStringCache* pCache = GetStringCache();
+    bool useCache = ((pCache != nullptr) && (encoding != DEFSTRING_ENCODING_UTF16));
+    UINT64 key = DecodedStringCache::MakeKey(index, encoding);
+
+    PCWSTR pCached;
+    if (useCache && pCache->TryGet(key, &pCached))
+    {
+        return pStringOut->SetRef(pCached);
+    }
+
+    BlobResult blob;
+    RETURN_IF_FAILED(GetItemDataRef(index, &blob));
+    RETURN_IF_FAILED(GetStringResultFromBlobResult(&blob, encoding, pStringOut));
+
+    if (useCache)
+    {
+        // Hand the decoded buffer to the cache and return a reference to it
+        // instead; if it doesn't fit, give it back.
+        PWSTR pBuffer;
+        size_t cchBuffer;
+        RETURN_IF_FAILED(pStringOut->ReleaseContents(&pBuffer, &cchBuffer));
+        if (pCache->TryAdd(key, pBuffer, cchBuffer, &pCached))
+        {
+            return pStringOut->SetRef(pCached);
+        }
+
+        HRESULT hr = pStringOut->SetContents(pBuffer, cchBuffer);
+        if (FAILED(hr))
+        {
+            _DefFree(pBuffer);
+            return hr;
+        }
+    }
+
+    return S_OK;
+}
+
+_Use_decl_annotations_ HRESULT FileDataItemsSection::EnableDecodedStringCache(UINT32 cbBudget)
+{
+    if (GetStringCache() != nullptr)
+    {
+        return S_OK;
+    }
+
+    DecodedStringCache* pCache;
+    RETURN_IF_FAILED(DecodedStringCache::CreateInstance(cbBudget, &pCache));
+    if (InterlockedCompareExchangePointer(reinterpret_cast<PVOID volatile*>(&m_pStringCache), pCache, nullptr) != nullptr)
+    {
+        // Another thread enabled it first.
+        delete pCache;
+    }
+    return S_OK;
+}
+
+_Use_decl_annotations_ bool FileDataItemsSection::TryGetDecodedStringCacheStats(DecodedStringCache::Stats* pStats) const
+{
+    const DecodedStringCache* pCache = GetStringCache();
+    if (pCache == nullptr)
+    {
+        *pStats = {};
+        return false;
+    }
+
+    pCache->GetStats(pStats);
+    return true;
+}
+
+_Use_decl_annotations_ HRESULT FileDataItemsSection::GetCompressedItemData(size_t offset, size_t cbItemData, BlobResult* pData) const
+{
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), m_pBlocksHeader->numBlocks == 0);
+
+    // Find the last block that starts at or before the item
+    UINT32 low = 0;
+    UINT32 high = m_pBlocksHeader->numBlocks;
+    while ((high - low) > 1)
+    {
+        UINT32 mid = low + ((high - low) / 2);
+        if (m_pBlocks[mid].uncompressedOffset <= offset)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    const DEFFILE_DATAITEMS_BLOCK* pBlock = &m_pBlocks[low];
+    size_t offsetInBlock = offset - pBlock->uncompressedOffset;
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), (offsetInBlock + cbItemData) > pBlock->cbUncompressed);
+
+    const BYTE* pBlockData = &m_pCompressedData[pBlock->compressedOffset];
+    if (pBlock->cbCompressed == pBlock->cbUncompressed)
+    {
+        // stored as is
+        return pData->SetRef(&pBlockData[offsetInBlock], cbItemData);
+    }
+
+    AutoReaderWriterLock autoLock(&m_blockCacheLock);
+
+    // Use the cached copy of the block if we have one, otherwise decompress
+    // into an empty entry or the least recently used one.
+    BlockCacheEntry* pEntry = nullptr;
+    for (int i = 0; i < BlockCacheSize; i++)
+    {
+        if (m_blockCache[i].blockIndex == static_cast<int>(low))
+        {
+            pEntry = &m_blockCache[i];
+            break;
+        }
+        if ((pEntry == nullptr) || (m_blockCache[i].lastUsed < pEntry->lastUsed))
+        {
+            pEntry = &m_blockCache[i];
+        }
+    }
+
+    if (pEntry->blockIndex != static_cast<int>(low))
+    {
+        pEntry->blockIndex = -1;
+        if (pEntry->cbCapacity < pBlock->cbUncompressed)
+        {
+            if (pEntry->pData != nullptr)
+            {
+                Def_Free(pEntry->pData);
+            }
+            pEntry->cbCapacity = 0;
+            pEntry->pData = _DefArray_Alloc(BYTE, pBlock->cbUncompressed);
+            RETURN_IF_NULL_ALLOC(pEntry->pData);
+            pEntry->cbCapacity = pBlock->cbUncompressed;
+        }
+
+        RETURN_IF_FAILED(DefCompression::Decompress(pBlockData, pBlock->cbCompressed, pEntry->pData, pBlock->cbUncompressed));
+        pEntry->blockIndex = static_cast<int>(low);
+    }
+    pEntry->lastUsed = ++m_blockCacheClock;
+
+    // Copy rather than reference; the entry can be evicted at any time.
+    return pData->SetCopy(&pEntry->pData[offsetInBlock], cbItemData);
+}
+
 } // namespace Microsoft::Resources
\ No newline at end of file
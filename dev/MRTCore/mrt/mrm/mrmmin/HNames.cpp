@@ -148,12 +148,38 @@ public:
 
     virtual bool TryGetString(__in Atom::Index index, __inout_opt StringResult* pStringOut) const = 0;
 
+    HRESULT ComputeStringsChecksum(__in DEF_CHECKSUM partialChecksum, __in Atom::Index numAtoms, __out DEF_CHECKSUM* pChecksumOut) const override
+    {
+        *pChecksumOut = partialChecksum;
+        RETURN_HR_IF(E_INVALIDARG, (numAtoms < 0) || (numAtoms > m_numAtoms));
+
+        StringResult name;
+        DEF_CHECKSUM crc = partialChecksum;
+        for (Atom::Index i = 0; i < numAtoms; i++)
+        {
+            int nodeIndex = GetNameNodeIndex(i);
+            if (!m_pNames->TryComputeNameChecksum(nodeIndex, crc, &crc))
+            {
+                if (!m_pNames->TryGetName(nodeIndex, &name))
+                {
+                    break;
+                }
+                RETURN_IF_FAILED(DefChecksum::ComputeStringChecksum(crc, true, name.GetRef(), &crc));
+            }
+        }
+
+        *pChecksumOut = crc;
+        return S_OK;
+    }
+
 protected:
-    HierarchicalNamesAtomPool(__in const IHierarchicalNames* pNames, __in int numAtoms) :
+    HierarchicalNamesAtomPool(__in const HierarchicalNames* pNames, __in int numAtoms) :
         m_pNames(pNames), m_numAtoms(numAtoms), m_poolIndex(Atom::PoolIndexNone), m_pAtomPoolGroup(nullptr)
     {}
 
-    const IHierarchicalNames* m_pNames;
+    virtual int GetNameNodeIndex(__in Atom::Index index) const = 0;
+
+    const HierarchicalNames* m_pNames;
     int m_numAtoms;
 
     Atom::PoolIndex m_poolIndex;
@@ -165,7 +191,7 @@ class ScopesAtomPool : public HierarchicalNamesAtomPool
 {
 public:
     static HRESULT CreateInstance(
-        __in const IHierarchicalNames* pNames,
+        __in const HierarchicalNames* pNames,
         __in_ecount(numScopes) const T* pScopes,
         __in int numScopes,
         _Outptr_ ScopesAtomPool** result)
@@ -243,7 +269,9 @@ public:
     }
 
 protected:
-    ScopesAtomPool(__in const IHierarchicalNames* pNames, __in_ecount(numScopes) const T* pScopes, __in int numScopes) :
+    int GetNameNodeIndex(__in Atom::Index index) const override { return m_pScopes[index].nameNodeIndex; }
+
+    ScopesAtomPool(__in const HierarchicalNames* pNames, __in_ecount(numScopes) const T* pScopes, __in int numScopes) :
         HierarchicalNamesAtomPool(pNames, numScopes)
     {
         m_pScopes = pScopes;
@@ -257,7 +285,7 @@ class ItemsAtomPool : public HierarchicalNamesAtomPool
 {
 public:
     static HRESULT CreateInstance(
-        __in const IHierarchicalNames* pNames,
+        __in const HierarchicalNames* pNames,
         __in_ecount(numItems) const T* pItems,
         __in int numItems,
         _Outptr_ ItemsAtomPool** result)
@@ -334,7 +362,9 @@ public:
     }
 
 protected:
-    ItemsAtomPool(__in const IHierarchicalNames* pNames, __in_ecount(numItems) const T* pItems, __in int numItems) :
+    int GetNameNodeIndex(__in Atom::Index index) const override { return m_pItems[index]; }
+
+    ItemsAtomPool(__in const HierarchicalNames* pNames, __in_ecount(numItems) const T* pItems, __in int numItems) :
         HierarchicalNamesAtomPool(pNames, numItems)
     {
         m_pItems = pItems;
@@ -355,8 +385,13 @@ HierarchicalNames::HierarchicalNames() :
     m_pAsciiNames(nullptr),
     m_pScopeNames(nullptr),
     m_pItemNames(nullptr),
-    m_largeNode(false)
-{}
+    m_largeNode(false),
+    m_pNameCache(nullptr),
+    m_nameCacheSize(0),
+    m_nameCacheClock(0)
+{
+    _DefInitializeSRWLock(&m_nameCacheLock);
+}
 
 HRESULT HierarchicalNames::Init(
     _In_ const DEFFILE_SECTION_TYPEID& type,
@@ -486,6 +521,8 @@ HierarchicalNames::~HierarchicalNames()
 
     m_pScopeNames = NULL;
     m_pItemNames = NULL;
+
+    FreeNameCache();
 }
 
 _Success_(return ) bool HierarchicalNames::TryGetName(
@@ -573,6 +610,13 @@ _Success_(return ) bool HierarchicalNames::TryGetName(
         }
     }
 
+    // The size is only a hint here; the cache re-checks it under its lock.
+    bool useNameCache = (_DefReadAcquire(&m_nameCacheSize) > 0);
+    if ((pNameOut != nullptr) && useNameCache && TryGetCachedName(nodeIndex, relativeToScope, pNameOut))
+    {
+        return true;
+    }
+
     if (pNameOut != nullptr)
     {
         // Now we'll have to build up the file name from back to front.  First we
@@ -672,10 +716,276 @@ _Success_(return ) bool HierarchicalNames::TryGetName(
                 }
             }
         }
+
+        if (useNameCache)
+        {
+            CacheName(nodeIndex, relativeToScope, pNameOut->GetRef());
+        }
     }
     return true;
 }
 
+_Success_(return ) bool HierarchicalNames::TryComputeNameChecksum(
+    _In_ int nodeIndex,
+    _In_ DEF_CHECKSUM partialChecksum,
+    _Out_ DEF_CHECKSUM* pChecksumOut) const
+{
+    *pChecksumOut = partialChecksum;
+
+    if ((m_pHeader->numNodes == 0) || (m_pHeader->numScopes == 0) || (nodeIndex < 0) || (nodeIndex > m_pHeader->numNodes - 1))
+    {
+        return false;
+    }
+
+    // Names are relative to the root scope, which is always the root node in
+    // names we build.  Leave anything else to TryGetName.
+    if ((m_largeNode ? m_pScopesLarge[0].nameNodeIndex : m_pScopes[0].nameNodeIndex) != 0)
+    {
+        return false;
+    }
+
+    // Walk from the node to the root with the same checks TryGetName makes,
+    // remembering where each segment lives and whether a separator precedes it.
+    NameSegment segments[MaxStreamedNameDepth];
+    int numSegments = 0;
+    int cchFullPath = GetNodeLarge(nodeIndex).cchFullPath;
+    int cchNext = cchFullPath;
+
+    if (cchFullPath > 0)
+    {
+        int segmentNodeIndex = nodeIndex;
+        do
+        {
+            if ((segmentNodeIndex > m_pHeader->numNodes - 1) || (numSegments >= MaxStreamedNameDepth))
+            {
+                return false;
+            }
+
+            DEFFILE_HNAMES_NODE_LARGE segmentNode = GetNodeLarge(segmentNodeIndex);
+            NameSegment* pSegment = &segments[numSegments++];
+            int nameOffset = HNamesGetNodeNameOffsetLarge(&segmentNode);
+
+            pSegment->pAsciiName = nullptr;
+            pSegment->pUtf16Name = nullptr;
+            pSegment->cchName = segmentNode.cchName;
+
+            cchNext -= segmentNode.cchName;
+            if (cchNext < 0)
+            {
+                return false;
+            }
+
+            // ComputeStringChecksum stops at the first NULL, so a segment with an
+            // embedded NULL can't be streamed.
+            if ((segmentNode.flagsAndNameOffsetHigh & DEFFILE_HNAMES_FLAGS_NAME_IS_ASCII) != 0)
+            {
+                if (FAILED(GetAsciiName(nameOffset, segmentNode.cchName, &pSegment->pAsciiName)) ||
+                    (memchr(pSegment->pAsciiName, 0, segmentNode.cchName) != nullptr))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                if (FAILED(GetUtf16Name(nameOffset, segmentNode.cchName, &pSegment->pUtf16Name)))
+                {
+                    return false;
+                }
+
+                for (int i = 0; i < segmentNode.cchName; i++)
+                {
+                    if (pSegment->pUtf16Name[i] == L'\0')
+                    {
+                        return false;
+                    }
+                }
+            }
+
+            pSegment->separatorBefore = (cchNext > 0);
+            if (cchNext > 0)
+            {
+                cchNext--;
+            }
+
+            segmentNodeIndex = segmentNode.parentNodeIndex;
+        } while (segmentNodeIndex > 0);
+
+        if (cchNext != 0)
+        {
+            return false;
+        }
+    }
+
+    // Now add the segments front to back, exactly as if they'd been copied into one string.
+    const WCHAR separator = GetDefaultPathSeparator();
+    const WCHAR terminator = L'\0';
+    DEF_CHECKSUM crc = DefChecksum::ComputeStringLengthChecksum(partialChecksum, static_cast<UINT32>(cchFullPath));
+
+    for (int i = numSegments - 1; i >= 0; i--)
+    {
+        const NameSegment* pSegment = &segments[i];
+        if (pSegment->separatorBefore)
+        {
+            crc = _DefComputeStringCrc32(crc, TRUE, &separator, 1);
+        }
+
+        if (pSegment->pUtf16Name != nullptr)
+        {
+            crc = _DefComputeStringCrc32(crc, TRUE, pSegment->pUtf16Name, pSegment->cchName);
+            continue;
+        }
+
+        // Widen ASCII names the same way CopyNameSegment does.
+        WCHAR chunk[64];
+        for (int first = 0; first < pSegment->cchName; first += ARRAYSIZE(chunk))
+        {
+            int cchChunk = min(pSegment->cchName - first, static_cast<int>(ARRAYSIZE(chunk)));
+            for (int j = 0; j < cchChunk; j++)
+            {
+                chunk[j] = pSegment->pAsciiName[first + j];
+            }
+            crc = _DefComputeStringCrc32(crc, TRUE, chunk, cchChunk);
+        }
+    }
+
+    *pChecksumOut = _DefComputeStringCrc32(crc, TRUE, &terminator, 1);
+    return true;
+}
+
+HierarchicalNames::NameCacheEntry* HierarchicalNames::GetNameCacheSet(_In_ int nodeIndex, _In_ int relativeToScope) const
+{
+    if (m_nameCacheSize <= 0)
+    {
+        return nullptr;
+    }
+
+    UINT32 hash = (static_cast<UINT32>(nodeIndex) * 0x9E3779B1) ^ (static_cast<UINT32>(relativeToScope) * 0x85EBCA77);
+    hash ^= (hash >> 16);
+    UINT32 numSets = static_cast<UINT32>(m_nameCacheSize / NameCacheWays);
+    return &m_pNameCache[(hash % numSets) * NameCacheWays];
+}
+
+_Success_(return ) bool HierarchicalNames::TryGetCachedName(
+    _In_ int nodeIndex,
+    _In_ int relativeToScope,
+    _Inout_ StringResult* pNameOut) const
+{
+    // Lookups share the lock; only the use stamp changes, and that is atomic.
+    AutoReaderWriterLock autoLock(&m_nameCacheLock, true);
+
+    NameCacheEntry* pSet = GetNameCacheSet(nodeIndex, relativeToScope);
+    if (pSet == nullptr)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < NameCacheWays; i++)
+    {
+        NameCacheEntry* pEntry = &pSet[i];
+        if ((pEntry->pName != nullptr) && (pEntry->nodeIndex == nodeIndex) && (pEntry->relativeToScope == relativeToScope))
+        {
+            // Copy rather than reference; the entry can be evicted as soon as we drop the lock.
+            if (FAILED(pNameOut->SetCopy(pEntry->pName)))
+            {
+                return false;
+            }
+            InterlockedExchange(&pEntry->lastUsed, InterlockedIncrement(&m_nameCacheClock));
+            return true;
+        }
+    }
+    return false;
+}
+
+void HierarchicalNames::CacheName(_In_ int nodeIndex, _In_ int relativeToScope, _In_ PCWSTR pName) const
+{
+    PWSTR pCopy;
+    if ((pName == nullptr) || FAILED(DefString_Dup(pName, &pCopy)))
+    {
+        // The cache is only an optimization
+        return;
+    }
+
+    AutoReaderWriterLock autoLock(&m_nameCacheLock);
+
+    NameCacheEntry* pSet = GetNameCacheSet(nodeIndex, relativeToScope);
+    if (pSet == nullptr)
+    {
+        // The cache was disabled while we were building the name
+        Def_Free(pCopy);
+        return;
+    }
+
+    // Replace an empty entry in the set if there is one, otherwise the least recently used.
+    NameCacheEntry* pVictim = nullptr;
+    for (int i = 0; i < NameCacheWays; i++)
+    {
+        NameCacheEntry* pEntry = &pSet[i];
+        if ((pEntry->pName != nullptr) && (pEntry->nodeIndex == nodeIndex) && (pEntry->relativeToScope == relativeToScope))
+        {
+            // Another thread got here first
+            pEntry->lastUsed = InterlockedIncrement(&m_nameCacheClock);
+            Def_Free(pCopy);
+            return;
+        }
+
+        if ((pVictim == nullptr) || (pEntry->pName == nullptr) ||
+            ((pVictim->pName != nullptr) && (static_cast<UINT32>(pEntry->lastUsed) < static_cast<UINT32>(pVictim->lastUsed))))
+        {
+            pVictim = pEntry;
+        }
+    }
+
+    if (pVictim->pName != nullptr)
+    {
+        Def_Free(pVictim->pName);
+    }
+
+    pVictim->nodeIndex = nodeIndex;
+    pVictim->relativeToScope = relativeToScope;
+    pVictim->lastUsed = InterlockedIncrement(&m_nameCacheClock);
+    pVictim->pName = pCopy;
+}
+
+void HierarchicalNames::FreeNameCache() const
+{
+    if (m_pNameCache != nullptr)
+    {
+        for (int i = 0; i < m_nameCacheSize; i++)
+        {
+            if (m_pNameCache[i].pName != nullptr)
+            {
+                Def_Free(m_pNameCache[i].pName);
+            }
+        }
+        Def_Free(m_pNameCache);
+    }
+
+    m_pNameCache = nullptr;
+    _DefWriteRelease(&m_nameCacheSize, 0);
+    m_nameCacheClock = 0;
+}
+
+HRESULT HierarchicalNames::SetNameCacheSize(_In_ int maxNames) const
+{
+    RETURN_HR_IF(E_INVALIDARG, (maxNames < 0) || (maxNames > MaxNameCacheSize));
+
+    int numEntries = ((maxNames + NameCacheWays - 1) / NameCacheWays) * NameCacheWays;
+    NameCacheEntry* pNewCache = nullptr;
+    if (numEntries > 0)
+    {
+        pNewCache = _DefArray_AllocZeroed(NameCacheEntry, numEntries);
+        RETURN_IF_NULL_ALLOC(pNewCache);
+    }
+
+    AutoReaderWriterLock autoLock(&m_nameCacheLock);
+
+    FreeNameCache();
+    m_pNameCache = pNewCache;
+    _DefWriteRelease(&m_nameCacheSize, numEntries);
+
+    return S_OK;
+}
+
 bool HierarchicalNames::Contains(
     __in PCWSTR pPath,
     __out_opt int* pScopeIndexOut,
@@ -1259,63 +1569,162 @@ HRESULT HierarchicalNames::CompareNameSegment(_In_ const T* pNode, _In_ PCWSTR p
     return S_OK;
 }
 
-HRESULT
-HierarchicalNames::GetNumDescendents(_In_ int scopeIndex, _In_ UINT32 currentDepth, _Out_opt_ int* pNumScopes, _Out_opt_ int* pNumItems)
-    const
+HRESULT HierarchicalNames::GetNumDescendents(_In_ int scopeIndex, _Out_opt_ int* pNumScopes, _Out_opt_ int* pNumItems) const
 {
     RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), m_pHeader->numScopes == 0);
     RETURN_HR_IF(E_INVALIDARG, (scopeIndex < 0) || (scopeIndex > m_pHeader->numScopes - 1));
 
-    const DEFFILE_HNAMES_SCOPE_LARGE* pScope;
-    DEFFILE_HNAMES_SCOPE_LARGE scope;
-    if (m_largeNode)
+    if ((pNumScopes == nullptr) && ((m_pHeader->flags & DEFFILE_HNAMES_FLAGS_DESCENDENT_ITEM_COUNTS) != 0))
     {
-        pScope = &m_pScopesLarge[scopeIndex];
+        UINT32 numItems = GetScopeLarge(scopeIndex).flags;
+        RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), numItems > m_pHeader->numItems);
+
+        if (pNumItems != nullptr)
+        {
+            *pNumItems = static_cast<int>(numItems);
+        }
+        return S_OK;
     }
-    else
+
+    HierarchicalNamesCursor cursor;
+    RETURN_IF_FAILED(InitDescendentCursor(scopeIndex, &cursor));
+
+    int numScopes = 0;
+    int numItems = 0;
+    int descendentScope;
+    while (TryGetNextDescendent(&cursor, &descendentScope, nullptr))
     {
-        scope = HNAMES_SCOPE_TO_HNAMES_SCOPE_LARGE(&m_pScopes[scopeIndex]);
-        pScope = &scope;
+        if (descendentScope >= 0)
+        {
+            numScopes++;
+        }
+        else
+        {
+            numItems++;
+        }
+    }
+
+    if (FAILED(cursor.status))
+    {
+        return GetNumDescendentsByWalk(scopeIndex, 0, pNumScopes, pNumItems);
+    }
+
+    if (pNumScopes != nullptr)
+    {
+        *pNumScopes = numScopes;
+    }
+
+    if (pNumItems != nullptr)
+    {
+        *pNumItems = numItems;
+    }
+    return S_OK;
+}
+
+HRESULT HierarchicalNames::GetDescendents(
+    _In_ int scopeIndex,
+    _In_ int sizeScopes,
+    _Out_writes_to_opt_(sizeScopes, *pNumScopesWritten) int* pScopesOut,
+    _Out_opt_ int* pNumScopesWritten,
+    _In_ int sizeItems,
+    _Out_writes_to_opt_(sizeItems, *pNumItemsWritten) int* pItemsOut,
+    _Out_opt_ int* pNumItemsWritten) const
+{
+    if (pNumScopesWritten != nullptr)
+    {
+        *pNumScopesWritten = 0;
+    }
+
+    if (pNumItemsWritten != nullptr)
+    {
+        *pNumItemsWritten = 0;
+    }
+
+    HierarchicalNamesCursor cursor;
+    RETURN_IF_FAILED(InitDescendentCursor(scopeIndex, &cursor));
+
+    int numScopesWritten = 0;
+    int numItemsWritten = 0;
+    int descendentScope;
+    int descendentItem;
+
+    while (TryGetNextDescendent(&cursor, &descendentScope, &descendentItem))
+    {
+        // Now report either the schema or item index
+        if (descendentScope >= 0)
+        {
+            if (pScopesOut != nullptr)
+            {
+                if (numScopesWritten >= sizeScopes)
+                {
+                    return HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
+                }
+                pScopesOut[numScopesWritten] = descendentScope;
+                numScopesWritten++;
+            }
+        }
+        else if (pItemsOut != nullptr)
+        {
+            if (numItemsWritten >= sizeItems)
+            {
+                return HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
+            }
+            pItemsOut[numItemsWritten] = descendentItem;
+            numItemsWritten++;
+        }
+    }
+
+    if (FAILED(cursor.status))
+    {
+        return GetDescendentsByWalk(scopeIndex, 0, sizeScopes, pScopesOut, pNumScopesWritten, sizeItems, pItemsOut, pNumItemsWritten);
+    }
+
+    if (pNumScopesWritten != nullptr)
+    {
+        *pNumScopesWritten = numScopesWritten;
+    }
+
+    if (pNumItemsWritten != nullptr)
+    {
+        *pNumItemsWritten = numItemsWritten;
     }
+    return S_OK;
+}
+
+HRESULT
+HierarchicalNames::GetNumDescendentsByWalk(_In_ int scopeIndex, _In_ UINT32 currentDepth, _Out_opt_ int* pNumScopes, _Out_opt_ int* pNumItems)
+    const
+{
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), m_pHeader->numScopes == 0);
+    RETURN_HR_IF(E_INVALIDARG, (scopeIndex < 0) || (scopeIndex > m_pHeader->numScopes - 1));
+
+    DEFFILE_HNAMES_SCOPE_LARGE scope = GetScopeLarge(scopeIndex);
 
     int numScopes = 0;
     int numItems = 0;
 
-    for (int i = 0; i < pScope->numChildNames; i++)
+    for (int i = 0; i < scope.numChildNames; i++)
     {
         // make sure the child refers to a name node that exists
-        if ((pScope->firstChildNameNode + i) >= m_pHeader->numNodes)
+        if ((scope.firstChildNameNode + i) >= m_pHeader->numNodes)
         {
             return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
         }
 
-        BYTE flags;
-        int payload;
-        if (m_largeNode)
-        {
-            const DEFFILE_HNAMES_NODE_LARGE* pChildNode = &m_pNodesLarge[pScope->firstChildNameNode + i];
-            flags = pChildNode->flagsAndNameOffsetHigh;
-            payload = pChildNode->payload;
-        }
-        else
-        {
-            const DEFFILE_HNAMES_NODE* pChildNode = &m_pNodes[pScope->firstChildNameNode + i];
-            flags = pChildNode->flagsAndNameOffsetHigh;
-            payload = pChildNode->payload;
-        }
+        DEFFILE_HNAMES_NODE_LARGE childNode = GetNodeLarge(scope.firstChildNameNode + i);
 
         // Now report either the schema or item index, depending on flag
-        if ((flags & DEFFILE_HNAMES_FLAGS_NODE_IS_SCOPE) != 0)
+        if ((childNode.flagsAndNameOffsetHigh & DEFFILE_HNAMES_FLAGS_NODE_IS_SCOPE) != 0)
         {
             int nChildItems = 0;
             int nChildScopes = 0;
 
-            if ((payload == scopeIndex) || (currentDepth > m_pHeader->numScopes))
+            if ((static_cast<int>(childNode.payload) == scopeIndex) || (currentDepth > m_pHeader->numScopes))
             {
                 return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
             }
 
-            RETURN_IF_FAILED(GetNumDescendents(payload, currentDepth + 1, &nChildScopes, &nChildItems));
+            RETURN_IF_FAILED(GetNumDescendentsByWalk(childNode.payload, currentDepth + 1, &nChildScopes, &nChildItems));
 
             numScopes += nChildScopes + 1;
             numItems += nChildItems;
@@ -1338,8 +1747,9 @@ HierarchicalNames::GetNumDescendents(_In_ int scopeIndex, _In_ UINT32 currentDep
     return S_OK;
 }
 
-HRESULT HierarchicalNames::GetDescendents(
+HRESULT HierarchicalNames::GetDescendentsByWalk(
     _In_ int scopeIndex,
+    _In_ UINT32 currentDepth,
     _In_ int sizeScopes,
     _Out_writes_to_opt_(sizeScopes, *pNumScopesWritten) int* pScopesOut,
     _Out_opt_ int* pNumScopesWritten,
@@ -1360,48 +1770,30 @@ HRESULT HierarchicalNames::GetDescendents(
     RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), m_pHeader->numScopes == 0);
     RETURN_HR_IF(E_INVALIDARG, (scopeIndex < 0) || (scopeIndex > m_pHeader->numScopes - 1));
 
-    const DEFFILE_HNAMES_SCOPE_LARGE* pScope;
-    DEFFILE_HNAMES_SCOPE_LARGE scope;
-    if (m_largeNode)
-    {
-        pScope = &m_pScopesLarge[scopeIndex];
-    }
-    else
-    {
-        scope = HNAMES_SCOPE_TO_HNAMES_SCOPE_LARGE(&m_pScopes[scopeIndex]);
-        pScope = &scope;
-    }
+    DEFFILE_HNAMES_SCOPE_LARGE scope = GetScopeLarge(scopeIndex);
 
     int numScopesWritten = 0;
     int numItemsWritten = 0;
 
-    for (int i = 0; i < pScope->numChildNames; i++)
+    for (int i = 0; i < scope.numChildNames; i++)
     {
         // make sure the child refers to a name node that exists
-        if ((pScope->firstChildNameNode + i) >= m_pHeader->numNodes)
+        if ((scope.firstChildNameNode + i) >= m_pHeader->numNodes)
         {
             return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
         }
 
-        BYTE flags;
-        int payload;
-
-        if (m_largeNode)
-        {
-            const DEFFILE_HNAMES_NODE_LARGE* pChildNode = &m_pNodesLarge[pScope->firstChildNameNode + i];
-            flags = pChildNode->flagsAndNameOffsetHigh;
-            payload = pChildNode->payload;
-        }
-        else
-        {
-            const DEFFILE_HNAMES_NODE* pChildNode = &m_pNodes[pScope->firstChildNameNode + i];
-            flags = pChildNode->flagsAndNameOffsetHigh;
-            payload = pChildNode->payload;
-        }
+        DEFFILE_HNAMES_NODE_LARGE childNode = GetNodeLarge(scope.firstChildNameNode + i);
+        int payload = childNode.payload;
 
         // Now report either the schema or item index, depending on flag
-        if ((flags & DEFFILE_HNAMES_FLAGS_NODE_IS_SCOPE) != 0)
+        if ((childNode.flagsAndNameOffsetHigh & DEFFILE_HNAMES_FLAGS_NODE_IS_SCOPE) != 0)
         {
+            if ((payload == scopeIndex) || (currentDepth > m_pHeader->numScopes))
+            {
+                return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            }
+
             if (pScopesOut != nullptr)
             {
                 if (numScopesWritten >= sizeScopes)
@@ -1414,8 +1806,9 @@ HRESULT HierarchicalNames::GetDescendents(
 
             int nChildItemsWritten = 0;
             int nChildScopesWritten = 0;
-            RETURN_IF_FAILED(GetDescendents(
+            RETURN_IF_FAILED(GetDescendentsByWalk(
                 payload,
+                currentDepth + 1,
                 (sizeScopes - numScopesWritten),
                 (pScopesOut ? &pScopesOut[numScopesWritten] : nullptr),
                 &nChildScopesWritten,
@@ -1449,6 +1842,351 @@ HRESULT HierarchicalNames::GetDescendents(
     return S_OK;
 }
 
+HRESULT HierarchicalNames::InitDescendentCursor(_In_ int scopeIndex, _Out_ HierarchicalNamesCursor* pCursorOut) const
+{
+    pCursorOut->rootScopeIndex = -1;
+    pCursorOut->scopeIndex = -1;
+    pCursorOut->nextChild = 0;
+    pCursorOut->depth = 0;
+    pCursorOut->status = S_OK;
+
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), m_pHeader->numScopes == 0);
+    RETURN_HR_IF(E_INVALIDARG, (scopeIndex < 0) || (scopeIndex > m_pHeader->numScopes - 1));
+
+    pCursorOut->rootScopeIndex = scopeIndex;
+    pCursorOut->scopeIndex = scopeIndex;
+    return S_OK;
+}
+
+_Success_(return ) bool HierarchicalNames::TryGetNextDescendent(
+    _Inout_ HierarchicalNamesCursor* pCursor,
+    _Out_opt_ int* pScopeIndexOut,
+    _Out_opt_ int* pItemIndexOut) const
+{
+    if (pScopeIndexOut != nullptr)
+    {
+        *pScopeIndexOut = -1;
+    }
+
+    if (pItemIndexOut != nullptr)
+    {
+        *pItemIndexOut = -1;
+    }
+
+    if ((pCursor->scopeIndex < 0) || (pCursor->scopeIndex > m_pHeader->numScopes - 1))
+    {
+        return false;
+    }
+
+    // Scope children are contiguous and every scope's name node points back to
+    // its parent, so the walk needs no stack: finishing a scope resumes its
+    // parent just after the child that named it.
+    HRESULT hr = HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+    while (true)
+    {
+        DEFFILE_HNAMES_SCOPE_LARGE scope = GetScopeLarge(pCursor->scopeIndex);
+
+        if (pCursor->nextChild < scope.numChildNames)
+        {
+            UINT32 childNodeIndex = scope.firstChildNameNode + pCursor->nextChild;
+            if (childNodeIndex >= m_pHeader->numNodes)
+            {
+                break;
+            }
+
+            DEFFILE_HNAMES_NODE_LARGE childNode = GetNodeLarge(childNodeIndex);
+            pCursor->nextChild++;
+
+            if ((childNode.flagsAndNameOffsetHigh & DEFFILE_HNAMES_FLAGS_NODE_IS_SCOPE) == 0)
+            {
+                if (pItemIndexOut != nullptr)
+                {
+                    *pItemIndexOut = childNode.payload;
+                }
+                return true;
+            }
+
+            // the depth limit catches cycles in malformed files
+            if ((childNode.payload >= m_pHeader->numScopes) || (pCursor->depth >= m_pHeader->numScopes) ||
+                (GetScopeLarge(childNode.payload).nameNodeIndex != childNodeIndex))
+            {
+                break;
+            }
+
+            pCursor->scopeIndex = childNode.payload;
+            pCursor->nextChild = 0;
+            pCursor->depth++;
+
+            if (pScopeIndexOut != nullptr)
+            {
+                *pScopeIndexOut = childNode.payload;
+            }
+            return true;
+        }
+
+        if (pCursor->scopeIndex == pCursor->rootScopeIndex)
+        {
+            hr = S_OK;
+            break;
+        }
+
+        // Done with this scope, so go back up to its parent
+        if ((pCursor->depth == 0) || (scope.nameNodeIndex >= m_pHeader->numNodes))
+        {
+            break;
+        }
+
+        UINT32 parentNodeIndex = GetNodeLarge(scope.nameNodeIndex).parentNodeIndex;
+        if (parentNodeIndex >= m_pHeader->numNodes)
+        {
+            break;
+        }
+
+        DEFFILE_HNAMES_NODE_LARGE parentNode = GetNodeLarge(parentNodeIndex);
+        if (((parentNode.flagsAndNameOffsetHigh & DEFFILE_HNAMES_FLAGS_NODE_IS_SCOPE) == 0) || (parentNode.payload >= m_pHeader->numScopes))
+        {
+            break;
+        }
+
+        DEFFILE_HNAMES_SCOPE_LARGE parentScope = GetScopeLarge(parentNode.payload);
+        if ((scope.nameNodeIndex < parentScope.firstChildNameNode) ||
+            ((scope.nameNodeIndex - parentScope.firstChildNameNode) >= parentScope.numChildNames))
+        {
+            break;
+        }
+
+        pCursor->scopeIndex = parentNode.payload;
+        pCursor->nextChild = scope.nameNodeIndex - parentScope.firstChildNameNode + 1;
+        pCursor->depth--;
+    }
+
+    // The walk is over, either because we're done or because the names are bad.
+    pCursor->scopeIndex = -1;
+    pCursor->status = hr;
+    return false;
+}
+
+HRESULT HierarchicalNames::GetDescendentItemNames(
+    _In_ int scopeIndex,
+    _In_ int firstDescendent,
+    _In_ int maxNames,
+    _Inout_ HierarchicalNamesBatch* pNamesOut) const
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, pNamesOut);
+    RETURN_HR_IF(E_INVALIDARG, (firstDescendent < 0) || (maxNames < 0));
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), m_pHeader->numScopes == 0);
+    RETURN_HR_IF(E_INVALIDARG, (scopeIndex < 0) || (scopeIndex > m_pHeader->numScopes - 1));
+
+    if (maxNames == 0)
+    {
+        return S_OK;
+    }
+
+    // Names relative to a scope are never longer than the longest full path.
+    int cchPrefixMax = m_pHeader->cchLongestPath + 2;
+    WCHAR* pPrefix = _DefArray_AllocZeroed(WCHAR, cchPrefixMax);
+    RETURN_IF_NULL_ALLOC(pPrefix);
+
+    int endDescendent = ((maxNames > (INT_MAX - firstDescendent)) ? INT_MAX : (firstDescendent + maxNames));
+    int nextDescendent = 0;
+    HRESULT hr = AppendDescendentItemNames(
+        scopeIndex, 0, pPrefix, 0, cchPrefixMax, &nextDescendent, firstDescendent, endDescendent, pNamesOut);
+
+    Def_Free(pPrefix);
+    return hr;
+}
+
+HRESULT HierarchicalNames::AppendDescendentItemNames(
+    _In_ int scopeIndex,
+    _In_ UINT32 currentDepth,
+    _Inout_updates_(cchPrefixMax) WCHAR* pPrefix,
+    _In_ int cchPrefix,
+    _In_ int cchPrefixMax,
+    _Inout_ int* pNextDescendent,
+    _In_ int firstDescendent,
+    _In_ int endDescendent,
+    _Inout_ HierarchicalNamesBatch* pNamesOut) const
+{
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), currentDepth > m_pHeader->numScopes);
+
+    const DEFFILE_HNAMES_SCOPE_LARGE* pScope;
+    DEFFILE_HNAMES_SCOPE_LARGE scope;
+    if (m_largeNode)
+    {
+        pScope = &m_pScopesLarge[scopeIndex];
+    }
+    else
+    {
+        scope = HNAMES_SCOPE_TO_HNAMES_SCOPE_LARGE(&m_pScopes[scopeIndex]);
+        pScope = &scope;
+    }
+
+    // Visit children in the same order as GetDescendents so that descendent
+    // numbers line up.
+    for (UINT32 i = 0; (i < pScope->numChildNames) && (*pNextDescendent < endDescendent); i++)
+    {
+        if ((pScope->firstChildNameNode + i) >= m_pHeader->numNodes)
+        {
+            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+        }
+
+        const DEFFILE_HNAMES_NODE_LARGE* pChildNode;
+        DEFFILE_HNAMES_NODE_LARGE childNode;
+        if (m_largeNode)
+        {
+            pChildNode = &m_pNodesLarge[pScope->firstChildNameNode + i];
+        }
+        else
+        {
+            childNode = HNAMES_NODE_TO_HNAMES_NODE_LARGE(&m_pNodes[pScope->firstChildNameNode + i]);
+            pChildNode = &childNode;
+        }
+
+        int cchName = pChildNode->cchName;
+        UINT32 nameOffset = HNamesGetNodeNameOffsetLarge(pChildNode);
+
+        if ((pChildNode->flagsAndNameOffsetHigh & DEFFILE_HNAMES_FLAGS_NODE_IS_SCOPE) != 0)
+        {
+            int childScopeIndex = pChildNode->payload;
+            if ((childScopeIndex == scopeIndex) || (childScopeIndex < 0) || (childScopeIndex > m_pHeader->numScopes - 1))
+            {
+                return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            }
+
+            // Extend the prefix with "<scope>/" for everything below this scope.
+            RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE), (cchPrefix + cchName + 1) > cchPrefixMax);
+            RETURN_IF_FAILED(CopyNameSegment(pChildNode->flagsAndNameOffsetHigh, nameOffset, cchName, &pPrefix[cchPrefix]));
+            pPrefix[cchPrefix + cchName] = GetDefaultPathSeparator();
+
+            RETURN_IF_FAILED(AppendDescendentItemNames(
+                childScopeIndex,
+                currentDepth + 1,
+                pPrefix,
+                cchPrefix + cchName + 1,
+                cchPrefixMax,
+                pNextDescendent,
+                firstDescendent,
+                endDescendent,
+                pNamesOut));
+        }
+        else
+        {
+            if (*pNextDescendent >= firstDescendent)
+            {
+                PWSTR pName;
+                RETURN_IF_FAILED(pNamesOut->AddName(pChildNode->payload, cchPrefix + cchName, &pName));
+                memcpy(pName, pPrefix, cchPrefix * sizeof(WCHAR));
+                RETURN_IF_FAILED(CopyNameSegment(pChildNode->flagsAndNameOffsetHigh, nameOffset, cchName, &pName[cchPrefix]));
+                pName[cchPrefix + cchName] = L'\0';
+            }
+            (*pNextDescendent)++;
+        }
+    }
+
+    return S_OK;
+}
+
+HierarchicalNamesBatch::HierarchicalNamesBatch() :
+    m_pChars(nullptr), m_cchUsed(0), m_cchAllocated(0), m_pNameOffsets(nullptr), m_pItemIndices(nullptr), m_numNames(0), m_sizeNames(0)
+{}
+
+HierarchicalNamesBatch::~HierarchicalNamesBatch()
+{
+    if (m_pChars != nullptr)
+    {
+        Def_Free(m_pChars);
+        m_pChars = nullptr;
+    }
+
+    if (m_pNameOffsets != nullptr)
+    {
+        Def_Free(m_pNameOffsets);
+        m_pNameOffsets = nullptr;
+    }
+
+    if (m_pItemIndices != nullptr)
+    {
+        Def_Free(m_pItemIndices);
+        m_pItemIndices = nullptr;
+    }
+}
+
+HRESULT HierarchicalNamesBatch::CreateInstance(_Outptr_ HierarchicalNamesBatch** result)
+{
+    *result = nullptr;
+
+    HierarchicalNamesBatch* pRtrn = new HierarchicalNamesBatch();
+    RETURN_IF_NULL_ALLOC(pRtrn);
+
+    *result = pRtrn;
+    return S_OK;
+}
+
+_Success_(return ) bool HierarchicalNamesBatch::TryGetName(_In_ int index, _Out_ PCWSTR* pNameOut, _Out_opt_ int* pItemIndexOut) const
+{
+    *pNameOut = nullptr;
+    if (pItemIndexOut != nullptr)
+    {
+        *pItemIndexOut = -1;
+    }
+
+    if ((index < 0) || (static_cast<UINT32>(index) >= m_numNames))
+    {
+        return false;
+    }
+
+    *pNameOut = &m_pChars[m_pNameOffsets[index]];
+    if (pItemIndexOut != nullptr)
+    {
+        *pItemIndexOut = m_pItemIndices[index];
+    }
+    return true;
+}
+
+HRESULT HierarchicalNamesBatch::AddName(_In_ int itemIndex, _In_ int cchName, _Outptr_result_buffer_(cchName + 1) PWSTR* ppNameOut)
+{
+    *ppNameOut = nullptr;
+    RETURN_HR_IF(E_INVALIDARG, cchName < 0);
+    RETURN_HR_IF(E_OUTOFMEMORY, (static_cast<UINT32>(cchName) + 1) > (UINT_MAX / 2 - m_cchUsed));
+
+    // Both buffers grow geometrically so building a batch is linear overall.
+    UINT32 cchNeeded = m_cchUsed + cchName + 1;
+    if (cchNeeded > m_cchAllocated)
+    {
+        UINT32 cchNew = ((m_cchAllocated > 0) ? m_cchAllocated : 256);
+        while (cchNew < cchNeeded)
+        {
+            cchNew *= 2;
+        }
+        // Grow through locals so a failed allocation leaves the batch intact.
+        WCHAR* pNewChars = m_pChars;
+        RETURN_HR_IF(E_OUTOFMEMORY, !_DefArray_TryEnsureSize(&pNewChars, WCHAR, m_cchUsed, cchNew));
+        m_pChars = pNewChars;
+        m_cchAllocated = cchNew;
+    }
+
+    if (m_numNames >= m_sizeNames)
+    {
+        UINT32 sizeNew = ((m_sizeNames > 0) ? (m_sizeNames * 2) : 16);
+        UINT32* pNewOffsets = m_pNameOffsets;
+        RETURN_HR_IF(E_OUTOFMEMORY, !_DefArray_TryEnsureSize(&pNewOffsets, UINT32, m_numNames, sizeNew));
+        m_pNameOffsets = pNewOffsets;
+
+        int* pNewItems = m_pItemIndices;
+        RETURN_HR_IF(E_OUTOFMEMORY, !_DefArray_TryEnsureSize(&pNewItems, int, m_numNames, sizeNew));
+        m_pItemIndices = pNewItems;
+        m_sizeNames = sizeNew;
+    }
+
+    m_pNameOffsets[m_numNames] = m_cchUsed;
+    m_pItemIndices[m_numNames] = itemIndex;
+    m_numNames++;
+
+    *ppNameOut = &m_pChars[m_cchUsed];
+    m_cchUsed += cchName + 1;
+    return S_OK;
+}
+
 const DEFFILE_SECTION_TYPEID HierarchicalNames::GetSectionTypeId() { return gHierarchicalNamesSectionType; }
 
 } // namespace Microsoft::Resources
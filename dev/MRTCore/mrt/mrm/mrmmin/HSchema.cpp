@@ -200,7 +200,7 @@ bool HierarchicalSchemaReference::CheckIsCompatible(_In_ const IHierarchicalSche
         return true;
     }
     DefChecksum::Checksum cs = 0;
-    return (SUCCEEDED(ComputeHierarchicalSchemaVersionChecksum(pSchema, m_pVersion, &cs)) && (cs == m_pVersion->GetVersionChecksum()));
+    return (SUCCEEDED(pSchema->GetChecksumForVersion(m_pVersion, &cs)) && (cs == m_pVersion->GetVersionChecksum()));
 }
 
 bool HierarchicalSchemaReference::CheckIsIdentical(_In_ const HierarchicalSchemaReference* schema) const
@@ -318,14 +318,63 @@ bool CheckHierarchicalSchemaVersionIsCompatible(
     }
 
     DefChecksum::Checksum cs = 0;
-    return (
-        SUCCEEDED(ComputeHierarchicalSchemaVersionChecksum(pHaveSchema, pWantVersion, &cs)) && (cs == pWantVersion->GetVersionChecksum()));
+    return (SUCCEEDED(pHaveSchema->GetChecksumForVersion(pWantVersion, &cs)) && (cs == pWantVersion->GetVersionChecksum()));
 }
 
 HierarchicalSchema::HierarchicalSchema() :
-    m_pUniqueId(nullptr), m_pSimpleId(nullptr), m_pVersions(nullptr), m_pNames(nullptr), m_pMyBuffer(nullptr)
+    m_pUniqueId(nullptr),
+    m_pSimpleId(nullptr),
+    m_pVersions(nullptr),
+    m_pNames(nullptr),
+    m_pMyBuffer(nullptr),
+    m_numVersionChecksums(0),
+    m_nextVersionChecksum(0)
 {
     m_header.numVersions = 0; // This is needed during class destruction so ensure it always has a predictable state.
+    _DefInitializeSRWLock(&m_versionChecksumLock);
+}
+
+HRESULT HierarchicalSchema::GetChecksumForVersion(_In_ const IHierarchicalSchemaVersionInfo* pVersion, _Out_ DEF_CHECKSUM* pChecksumOut) const
+{
+    RETURN_HR_IF(E_INVALIDARG, (pVersion == nullptr) || (pChecksumOut == nullptr));
+    *pChecksumOut = 0;
+
+    {
+        AutoReaderWriterLock autoLock(&m_versionChecksumLock, true);
+        for (int i = 0; i < m_numVersionChecksums; i++)
+        {
+            const VersionChecksumCacheEntry* pEntry = &m_versionChecksums[i];
+            if ((pEntry->major == pVersion->GetMajorVersion()) && (pEntry->minor == pVersion->GetMinorVersion()) &&
+                (pEntry->numScopes == pVersion->GetNumScopes()) && (pEntry->numItems == pVersion->GetNumItems()))
+            {
+                *pChecksumOut = pEntry->checksum;
+                return S_OK;
+            }
+        }
+    }
+
+    // Compute outside the lock; if two threads race, both get the same answer.
+    DEF_CHECKSUM checksum;
+    RETURN_IF_FAILED(ComputeHierarchicalSchemaVersionChecksum(this, pVersion, &checksum));
+
+    {
+        AutoReaderWriterLock autoLock(&m_versionChecksumLock);
+        VersionChecksumCacheEntry* pEntry = &m_versionChecksums[m_nextVersionChecksum];
+        pEntry->major = pVersion->GetMajorVersion();
+        pEntry->minor = pVersion->GetMinorVersion();
+        pEntry->numScopes = pVersion->GetNumScopes();
+        pEntry->numItems = pVersion->GetNumItems();
+        pEntry->checksum = checksum;
+
+        m_nextVersionChecksum = (m_nextVersionChecksum + 1) % MaxCachedVersionChecksums;
+        if (m_numVersionChecksums < MaxCachedVersionChecksums)
+        {
+            m_numVersionChecksums++;
+        }
+    }
+
+    *pChecksumOut = checksum;
+    return S_OK;
 }
 
 HRESULT
@@ -8,6 +8,43 @@ WCHAR g_lastFailedFile[MAX_PATH];
 namespace Microsoft::Resources
 {
 
+// Keeps a file from being unloaded to fit the loaded file budget while it's
+// used without handing out pointers into it.
+class AutoPinFile
+{
+public:
+    AutoPinFile(_In_ const ManagedFile* pFile) : m_pFile(pFile) { m_pFile->Pin(); }
+    ~AutoPinFile() { m_pFile->Unpin(); }
+
+private:
+    const ManagedFile* m_pFile;
+};
+
+// Holds a file's load lock for the current scope.  Files that aren't shared
+// have no lock, and then this does nothing.
+class AutoLoadLock
+{
+public:
+    AutoLoadLock(_In_opt_ _DEF_SRWLOCK* pLock) : m_pLock(pLock)
+    {
+        if (m_pLock != nullptr)
+        {
+            _DefAcquireSRWLockExclusive(m_pLock);
+        }
+    }
+
+    ~AutoLoadLock()
+    {
+        if (m_pLock != nullptr)
+        {
+            _DefReleaseSRWLockExclusive(m_pLock);
+        }
+    }
+
+private:
+    _DEF_SRWLOCK* m_pLock;
+};
+
 HRESULT NormalizedFilePath::Init(_In_ PCWSTR pStr)
 {
     StringResult path;
@@ -113,6 +150,27 @@ HRESULT ManagedFile::CreateInstance(
     return S_OK;
 }
 
+HRESULT ManagedFile::CreatePreloadedInstance(
+    _In_ const PriFileManager* pManager,
+    _In_ const NormalizedFilePath* pNormalizedPath,
+    _In_opt_ PCWSTR pPackageRoot,
+    _Outptr_ ManagedFile** result)
+{
+    *result = nullptr;
+    RETURN_HR_IF(E_INVALIDARG, (pManager == nullptr) || (pNormalizedPath == nullptr) || DefString_IsEmpty(pNormalizedPath->GetRef()));
+
+    AutoDeletePtr<ManagedFile> pRtrn = new ManagedFile(pManager, -1);
+    RETURN_IF_NULL_ALLOC(pRtrn);
+
+    // Failures aren't traced here; the caller loads the file again the usual
+    // way if it turns out to be needed, and that reports the error.
+    RETURN_IF_FAILED_EXPECTED(pRtrn->Initialize(pManager, pNormalizedPath, pPackageRoot));
+    RETURN_IF_FAILED_EXPECTED(pRtrn->Load());
+
+    *result = pRtrn.Detach();
+    return S_OK;
+}
+
 ManagedFile::ManagedFile(_In_ const MrmFile* pBaseFile) :
     m_pManager(nullptr),
     m_globalIndex(-1),
@@ -123,6 +181,14 @@ ManagedFile::ManagedFile(_In_ const MrmFile* pBaseFile) :
     m_fileSizeInBytes(0),
     m_fileLastModifiedDate(0),
     m_pPackageRoot(nullptr),
+    m_pinCount(0),
+    m_isReferenced(false),
+    m_wasUnloaded(false),
+    m_haveLoadedChecksum(false),
+    m_loadedChecksum(0),
+    m_isCounted(false),
+    m_pLruPrev(nullptr),
+    m_pLruNext(nullptr),
     m_pEnvironment(pBaseFile->GetUnifiedEnvironment())
 {}
 
@@ -162,6 +228,14 @@ ManagedFile::ManagedFile(_In_ const PriFileManager* pManager, _In_ int globalInd
     m_fileSizeInBytes(0),
     m_fileLastModifiedDate(0),
     m_pPackageRoot(nullptr),
+    m_pinCount(0),
+    m_isReferenced(false),
+    m_wasUnloaded(false),
+    m_haveLoadedChecksum(false),
+    m_loadedChecksum(0),
+    m_isCounted(false),
+    m_pLruPrev(nullptr),
+    m_pLruNext(nullptr),
     m_pEnvironment(pManager->GetUnifiedEnvironment())
 {}
 
@@ -185,22 +259,106 @@ ManagedFile::~ManagedFile()
     }
 }
 
+_DEF_SRWLOCK* ManagedFile::GetLoadLock() const
+{
+    return (IsShared() ? m_pManager->GetLoadLock() : nullptr);
+}
+
 HRESULT ManagedFile::InnerLoad() const
 {
-    if (m_pBaseFile != nullptr)
+    return EnsureLoaded(false);
+}
+
+HRESULT ManagedFile::EnsureLoaded(_In_ bool reference) const
+{
+    bool wasUnloaded;
+    bool haveOldChecksum;
+    UINT32 oldChecksum;
     {
-        return S_OK;
+        AutoLoadLock autoLock(GetLoadLock());
+        if (m_pBaseFile != nullptr)
+        {
+            NoteAccess(reference);
+            return S_OK;
+        }
+
+        wasUnloaded = m_wasUnloaded;
+        haveOldChecksum = m_haveLoadedChecksum;
+        oldChecksum = m_loadedChecksum;
     }
 
-    RETURN_IF_FAILED(MrmFile::CreateInstance(const_cast<PriFileManager*>(m_pManager), m_pPath, (MrmFile**)&m_pMyBaseFile));
-    m_pBaseFile = m_pMyBaseFile;
+    // Mapping and checking the file can take a while, so it happens outside
+    // the load lock and the result is published under it.
+    LARGE_INTEGER start = {};
+    _DefQueryPerformanceCounter(&start);
+
+    UINT32 checksum = 0;
+    bool haveChecksum = false;
+    if (haveOldChecksum)
+    {
+        // Everything the manager has handed out about this file came from
+        // its old contents, so don't quietly reload a file that changed.
+        RETURN_IF_FAILED(GetFileChecksum(&checksum));
+        RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_FILE_INVALID), checksum != oldChecksum);
+        haveChecksum = true;
+    }
+    else if ((m_pManager != nullptr) && m_pManager->HasLoadedFileBudget())
+    {
+        // The file might be unloaded to fit the budget, so remember what was
+        // loaded.  If it can't be computed the reload isn't checked.
+        haveChecksum = SUCCEEDED(GetFileChecksum(&checksum));
+    }
 
-    m_loadFailed = false;
+    AutoDeletePtr<MrmFile> pNewFile;
+    RETURN_IF_FAILED(MrmFile::CreateInstance(const_cast<PriFileManager*>(m_pManager), m_pPath, &pNewFile));
 
+    UINT64 reloadTicks = 0;
+    if (wasUnloaded)
+    {
+        LARGE_INTEGER end = {};
+        _DefQueryPerformanceCounter(&end);
+        reloadTicks = static_cast<UINT64>(end.QuadPart - start.QuadPart);
+    }
+
+    // If another thread loaded the file meanwhile, its copy is kept and ours
+    // is deleted once the lock is released.
+    AutoLoadLock autoLock(GetLoadLock());
+    if (m_pBaseFile == nullptr)
+    {
+        m_pMyBaseFile = pNewFile.Detach();
+        m_pBaseFile = m_pMyBaseFile;
+        m_loadFailed = false;
+        m_haveLoadedChecksum = haveChecksum;
+        m_loadedChecksum = checksum;
+
+        // Files preloaded on a worker thread aren't in the manager yet.
+        if (IsShared())
+        {
+            m_pManager->NoteFileLoaded(this, m_wasUnloaded, reloadTicks);
+        }
+        m_wasUnloaded = false;
+    }
+
+    NoteAccess(reference);
     return S_OK;
 }
 
+void ManagedFile::NoteAccess(_In_ bool reference) const
+{
+    m_isReferenced = (m_isReferenced || reference);
+    if (IsShared())
+    {
+        m_pManager->NoteFileAccessed(this);
+    }
+}
+
 HRESULT ManagedFile::InnerUnload() const
+{
+    AutoLoadLock autoLock(GetLoadLock());
+    return UnloadIfLoaded();
+}
+
+HRESULT ManagedFile::UnloadIfLoaded() const
 {
     if (m_pBaseFile == nullptr)
     {
@@ -211,12 +369,31 @@ HRESULT ManagedFile::InnerUnload() const
         return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_FILE_TYPE);
     }
 
+    if (IsShared())
+    {
+        m_pManager->NoteFileUnloaded(this);
+    }
+
     delete m_pMyBaseFile;
     m_pMyBaseFile = nullptr;
     m_pBaseFile = nullptr;
+    m_isReferenced = false;
+    m_wasUnloaded = true;
     return S_OK;
 }
 
+void ManagedFile::Pin() const
+{
+    AutoLoadLock autoLock(GetLoadLock());
+    m_pinCount++;
+}
+
+void ManagedFile::Unpin() const
+{
+    AutoLoadLock autoLock(GetLoadLock());
+    m_pinCount = ((m_pinCount > 0) ? (m_pinCount - 1) : 0);
+}
+
 HRESULT ManagedFile::SetPackageRoot(_In_ PCWSTR pPackageRoot)
 {
     // Nothing to do if the path hasn't changed
@@ -245,10 +422,7 @@ HRESULT ManagedFile::SetPackageRoot(_In_ PCWSTR pPackageRoot)
 HRESULT ManagedFile::GetBaseFile(_Out_ const BaseFile** result) const
 {
     *result = nullptr;
-    if (m_pBaseFile == nullptr)
-    {
-        RETURN_IF_FAILED(InnerLoad());
-    }
+    RETURN_IF_FAILED(EnsureLoaded(true));
 
     DEF_ASSERT(m_pBaseFile != nullptr);
 
@@ -257,13 +431,17 @@ HRESULT ManagedFile::GetBaseFile(_Out_ const BaseFile** result) const
     return S_OK;
 }
 
+HRESULT ManagedFile::GetFileChecksum(_Out_ UINT32* checksum) const
+{
+    *checksum = 0;
+    RETURN_HR_IF_NULL(HRESULT_FROM_WIN32(ERROR_INVALID_OPERATION), m_pPath);
+    return DefChecksum::ComputeFileChecksum(0, m_pPath, checksum);
+}
+
 HRESULT ManagedFile::GetBaseMrmFile(_Out_ const IMrmFile** result) const
 {
     *result = nullptr;
-    if (m_pBaseFile == nullptr)
-    {
-        RETURN_IF_FAILED(InnerLoad());
-    }
+    RETURN_IF_FAILED(EnsureLoaded(true));
     *result = m_pBaseFile;
     return S_OK;
 }
@@ -278,10 +456,7 @@ HRESULT ManagedFile::GetSection(
 
     RETURN_HR_IF(E_DEF_NOT_READY, fileIndex != 0);
 
-    if (m_pBaseFile == nullptr)
-    {
-        RETURN_IF_FAILED(InnerLoad());
-    }
+    RETURN_IF_FAILED(EnsureLoaded(true));
 
     DEF_ASSERT(m_pBaseFile != nullptr);
 
@@ -296,7 +471,10 @@ const bool ManagedFile::TryGetSectionIndexByType(
     _In_ int startAtSectionIndex,
     _Out_ int* nextSectionIndex) const
 {
-    if ((fileIndex != 0) || ((m_pBaseFile == nullptr) && FAILED(InnerLoad())))
+    // Nothing from the file is handed out, so it's pinned rather than
+    // referenced for the lookup.
+    AutoPinFile pin(this);
+    if ((fileIndex != 0) || FAILED(EnsureLoaded(false)))
     {
         return false;
     }
@@ -312,10 +490,7 @@ HRESULT ManagedFile::GetAtomPoolSection(_In_ int fileIndex, _In_ BaseFile::Secti
 
     RETURN_HR_IF(E_DEF_NOT_READY, fileIndex != 0);
 
-    if (m_pBaseFile == nullptr)
-    {
-        RETURN_IF_FAILED(InnerLoad());
-    }
+    RETURN_IF_FAILED(EnsureLoaded(true));
 
     DEF_ASSERT(m_pBaseFile != nullptr);
 
@@ -332,10 +507,7 @@ ManagedFile::GetDecisionInfoSection(_In_ int fileIndex, _In_ BaseFile::SectionIn
 
     RETURN_HR_IF(E_DEF_NOT_READY, fileIndex != 0);
 
-    if (m_pBaseFile == nullptr)
-    {
-        RETURN_IF_FAILED(InnerLoad());
-    }
+    RETURN_IF_FAILED(EnsureLoaded(true));
 
     DEF_ASSERT(m_pBaseFile != nullptr);
 
@@ -350,10 +522,7 @@ HRESULT ManagedFile::GetSchemaSection(_In_ int fileIndex, _In_ BaseFile::Section
 
     RETURN_HR_IF(E_DEF_NOT_READY, fileIndex != 0);
 
-    if (m_pBaseFile == nullptr)
-    {
-        RETURN_IF_FAILED(InnerLoad());
-    }
+    RETURN_IF_FAILED(EnsureLoaded(true));
 
     DEF_ASSERT(m_pBaseFile != nullptr);
 
@@ -372,10 +541,7 @@ HRESULT ManagedFile::GetResourceMapSection(
 
     RETURN_HR_IF(E_DEF_NOT_READY, fileIndex != 0);
 
-    if (m_pBaseFile == nullptr)
-    {
-        RETURN_IF_FAILED(InnerLoad());
-    }
+    RETURN_IF_FAILED(EnsureLoaded(true));
 
     DEF_ASSERT(m_pBaseFile != nullptr);
 
@@ -394,10 +560,7 @@ HRESULT ManagedFile::GetPriDescriptorSection(
 
     RETURN_HR_IF(E_DEF_NOT_READY, fileIndex != 0);
 
-    if (m_pBaseFile == nullptr)
-    {
-        RETURN_IF_FAILED(InnerLoad());
-    }
+    RETURN_IF_FAILED(EnsureLoaded(true));
 
     DEF_ASSERT(m_pBaseFile != nullptr);
 
@@ -412,10 +575,7 @@ HRESULT ManagedFile::GetFileListSection(_In_ int fileIndex, _In_ BaseFile::Secti
 
     RETURN_HR_IF(E_DEF_NOT_READY, fileIndex != 0);
 
-    if (m_pBaseFile == nullptr)
-    {
-        RETURN_IF_FAILED(InnerLoad());
-    }
+    RETURN_IF_FAILED(EnsureLoaded(true));
 
     DEF_ASSERT(m_pBaseFile != nullptr);
 
@@ -431,10 +591,7 @@ ManagedFile::GetDataItemsSection(_In_ int fileIndex, _In_ BaseFile::SectionIndex
 
     RETURN_HR_IF(E_DEF_NOT_READY, fileIndex != 0);
 
-    if (m_pBaseFile == nullptr)
-    {
-        RETURN_IF_FAILED(InnerLoad());
-    }
+    RETURN_IF_FAILED(EnsureLoaded(true));
 
     DEF_ASSERT(m_pBaseFile != nullptr);
 
@@ -449,10 +606,7 @@ HRESULT ManagedFile::GetDataSection(_In_ int fileIndex, _In_ BaseFile::SectionIn
 
     RETURN_HR_IF(E_DEF_NOT_READY, fileIndex != 0);
 
-    if (m_pBaseFile == nullptr)
-    {
-        RETURN_IF_FAILED(InnerLoad());
-    }
+    RETURN_IF_FAILED(EnsureLoaded(true));
 
     DEF_ASSERT(m_pBaseFile != nullptr);
 
@@ -468,10 +622,7 @@ ManagedFile::GetReverseFileMapSection(_In_ int fileIndex, _In_ BaseFile::Section
 
     RETURN_HR_IF(E_DEF_NOT_READY, fileIndex != 0);
 
-    if (m_pBaseFile == nullptr)
-    {
-        RETURN_IF_FAILED(InnerLoad());
-    }
+    RETURN_IF_FAILED(EnsureLoaded(true));
 
     DEF_ASSERT(m_pBaseFile != nullptr);
 
@@ -489,10 +640,7 @@ HRESULT ManagedFile::GetEnvironmentMappingSection(
 
     RETURN_HR_IF(E_DEF_NOT_READY, fileIndex != 0);
 
-    if (m_pBaseFile == nullptr)
-    {
-        RETURN_IF_FAILED(InnerLoad());
-    }
+    RETURN_IF_FAILED(EnsureLoaded(true));
 
     DEF_ASSERT(m_pBaseFile != nullptr);
 
@@ -511,10 +659,7 @@ HRESULT ManagedFile::GetResourceLinkSection(
 
     RETURN_HR_IF(E_DEF_NOT_READY, fileIndex != 0);
 
-    if (m_pBaseFile == nullptr)
-    {
-        RETURN_IF_FAILED(InnerLoad());
-    }
+    RETURN_IF_FAILED(EnsureLoaded(true));
 
     DEF_ASSERT(m_pBaseFile != nullptr);
 
@@ -530,10 +675,7 @@ HRESULT ManagedFile::GetFileDefaultEnvironment(
 {
     RETURN_HR_IF(E_DEF_NOT_READY, fileIndex != 0);
 
-    if (m_pBaseFile == nullptr)
-    {
-        RETURN_IF_FAILED(InnerLoad());
-    }
+    RETURN_IF_FAILED(EnsureLoaded(true));
 
     DEF_ASSERT(m_pBaseFile != nullptr);
 
@@ -545,10 +687,7 @@ HRESULT ManagedFile::GetDefaultQualifierMapping(_In_ int fileIndex, _Out_ const
     *result = nullptr;
     RETURN_HR_IF(E_DEF_NOT_READY, fileIndex != 0);
 
-    if (m_pBaseFile == nullptr)
-    {
-        RETURN_IF_FAILED(InnerLoad());
-    }
+    RETURN_IF_FAILED(EnsureLoaded(true));
 
     DEF_ASSERT(m_pBaseFile != nullptr);
 
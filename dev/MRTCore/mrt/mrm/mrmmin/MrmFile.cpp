@@ -6,37 +6,55 @@
 namespace Microsoft::Resources
 {
 
+// Sections are initialized, and their readers created, on first use.  Each
+// happens once, under the section's lock, and is then published so later
+// lookups from any thread return it without locking.
 class MrmFileSection : public BaseFileSectionResult
 {
 public:
-    MrmFileSection() : BaseFileSectionResult(), m_sectionType(SectionTypeUnknown), isInitialized(false) { u.pFileList = nullptr; }
+    MrmFileSection() : BaseFileSectionResult(), m_sectionType(SectionTypeUnknown), m_readyType(SectionTypeUnknown), m_initialized(0)
+    {
+        u.pFileList = nullptr;
+        _DefInitializeSRWLock(&m_lock);
+    }
 
     virtual ~MrmFileSection() { ResetSection(); }
 
-    bool IsInitialized() { return isInitialized; }
+    bool IsInitialized() const { return (_DefReadAcquire(&m_initialized) != 0); }
 
-    HRESULT Init(_In_ const BaseFile* pParent, _In_ BaseFile::SectionIndex index)
+    HRESULT EnsureInitialized(_In_ const BaseFile* pParent, _In_ BaseFile::SectionIndex index)
     {
-        ResetSection();
+        if (IsInitialized())
+        {
+            return S_OK;
+        }
+
+        AutoReaderWriterLock autoLock(&m_lock);
+        if (m_initialized == 0)
+        {
+            ResetSection();
 
-        RETURN_IF_FAILED(pParent->GetFileSection(index, this));
-        isInitialized = true;
+            RETURN_IF_FAILED(pParent->GetFileSection(index, this));
+            _DefWriteRelease(&m_initialized, 1);
+        }
         return S_OK;
     }
 
     HRESULT GetAtomPoolSection(_Out_ FileAtomPool** result)
     {
         *result = nullptr;
-        if (m_sectionType == SectionTypeUnknown)
+        if (!IsReady(SectionTypeAtomPool))
         {
-            RETURN_IF_FAILED(FileAtomPool::CreateInstance(this, &u.pAtomPool));
-
-            m_sectionType = SectionTypeAtomPool;
-        }
-        else if (m_sectionType != SectionTypeAtomPool)
-        {
-            u.pAtomPool = nullptr;
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            AutoReaderWriterLock autoLock(&m_lock);
+            if (m_sectionType == SectionTypeUnknown)
+            {
+                RETURN_IF_FAILED(FileAtomPool::CreateInstance(this, &u.pAtomPool));
+                Publish(SectionTypeAtomPool);
+            }
+            else if (m_sectionType != SectionTypeAtomPool)
+            {
+                return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            }
         }
         *result = u.pAtomPool;
 
@@ -47,20 +65,22 @@ public:
     {
         *result = nullptr;
 
-        if (m_sectionType == SectionTypeUnknown)
+        if (!IsReady(SectionTypeDecisionInfo))
         {
-            // get default qualifier mapping for the file which contains the decision info
-            const RemapAtomPool* pMapping;
-            (void)pResolver->GetDefaultQualifierMapping(0, &pMapping);
-
-            RETURN_IF_FAILED(DecisionInfoFileSection::CreateInstance(this, pMapping, &u.pDecisionInfo));
+            AutoReaderWriterLock autoLock(&m_lock);
+            if (m_sectionType == SectionTypeUnknown)
+            {
+                // get default qualifier mapping for the file which contains the decision info
+                const RemapAtomPool* pMapping;
+                (void)pResolver->GetDefaultQualifierMapping(0, &pMapping);
 
-            m_sectionType = SectionTypeDecisionInfo;
-        }
-        else if (m_sectionType != SectionTypeDecisionInfo)
-        {
-            u.pDecisionInfo = nullptr;
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+                RETURN_IF_FAILED(DecisionInfoFileSection::CreateInstance(this, pMapping, &u.pDecisionInfo));
+                Publish(SectionTypeDecisionInfo);
+            }
+            else if (m_sectionType != SectionTypeDecisionInfo)
+            {
+                return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            }
         }
 
         *result = u.pDecisionInfo;
@@ -70,15 +90,18 @@ public:
     HRESULT GetSchemaSection(_Out_ HierarchicalSchema** result)
     {
         *result = nullptr;
-        if (m_sectionType == SectionTypeUnknown)
+        if (!IsReady(SectionTypeSchema))
         {
-            RETURN_IF_FAILED(HierarchicalSchema::CreateFromSection(this, &u.pSchema));
-            m_sectionType = SectionTypeSchema;
-        }
-        else if (m_sectionType != SectionTypeSchema)
-        {
-            u.pSchema = nullptr;
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            AutoReaderWriterLock autoLock(&m_lock);
+            if (m_sectionType == SectionTypeUnknown)
+            {
+                RETURN_IF_FAILED(HierarchicalSchema::CreateFromSection(this, &u.pSchema));
+                Publish(SectionTypeSchema);
+            }
+            else if (m_sectionType != SectionTypeSchema)
+            {
+                return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            }
         }
         *result = u.pSchema;
         return S_OK;
@@ -90,15 +113,18 @@ public:
         _Out_ ResourceMapBase** result)
     {
         *result = nullptr;
-        if (m_sectionType == SectionTypeUnknown)
-        {
-            RETURN_IF_FAILED(ResourceMapBase::CreateInstance(pResolver, pSchemaCollection, this, &u.pResourceMap));
-            m_sectionType = SectionTypeResourceMap;
-        }
-        else if (m_sectionType != SectionTypeResourceMap)
+        if (!IsReady(SectionTypeResourceMap))
         {
-            u.pResourceMap = nullptr;
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            AutoReaderWriterLock autoLock(&m_lock);
+            if (m_sectionType == SectionTypeUnknown)
+            {
+                RETURN_IF_FAILED(ResourceMapBase::CreateInstance(pResolver, pSchemaCollection, this, &u.pResourceMap));
+                Publish(SectionTypeResourceMap);
+            }
+            else if (m_sectionType != SectionTypeResourceMap)
+            {
+                return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            }
         }
         *result = u.pResourceMap;
         return S_OK;
@@ -110,15 +136,18 @@ public:
         _Out_ PriDescriptor** result)
     {
         *result = nullptr;
-        if (m_sectionType == SectionTypeUnknown)
+        if (!IsReady(SectionTypePriDescriptor))
         {
-            RETURN_IF_FAILED(PriDescriptor::CreateInstance(pResolver, pSchemaCollection, this, &u.pPriDescriptor));
-            m_sectionType = SectionTypePriDescriptor;
-        }
-        else if (m_sectionType != SectionTypePriDescriptor)
-        {
-            u.pPriDescriptor = nullptr;
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            AutoReaderWriterLock autoLock(&m_lock);
+            if (m_sectionType == SectionTypeUnknown)
+            {
+                RETURN_IF_FAILED(PriDescriptor::CreateInstance(pResolver, pSchemaCollection, this, &u.pPriDescriptor));
+                Publish(SectionTypePriDescriptor);
+            }
+            else if (m_sectionType != SectionTypePriDescriptor)
+            {
+                return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            }
         }
         *result = u.pPriDescriptor;
         return S_OK;
@@ -127,15 +156,18 @@ public:
     HRESULT GetFileListSection(_Out_ FileFileList** result)
     {
         *result = nullptr;
-        if (m_sectionType == SectionTypeUnknown)
-        {
-            RETURN_IF_FAILED(FileFileList::CreateInstance(this, &u.pFileList));
-            m_sectionType = SectionTypeFileList;
-        }
-        else if (m_sectionType != SectionTypeFileList)
+        if (!IsReady(SectionTypeFileList))
         {
-            u.pFileList = nullptr;
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            AutoReaderWriterLock autoLock(&m_lock);
+            if (m_sectionType == SectionTypeUnknown)
+            {
+                RETURN_IF_FAILED(FileFileList::CreateInstance(this, &u.pFileList));
+                Publish(SectionTypeFileList);
+            }
+            else if (m_sectionType != SectionTypeFileList)
+            {
+                return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            }
         }
         *result = u.pFileList;
         return S_OK;
@@ -144,15 +176,18 @@ public:
     HRESULT GetDataSection(_Out_ FileDataSection** result)
     {
         *result = nullptr;
-        if (m_sectionType == SectionTypeUnknown)
-        {
-            RETURN_IF_FAILED(FileDataSection::CreateInstance(this, &u.pData));
-            m_sectionType = SectionTypeData;
-        }
-        else if (m_sectionType != SectionTypeData)
+        if (!IsReady(SectionTypeData))
         {
-            u.pData = nullptr;
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            AutoReaderWriterLock autoLock(&m_lock);
+            if (m_sectionType == SectionTypeUnknown)
+            {
+                RETURN_IF_FAILED(FileDataSection::CreateInstance(this, &u.pData));
+                Publish(SectionTypeData);
+            }
+            else if (m_sectionType != SectionTypeData)
+            {
+                return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            }
         }
         *result = u.pData;
         return S_OK;
@@ -161,32 +196,41 @@ public:
     HRESULT GetDataItemsSection(_Out_ FileDataItemsSection** result)
     {
         *result = nullptr;
-        if (m_sectionType == SectionTypeUnknown)
+        if (!IsReady(SectionTypeDataItems))
         {
-            RETURN_IF_FAILED(FileDataItemsSection::CreateInstance(this, &u.pDataItems));
-            m_sectionType = SectionTypeDataItems;
-        }
-        else if (m_sectionType != SectionTypeDataItems)
-        {
-            u.pDataItems = nullptr;
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            AutoReaderWriterLock autoLock(&m_lock);
+            if (m_sectionType == SectionTypeUnknown)
+            {
+                RETURN_IF_FAILED(FileDataItemsSection::CreateInstance(this, &u.pDataItems));
+                Publish(SectionTypeDataItems);
+            }
+            else if (m_sectionType != SectionTypeDataItems)
+            {
+                return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            }
         }
         *result = u.pDataItems;
         return S_OK;
     }
 
+    // Returns the data items section if it has already been created.
+    FileDataItemsSection* TryGetDataItemsSection() const { return (IsReady(SectionTypeDataItems) ? u.pDataItems : nullptr); }
+
     HRESULT GetReverseFileMapSection(_Out_ ReverseFileMap** result)
     {
         *result = nullptr;
-        if (m_sectionType == SectionTypeUnknown)
+        if (!IsReady(SectionTypeReverseMap))
         {
-            RETURN_IF_FAILED(ReverseFileMap::CreateInstance(this, &u.pReverseMap));
-            m_sectionType = SectionTypeReverseMap;
-        }
-        else if (m_sectionType != SectionTypeReverseMap)
-        {
-            u.pReverseMap = nullptr;
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            AutoReaderWriterLock autoLock(&m_lock);
+            if (m_sectionType == SectionTypeUnknown)
+            {
+                RETURN_IF_FAILED(ReverseFileMap::CreateInstance(this, &u.pReverseMap));
+                Publish(SectionTypeReverseMap);
+            }
+            else if (m_sectionType != SectionTypeReverseMap)
+            {
+                return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            }
         }
         *result = u.pReverseMap;
         return S_OK;
@@ -198,17 +242,20 @@ public:
         _In_ const IEnvironmentCollection* environments,
         _Out_ const EnvironmentMapping** result)
     {
-        bool typeMatch = BaseFile::SectionTypesEqual(GetSectionType(), gEnvironmentMappingSectionType);
-
-        if ((m_sectionType == SectionTypeUnknown) && typeMatch)
-        {
-            RETURN_IF_FAILED(EnvironmentMapping::CreateInstance(profile, environments, GetData(), GetDataSize(), &u.pEnvironmentMap));
-            m_sectionType = SectionTypeEnvironmentMapping;
-        }
-        else if ((m_sectionType != SectionTypeEnvironmentMapping) || (!typeMatch))
+        if (!IsReady(SectionTypeEnvironmentMapping))
         {
-            u.pEnvironmentMap = nullptr;
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            bool typeMatch = BaseFile::SectionTypesEqual(GetSectionType(), gEnvironmentMappingSectionType);
+
+            AutoReaderWriterLock autoLock(&m_lock);
+            if ((m_sectionType == SectionTypeUnknown) && typeMatch)
+            {
+                RETURN_IF_FAILED(EnvironmentMapping::CreateInstance(profile, environments, GetData(), GetDataSize(), &u.pEnvironmentMap));
+                Publish(SectionTypeEnvironmentMapping);
+            }
+            else if ((m_sectionType != SectionTypeEnvironmentMapping) || (!typeMatch))
+            {
+                return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            }
         }
         *result = u.pEnvironmentMap;
         return S_OK;
@@ -220,25 +267,26 @@ public:
         _In_opt_ const ISchemaCollection* schemas,
         _Out_ const ResourceLinkSection** result)
     {
-        bool typeMatch = BaseFile::SectionTypesEqual(GetSectionType(), ResourceLinkSection::GetSectionTypeId());
-
-        if ((m_sectionType == SectionTypeUnknown) && typeMatch)
+        if (!IsReady(SectionTypeResourceLink))
         {
-            RETURN_IF_FAILED(ResourceLinkSection::CreateFromSection(sections, schemas, this, &u.pResourceLink));
-            m_sectionType = SectionTypeResourceLink;
-        }
-        else if ((m_sectionType != SectionTypeResourceLink) || (!typeMatch))
-        {
-            u.pEnvironmentMap = nullptr;
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            bool typeMatch = BaseFile::SectionTypesEqual(GetSectionType(), ResourceLinkSection::GetSectionTypeId());
+
+            AutoReaderWriterLock autoLock(&m_lock);
+            if ((m_sectionType == SectionTypeUnknown) && typeMatch)
+            {
+                RETURN_IF_FAILED(ResourceLinkSection::CreateFromSection(sections, schemas, this, &u.pResourceLink));
+                Publish(SectionTypeResourceLink);
+            }
+            else if ((m_sectionType != SectionTypeResourceLink) || (!typeMatch))
+            {
+                return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            }
         }
         *result = u.pResourceLink;
         return S_OK;
     }
 
 protected:
-    bool isInitialized;
-
     enum SectionType
     {
         SectionTypeUnknown = 0,
@@ -255,7 +303,13 @@ protected:
         SectionTypeResourceLink = 11
     };
 
+    // m_sectionType and the reader are only changed under m_lock.  m_readyType
+    // is set last, so a thread that reads it also sees the reader.
+    _DEF_SRWLOCK m_lock;
     SectionType m_sectionType;
+    volatile LONG m_readyType;
+    volatile LONG m_initialized;
+
     union
     {
         IFileSection* pOther;
@@ -315,6 +369,15 @@ protected:
             u.pOther = nullptr;
         }
         m_sectionType = SectionTypeUnknown;
+        m_readyType = SectionTypeUnknown;
+    }
+
+    bool IsReady(_In_ SectionType type) const { return (_DefReadAcquire(&m_readyType) == type); }
+
+    void Publish(_In_ SectionType type)
+    {
+        m_sectionType = type;
+        _DefWriteRelease(&m_readyType, type);
     }
 };
 
@@ -479,6 +542,16 @@ HRESULT MrmFile::Init(_In_ PriFileManager* pManager, _In_ PCWSTR pPath)
 
     m_pMyBaseFile = m_pBaseFile;
 
+    // Nearly every lookup goes through the names, schema and atom pools, so
+    // ask for those up front rather than faulting them in a page at a time.
+    static const DEFFILE_SECTION_TYPEID hotSectionTypes[] = {gAtomPoolSectionType,
+                                                             gSequentialAtomPoolSectionType,
+                                                             gHierarchicalNamesSectionType,
+                                                             gHierarchicalNamesExSectionType,
+                                                             gHierarchicalSchemaSectionType,
+                                                             gHierarchicalSchemaExSectionType};
+    (void)m_pBaseFile->PrefetchSections(hotSectionTypes, ARRAYSIZE(hotSectionTypes));
+
     RETURN_IF_FAILED(InitSections());
     RETURN_IF_FAILED(MrmFileResolver::CreateInstance(m_pPriFileManager, &m_pFileResolver));
 
@@ -505,7 +578,7 @@ MrmFile::Init(_In_ UnifiedEnvironment* pEnvironment, _In_ UINT32 flags, _In_read
     RETURN_IF_FAILED(BaseFile::CreateInstance(flags, pData, cbData, (BaseFile**)&m_pBaseFile));
 
     m_pMyBaseFile = m_pBaseFile;
-    (void)InitSections();
+    RETURN_IF_FAILED(InitSections());
 
     return S_OK;
 }
@@ -525,23 +598,71 @@ HRESULT MrmFile::InitSections()
         return S_OK;
     }
 
-    m_pSections = new MrmFileSection[m_pBaseFile->GetNumSections()];
-    if (m_pSections == nullptr)
+    int numSections = m_pBaseFile->GetNumSections();
+    m_pSections = new MrmFileSection[numSections];
+    m_pSectionTypes = _DefArray_AllocZeroed(SectionTypeEntry, numSections);
+    m_pNextSectionOfType = _DefArray_AllocZeroed(int, numSections);
+    if ((m_pSections == nullptr) || (m_pSectionTypes == nullptr) || (m_pNextSectionOfType == nullptr))
     {
         ReleaseSections();
         return E_OUTOFMEMORY;
     }
 
+    // Index the TOC by type: one entry per distinct type with its first
+    // section, and each section linked to the next one of the same type.
+    // Walk backwards so each new section lands at the head of its list.
+    m_numSectionTypes = 0;
+    for (int i = numSections - 1; i >= 0; i--)
+    {
+        m_pNextSectionOfType[i] = -1;
+
+        const DEFFILE_TOC_ENTRY* toc = nullptr;
+        (void)m_pBaseFile->GetTocEntry(i, &toc);
+        if (toc == nullptr)
+        {
+            continue;
+        }
+
+        SectionTypeEntry* pEntry = FindSectionType(toc->type);
+        if (pEntry == nullptr)
+        {
+            pEntry = &m_pSectionTypes[m_numSectionTypes++];
+            pEntry->type = toc->type;
+            pEntry->firstSection = -1;
+        }
+        m_pNextSectionOfType[i] = pEntry->firstSection;
+        pEntry->firstSection = i;
+    }
+
     // We do not initialize the various sections here. Rather, we initialize them on demand
     // when they are actually used to avoid excessive I/O on initialization.
     return S_OK;
 }
 
+MrmFile::SectionTypeEntry* MrmFile::FindSectionType(_In_ const DEFFILE_SECTION_TYPEID& sectionType) const
+{
+    for (int i = 0; i < m_numSectionTypes; i++)
+    {
+        if (BaseFile::SectionTypesEqual(sectionType, m_pSectionTypes[i].type))
+        {
+            return &m_pSectionTypes[i];
+        }
+    }
+    return nullptr;
+}
+
 void MrmFile::ReleaseSections()
 {
     delete[] m_pSections;
     m_pSections = nullptr;
 
+    Def_Free(m_pSectionTypes);
+    m_pSectionTypes = nullptr;
+    m_numSectionTypes = 0;
+
+    Def_Free(m_pNextSectionOfType);
+    m_pNextSectionOfType = nullptr;
+
     delete m_pMyBaseFile;
     m_pMyBaseFile = nullptr;
     m_pBaseFile = nullptr;
@@ -556,10 +677,7 @@ HRESULT MrmFile::InitializeAndGetSection(_In_ BaseFile::SectionIndex sectionInde
         return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
     }
 
-    if (!m_pSections[sectionIndex].IsInitialized())
-    {
-        RETURN_IF_FAILED(m_pSections[sectionIndex].Init(m_pBaseFile, sectionIndex));
-    }
+    RETURN_IF_FAILED(m_pSections[sectionIndex].EnsureInitialized(m_pBaseFile, sectionIndex));
 
     *result = &m_pSections[sectionIndex];
     return S_OK;
@@ -574,11 +692,6 @@ HRESULT MrmFile::GetSection(
     *result = nullptr;
     RETURN_HR_IF(E_DEF_NOT_READY, fileIndex != 0);
 
-    if ((sectionIndex < 0) || (sectionIndex >= m_pBaseFile->GetNumSections()))
-    {
-        return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
-    }
-
     RETURN_IF_FAILED(InitializeAndGetSection(sectionIndex, (MrmFileSection**)result));
     return S_OK;
 }
@@ -596,20 +709,16 @@ const bool MrmFile::TryGetSectionIndexByType(
             return false;
         }
 
-        for (int i = startAtSectionIndex; i < m_pBaseFile->GetNumSections(); i++)
+        const SectionTypeEntry* pEntry = FindSectionType(sectionType);
+        int i = ((pEntry != nullptr) ? pEntry->firstSection : -1);
+        while ((i >= 0) && (i < startAtSectionIndex))
         {
-            const DEFFILE_TOC_ENTRY* toc;
-            m_pBaseFile->GetTocEntry(i, &toc);
-            if ((toc != nullptr) && BaseFile::SectionTypesEqual(sectionType, toc->type))
-            {
-                *nextSectionIndex = i;
-                return true;
-            }
+            i = m_pNextSectionOfType[i];
         }
 
-        *nextSectionIndex = -1;
+        *nextSectionIndex = i;
 
-        return false;
+        return (i >= 0);
     }
 
     if (m_pPriFileManager != nullptr)
@@ -632,11 +741,6 @@ HRESULT MrmFile::GetAtomPoolSection(_In_ int fileIndex, _In_ BaseFile::SectionIn
 
     if (fileIndex == 0)
     {
-        if ((sectionIndex < 0) || (sectionIndex >= m_pBaseFile->GetNumSections()))
-        {
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
-        }
-
         MrmFileSection* pSection;
         RETURN_IF_FAILED(InitializeAndGetSection(sectionIndex, &pSection));
 
@@ -667,11 +771,6 @@ MrmFile::GetDecisionInfoSection(_In_ int fileIndex, _In_ BaseFile::SectionIndex
 
     if (fileIndex == 0)
     {
-        if ((sectionIndex < 0) || (sectionIndex >= m_pBaseFile->GetNumSections()))
-        {
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
-        }
-
         MrmFileSection* pSection;
         RETURN_IF_FAILED(InitializeAndGetSection(sectionIndex, &pSection));
 
@@ -701,11 +800,6 @@ HRESULT MrmFile::GetSchemaSection(_In_ int fileIndex, _In_ BaseFile::SectionInde
 
     if (fileIndex == 0)
     {
-        if ((sectionIndex < 0) || (sectionIndex >= m_pBaseFile->GetNumSections()))
-        {
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
-        }
-
         MrmFileSection* pSection;
         RETURN_IF_FAILED(InitializeAndGetSection(sectionIndex, &pSection));
 
@@ -744,11 +838,6 @@ HRESULT MrmFile::GetResourceMapSection(
 
     if (fileIndex == 0)
     {
-        if ((sectionIndex < 0) || (sectionIndex >= m_pBaseFile->GetNumSections()))
-        {
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
-        }
-
         MrmFileSection* pSection;
         RETURN_IF_FAILED(InitializeAndGetSection(sectionIndex, &pSection));
 
@@ -782,11 +871,6 @@ HRESULT MrmFile::GetPriDescriptorSection(
 
     if (fileIndex == 0)
     {
-        if ((sectionIndex < 0) || (sectionIndex >= m_pBaseFile->GetNumSections()))
-        {
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
-        }
-
         MrmFileSection* pSection;
         RETURN_IF_FAILED(InitializeAndGetSection(sectionIndex, &pSection));
 
@@ -816,11 +900,6 @@ HRESULT MrmFile::GetFileListSection(_In_ int fileIndex, _In_ BaseFile::SectionIn
 
     if (fileIndex == 0)
     {
-        if ((sectionIndex < 0) || (sectionIndex >= m_pBaseFile->GetNumSections()))
-        {
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
-        }
-
         MrmFileSection* pSection;
         RETURN_IF_FAILED(InitializeAndGetSection(sectionIndex, &pSection));
 
@@ -851,16 +930,16 @@ MrmFile::GetDataItemsSection(_In_ int fileIndex, _In_ BaseFile::SectionIndex sec
 
     if (fileIndex == 0)
     {
-        if ((sectionIndex < 0) || (sectionIndex >= m_pBaseFile->GetNumSections()))
-        {
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
-        }
-
         MrmFileSection* pSection;
         RETURN_IF_FAILED(InitializeAndGetSection(sectionIndex, &pSection));
 
         RETURN_IF_FAILED(pSection->GetDataItemsSection(result));
 
+        if ((m_pPriFileManager != nullptr) && (m_pPriFileManager->GetDecodedStringCacheBudget() > 0))
+        {
+            RETURN_IF_FAILED((*result)->EnableDecodedStringCache(m_pPriFileManager->GetDecodedStringCacheBudget()));
+        }
+
         return S_OK;
     }
 
@@ -879,17 +958,28 @@ MrmFile::GetDataItemsSection(_In_ int fileIndex, _In_ BaseFile::SectionIndex sec
     return S_OK;
 }
 
-HRESULT MrmFile::GetDataSection(_In_ int fileIndex, _In_ BaseFile::SectionIndex sectionIndex, _Out_ FileDataSection** result) const
+HRESULT MrmFile::EnableDecodedStringCaches(_In_ UINT32 cbBudget) const
 {
-    *result = nullptr;
+    RETURN_HR_IF(E_INVALIDARG, cbBudget == 0);
 
-    if (fileIndex == 0)
+    for (int i = 0; i < m_pBaseFile->GetNumSections(); i++)
     {
-        if ((sectionIndex < 0) || (sectionIndex >= m_pBaseFile->GetNumSections()))
+        FileDataItemsSection* pDataItems = m_pSections[i].TryGetDataItemsSection();
+        if (pDataItems != nullptr)
         {
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            RETURN_IF_FAILED(pDataItems->EnableDecodedStringCache(cbBudget));
         }
+    }
+
+    return S_OK;
+}
 
+HRESULT MrmFile::GetDataSection(_In_ int fileIndex, _In_ BaseFile::SectionIndex sectionIndex, _Out_ FileDataSection** result) const
+{
+    *result = nullptr;
+
+    if (fileIndex == 0)
+    {
         MrmFileSection* pSection;
         RETURN_IF_FAILED(InitializeAndGetSection(sectionIndex, &pSection));
 
@@ -919,11 +1009,6 @@ HRESULT MrmFile::GetReverseFileMapSection(_In_ int fileIndex, _In_ BaseFile::Sec
 
     if (fileIndex == 0)
     {
-        if ((sectionIndex < 0) || (sectionIndex >= m_pBaseFile->GetNumSections()))
-        {
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
-        }
-
         MrmFileSection* pSection;
         RETURN_IF_FAILED(InitializeAndGetSection(sectionIndex, &pSection));
 
@@ -956,11 +1041,6 @@ HRESULT MrmFile::GetEnvironmentMappingSection(
 
     if (fileIndex == 0)
     {
-        if ((sectionIndex < 0) || (sectionIndex >= m_pBaseFile->GetNumSections()))
-        {
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
-        }
-
         MrmFileSection* pSection;
         RETURN_IF_FAILED(InitializeAndGetSection(sectionIndex, &pSection));
 
@@ -994,11 +1074,6 @@ HRESULT MrmFile::GetResourceLinkSection(
 
     if (fileIndex == 0)
     {
-        if ((sectionIndex < 0) || (sectionIndex >= m_pBaseFile->GetNumSections()))
-        {
-            return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
-        }
-
         MrmFileSection* pSection;
         RETURN_IF_FAILED(InitializeAndGetSection(sectionIndex, &pSection));
 
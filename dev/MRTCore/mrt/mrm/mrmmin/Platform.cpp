@@ -679,6 +679,66 @@ extern "C"
         return S_OK;
     }
 
+    HRESULT
+    _DefGetFileIdentity(__in HANDLE hFile, __out PDEF_FILE_IDENTITY pIdentity)
+    {
+        NTSTATUS Status;
+        IO_STATUS_BLOCK IoStatusBlock;
+        FILE_BASIC_INFORMATION BasicInfo;
+        FILE_STANDARD_INFORMATION StandardInfo;
+        FILE_INTERNAL_INFORMATION InternalInfo;
+        union
+        {
+            FILE_FS_VOLUME_INFORMATION Info;
+            BYTE Buffer[sizeof(FILE_FS_VOLUME_INFORMATION) + (MAX_PATH * sizeof(WCHAR))];
+        } VolumeInfo;
+
+        if (pIdentity == nullptr)
+        {
+            return E_INVALIDARG;
+        }
+
+        Status = NtQueryInformationFile(hFile, &IoStatusBlock, &BasicInfo, sizeof(BasicInfo), FileBasicInformation);
+        if (NT_SUCCESS(Status))
+        {
+            Status = NtQueryInformationFile(hFile, &IoStatusBlock, &StandardInfo, sizeof(StandardInfo), FileStandardInformation);
+        }
+        if (NT_SUCCESS(Status))
+        {
+            Status = NtQueryInformationFile(hFile, &IoStatusBlock, &InternalInfo, sizeof(InternalInfo), FileInternalInformation);
+        }
+        if (NT_SUCCESS(Status))
+        {
+            // Only the serial number matters, so a truncated label is fine
+            Status = NtQueryVolumeInformationFile(hFile, &IoStatusBlock, &VolumeInfo, sizeof(VolumeInfo), FileFsVolumeInformation);
+            if (Status == STATUS_BUFFER_OVERFLOW)
+            {
+                Status = STATUS_SUCCESS;
+            }
+        }
+
+        if (!NT_SUCCESS(Status))
+        {
+            return HRESULT_FROM_NT(Status);
+        }
+
+        pIdentity->VolumeId = VolumeInfo.Info.VolumeSerialNumber;
+        pIdentity->FileId = (ULONGLONG)InternalInfo.IndexNumber.QuadPart;
+        pIdentity->FileSize = (ULONGLONG)StandardInfo.EndOfFile.QuadPart;
+        pIdentity->LastWriteTime = (ULONGLONG)BasicInfo.LastWriteTime.QuadPart;
+        pIdentity->ChangeTime = (ULONGLONG)BasicInfo.ChangeTime.QuadPart;
+
+        return S_OK;
+    }
+
+    ULONGLONG
+    _DefGetSystemTime()
+    {
+        LARGE_INTEGER SystemTime;
+        NtQuerySystemTime(&SystemTime);
+        return (ULONGLONG)SystemTime.QuadPart;
+    }
+
     DEFRESULT
     _DefGetLastError()
     {
@@ -893,6 +953,28 @@ extern "C"
         return TRUE;
     }
 
+    HRESULT
+    _DefPrefetchVirtualMemory(__in_ecount(NumberOfRanges) PDEF_MEMORY_RANGE pRanges, __in ULONG NumberOfRanges)
+    {
+        ULONG Flags = 0;
+
+        if ((pRanges == nullptr) && (NumberOfRanges > 0))
+        {
+            return E_INVALIDARG;
+        }
+
+        if (NumberOfRanges > 0)
+        {
+            C_ASSERT(sizeof(DEF_MEMORY_RANGE) == sizeof(MEMORY_RANGE_ENTRY));
+
+            // Prefetching is advisory, so ignore failures.
+            (void)NtSetInformationVirtualMemory(
+                NtCurrentProcess(), VmPrefetchInformation, NumberOfRanges, (PMEMORY_RANGE_ENTRY)pRanges, &Flags, sizeof(Flags));
+        }
+
+        return S_OK;
+    }
+
     UINT _DefGetDriveTypeW(_In_opt_ PCWSTR rootPathName)
     {
         UNREFERENCED_PARAMETER(rootPathName);
@@ -948,6 +1030,14 @@ extern "C"
 
 #else // !DEF_RTL
 
+#if defined(_M_X64)
+#include <intrin.h>
+#define DEF_CRC32_CLMUL
+#elif defined(_M_ARM64)
+#include <intrin.h>
+#define DEF_CRC32_ARM64
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -1025,6 +1115,39 @@ extern "C"
         return S_OK;
     }
 
+    HRESULT
+    _DefGetFileIdentity(__in HANDLE hFile, __out PDEF_FILE_IDENTITY pIdentity)
+    {
+        if (pIdentity == nullptr)
+        {
+            return E_INVALIDARG;
+        }
+
+        BY_HANDLE_FILE_INFORMATION fileInfo;
+        FILE_BASIC_INFO basicInfo;
+        if (!GetFileInformationByHandle(hFile, &fileInfo) ||
+            !GetFileInformationByHandleEx(hFile, FileBasicInfo, &basicInfo, sizeof(basicInfo)))
+        {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+
+        pIdentity->VolumeId = fileInfo.dwVolumeSerialNumber;
+        pIdentity->FileId = (((ULONGLONG)fileInfo.nFileIndexHigh) << 32) | fileInfo.nFileIndexLow;
+        pIdentity->FileSize = (((ULONGLONG)fileInfo.nFileSizeHigh) << 32) | fileInfo.nFileSizeLow;
+        pIdentity->LastWriteTime = (((ULONGLONG)fileInfo.ftLastWriteTime.dwHighDateTime) << 32) | fileInfo.ftLastWriteTime.dwLowDateTime;
+        pIdentity->ChangeTime = (ULONGLONG)basicInfo.ChangeTime.QuadPart;
+
+        return S_OK;
+    }
+
+    ULONGLONG
+    _DefGetSystemTime()
+    {
+        FILETIME now;
+        GetSystemTimeAsFileTime(&now);
+        return (((ULONGLONG)now.dwHighDateTime) << 32) | now.dwLowDateTime;
+    }
+
     DEFRESULT
     _DefGetLastError()
     {
@@ -1094,6 +1217,48 @@ extern "C"
     BOOLEAN
     _DefUnmapViewOfFile(__in PVOID pBaseAddress) { return (BOOLEAN)UnmapViewOfFile(pBaseAddress); }
 
+    // PrefetchVirtualMemory is only exported by Windows 8 and later, and we
+    // build for older targets, so look it up at runtime.  DEF_MEMORY_RANGE has
+    // the same layout as WIN32_MEMORY_RANGE_ENTRY.
+    typedef BOOL(WINAPI* PrefetchVirtualMemoryFunc)(HANDLE, ULONG_PTR, PDEF_MEMORY_RANGE, ULONG);
+    static PrefetchVirtualMemoryFunc g_prefetchVirtualMemory = reinterpret_cast<PrefetchVirtualMemoryFunc>(-1);
+
+    static PrefetchVirtualMemoryFunc GetPrefetchVirtualMemoryFunc()
+    {
+        PVOID comparand = reinterpret_cast<PVOID>(-1);
+        PVOID func = InterlockedCompareExchangePointer(reinterpret_cast<PVOID*>(&g_prefetchVirtualMemory), comparand, comparand);
+        if (func == comparand)
+        {
+            // kernel32 is always loaded, so there's no module reference to keep.
+            HMODULE module = GetModuleHandleW(L"kernel32.dll");
+            func = (module != nullptr) ? reinterpret_cast<PVOID>(GetProcAddress(module, "PrefetchVirtualMemory")) : nullptr;
+            InterlockedExchangePointer(reinterpret_cast<PVOID*>(&g_prefetchVirtualMemory), func);
+        }
+
+        return reinterpret_cast<PrefetchVirtualMemoryFunc>(func);
+    }
+
+    HRESULT
+    _DefPrefetchVirtualMemory(__in_ecount(NumberOfRanges) PDEF_MEMORY_RANGE pRanges, __in ULONG NumberOfRanges)
+    {
+        if ((pRanges == nullptr) && (NumberOfRanges > 0))
+        {
+            return E_INVALIDARG;
+        }
+
+        if (NumberOfRanges > 0)
+        {
+            PrefetchVirtualMemoryFunc func = GetPrefetchVirtualMemoryFunc();
+            if (func != nullptr)
+            {
+                // Prefetching is advisory, so ignore failures.
+                (void)func(GetCurrentProcess(), NumberOfRanges, pRanges, 0);
+            }
+        }
+
+        return S_OK;
+    }
+
     ULONG
     _DefVirtualQuery(__in_opt PVOID Address, __out_bcount(Length) PMEMORY_BASIC_INFORMATION Buffer, __in ULONG Length)
     {
@@ -1175,6 +1340,209 @@ extern "C"
         0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37,
         0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d};
 
+    // Slicing-by-8 tables.  Table k holds the CRC of each byte value followed
+    // by k zero bytes, so eight bytes of input are folded in with independent
+    // lookups instead of a chain of eight.  Table 0 matches gCrc32Table.
+    typedef struct _DEF_CRC32_SLICE_TABLES
+    {
+        UINT32 table[8][256];
+    } DEF_CRC32_SLICE_TABLES;
+
+    static constexpr DEF_CRC32_SLICE_TABLES _DefBuildCrc32SliceTables()
+    {
+        DEF_CRC32_SLICE_TABLES tables = {};
+
+        for (UINT32 i = 0; i < 256; i++)
+        {
+            UINT32 val = i;
+            for (int k = 0; k < 8; k++)
+            {
+                val = ((val & 1) ? (0xedb88320 ^ (val >> 1)) : (val >> 1));
+            }
+            tables.table[0][i] = val;
+        }
+
+        for (int k = 1; k < 8; k++)
+        {
+            for (UINT32 i = 0; i < 256; i++)
+            {
+                UINT32 prev = tables.table[k - 1][i];
+                tables.table[k][i] = (prev >> 8) ^ tables.table[0][prev & 0xff];
+            }
+        }
+
+        return tables;
+    }
+
+    static constexpr DEF_CRC32_SLICE_TABLES gCrc32SliceTables = _DefBuildCrc32SliceTables();
+
+    // Takes and returns the running (pre-conditioned) CRC.  Assumes a
+    // little-endian machine, like every platform this layer supports.
+    static UINT32 _DefCrc32Slice8(UINT32 crc, __in_bcount(cbBuf) const BYTE* pBuf, size_t cbBuf)
+    {
+        const UINT32(*t)[256] = gCrc32SliceTables.table;
+
+        while (cbBuf >= 8)
+        {
+            UINT32 lo;
+            UINT32 hi;
+            memcpy(&lo, pBuf, sizeof(lo));
+            memcpy(&hi, pBuf + 4, sizeof(hi));
+            lo ^= crc;
+
+            crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^ t[3][hi & 0xff] ^
+                  t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+
+            pBuf += 8;
+            cbBuf -= 8;
+        }
+
+        while (cbBuf > 0)
+        {
+            crc = t[0][(crc ^ *pBuf) & 0xff] ^ (crc >> 8);
+            pBuf++;
+            cbBuf--;
+        }
+
+        return crc;
+    }
+
+#if defined(DEF_CRC32_CLMUL)
+
+    // Shortest buffer worth setting up the carry-less multiply path for.
+#define DEF_CRC32_CLMUL_MIN_SIZE 64
+
+    static BOOLEAN _DefCrc32HasClmul()
+    {
+        // PCLMULQDQ and SSE4.1 (for the final extract).
+        int info[4];
+        __cpuid(info, 1);
+        return (((info[2] & (1 << 1)) != 0) && ((info[2] & (1 << 19)) != 0));
+    }
+
+    // Folds the buffer 64 bytes at a time with carry-less multiplies, then
+    // Barrett-reduces to 32 bits, following Intel's "Fast CRC Computation for
+    // Generic Polynomials Using PCLMULQDQ Instruction".  cbBuf must be at
+    // least 64 and a multiple of 16.
+    static UINT32 _DefCrc32Clmul(UINT32 crc, __in_bcount(cbBuf) const BYTE* pBuf, size_t cbBuf)
+    {
+        const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+        const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+        const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+        const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+        const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+        __m128i x1 = _mm_loadu_si128((const __m128i*)(pBuf + 0x00));
+        __m128i x2 = _mm_loadu_si128((const __m128i*)(pBuf + 0x10));
+        __m128i x3 = _mm_loadu_si128((const __m128i*)(pBuf + 0x20));
+        __m128i x4 = _mm_loadu_si128((const __m128i*)(pBuf + 0x30));
+        x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+        pBuf += 64;
+        cbBuf -= 64;
+
+        // Fold four 128-bit lanes in parallel.
+        while (cbBuf >= 64)
+        {
+            __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+            __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+            __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+            __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+            x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+            x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+            x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+            x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+            x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(pBuf + 0x00)));
+            x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(pBuf + 0x10)));
+            x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(pBuf + 0x20)));
+            x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(pBuf + 0x30)));
+            pBuf += 64;
+            cbBuf -= 64;
+        }
+
+        // Fold the four lanes into one.
+        __m128i x0 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x0);
+        x0 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x0);
+        x0 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x0);
+
+        // Fold in any remaining 16-byte blocks.
+        while (cbBuf >= 16)
+        {
+            x0 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+            x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_loadu_si128((const __m128i*)pBuf)), x0);
+            pBuf += 16;
+            cbBuf -= 16;
+        }
+
+        // Fold 128 bits down to 64.
+        x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+        x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+        x2 = _mm_srli_si128(x1, 4);
+        x1 = _mm_and_si128(x1, mask32);
+        x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k5k0, 0x00), x2);
+
+        // Barrett-reduce to 32 bits.
+        x2 = _mm_and_si128(x1, mask32);
+        x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+        x2 = _mm_and_si128(x2, mask32);
+        x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+
+        return (UINT32)_mm_extract_epi32(x1, 1);
+    }
+
+#elif defined(DEF_CRC32_ARM64)
+
+    // The ARMv8 CRC32 instructions use the same (reflected) polynomial.
+    static UINT32 _DefCrc32Arm64(UINT32 crc, __in_bcount(cbBuf) const BYTE* pBuf, size_t cbBuf)
+    {
+        while (cbBuf >= 8)
+        {
+            UINT64 val;
+            memcpy(&val, pBuf, sizeof(val));
+            crc = __crc32d(crc, val);
+            pBuf += 8;
+            cbBuf -= 8;
+        }
+
+        while (cbBuf > 0)
+        {
+            crc = __crc32b(crc, *pBuf);
+            pBuf++;
+            cbBuf--;
+        }
+
+        return crc;
+    }
+
+#endif
+
+    // Takes and returns the running (pre-conditioned) CRC, using the fastest
+    // implementation the processor supports.
+    static UINT32 _DefCrc32Update(UINT32 crc, __in_bcount(cbBuf) const BYTE* pBuf, size_t cbBuf)
+    {
+#if defined(DEF_CRC32_CLMUL)
+        static const BOOLEAN hasClmul = _DefCrc32HasClmul();
+        if (hasClmul && (cbBuf >= DEF_CRC32_CLMUL_MIN_SIZE))
+        {
+            size_t cbFolded = (cbBuf & ~((size_t)15));
+            crc = _DefCrc32Clmul(crc, pBuf, cbFolded);
+            pBuf += cbFolded;
+            cbBuf -= cbFolded;
+        }
+#elif defined(DEF_CRC32_ARM64)
+        static const BOOLEAN hasCrc32 = (BOOLEAN)IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE);
+        if (hasCrc32)
+        {
+            return _DefCrc32Arm64(crc, pBuf, cbBuf);
+        }
+#endif
+
+        return _DefCrc32Slice8(crc, pBuf, cbBuf);
+    }
+
     /*
  * Compute the CRC32 as specified in in IS0 3309. See RFC-1662 and RFC-1952
  * for implementation details and references.
@@ -1205,7 +1573,6 @@ extern "C"
     _DefComputeCrc32(__in UINT32 partialCrc, __in_bcount(cbBuf) const BYTE* pBuf, __in UINT32 cbBuf)
     {
         UINT32 crc;
-        UINT32 i;
 
         //
         // Compute the CRC32 checksum.
@@ -1213,10 +1580,7 @@ extern "C"
 
         crc = partialCrc ^ 0xffffffffL;
 
-        for (i = 0; i < cbBuf; i++)
-        {
-            crc = gCrc32Table[(crc ^ pBuf[i]) & 0xff] ^ (crc >> 8);
-        }
+        crc = _DefCrc32Update(crc, pBuf, cbBuf);
 
         return (crc ^ 0xffffffffL);
     }
@@ -1229,11 +1593,25 @@ extern "C"
 
         crc = partialCrc ^ 0xffffffffL;
 
-        for (i = 0; i < cchStr; i++)
+        // Each character is hashed as its two little-endian bytes, which is
+        // just the CRC of the (case-folded) string buffer.
+        static_assert(sizeof(WCHAR) == 2, "string checksums hash each character as two bytes");
+        WCHAR folded[128];
+        for (i = 0; i < cchStr;)
         {
-            WCHAR ch = (isCaseInsensitive ? towlower(pStr[i]) : pStr[i]);
-            crc = gCrc32Table[(crc ^ (ch & 0xff)) & 0xff] ^ (crc >> 8);
-            crc = gCrc32Table[(crc ^ ((ch >> 8) & 0xff)) & 0xff] ^ (crc >> 8);
+            UINT32 cchChunk = (((cchStr - i) < ARRAYSIZE(folded)) ? (cchStr - i) : ARRAYSIZE(folded));
+            const WCHAR* pChunk = &pStr[i];
+            if (isCaseInsensitive)
+            {
+                for (UINT32 j = 0; j < cchChunk; j++)
+                {
+                    folded[j] = towlower(pStr[i + j]);
+                }
+                pChunk = folded;
+            }
+
+            crc = _DefCrc32Update(crc, (const BYTE*)pChunk, cchChunk * sizeof(WCHAR));
+            i += cchChunk;
         }
 
         return (crc ^ 0xffffffffL);
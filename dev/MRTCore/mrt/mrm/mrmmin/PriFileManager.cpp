@@ -35,19 +35,85 @@ HRESULT PriFileManager::GetFile(_In_ const NormalizedFilePath* pNormalizedPath,
 {
     *result = nullptr;
 
-    ManagedFile* pRtrn = nullptr;
-    // See if we already have the file
+    if (TryFindFile(pNormalizedPath->GetRef(), result))
+    {
+        return S_OK;
+    }
+
+    return E_INVALIDARG;
+}
+
+bool PriFileManager::TryFindFile(_In_ PCWSTR pNormalizedPath, _Out_ ManagedFile** result) const
+{
+    *result = nullptr;
+
+    // Several entries can share a hash, so keep the first file that matches.
+    UINT32 hash = CaseInsensitiveStringIndex::ComputeHash(pNormalizedPath);
+    UINT cursor = 0;
+    int index;
+    int foundIndex = -1;
+    while (m_pFilesByPath->TryGetNext(hash, &cursor, &index))
+    {
+        FileManagerFileInfo finfo;
+        if (((foundIndex < 0) || (index < foundIndex)) && m_pFiles->TryGet(index, &finfo) && (finfo.pFile != nullptr) &&
+            (DefString_ICompare(pNormalizedPath, finfo.pFile->GetPath()) == Def_Equal))
+        {
+            foundIndex = index;
+            *result = finfo.pFile;
+        }
+    }
+
+    return (foundIndex >= 0);
+}
+
+HRESULT PriFileManager::AddFileInfo(_In_ ManagedFile* pFile, _Out_ int* pIndexOut) const
+{
+    *pIndexOut = -1;
+
+    FileManagerFileInfo finfo;
+    finfo.pFile = pFile;
+
+    AutoReaderWriterLock autoLock(&m_loadLock);
+
+    int index;
+    RETURN_IF_FAILED(m_pFiles->Add(finfo, &index));
+
+    // Index only files that made it into the list, and don't keep a file
+    // that lookups won't find.
+    HRESULT hr = m_pFilesByPath->Add(CaseInsensitiveStringIndex::ComputeHash(pFile->GetPath()), index);
+    if (FAILED(hr))
+    {
+        (void)m_pFiles->Delete(index);
+        return hr;
+    }
+
+    pFile->SetGlobalIndex(index);
+
+    // The new file was loaded before it had an index, so this is the first
+    // chance to count it and bring the manager back within its budget.
+    if (pFile->IsLoaded())
+    {
+        NoteFileLoaded(pFile, false, 0);
+    }
+
+    *pIndexOut = index;
+    return S_OK;
+}
+
+HRESULT PriFileManager::RebuildFileIndex() const
+{
+    m_pFilesByPath->Reset();
+
+    FileManagerFileInfo finfo;
     for (int i = 0; i < m_pFiles->Count(); i++)
     {
-        GetFile(i, &pRtrn);
-        if ((pRtrn != nullptr) && (DefString_ICompare(pNormalizedPath->GetRef(), pRtrn->GetPath()) == Def_Equal))
+        if (m_pFiles->TryGet(i, &finfo) && (finfo.pFile != nullptr))
         {
-            *result = pRtrn;
-            return S_OK;
+            RETURN_IF_FAILED(m_pFilesByPath->Add(CaseInsensitiveStringIndex::ComputeHash(finfo.pFile->GetPath()), i));
         }
     }
 
-    return E_INVALIDARG;
+    return S_OK;
 }
 
 HRESULT PriFileManager::GetFile(_In_ PCWSTR pFilePath, _Out_ ManagedFile** result) const
@@ -67,59 +133,65 @@ HRESULT PriFileManager::GetOrAddFile(
     _In_opt_ PCWSTR pPackageRoot,
     _In_ LoadPriFlags flags,
     _Out_ ManagedFile** result) const
+{
+    return GetOrAddFile(pNormalizedPath, pPackageRoot, flags, nullptr, result);
+}
+
+HRESULT PriFileManager::GetOrAddFile(
+    _In_ const NormalizedFilePath* pNormalizedPath,
+    _In_opt_ PCWSTR pPackageRoot,
+    _In_ LoadPriFlags flags,
+    _Inout_opt_ ManagedFile** ppPreloadedFile,
+    _Out_ ManagedFile** result) const
 {
     *result = nullptr;
 
     RETURN_HR_IF_NULL(E_INVALIDARG, pNormalizedPath);
     RETURN_HR_IF(E_INVALIDARG, DefString_IsEmpty(pNormalizedPath->GetRef()));
 
-    FileManagerFileInfo finfo;
     StringResult rootPath;
     ManagedFile* pRtrn = nullptr;
 
     RETURN_IF_FAILED(ManagedFile::NormalizePackageRoot(pNormalizedPath->GetRef(), pPackageRoot, &rootPath));
 
     // See if we already have the file
-    for (int i = 0; i < m_pFiles->Count(); i++)
+    if (TryFindFile(pNormalizedPath->GetRef(), &pRtrn))
     {
-        if (m_pFiles->TryGet(i, &finfo))
-        {
-            pRtrn = finfo.pFile;
-        }
-        else
-        {
-            pRtrn = nullptr;
-        }
-        if ((pRtrn != nullptr) && (DefString_ICompare(pNormalizedPath->GetRef(), pRtrn->GetPath()) == Def_Equal))
-        {
-            RETURN_IF_FAILED(pRtrn->SetPackageRoot(rootPath.GetRef()));
+        RETURN_IF_FAILED(pRtrn->SetPackageRoot(rootPath.GetRef()));
 
-            if ((flags & LoadPriFlags::Preload) == LoadPriFlags::Preload)
-            {
-                RETURN_IF_FAILED(pRtrn->Load());
-            }
-            *result = pRtrn;
-            return S_OK;
+        if ((flags & LoadPriFlags::Preload) == LoadPriFlags::Preload)
+        {
+            RETURN_IF_FAILED(pRtrn->Load());
         }
+        *result = pRtrn;
+        return S_OK;
     }
 
-    // not found - create a new file
+    // not found - create a new file, unless the caller already loaded it
     int index = -1;
-    RETURN_IF_FAILED_WITH_EXPECTED(
-        ManagedFile::CreateInstance(this, index, pNormalizedPath, rootPath.GetRef(), flags, &pRtrn),
-        HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
-        HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND));
-
-    finfo.pFile = pRtrn;
+    if ((ppPreloadedFile != nullptr) && (*ppPreloadedFile != nullptr) &&
+        ((flags & LoadPriFlags::Preload) == LoadPriFlags::Preload) &&
+        (DefString_ICompare(pNormalizedPath->GetRef(), (*ppPreloadedFile)->GetPath()) == Def_Equal))
+    {
+        RETURN_IF_FAILED((*ppPreloadedFile)->SetPackageRoot(rootPath.GetRef()));
+        pRtrn = *ppPreloadedFile;
+        *ppPreloadedFile = nullptr;
+    }
+    else
+    {
+        RETURN_IF_FAILED_WITH_EXPECTED(
+            ManagedFile::CreateInstance(this, index, pNormalizedPath, rootPath.GetRef(), flags, &pRtrn),
+            HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND));
+    }
 
-    HRESULT hr = m_pFiles->Add(finfo, &index);
+    HRESULT hr = AddFileInfo(pRtrn, &index);
     if (FAILED(hr))
     {
         delete pRtrn;
         return hr;
     }
 
-    pRtrn->SetGlobalIndex(index);
     *result = pRtrn;
 
     return S_OK;
@@ -151,27 +223,15 @@ HRESULT PriFileManager::AddFile(
     RETURN_HR_IF_NULL(E_INVALIDARG, pNormalizedPath);
     RETURN_HR_IF(E_INVALIDARG, DefString_IsEmpty(pNormalizedPath->GetRef()));
 
-    FileManagerFileInfo finfo;
     StringResult rootPath;
     ManagedFile* pRtrn = nullptr;
 
     RETURN_IF_FAILED(ManagedFile::NormalizePackageRoot(pNormalizedPath->GetRef(), pPackageRoot, &rootPath));
 
     // See if we already have the file
-    for (int i = 0; i < m_pFiles->Count(); i++)
+    if (TryFindFile(pNormalizedPath->GetRef(), &pRtrn))
     {
-        if (m_pFiles->TryGet(i, &finfo))
-        {
-            pRtrn = finfo.pFile;
-        }
-        else
-        {
-            pRtrn = nullptr;
-        }
-        if ((pRtrn != nullptr) && (DefString_ICompare(pNormalizedPath->GetRef(), pRtrn->GetPath()) == Def_Equal))
-        {
-            return HRESULT_FROM_WIN32(ERROR_MRM_DUPLICATE_ENTRY);
-        }
+        return HRESULT_FROM_WIN32(ERROR_MRM_DUPLICATE_ENTRY);
     }
 
     // not found - create a new file
@@ -179,15 +239,12 @@ HRESULT PriFileManager::AddFile(
     RETURN_IF_FAILED(ManagedFile::CreateInstance(
         this, index, pNormalizedPath, rootPath.GetRef(), fPreload ? LoadPriFlags::Preload : LoadPriFlags::Default, &pRtrn));
 
-    finfo.pFile = pRtrn;
-
-    HRESULT hr = m_pFiles->Add(finfo, &index);
+    HRESULT hr = AddFileInfo(pRtrn, &index);
     if (FAILED(hr))
     {
         delete pRtrn;
         return hr;
     }
-    pRtrn->SetGlobalIndex(index);
     *result = pRtrn;
 
     return S_OK;
@@ -223,6 +280,9 @@ HRESULT PriFileManager::InsertFile(
 
     FileManagerFileInfo finfo;
     finfo.pFile = pRtrn;
+
+    AutoReaderWriterLock autoLock(&m_loadLock);
+
     // Insert move all contents to
     RETURN_IF_FAILED(m_pFiles->Insert(finfo, pRtrn->GetGlobalIndex()));
 
@@ -237,6 +297,11 @@ HRESULT PriFileManager::InsertFile(
         pManagedFile->SetGlobalIndex(i);
     }
 
+    // Everything after the new file moved, so the index has to be rebuilt.
+    RETURN_IF_FAILED(RebuildFileIndex());
+
+    (void)TrimLoadedFiles(mf);
+
     *result = mf;
     return S_OK;
 }
@@ -280,8 +345,11 @@ HRESULT PriFileManager::RemoveFile(_In_ const ManagedFile* pFile)
         return E_MRM_PRI_MANAGER_MISMATCH;
     }
 
-    FileManagerFileInfo finfoNull = {};
-    RETURN_IF_FAILED(m_pFiles->Set(pFile->GetGlobalIndex(), finfoNull));
+    {
+        AutoReaderWriterLock autoLock(&m_loadLock);
+        FileManagerFileInfo finfoNull = {};
+        RETURN_IF_FAILED(m_pFiles->Set(pFile->GetGlobalIndex(), finfoNull));
+    }
 
     delete finfo.pFile;
     return S_OK;
@@ -295,6 +363,171 @@ HRESULT PriFileManager::SetDefaultFileFlags(_In_ UINT32 flags)
     return S_OK;
 }
 
+HRESULT PriFileManager::SetLoadedFileBudget(_In_ UINT64 maxLoadedBytes, _In_ int maxLoadedFiles)
+{
+    RETURN_HR_IF(E_INVALIDARG, maxLoadedFiles < 0);
+
+    AutoReaderWriterLock autoLock(&m_loadLock);
+    m_maxLoadedBytes = maxLoadedBytes;
+    m_maxLoadedFiles = maxLoadedFiles;
+    InterlockedExchange(&m_hasLoadedFileBudget, (((maxLoadedBytes != 0) || (maxLoadedFiles != 0)) ? 1 : 0));
+    return TrimLoadedFiles(nullptr);
+}
+
+HRESULT PriFileManager::TrimLoadedFiles()
+{
+    AutoReaderWriterLock autoLock(&m_loadLock);
+    return TrimLoadedFiles(nullptr);
+}
+
+void PriFileManager::GetLoadedFileStats(_Out_ LoadedFileStats* pStats) const
+{
+    AutoReaderWriterLock autoLock(&m_loadLock, true);
+    *pStats = m_loadedFileStats;
+}
+
+HRESULT PriFileManager::SetDecodedStringCacheBudget(_In_ UINT32 cbBudget)
+{
+    InterlockedExchange(&m_cbDecodedStringCacheBudget, static_cast<LONG>(cbBudget));
+    if (cbBudget == 0)
+    {
+        return S_OK;
+    }
+
+    // Sections that are already in use may have been handed out and cached
+    // by their readers, so enable their caches in place.  Holding the load
+    // lock keeps the files from being unloaded underneath us.
+    AutoReaderWriterLock autoLock(&m_loadLock, true);
+    for (UINT i = 0; i < m_pFiles->Count(); i++)
+    {
+        FileManagerFileInfo finfo;
+        if (m_pFiles->TryGet(i, &finfo) && (finfo.pFile != nullptr) && (finfo.pFile->m_pMyBaseFile != nullptr))
+        {
+            RETURN_IF_FAILED(static_cast<const MrmFile*>(finfo.pFile->m_pMyBaseFile)->EnableDecodedStringCaches(cbBudget));
+        }
+    }
+
+    return S_OK;
+}
+
+void PriFileManager::NoteFileLoaded(_In_ const ManagedFile* pFile, _In_ bool isReload, _In_ UINT64 reloadTicks) const
+{
+    if (isReload)
+    {
+        UINT64 micros = ((m_perfFrequency > 0) ? ((reloadTicks * 1000000) / m_perfFrequency) : 0);
+        m_loadedFileStats.numReloads++;
+        m_loadedFileStats.totalReloadMicroseconds += micros;
+        if (micros > m_loadedFileStats.maxReloadMicroseconds)
+        {
+            m_loadedFileStats.maxReloadMicroseconds = micros;
+        }
+    }
+
+    if (!pFile->m_isCounted)
+    {
+        pFile->m_isCounted = true;
+        m_loadedBytes += pFile->GetSizeInBytes();
+        m_numLoadedFiles++;
+    }
+
+    NoteFileAccessed(pFile);
+
+    // A failure here only means we stay over budget until the next load.
+    (void)TrimLoadedFiles(pFile);
+}
+
+void PriFileManager::NoteFileAccessed(_In_ const ManagedFile* pFile) const
+{
+    if (!pFile->m_isCounted)
+    {
+        return;
+    }
+
+    UnlinkLoadedFile(pFile);
+
+    // Referenced files can't be unloaded, so they aren't worth keeping in order.
+    if (pFile->CanEvict())
+    {
+        pFile->m_pLruNext = m_pLruHead;
+        if (m_pLruHead != nullptr)
+        {
+            m_pLruHead->m_pLruPrev = pFile;
+        }
+        m_pLruHead = pFile;
+        if (m_pLruTail == nullptr)
+        {
+            m_pLruTail = pFile;
+        }
+    }
+}
+
+void PriFileManager::NoteFileUnloaded(_In_ const ManagedFile* pFile) const
+{
+    if (!pFile->m_isCounted)
+    {
+        return;
+    }
+
+    UnlinkLoadedFile(pFile);
+    pFile->m_isCounted = false;
+    m_loadedBytes -= pFile->GetSizeInBytes();
+    m_numLoadedFiles--;
+}
+
+void PriFileManager::UnlinkLoadedFile(_In_ const ManagedFile* pFile) const
+{
+    if ((pFile->m_pLruPrev == nullptr) && (m_pLruHead != pFile))
+    {
+        return;
+    }
+
+    if (pFile->m_pLruPrev != nullptr)
+    {
+        pFile->m_pLruPrev->m_pLruNext = pFile->m_pLruNext;
+    }
+    else
+    {
+        m_pLruHead = pFile->m_pLruNext;
+    }
+
+    if (pFile->m_pLruNext != nullptr)
+    {
+        pFile->m_pLruNext->m_pLruPrev = pFile->m_pLruPrev;
+    }
+    else
+    {
+        m_pLruTail = pFile->m_pLruPrev;
+    }
+
+    pFile->m_pLruPrev = nullptr;
+    pFile->m_pLruNext = nullptr;
+}
+
+HRESULT PriFileManager::TrimLoadedFiles(_In_opt_ const ManagedFile* pKeep) const
+{
+    if ((m_maxLoadedBytes == 0) && (m_maxLoadedFiles == 0))
+    {
+        return S_OK;
+    }
+
+    // Walk from the least recently used end; only pinned files are skipped,
+    // since files that can't be unloaded otherwise aren't in the list.
+    const ManagedFile* pFile = m_pLruTail;
+    while ((pFile != nullptr) && (((m_maxLoadedBytes != 0) && (m_loadedBytes > m_maxLoadedBytes)) ||
+                                  ((m_maxLoadedFiles != 0) && (m_numLoadedFiles > m_maxLoadedFiles))))
+    {
+        const ManagedFile* pPrev = pFile->m_pLruPrev;
+        if ((pFile != pKeep) && pFile->CanEvict())
+        {
+            RETURN_IF_FAILED(pFile->UnloadIfLoaded());
+            m_loadedFileStats.numEvictions++;
+        }
+        pFile = pPrev;
+    }
+
+    return S_OK;
+}
+
 HRESULT PriFileManager::GetSection(
     _In_ const ISchemaCollection* pSchemaCollection,
     _In_ int fileIndex,
@@ -558,7 +791,14 @@ HRESULT PriFileManager::Init(_In_ UnifiedEnvironment* pEnvironment)
 {
     m_pEnvironment = pEnvironment;
     m_defaultFileFlags = BaseFile::MapFileFlag;
+    _DefInitializeSRWLock(&m_loadLock);
+
+    LARGE_INTEGER frequency = {};
+    _DefQueryPerformanceFrequency(&frequency);
+    m_perfFrequency = static_cast<UINT64>(frequency.QuadPart);
+
     RETURN_IF_FAILED(DynamicArray<FileManagerFileInfo>::CreateInstance(DefaultInitialFilesSize, &m_pFiles));
+    RETURN_IF_FAILED(CaseInsensitiveStringIndex::CreateInstance(DefaultInitialFilesSize, &m_pFilesByPath));
 
     return S_OK;
 }
@@ -583,6 +823,9 @@ PriFileManager::~PriFileManager()
         delete m_pFiles;
         m_pFiles = nullptr;
     }
+
+    delete m_pFilesByPath;
+    m_pFilesByPath = nullptr;
 }
 
 } // namespace Microsoft::Resources
@@ -49,6 +49,9 @@ public:
 
         delete m_pOverrideDecisionMap;
         m_pOverrideDecisionMap = nullptr;
+
+        Def_Free(m_ppDataItemsSections);
+        m_ppDataItemsSections = nullptr;
     }
 
     const IHierarchicalSchema* GetSchema() const { return (m_pOverrideSchema ? m_pOverrideSchema : m_pSchema); }
@@ -314,14 +317,9 @@ public:
         UINT16 fileIndex = detail;
 
         const FileDataItemsSection* pDataSection;
-        RETURN_IF_FAILED(m_pSectionResolver->GetDataItemsSection(
-            fileIndex, (BaseFile::SectionIndex)sectionIndex, (FileDataItemsSection**)&pDataSection));
-        if (pDataSection != nullptr)
-        {
-            return pDataSection->GetItemDataRef(itemIndex, pDataOut);
-        }
+        RETURN_IF_FAILED(GetDataItemsSection(fileIndex, sectionIndex, &pDataSection));
 
-        return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+        return pDataSection->GetItemDataRef(itemIndex, pDataOut);
     }
 
     HRESULT GetInternalDataAsString(
@@ -334,7 +332,7 @@ public:
 
         RETURN_IF_FAILED(m_pInternalData->GetDataRef(offset, cbData, &blob));
 
-        return GetDataAsString(&blob, valueType, 0, pStringOut);
+        return GetDataAsString(&blob, nullptr, 0, valueType, 0, pStringOut);
     }
 
     HRESULT GetReferenceDataAsString(
@@ -347,18 +345,10 @@ public:
         UINT16 fileIndex = detail;
 
         const FileDataItemsSection* pDataSection;
-        RETURN_IF_FAILED(m_pSectionResolver->GetDataItemsSection(
-            fileIndex, (BaseFile::SectionIndex)sectionIndex, (FileDataItemsSection**)&pDataSection));
-        if (pDataSection != nullptr)
-        {
-            BlobResult blob;
-            RETURN_IF_FAILED(pDataSection->GetItemDataRef(itemIndex, &blob));
-
-            // It prepend the file full path if the valueType is 'Path'
-            return GetDataAsString(&blob, valueType, fileIndex, pStringOut);
-        }
+        RETURN_IF_FAILED(GetDataItemsSection(fileIndex, sectionIndex, &pDataSection));
 
-        return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+        // It prepend the file full path if the valueType is 'Path'
+        return GetDataAsString(nullptr, pDataSection, itemIndex, valueType, fileIndex, pStringOut);
     }
 
     HRESULT SetDecisionInfoOverride(_In_ const IDecisionInfo* pOverrideDecisionInfo, _In_ const RemapUInt16* pOverrideDecisionMap) const
@@ -412,8 +402,54 @@ public:
     }
 
 private:
+    // Data items sections of this file live as long as the map does, so they're
+    // remembered by section index.  Sections of other files are always resolved,
+    // since the file manager can unload those files.
+    HRESULT GetDataItemsSection(_In_ UINT16 fileIndex, _In_ UINT16 sectionIndex, _Out_ const FileDataItemsSection** result) const
+    {
+        bool cacheable = ((fileIndex == 0) && (sectionIndex < m_numDataItemsSections));
+        if (cacheable)
+        {
+            *result = static_cast<const FileDataItemsSection*>(_DefReadPointerAcquire(&m_ppDataItemsSections[sectionIndex]));
+            if (*result != nullptr)
+            {
+                return S_OK;
+            }
+        }
+
+        FileDataItemsSection* pDataSection;
+        RETURN_IF_FAILED(m_pSectionResolver->GetDataItemsSection(fileIndex, (BaseFile::SectionIndex)sectionIndex, &pDataSection));
+        RETURN_HR_IF_NULL(HRESULT_FROM_WIN32(ERROR_NOT_FOUND), pDataSection);
+
+        if (cacheable)
+        {
+            _DefWritePointerRelease(&m_ppDataItemsSections[sectionIndex], pDataSection);
+        }
+
+        *result = pDataSection;
+        return S_OK;
+    }
+
+    // Decodes the string in pBlobResult or, if pDataSection is supplied, in its item itemIndex.
+    // The section decodes its own items so that it can cache them.
+    HRESULT DecodeString(
+        _In_opt_ BlobResult* pBlobResult,
+        _In_opt_ const FileDataItemsSection* pDataSection,
+        _In_ UINT32 itemIndex,
+        _In_ DEFSTRING_ENCODING encoding,
+        _Inout_ StringResult* pStringOut) const
+    {
+        if (pDataSection != nullptr)
+        {
+            return pDataSection->GetItemDataAsString(itemIndex, encoding, pStringOut);
+        }
+        return GetStringResultFromBlobResult(pBlobResult, encoding, pStringOut);
+    }
+
     HRESULT GetDataAsString(
-        _In_ BlobResult* pBlobResult,
+        _In_opt_ BlobResult* pBlobResult,
+        _In_opt_ const FileDataItemsSection* pDataSection,
+        _In_ UINT32 itemIndex,
         _In_ MrmEnvironment::ResourceValueType valueType,
         _In_ int fileIndex,
         _Inout_ StringResult* pStringOut) const
@@ -426,12 +462,12 @@ private:
 
         if (!MrmEnvironment::IsPathResourceValueType(valueType) || m_packageRootPath.IsEmpty())
         {
-            return GetStringResultFromBlobResult(pBlobResult, MrmEnvironment::MapResourceValueTypeToEncoding(valueType), pStringOut);
+            return DecodeString(pBlobResult, pDataSection, itemIndex, MrmEnvironment::MapResourceValueTypeToEncoding(valueType), pStringOut);
         }
 
         // It's a path, and we have a package root.  Prepare to concatenate.
         StringResult tmp;
-        RETURN_IF_FAILED(GetStringResultFromBlobResult(pBlobResult, MrmEnvironment::MapResourceValueTypeToEncoding(valueType), &tmp));
+        RETURN_IF_FAILED(DecodeString(pBlobResult, pDataSection, itemIndex, MrmEnvironment::MapResourceValueTypeToEncoding(valueType), &tmp));
 
         bool absolutePath;
         RETURN_IF_FAILED(tmp.IsAbsolutePath(&absolutePath));
@@ -494,6 +530,10 @@ protected:
 
     _Field_size_(m_pHeader->numEnvironmentRefs) const EnvironmentReference** m_ppEnvironmentRefs;
 
+    // Resolved FileDataItemsSection pointers for this file, by section index.
+    _Field_size_(m_numDataItemsSections) PVOID* m_ppDataItemsSections;
+    int m_numDataItemsSections;
+
     ResourceMapFileData(_In_ const IFileSectionResolver* pSections) :
         m_pSchema(nullptr),
         m_pDecisionInfo(nullptr),
@@ -518,7 +558,9 @@ protected:
         m_pOverrideSchema(nullptr),
         m_pSectionResolver(pSections),
         m_links(nullptr),
-        m_largeValues(false)
+        m_largeValues(false),
+        m_ppDataItemsSections(nullptr),
+        m_numDataItemsSections(0)
     {}
 
     HRESULT Init(
@@ -645,6 +687,26 @@ protected:
             }
         }
 
+        // Size the data items cache to cover every data items section in this file.
+        const DEFFILE_SECTION_TYPEID dataItemsTypes[] = {FileDataItemsSection::GetSectionTypeId(),
+                                                         FileDataItemsSection::GetCompressedSectionTypeId()};
+        int numDataItemsSections = 0;
+        for (size_t i = 0; i < ARRAYSIZE(dataItemsTypes); i++)
+        {
+            int sectionIndex = -1;
+            while (m_pSectionResolver->TryGetSectionIndexByType(dataItemsTypes[i], 0, sectionIndex + 1, &sectionIndex))
+            {
+                numDataItemsSections = max(numDataItemsSections, sectionIndex + 1);
+            }
+        }
+
+        if (numDataItemsSections > 0)
+        {
+            m_ppDataItemsSections = _DefArray_AllocZeroed(PVOID, numDataItemsSections);
+            RETURN_IF_NULL_ALLOC(m_ppDataItemsSections);
+            m_numDataItemsSections = numDataItemsSections;
+        }
+
         return S_OK;
     }
 };
@@ -682,32 +744,91 @@ ResourceCandidateResult::GetValueLocation(
     return m_pRawMap->GetRawValueInfo(m_valueGlobalIndex, pLocatorType, pDataOut, extraDataOut, pDetailOut, nullptr);
 }
 
-bool ResourceCandidateResult::TryGetStringValue(_Inout_ StringResult* pStringOut) const
+HRESULT ResourceCandidateResult::GetStringValue(_Inout_ StringResult* pStringOut) const
 {
+    RETURN_HR_IF_NULL(E_DEF_NOT_READY, m_pRawMap);
+
     MrmEnvironment::ResourceValueType valueType;
     MRMFILE_MAP_VALUE_LOCATOR locatorType;
     UINT32 data;
     UINT16 extraData;
     UINT16 detail;
 
-    if (SUCCEEDED(m_pRawMap->GetRawValueInfo(m_valueGlobalIndex, &locatorType, &data, &extraData, &detail, &valueType)))
+    RETURN_IF_FAILED(m_pRawMap->GetRawValueInfo(m_valueGlobalIndex, &locatorType, &data, &extraData, &detail, &valueType));
+    switch (locatorType)
     {
-        switch (locatorType)
-        {
-        case MRMFILE_MAP_VALUE_LOCATOR_INTERNAL:
-            return SUCCEEDED(m_pRawMap->GetInternalDataAsString(data, detail, valueType, pStringOut));
-        case MRMFILE_MAP_VALUE_LOCATOR_DATA_ITEM:
+    case MRMFILE_MAP_VALUE_LOCATOR_INTERNAL:
+        return m_pRawMap->GetInternalDataAsString(data, detail, valueType, pStringOut);
+    case MRMFILE_MAP_VALUE_LOCATOR_DATA_ITEM:
+    {
+        UINT32 itemIndex = ((extraData << 16) | (data & 0xffff));
+        UINT16 sectionIndex = static_cast<UINT16>(data >> 16);
+        return m_pRawMap->GetReferenceDataAsString(itemIndex, sectionIndex, detail, valueType, pStringOut);
+    }
+    case MRMFILE_MAP_VALUE_LOCATOR_FILE_ITEM:
+    default:
+        return HRESULT_FROM_WIN32(ERROR_MRM_RESOURCE_TYPE_MISMATCH);
+    }
+}
+
+bool ResourceCandidateResult::TryGetStringValue(_Inout_ StringResult* pStringOut) const
+{
+    return SUCCEEDED(GetStringValue(pStringOut));
+}
+
+// Stored bytes can only be handed out as UTF-8 if they are nul-terminated and converting
+// them through UTF-16 would succeed and give the same string.
+static bool IsStoredStringUsableAsUtf8(
+    _In_ DEFSTRING_ENCODING encoding,
+    _In_reads_bytes_(cbString) const BYTE* pString,
+    _In_ size_t cbString)
+{
+    if (encoding == DEFSTRING_ENCODING_ASCII)
+    {
+        // ASCII strings are widened byte by byte, so anything above 0x7f changes when it is re-encoded.
+        for (size_t i = 0; i < cbString; i++)
         {
-            UINT32 itemIndex = ((extraData << 16) | (data & 0xffff));
-            UINT16 sectionIndex = static_cast<UINT16>(data >> 16);
-            return SUCCEEDED(m_pRawMap->GetReferenceDataAsString(itemIndex, sectionIndex, detail, valueType, pStringOut));
+            if (pString[i] == 0)
+            {
+                return true;
+            }
+            if (pString[i] > 0x7f)
+            {
+                return false;
+            }
         }
-        case MRMFILE_MAP_VALUE_LOCATOR_FILE_ITEM:
-        default:
-            break;
+        return false;
+    }
+
+    return ((memchr(pString, 0, cbString) != nullptr) && DefString_IsValidUtf8(reinterpret_cast<PCSTR>(pString), cbString));
+}
+
+HRESULT ResourceCandidateResult::GetStringValueUtf8(_Inout_ BlobResult* pUtf8Out) const
+{
+    MrmEnvironment::ResourceValueType valueType;
+    RETURN_IF_FAILED(GetResourceValueType(&valueType));
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_MRM_RESOURCE_TYPE_MISMATCH), MrmEnvironment::IsBinaryResourceValueType(valueType));
+
+    // Paths can have the package root prepended, so they always go through UTF-16.  Stored strings
+    // that aren't nul-terminated, well-formed UTF-8 also go through UTF-16, so they get the same
+    // result or conversion error as the UTF-16 lookup instead of being handed out as is.
+    if (MrmEnvironment::IsStringResourceValueType(valueType))
+    {
+        DEFSTRING_ENCODING encoding = MrmEnvironment::MapResourceValueTypeToEncoding(valueType);
+        if ((encoding != DEFSTRING_ENCODING_UTF16) && TryGetBlobValue(pUtf8Out))
+        {
+            size_t cbBlob;
+            const BYTE* pBlob = static_cast<const BYTE*>(pUtf8Out->GetRef(&cbBlob));
+            if ((pBlob != nullptr) && IsStoredStringUsableAsUtf8(encoding, pBlob, cbBlob))
+            {
+                return S_OK;
+            }
         }
     }
-    return false;
+
+    StringResult str;
+    RETURN_IF_FAILED(GetStringValue(&str));
+    return GetUtf8BlobResultFromStringResult(&str, pUtf8Out);
 }
 
 HRESULT ResourceCandidateResult::GetSourceFileIndex(_Inout_ int* pIndexOut) const
@@ -929,26 +1050,20 @@ ResourceMapSubtree::ResourceMapSubtree() :
     m_numDescendentResources(-1),
     m_numDescendentScopes(-1),
     m_pDescendentResources(nullptr),
-    m_pDescendentScopes(nullptr)
-{}
-
-ResourceMapSubtree::~ResourceMapSubtree()
+    m_pDescendentScopes(nullptr),
+    m_pDescendentNames(nullptr),
+    m_firstDescendentName(-1),
+    m_currentMinorVersion(0),
+    m_scopePathHashIndex(-1),
+    m_scopePathHash(0)
 {
-    if (m_pDescendentResources != nullptr)
-    {
-        Def_Free(m_pDescendentResources);
-        m_pDescendentResources = nullptr;
-    }
-
-    if (m_pDescendentScopes != nullptr)
-    {
-        Def_Free(m_pDescendentScopes);
-        m_pDescendentScopes = nullptr;
-    }
-    m_numDescendentResources = -1;
-    m_numDescendentScopes = -1;
+    m_resourceWalk.index = -1;
+    m_scopeWalk.index = -1;
+    _DefInitializeSRWLock(&m_descendentLock);
 }
 
+ResourceMapSubtree::~ResourceMapSubtree() { ResetDescendents(); }
+
 HRESULT
 ResourceMapSubtree::CreateInstance(_In_ const IResourceMapBase* pFullMap, _In_ int scopeIndex, _Outptr_ const ResourceMapSubtree** result)
 {
@@ -1069,6 +1184,44 @@ HRESULT ResourceMapSubtree::GetChildResource(_In_ int childIndex, _Inout_ NamedR
     return HRESULT_FROM_WIN32(ERROR_RANGE_NOT_FOUND);
 }
 
+bool ResourceMapSubtree::TryGetResourceIndexFromNameIndex(_In_ PCWSTR pPath, _Out_ int* pItemIndexOut) const
+{
+    *pItemIndexOut = -1;
+
+    const ResourceNameIndexSection* nameIndex = m_pFullMap->GetNameIndex();
+    if ((nameIndex == nullptr) || (nameIndex->GetSchema() != m_pSchema))
+    {
+        return false;
+    }
+
+    if (m_scopeIndex == 0)
+    {
+        return nameIndex->TryFindItem(0, ResourceNameIndexSection::GetInitialPathHash(), pPath, pItemIndexOut);
+    }
+
+    // The index is keyed by full path, so remember the hash of our own scope
+    // name and extend it with the relative path on each lookup.
+    UINT32 scopePathHash;
+    {
+        AutoReaderWriterLock autoLock(&m_descendentLock);
+        if (m_scopePathHashIndex != m_scopeIndex)
+        {
+            StringResult scopeName;
+            if (!m_pSchema->TryGetScopeInfo(m_scopeIndex, &scopeName))
+            {
+                return false;
+            }
+
+            m_scopePathHash =
+                ResourceNameIndexSection::ComputePathHash(ResourceNameIndexSection::GetInitialPathHash(), scopeName.GetRef());
+            m_scopePathHashIndex = m_scopeIndex;
+        }
+        scopePathHash = m_scopePathHash;
+    }
+
+    return nameIndex->TryFindItem(m_scopeIndex, scopePathHash, pPath, pItemIndexOut);
+}
+
 HRESULT ResourceMapSubtree::GetResource(_In_ PCWSTR pPath, _Inout_ NamedResourceResult* pResourceOut) const
 {
     int schemaScopeIndex = -1;
@@ -1076,6 +1229,11 @@ HRESULT ResourceMapSubtree::GetResource(_In_ PCWSTR pPath, _Inout_ NamedResource
 
     RETURN_HR_IF_EXPECTED(E_INVALIDARG, (pPath == nullptr) || (*pPath == 0));
 
+    if (TryGetResourceIndexFromNameIndex(pPath, &schemaItemIndex))
+    {
+        return m_pFullMap->GetResourceByIndex(schemaItemIndex, pResourceOut);
+    }
+
     if (!m_pSchema->Contains(pPath, m_scopeIndex, &schemaScopeIndex, &schemaItemIndex))
     {
         return HRESULT_FROM_WIN32(ERROR_MRM_NAMED_RESOURCE_NOT_FOUND);
@@ -1161,7 +1319,9 @@ HRESULT ResourceMapSubtree::MoveToSubtree(_In_ PCWSTR pPath)
 
 int ResourceMapSubtree::GetNumDescendentResources() const
 {
-    if (FAILED(GetOrUpdateDescendents()))
+    AutoReaderWriterLock autoLock(&m_descendentLock);
+
+    if (FAILED(GetOrUpdateDescendentResources()))
     {
         return -1;
     }
@@ -1171,11 +1331,13 @@ int ResourceMapSubtree::GetNumDescendentResources() const
 
 HRESULT ResourceMapSubtree::GetDescendentResource(_In_ int index, _Inout_ NamedResourceResult* pItemOut) const
 {
-    RETURN_IF_FAILED(GetOrUpdateDescendents());
-
-    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_RANGE_NOT_FOUND), (index < 0) || (index > m_numDescendentResources - 1));
+    int itemIndex;
+    {
+        AutoReaderWriterLock autoLock(&m_descendentLock);
+        RETURN_IF_FAILED(GetDescendentIndex(false, index, &itemIndex));
+    }
 
-    return m_pFullMap->GetResourceByIndex(m_pDescendentResources[index], pItemOut);
+    return m_pFullMap->GetResourceByIndex(itemIndex, pItemOut);
 }
 
 HRESULT ResourceMapSubtree::GetResourceNameBySchemaIndex(_In_ int indexInSchema, _Inout_ StringResult* pNameOut) const
@@ -1191,11 +1353,23 @@ HRESULT ResourceMapSubtree::GetResourceNameBySchemaIndex(_In_ int indexInSchema,
 // Gets the name of the resource relative to this scope
 HRESULT ResourceMapSubtree::GetDescendentResourceName(_In_ int index, _Inout_ StringResult* pNameOut) const
 {
-    RETURN_IF_FAILED(GetOrUpdateDescendents());
+    AutoReaderWriterLock autoLock(&m_descendentLock);
 
-    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_RANGE_NOT_FOUND), (index < 0) || (index > m_numDescendentResources - 1));
+    int itemIndex;
+    RETURN_IF_FAILED(GetDescendentIndex(false, index, &itemIndex));
 
-    if (m_pSchema->TryGetRelativeItemName(m_scopeIndex, m_pDescendentResources[index], pNameOut))
+    // Callers typically enumerate every descendent, so build the names a
+    // window at a time rather than walking up from each item.
+    PCWSTR pName;
+    int batchItemIndex;
+    if (SUCCEEDED(GetOrUpdateDescendentNames(index)) &&
+        m_pDescendentNames->TryGetName(index - m_firstDescendentName, &pName, &batchItemIndex) && (batchItemIndex == itemIndex))
+    {
+        // Copy so the result doesn't depend on the lifetime of this subtree
+        return pNameOut->SetCopy(pName);
+    }
+
+    if (m_pSchema->TryGetRelativeItemName(m_scopeIndex, itemIndex, pNameOut))
     {
         return S_OK;
     }
@@ -1205,7 +1379,9 @@ HRESULT ResourceMapSubtree::GetDescendentResourceName(_In_ int index, _Inout_ St
 
 int ResourceMapSubtree::GetNumDescendentScopes() const
 {
-    if (FAILED(GetOrUpdateDescendents()))
+    AutoReaderWriterLock autoLock(&m_descendentLock);
+
+    if (FAILED(GetOrUpdateDescendentScopes()))
     {
         return -1;
     }
@@ -1216,21 +1392,26 @@ int ResourceMapSubtree::GetNumDescendentScopes() const
 HRESULT ResourceMapSubtree::GetDescendentScopeSubtree(_In_ int index, _Out_ const ResourceMapSubtree** result) const
 {
     *result = nullptr;
-    RETURN_IF_FAILED(GetOrUpdateDescendents());
 
-    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_RANGE_NOT_FOUND), (index < 0) || (index > m_numDescendentScopes - 1));
+    int scopeIndex;
+    {
+        AutoReaderWriterLock autoLock(&m_descendentLock);
+        RETURN_IF_FAILED(GetDescendentIndex(true, index, &scopeIndex));
+    }
 
-    return ResourceMapSubtree::CreateInstance(m_pFullMap, m_pDescendentScopes[index], result);
+    return ResourceMapSubtree::CreateInstance(m_pFullMap, scopeIndex, result);
 }
 
 // Gets the name of the descendent scope relative to this one
 HRESULT ResourceMapSubtree::GetDescendentScopeName(_In_ int index, _Inout_ StringResult* pNameOut) const
 {
-    RETURN_IF_FAILED(GetOrUpdateDescendents());
-
-    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_RANGE_NOT_FOUND), (index < 0) || (index > m_numDescendentScopes - 1));
+    int scopeIndex;
+    {
+        AutoReaderWriterLock autoLock(&m_descendentLock);
+        RETURN_IF_FAILED(GetDescendentIndex(true, index, &scopeIndex));
+    }
 
-    if (m_pSchema->TryGetRelativeScopeName(m_scopeIndex, m_pDescendentScopes[index], pNameOut))
+    if (m_pSchema->TryGetRelativeScopeName(m_scopeIndex, scopeIndex, pNameOut))
     {
         return S_OK;
     }
@@ -1238,28 +1419,44 @@ HRESULT ResourceMapSubtree::GetDescendentScopeName(_In_ int index, _Inout_ Strin
     return HRESULT_FROM_WIN32(ERROR_MRM_MAP_NOT_FOUND);
 }
 
-HRESULT ResourceMapSubtree::GetOrUpdateDescendentResources() const
+void ResourceMapSubtree::ResetDescendents() const
 {
-    // set to zero to indicate that we've attempted to get the resources
-    m_numDescendentResources = 0;
-
-    int numResources = 0;
-    RETURN_IF_FAILED(m_pSchema->GetNumDescendents(m_scopeIndex, nullptr, &numResources));
+    if (m_pDescendentResources != nullptr)
+    {
+        Def_Free(m_pDescendentResources);
+        m_pDescendentResources = nullptr;
+    }
 
-    if (numResources > 0)
+    if (m_pDescendentScopes != nullptr)
     {
-        if (m_pDescendentResources)
-        {
-            Def_Free(m_pDescendentResources);
-            m_pDescendentResources = nullptr;
-        }
-        m_pDescendentResources = _DefArray_AllocZeroed(int, numResources);
-        RETURN_IF_NULL_ALLOC(m_pDescendentResources);
+        Def_Free(m_pDescendentScopes);
+        m_pDescendentScopes = nullptr;
+    }
 
-        int numWritten = 0;
-        RETURN_IF_FAILED(m_pSchema->GetDescendents(m_scopeIndex, 0, nullptr, nullptr, numResources, m_pDescendentResources, &numWritten));
+    delete m_pDescendentNames;
+    m_pDescendentNames = nullptr;
+    m_firstDescendentName = -1;
+
+    m_numDescendentResources = -1;
+    m_numDescendentScopes = -1;
+    m_resourceWalk.index = -1;
+    m_scopeWalk.index = -1;
+}
 
-        DEF_ASSERT(numWritten == numResources);
+HRESULT ResourceMapSubtree::GetOrUpdateDescendentResources() const
+{
+    if (m_currentMinorVersion != m_pSchema->GetMinorVersion())
+    {
+        ResetDescendents();
+        m_currentMinorVersion = m_pSchema->GetMinorVersion();
+    }
+
+    if (m_numDescendentResources < 0)
+    {
+        // Resource counts are normally stored in the schema, so this doesn't
+        // need to visit (or allocate anything for) the descendents.
+        int numResources = 0;
+        RETURN_IF_FAILED(m_pSchema->GetNumDescendents(m_scopeIndex, nullptr, &numResources));
         m_numDescendentResources = numResources;
     }
 
@@ -1268,44 +1465,150 @@ HRESULT ResourceMapSubtree::GetOrUpdateDescendentResources() const
 
 HRESULT ResourceMapSubtree::GetOrUpdateDescendentScopes() const
 {
-    // set to zero to indicate that we've attempted to get the scopes
-    m_numDescendentScopes = 0;
+    if (m_currentMinorVersion != m_pSchema->GetMinorVersion())
+    {
+        ResetDescendents();
+        m_currentMinorVersion = m_pSchema->GetMinorVersion();
+    }
+
+    if (m_numDescendentScopes < 0)
+    {
+        int numScopes = 0;
+        RETURN_IF_FAILED(m_pSchema->GetNumDescendents(m_scopeIndex, &numScopes, nullptr));
+        m_numDescendentScopes = numScopes;
+    }
+
+    return S_OK;
+}
 
-    int numScopes = 0;
-    RETURN_IF_FAILED(m_pSchema->GetNumDescendents(m_scopeIndex, &numScopes, nullptr));
+HRESULT ResourceMapSubtree::GetOrUpdateDescendentNames(_In_ int index) const
+{
+    if ((m_firstDescendentName >= 0) && (index >= m_firstDescendentName) &&
+        ((index - m_firstDescendentName) < m_pDescendentNames->GetNumNames()))
+    {
+        return S_OK;
+    }
 
-    if (numScopes > 0)
+    if (m_pDescendentNames == nullptr)
     {
-        if (m_pDescendentScopes != nullptr)
-        {
-            Def_Free(m_pDescendentScopes);
-            m_pDescendentScopes = nullptr;
-        }
-        m_pDescendentScopes = _DefArray_AllocZeroed(int, numScopes);
-        RETURN_IF_NULL_ALLOC(m_pDescendentScopes);
+        RETURN_IF_FAILED(HierarchicalNamesBatch::CreateInstance(&m_pDescendentNames));
+    }
 
-        int numWritten = 0;
-        RETURN_IF_FAILED(m_pSchema->GetDescendents(m_scopeIndex, numScopes, m_pDescendentScopes, &numWritten, 0, nullptr, nullptr));
+    // The batch keeps its buffers, so moving the window doesn't allocate
+    // once the names fit.
+    int firstName = index - (index % DescendentNamesWindow);
+    m_firstDescendentName = -1;
+    m_pDescendentNames->Reset();
+    RETURN_IF_FAILED(m_pSchema->GetDescendentItemNames(m_scopeIndex, firstName, DescendentNamesWindow, m_pDescendentNames));
 
-        DEF_ASSERT(numWritten == numScopes);
-        m_numDescendentScopes = numScopes;
+    m_firstDescendentName = firstName;
+    return S_OK;
+}
+
+HRESULT ResourceMapSubtree::MaterializeDescendents(_In_ bool wantScopes) const
+{
+    int numDescendents = (wantScopes ? m_numDescendentScopes : m_numDescendentResources);
+    int* pDescendents = _DefArray_AllocZeroed(int, numDescendents);
+    RETURN_IF_NULL_ALLOC(pDescendents);
+
+    int numWritten = 0;
+    HRESULT hr = (wantScopes ? m_pSchema->GetDescendents(m_scopeIndex, numDescendents, pDescendents, &numWritten, 0, nullptr, nullptr) :
+                               m_pSchema->GetDescendents(m_scopeIndex, 0, nullptr, nullptr, numDescendents, pDescendents, &numWritten));
+    if (SUCCEEDED(hr) && (numWritten != numDescendents))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+    }
+
+    if (FAILED(hr))
+    {
+        Def_Free(pDescendents);
+        return hr;
+    }
+
+    if (wantScopes)
+    {
+        m_pDescendentScopes = pDescendents;
+    }
+    else
+    {
+        m_pDescendentResources = pDescendents;
     }
     return S_OK;
 }
 
-HRESULT ResourceMapSubtree::GetOrUpdateDescendents() const
+HRESULT ResourceMapSubtree::GetDescendentIndex(_In_ bool wantScope, _In_ int index, _Out_ int* pIndexInSchemaOut) const
 {
-    if (m_numDescendentResources < 0 || m_currentMinorVersion != m_pSchema->GetMinorVersion())
+    *pIndexInSchemaOut = -1;
+
+    if (wantScope)
+    {
+        RETURN_IF_FAILED(GetOrUpdateDescendentScopes());
+    }
+    else
     {
         RETURN_IF_FAILED(GetOrUpdateDescendentResources());
     }
 
-    if (m_numDescendentScopes < 0 || m_currentMinorVersion != m_pSchema->GetMinorVersion())
+    int numDescendents = (wantScope ? m_numDescendentScopes : m_numDescendentResources);
+    RETURN_HR_IF(HRESULT_FROM_WIN32(ERROR_RANGE_NOT_FOUND), (index < 0) || (index > numDescendents - 1));
+
+    // Once the list has been built it answers everything.
+    const int* pDescendents = (wantScope ? m_pDescendentScopes : m_pDescendentResources);
+    if (pDescendents != nullptr)
     {
-        RETURN_IF_FAILED(GetOrUpdateDescendentScopes());
+        *pIndexInSchemaOut = pDescendents[index];
+        return S_OK;
+    }
+
+    DescendentWalk* pWalk = (wantScope ? &m_scopeWalk : &m_resourceWalk);
+    if (index == pWalk->index)
+    {
+        *pIndexInSchemaOut = pWalk->indexInSchema;
+        return S_OK;
+    }
+
+    // Going backwards means the caller wants random access, so fall back to
+    // the full list of descendents.
+    if ((pWalk->index >= 0) && (index < pWalk->index))
+    {
+        RETURN_IF_FAILED(MaterializeDescendents(wantScope));
+        *pIndexInSchemaOut = (wantScope ? m_pDescendentScopes : m_pDescendentResources)[index];
+        return S_OK;
+    }
+
+    if (pWalk->index < 0)
+    {
+        RETURN_IF_FAILED(m_pSchema->InitDescendentCursor(m_scopeIndex, &pWalk->cursor));
     }
 
-    m_currentMinorVersion = m_pSchema->GetMinorVersion();
+    while (pWalk->index < index)
+    {
+        int scopeIndex;
+        int itemIndex;
+        if (!m_pSchema->TryGetNextDescendent(&pWalk->cursor, &scopeIndex, &itemIndex))
+        {
+            pWalk->index = -1;
+            if (SUCCEEDED(pWalk->cursor.status))
+            {
+                // The walk ended before the count we were given
+                return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+            }
+
+            // Names the cursor can't walk still have a usable list.
+            RETURN_IF_FAILED(MaterializeDescendents(wantScope));
+            *pIndexInSchemaOut = (wantScope ? m_pDescendentScopes : m_pDescendentResources)[index];
+            return S_OK;
+        }
+
+        int found = (wantScope ? scopeIndex : itemIndex);
+        if (found >= 0)
+        {
+            pWalk->index++;
+            pWalk->indexInSchema = found;
+        }
+    }
+
+    *pIndexInSchemaOut = pWalk->indexInSchema;
     return S_OK;
 }
 
@@ -1392,11 +1695,32 @@ HRESULT ResourceMapBase::Init(
         linkSectionIndex++;
     }
 
+    // We might also have a name index for our schema.  The index is only
+    // an accelerator, so a missing or unreadable index is not an error.
+    int nameIndexSectionIndex = 0;
+
+    while (pSections->TryGetSectionIndexByType(gResourceNameIndexSectionType, 0, nameIndexSectionIndex, &nameIndexSectionIndex))
+    {
+        const IFileSection* section;
+        AutoDeletePtr<ResourceNameIndexSection> nameIndex;
+
+        if (SUCCEEDED(pSections->GetSection(pSchemaCollection, 0, static_cast<BaseFile::SectionIndex>(nameIndexSectionIndex), &section)) &&
+            SUCCEEDED(ResourceNameIndexSection::CreateFromSection(pSections, section, &nameIndex)) && (nameIndex->GetSchema() == m_pSchema))
+        {
+            m_nameIndex = nameIndex.Detach();
+            break;
+        }
+        nameIndexSectionIndex++;
+    }
+
     return S_OK;
 }
 
 ResourceMapBase::~ResourceMapBase()
 {
+    delete m_nameIndex;
+    m_nameIndex = nullptr;
+
     delete m_pFileData;
 
     m_pFileData = nullptr;
@@ -1435,6 +1759,11 @@ HRESULT ResourceMapBase::GetResource(_In_ PCWSTR pPath, _Inout_ NamedResourceRes
 
     RETURN_HR_IF_EXPECTED(E_INVALIDARG, (pPath == nullptr) || (*pPath == 0));
 
+    if (TryGetResourceIndexFromNameIndex(pPath, &schemaItemIndex))
+    {
+        return GetResourceByIndex(schemaItemIndex, pResourceOut);
+    }
+
     if (!m_pSchema->Contains(pPath, 0, &schemaScopeIndex, &schemaItemIndex))
     {
         return HRESULT_FROM_WIN32(ERROR_MRM_NAMED_RESOURCE_NOT_FOUND);
@@ -0,0 +1,202 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "stdafx.h"
+
+namespace Microsoft::Resources
+{
+
+HRESULT ResourceNameIndexSection::CreateFromSection(
+    _In_ const IFileSectionResolver* sectionResolver,
+    _In_ const IFileSection* const section,
+    _Outptr_ ResourceNameIndexSection** result)
+{
+    return CreateInstance(sectionResolver, section->GetSectionType(), section->GetData(), section->GetDataSize(), result);
+}
+
+HRESULT ResourceNameIndexSection::CreateInstance(
+    _In_opt_ const IFileSectionResolver* sectionResolver,
+    _In_ const DEFFILE_SECTION_TYPEID& sectionType,
+    _In_reads_bytes_(dataSizeInBytes) const BYTE* rawData,
+    _In_ int dataSizeInBytes,
+    _Outptr_ ResourceNameIndexSection** result)
+{
+    *result = nullptr;
+    RETURN_HR_IF_NULL(E_INVALIDARG, rawData);
+    RETURN_HR_IF(E_INVALIDARG, dataSizeInBytes < 0);
+
+    AutoDeletePtr<ResourceNameIndexSection> rtrn = new ResourceNameIndexSection();
+    RETURN_IF_NULL_ALLOC(rtrn);
+    RETURN_IF_FAILED(rtrn->Init(sectionType, sectionResolver, rawData, static_cast<UINT32>(dataSizeInBytes)));
+
+    *result = rtrn.Detach();
+
+    return S_OK;
+}
+
+const DEFFILE_SECTION_TYPEID ResourceNameIndexSection::GetSectionTypeId() { return gResourceNameIndexSectionType; }
+
+UINT32 ResourceNameIndexSection::ComputePathHash(_In_ UINT32 partialHash, _In_opt_ PCWSTR path)
+{
+    UINT32 hash = partialHash;
+
+    if (path == nullptr)
+    {
+        return hash;
+    }
+
+    // Every segment is hashed with a leading separator so that the hash of a
+    // scope can be extended with a path relative to that scope. Hashes are
+    // persisted, so characters are folded with the ordinal mapping rather
+    // than one that depends on the current locale.
+    bool atSegmentStart = true;
+    for (PCWSTR pCh = path; *pCh != L'\0'; pCh++)
+    {
+        if ((*pCh == L'/') || (*pCh == L'\\'))
+        {
+            atSegmentStart = true;
+            continue;
+        }
+
+        if (atSegmentStart)
+        {
+            hash = HashChar(hash, L'/');
+            atSegmentStart = false;
+        }
+        hash = HashChar(hash, DefString_ToUpperOrdinal(*pCh));
+    }
+
+    return hash;
+}
+
+bool ResourceNameIndexSection::NamesMatch(_In_ PCWSTR storedName, _In_ PCWSTR requestedName) const
+{
+    // Stored names never have empty segments, so this only accepts
+    // requested names that HierarchicalNames::Contains would also accept.
+    PCWSTR pStored = storedName;
+    PCWSTR pRequested = requestedName;
+
+    if (IsPathSeparator(pRequested[0]))
+    {
+        pRequested++;
+    }
+
+    while ((pStored[0] != L'\0') && (pRequested[0] != L'\0'))
+    {
+        int cchStored = 0;
+        while ((pStored[cchStored] != L'\0') && !IsPathSeparator(pStored[cchStored]))
+        {
+            cchStored++;
+        }
+
+        int cchRequested = 0;
+        while ((pRequested[cchRequested] != L'\0') && !IsPathSeparator(pRequested[cchRequested]))
+        {
+            cchRequested++;
+        }
+
+        if ((cchRequested == 0) || (CompareSegments(pStored, cchStored, pRequested, cchRequested) != 0))
+        {
+            return false;
+        }
+
+        pStored += cchStored;
+        pRequested += cchRequested;
+
+        if ((pStored[0] == L'\0') || (pRequested[0] == L'\0'))
+        {
+            break;
+        }
+
+        // both are at a separator
+        pStored++;
+        pRequested++;
+    }
+
+    return ((pStored[0] == L'\0') && (pRequested[0] == L'\0'));
+}
+
+bool ResourceNameIndexSection::TryFindItem(_In_ int relativeToScope, _In_ UINT32 scopePathHash, _In_ PCWSTR path, _Out_ int* itemIndex) const
+{
+    *itemIndex = -1;
+
+    if ((m_schema == nullptr) || (m_header->numEntries == 0) || DefString_IsEmpty(path))
+    {
+        return false;
+    }
+
+    UINT32 hash = ComputePathHash(scopePathHash, path);
+    UINT32 bucket = hash % m_header->numBuckets;
+    UINT32 first = m_bucketStart[bucket];
+    UINT32 last = m_bucketStart[bucket + 1];
+
+    if ((first > last) || (last > m_header->numEntries))
+    {
+        return false;
+    }
+
+    StringResult storedName;
+    for (UINT32 i = first; i < last; i++)
+    {
+        if (m_entries[i].pathHash != hash)
+        {
+            continue;
+        }
+
+        int candidate = static_cast<int>(m_entries[i].itemIndex);
+        if (m_schema->TryGetRelativeItemName(relativeToScope, candidate, &storedName) && NamesMatch(storedName.GetRef(), path))
+        {
+            *itemIndex = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+HRESULT ResourceNameIndexSection::Init(
+    _In_ const DEFFILE_SECTION_TYPEID& sectionType,
+    _In_opt_ const IFileSectionResolver* sections,
+    _In_reads_bytes_(dataSizeInBytes) const BYTE* rawData,
+    _In_ UINT32 dataSizeInBytes)
+{
+    if (!BaseFile::SectionTypesEqual(sectionType, gResourceNameIndexSectionType))
+    {
+        return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+    }
+
+    SectionParser data;
+    RETURN_IF_FAILED(data.Set(rawData, dataSizeInBytes));
+
+    HRESULT hr = S_OK;
+    m_header = _SECTION_PARSER_NEXT(data, MRMFILE_NAME_INDEX_HEADER, &hr);
+    if (m_header == nullptr)
+    {
+        return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+    }
+
+    if ((m_header->numBuckets < 1) || (m_header->numBuckets > (dataSizeInBytes / sizeof(UINT32))))
+    {
+        return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+    }
+
+    m_bucketStart = _SECTION_PARSER_NEXT_ARRAY(data, m_header->numBuckets + 1, UINT32, &hr);
+    m_entries = _SECTION_PARSER_NEXT_ARRAY(data, m_header->numEntries, MRMFILE_NAME_INDEX_ENTRY, &hr);
+    RETURN_IF_FAILED(hr);
+
+    if ((m_bucketStart[0] != 0) || (m_bucketStart[m_header->numBuckets] != m_header->numEntries))
+    {
+        return HRESULT_FROM_WIN32(ERROR_MRM_INVALID_PRI_FILE);
+    }
+
+    if (sections != nullptr)
+    {
+        HierarchicalSchema* schema;
+        RETURN_IF_FAILED(sections->GetSchemaSection(0, m_header->schemaSectionIndex, &schema));
+        m_schema = schema;
+    }
+
+    return S_OK;
+}
+
+} // namespace Microsoft::Resources
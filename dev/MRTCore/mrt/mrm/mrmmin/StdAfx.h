@@ -16,6 +16,7 @@
 #include "mrm/common/file/MrmFiles.h"
 #include "mrm/common/MrmProfileData.h"
 #include "mrm/Checksums.h"
+#include "mrm/Compression.h"
 #include "mrm/MrmEnvironment.h"
 #include "mrm/MrmQualifiers.h"
 #include "mrm/platform/base.h"
@@ -392,6 +392,29 @@ _Use_decl_annotations_ HRESULT GetBlobResultFromStringResult(StringResult* pStri
     return S_OK;
 }
 
+_Use_decl_annotations_ HRESULT GetUtf8BlobResultFromStringResult(StringResult* pStringResult, BlobResult* pBlobResult)
+{
+    RETURN_HR_IF_NULL(E_INVALIDARG, pBlobResult);
+    RETURN_HR_IF_NULL(E_INVALIDARG, pStringResult);
+    RETURN_HR_IF_NULL(E_INVALIDARG, pStringResult->GetRef());
+
+    size_t len;
+    RETURN_IF_FAILED(pStringResult->GetLength(&len));
+
+    size_t cbUtf8;
+    PSTR pszUtf8 = nullptr;
+    RETURN_IF_FAILED(DefString_ConvertUtf16ToUtf8(pStringResult->GetRef(), len + 1, &cbUtf8, &pszUtf8));
+
+    HRESULT hr = pBlobResult->SetContents(pszUtf8, cbUtf8);
+    if (FAILED(hr))
+    {
+        _DefFree(pszUtf8);
+        return hr;
+    }
+
+    return S_OK;
+}
+
 _Use_decl_annotations_ bool StringResult::TryFindLastOf(WCHAR charToFind, size_t* pCharPos) const
 {
     __BOOL found;
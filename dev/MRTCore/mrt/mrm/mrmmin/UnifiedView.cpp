@@ -9,6 +9,42 @@ using namespace Microsoft::Resources::Build;
 namespace Microsoft::Resources
 {
 
+// Finds the lowest-numbered entry of pArray that matches, looking only at the
+// candidates that pIndex has for hash.
+template<class T, class TMatch>
+static bool TryFindIndexed(
+    _In_ const CaseInsensitiveStringIndex* pIndex,
+    _In_opt_ const DynamicArray<T>* pArray,
+    _In_ UINT32 hash,
+    _In_ TMatch matches,
+    _Out_ T* pValueOut,
+    _Out_opt_ int* pIndexOut)
+{
+    *pValueOut = nullptr;
+
+    int foundIndex = -1;
+    if (pArray != nullptr)
+    {
+        UINT cursor = 0;
+        int index;
+        while (pIndex->TryGetNext(hash, &cursor, &index))
+        {
+            T value;
+            if (((foundIndex < 0) || (index < foundIndex)) && pArray->TryGet(index, &value) && (value != nullptr) && matches(value))
+            {
+                foundIndex = index;
+                *pValueOut = value;
+            }
+        }
+    }
+
+    if (pIndexOut != nullptr)
+    {
+        *pIndexOut = foundIndex;
+    }
+    return (foundIndex >= 0);
+}
+
 class UnifiedResourceView::UnifiedViewFileInfo : public DefObject
 {
 public:
@@ -33,8 +69,12 @@ public:
         m_pView = nullptr;
 
         // we own the PriFile, if it exists.
-        delete m_pMyPri;
-        m_pMyPri = nullptr;
+        if (m_pMyPri != nullptr)
+        {
+            delete m_pMyPri;
+            m_pMyPri = nullptr;
+            m_pFile->Unpin();
+        }
 
         // file manager owns the ManagedFile
         // parent view owns the ManagedResourceMap
@@ -53,7 +93,16 @@ public:
         if ((m_pMyPri == nullptr) && (!m_bPriAttempted))
         {
             m_bPriAttempted = true;
-            RETURN_IF_FAILED(PriFile::CreateInstance(m_pFile, m_pView, (const PriFile**)&m_pMyPri));
+
+            // The PriFile holds sections of the file, so the file can't be
+            // unloaded for as long as we have it.
+            m_pFile->Pin();
+            HRESULT hr = PriFile::CreateInstance(m_pFile, m_pView, (const PriFile**)&m_pMyPri);
+            if (FAILED(hr))
+            {
+                m_pFile->Unpin();
+                return hr;
+            }
         }
         *result = m_pMyPri;
 
@@ -179,7 +228,13 @@ UnifiedResourceView::UnifiedResourceView(_In_ CoreProfile* pProfile) :
     m_pReferencedFiles(nullptr),
     m_pSchemas(nullptr),
     m_pMaps(nullptr),
-    m_pAppFile(nullptr)
+    m_pReferencedFilesByPath(nullptr),
+    m_pSchemasBySimpleId(nullptr),
+    m_pSchemasByUniqueId(nullptr),
+    m_pMapsBySimpleId(nullptr),
+    m_pMapsByUniqueId(nullptr),
+    m_pAppFile(nullptr),
+    m_generation(0)
 {}
 
 HRESULT UnifiedResourceView::Init()
@@ -190,6 +245,12 @@ HRESULT UnifiedResourceView::Init()
     RETURN_IF_FAILED(ProviderResolver::CreateInstance(m_pProfile, m_pEnvironment, m_pDecisions, &m_pResolver));
     RETURN_IF_FAILED(PriFileManager::CreateInstance(m_pEnvironment, &m_pFileManager));
 
+    RETURN_IF_FAILED(CaseInsensitiveStringIndex::CreateInstance(2, &m_pReferencedFilesByPath));
+    RETURN_IF_FAILED(CaseInsensitiveStringIndex::CreateInstance(2, &m_pSchemasBySimpleId));
+    RETURN_IF_FAILED(CaseInsensitiveStringIndex::CreateInstance(2, &m_pSchemasByUniqueId));
+    RETURN_IF_FAILED(CaseInsensitiveStringIndex::CreateInstance(2, &m_pMapsBySimpleId));
+    RETURN_IF_FAILED(CaseInsensitiveStringIndex::CreateInstance(2, &m_pMapsByUniqueId));
+
     return S_OK;
 }
 
@@ -237,6 +298,18 @@ UnifiedResourceView::~UnifiedResourceView()
         delete m_pReferencedFiles;
     }
 
+    delete m_pReferencedFilesByPath;
+    delete m_pSchemasBySimpleId;
+    delete m_pSchemasByUniqueId;
+    delete m_pMapsBySimpleId;
+    delete m_pMapsByUniqueId;
+
+    m_pReferencedFilesByPath = nullptr;
+    m_pSchemasBySimpleId = nullptr;
+    m_pSchemasByUniqueId = nullptr;
+    m_pMapsBySimpleId = nullptr;
+    m_pMapsByUniqueId = nullptr;
+
     delete m_pResolver;
     delete m_pDecisions;
     delete m_pEnvironment;
@@ -433,6 +506,102 @@ HRESULT UnifiedResourceView::GetOrAddReferencedFile(
     return S_OK;
 }
 
+// One input to LoadPriFiles that can be opened and parsed ahead of time.
+struct PreloadedPriFile : public DefObject
+{
+    NormalizedFilePath path;
+    StringResult root;
+    bool preload = false;
+    ManagedFile* pFile = nullptr;
+};
+
+struct PriFilePreloadBatch
+{
+    const PriFileManager* pManager;
+    PreloadedPriFile* pFiles;
+    LONG numFiles;
+    volatile LONG nextFile;
+    volatile LONG failed;
+};
+
+static void PreloadNextPriFiles(_Inout_ PriFilePreloadBatch* pBatch)
+{
+    // LoadPriFiles fails at the first file that can't be loaded, so once any
+    // file fails there's no point opening the rest.
+    LONG i;
+    while ((pBatch->failed == 0) && ((i = InterlockedIncrement(&pBatch->nextFile) - 1) < pBatch->numFiles))
+    {
+        PreloadedPriFile* pFile = &pBatch->pFiles[i];
+        if (pFile->preload &&
+            FAILED(ManagedFile::CreatePreloadedInstance(pBatch->pManager, &pFile->path, pFile->root.GetRef(), &pFile->pFile)))
+        {
+            InterlockedExchange(&pBatch->failed, 1);
+        }
+    }
+}
+
+static VOID CALLBACK PreloadPriFilesCallback(_Inout_ PTP_CALLBACK_INSTANCE, _Inout_opt_ PVOID pContext, _Inout_ PTP_WORK)
+{
+    PreloadNextPriFiles(static_cast<PriFilePreloadBatch*>(pContext));
+}
+
+HRESULT UnifiedResourceView::PreloadPriFiles(
+    _In_ DynamicArray<StringResult*>* pFilePathsCollection,
+    _Outptr_result_maybenull_ PreloadedPriFile** ppPreloadedFiles)
+{
+    *ppPreloadedFiles = nullptr;
+
+    UINT uiNumPriFiles = pFilePathsCollection->Count();
+    if (uiNumPriFiles < MinPriFilesToPreload)
+    {
+        return S_OK;
+    }
+
+    PreloadedPriFile* pFiles = new PreloadedPriFile[uiNumPriFiles];
+    RETURN_IF_NULL_ALLOC(pFiles);
+
+    // Only files that aren't in the view or the file manager yet need to be
+    // opened.  Anything else is left for LoadPriFiles to handle as usual.
+    for (UINT uItr = 0; uItr < uiNumPriFiles; uItr++)
+    {
+        PreloadedPriFile* pFile = &pFiles[uItr];
+        StringResult* pStrFilePath;
+        ManagedFile* pExisting;
+        if (SUCCEEDED(pFilePathsCollection->Get(uItr, &pStrFilePath)) && (pStrFilePath != nullptr) &&
+            SUCCEEDED(pFile->path.Init(pStrFilePath->GetRef())) &&
+            SUCCEEDED(ManagedFile::NormalizePackageRoot(pFile->path.GetRef(), nullptr, &pFile->root)))
+        {
+            pFile->preload = !TryFindReferencedFile(pFile->path.GetRef(), pFile->root.GetRef(), nullptr, nullptr) &&
+                             FAILED(m_pFileManager->GetFile(&pFile->path, &pExisting));
+        }
+    }
+
+    PriFilePreloadBatch batch = {m_pFileManager, pFiles, static_cast<LONG>(uiNumPriFiles), 0, 0};
+
+    // The calling thread works through the list too, so if the thread pool
+    // isn't available the files are just loaded here.
+    PTP_WORK pWork = CreateThreadpoolWork(PreloadPriFilesCallback, &batch, nullptr);
+    if (pWork != nullptr)
+    {
+        for (UINT i = 1; (i < uiNumPriFiles) && (batch.failed == 0); i++)
+        {
+            SubmitThreadpoolWork(pWork);
+        }
+    }
+
+    PreloadNextPriFiles(&batch);
+
+    if (pWork != nullptr)
+    {
+        // After a failure, callbacks that haven't started yet are cancelled.
+        WaitForThreadpoolWorkCallbacks(pWork, (batch.failed != 0));
+        CloseThreadpoolWork(pWork);
+    }
+
+    *ppPreloadedFiles = pFiles;
+    return S_OK;
+}
+
 HRESULT UnifiedResourceView::LoadPriFiles(
     _In_ MRMPROFILE_PHASE mrmProfilePhase,
     _In_ DynamicArray<StringResult*>* pFilePathsCollection,
@@ -461,6 +630,24 @@ HRESULT UnifiedResourceView::LoadPriFiles(
         pUnifiedViewFileInfoCollection = nullptr;
     });
 
+    // Open and parse the files in parallel up front.  Attaching them to the
+    // view below still happens one at a time and in input order, and any
+    // file that couldn't be preloaded is simply loaded again there, so errors
+    // are reported exactly as before.  Preloading is best effort.
+    PreloadedPriFile* pPreloadedFiles = nullptr;
+    (void)PreloadPriFiles(pFilePathsCollection, &pPreloadedFiles);
+
+    auto cleanupPreloadedFiles = wil::scope_exit([&] {
+        if (pPreloadedFiles != nullptr)
+        {
+            for (UINT uItr = 0; uItr < uiNumPriFiles; uItr++)
+            {
+                delete pPreloadedFiles[uItr].pFile;
+            }
+            delete[] pPreloadedFiles;
+        }
+    });
+
     HRESULT hr = S_OK;
     for (UINT uItr = 0; uItr < uiNumPriFiles; uItr++)
     {
@@ -479,7 +666,12 @@ HRESULT UnifiedResourceView::LoadPriFiles(
         if (!TryFindReferencedFile(path.GetRef(), root.GetRef(), &pUnifiedViewFileInfo, &nFileIndexOut))
         {
             ManagedFile* pAppFile;
-            hr = m_pFileManager->GetOrAddFile(&path, root.GetRef(), flags | LoadPriFlags::Preload, &pAppFile);
+            hr = m_pFileManager->GetOrAddFile(
+                &path,
+                root.GetRef(),
+                flags | LoadPriFlags::Preload,
+                (pPreloadedFiles != nullptr) ? &pPreloadedFiles[uItr].pFile : nullptr,
+                &pAppFile);
             if (!pAppFile)
             {
                 // Empty resourceManager and dependency package can failed to map, which is just warning.
@@ -765,20 +957,17 @@ HRESULT UnifiedResourceView::GetSchemaById(_In_ PCWSTR pSchemaId, _Out_ const IH
     *result = nullptr;
     RETURN_HR_IF(E_INVALIDARG, DefString_IsEmpty(pSchemaId));
 
-    if (m_pSchemas == nullptr)
+    ManagedSchema* pSchema;
+    if (TryFindIndexed(
+            m_pSchemasBySimpleId,
+            m_pSchemas,
+            CaseInsensitiveStringIndex::ComputeHash(pSchemaId),
+            [pSchemaId](const ManagedSchema* pHave) { return (DefString_ICompare(pHave->GetSimpleId(), pSchemaId) == Def_Equal); },
+            &pSchema,
+            nullptr))
     {
-        return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
-    }
-
-    for (int i = 0; i < m_pSchemas->Count(); i++)
-    {
-        ManagedSchema* pSchema;
-        (void)m_pSchemas->Get(i, &pSchema);
-        if ((pSchema != nullptr) && (DefString_ICompare(pSchema->GetSimpleId(), pSchemaId) == Def_Equal))
-        {
-            *result = pSchema;
-            return S_OK;
-        }
+        *result = pSchema;
+        return S_OK;
     }
     return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
 }
@@ -789,18 +978,19 @@ UnifiedResourceView::FindSchema(_In_ const HierarchicalSchemaReference* pRef, _O
     *ppSchemaOut = nullptr;
     RETURN_HR_IF_NULL(E_INVALIDARG, pRef);
 
-    if (m_pSchemas != nullptr)
+    // A compatible schema always has the same unique ID, since the ID is
+    // part of the version checksum.
+    ManagedSchema* pSchema;
+    if (TryFindIndexed(
+            m_pSchemasByUniqueId,
+            m_pSchemas,
+            CaseInsensitiveStringIndex::ComputeHash(pRef->GetUniqueId()),
+            [pRef](const ManagedSchema* pHave) { return pRef->CheckIsCompatible(pHave); },
+            &pSchema,
+            nullptr))
     {
-        for (int i = 0; i < m_pSchemas->Count(); i++)
-        {
-            ManagedSchema* pSchema;
-            (void)m_pSchemas->Get(i, &pSchema);
-            if ((pSchema != nullptr) && pRef->CheckIsCompatible(pSchema))
-            {
-                *ppSchemaOut = pSchema;
-                return S_OK;
-            }
-        }
+        *ppSchemaOut = pSchema;
+        return S_OK;
     }
 
     return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
@@ -836,22 +1026,20 @@ HRESULT UnifiedResourceView::GetResourceMapById(_In_ PCWSTR pSchemaId, _Out_ con
     *result = nullptr;
     RETURN_HR_IF(E_INVALIDARG, DefString_IsEmpty(pSchemaId));
 
-    if (m_pMaps == nullptr)
-    {
-        return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
-    }
-
-    for (int i = 0; i < m_pMaps->Count(); i++)
+    ManagedResourceMap* pMap;
+    if (TryFindIndexed(
+            m_pMapsBySimpleId,
+            m_pMaps,
+            CaseInsensitiveStringIndex::ComputeHash(pSchemaId),
+            [pSchemaId](const ManagedResourceMap* pHave) {
+                const IHierarchicalSchema* pSchema = pHave->GetSchema();
+                return ((pSchema != nullptr) && (DefString_ICompare(pSchema->GetSimpleId(), pSchemaId) == Def_Equal));
+            },
+            &pMap,
+            nullptr))
     {
-        ManagedResourceMap* pMap;
-        (void)m_pMaps->Get(i, &pMap);
-
-        const IHierarchicalSchema* pSchema = (pMap ? pMap->GetSchema() : nullptr);
-        if ((pSchema != nullptr) && (DefString_ICompare(pSchema->GetSimpleId(), pSchemaId) == Def_Equal))
-        {
-            *result = pMap;
-            return S_OK;
-        }
+        *result = pMap;
+        return S_OK;
     }
     return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
 }
@@ -869,22 +1057,23 @@ bool UnifiedResourceView::TryFindResourceMap(_In_ const HierarchicalSchemaRefere
         return false;
     }
 
-    if (m_pMaps != nullptr)
+    ManagedResourceMap* pMap;
+    if (TryFindIndexed(
+            m_pMapsByUniqueId,
+            m_pMaps,
+            CaseInsensitiveStringIndex::ComputeHash(pRef->GetUniqueId()),
+            [pRef](const ManagedResourceMap* pHave) {
+                const IHierarchicalSchema* pSchema = pHave->GetSchema();
+                return ((pSchema != nullptr) && pRef->CheckIsCompatible(pSchema));
+            },
+            &pMap,
+            nullptr))
     {
-        for (int i = 0; i < m_pMaps->Count(); i++)
+        if (ppMapOut != nullptr)
         {
-            ManagedResourceMap* pMap;
-            (void)m_pMaps->Get(i, &pMap);
-            const IHierarchicalSchema* pSchema = (pMap ? pMap->GetSchema() : nullptr);
-            if ((pSchema != nullptr) && pRef->CheckIsCompatible(pSchema))
-            {
-                if (ppMapOut != nullptr)
-                {
-                    *ppMapOut = pMap;
-                }
-                return true;
-            }
+            *ppMapOut = pMap;
         }
+        return true;
     }
 
     return false;
@@ -903,49 +1092,76 @@ bool UnifiedResourceView::TryFindReferencedFile(
         *ppFileInfoOut = nullptr;
     }
 
+    if (!TryFindIndexed(
+            m_pReferencedFilesByPath,
+            m_pReferencedFiles,
+            CaseInsensitiveStringIndex::ComputeHash(pPath),
+            [pPath, pPackageRoot](const UnifiedViewFileInfo* pHave) {
+                return (
+                    (DefString_ICompare(pPath, pHave->GetManagedFile()->GetPath()) == Def_Equal) &&
+                    ((pPackageRoot == nullptr) || (DefString_ICompare(pPackageRoot, pHave->GetManagedFile()->GetPackageRoot()) == Def_Equal)));
+            },
+            &pFileInfo,
+            pFileIndexOut))
+    {
+        return false;
+    }
+
+    // found a match!
+    if (ppFileInfoOut != nullptr)
+    {
+        *ppFileInfoOut = pFileInfo;
+    }
+    return true;
+}
+
+HRESULT UnifiedResourceView::AddReferencedFile(_In_ UnifiedViewFileInfo* pFileInfo, _Out_opt_ int* pFileIndexOut)
+{
+    if (m_pReferencedFiles == nullptr)
+    {
+        RETURN_IF_FAILED(DynamicArray<UnifiedViewFileInfo*>::CreateInstance(2, &m_pReferencedFiles));
+    }
+
+    int index;
+    RETURN_IF_FAILED(m_pReferencedFiles->Add(pFileInfo, &index));
+
+    // Index only files that made it into the list, and don't keep a file
+    // that lookups won't find.
+    HRESULT hr = m_pReferencedFilesByPath->Add(CaseInsensitiveStringIndex::ComputeHash(pFileInfo->GetManagedFile()->GetPath()), index);
+    if (FAILED(hr))
+    {
+        (void)m_pReferencedFiles->Delete(index);
+        return hr;
+    }
+
     if (pFileIndexOut != nullptr)
     {
-        *pFileIndexOut = -1;
+        *pFileIndexOut = index;
     }
 
+    m_generation++;
+    return S_OK;
+}
+
+HRESULT UnifiedResourceView::RebuildReferencedFileIndex()
+{
+    m_pReferencedFilesByPath->Reset();
+
     if (m_pReferencedFiles != nullptr)
     {
         for (int i = 0; i < m_pReferencedFiles->Count(); i++)
         {
+            UnifiedViewFileInfo* pFileInfo;
             (void)m_pReferencedFiles->Get(i, &pFileInfo);
             if (pFileInfo != nullptr)
             {
-                if (DefString_ICompare(pPath, pFileInfo->GetManagedFile()->GetPath()) == Def_Equal)
-                {
-                    if ((pPackageRoot == nullptr) ||
-                        (DefString_ICompare(pPackageRoot, pFileInfo->GetManagedFile()->GetPackageRoot()) == Def_Equal))
-                    {
-                        // found a match!
-                        if (ppFileInfoOut != nullptr)
-                        {
-                            *ppFileInfoOut = pFileInfo;
-                        }
-
-                        if (pFileIndexOut != nullptr)
-                        {
-                            *pFileIndexOut = i;
-                        }
-                        return true;
-                    }
-                }
+                RETURN_IF_FAILED(
+                    m_pReferencedFilesByPath->Add(CaseInsensitiveStringIndex::ComputeHash(pFileInfo->GetManagedFile()->GetPath()), i));
             }
         }
     }
-    return false;
-}
 
-HRESULT UnifiedResourceView::AddReferencedFile(_In_ UnifiedViewFileInfo* pFileInfo, _Out_opt_ int* pFileIndexOut)
-{
-    if (m_pReferencedFiles == nullptr)
-    {
-        RETURN_IF_FAILED(DynamicArray<UnifiedViewFileInfo*>::CreateInstance(2, &m_pReferencedFiles));
-    }
-    return m_pReferencedFiles->Add(pFileInfo, pFileIndexOut);
+    return S_OK;
 }
 
 HRESULT UnifiedResourceView::RemoveReferencedFile(_In_ UnifiedViewFileInfo* pFileInfo)
@@ -961,7 +1177,10 @@ HRESULT UnifiedResourceView::RemoveReferencedFile(_In_ UnifiedViewFileInfo* pFil
                 if (SUCCEEDED(m_pReferencedFiles->Delete(i)))
                 {
                     delete pFileInfo;
-                    return S_OK;
+                    m_generation++;
+
+                    // Later files have moved down, so their positions are stale.
+                    return RebuildReferencedFileIndex();
                 }
             }
         }
@@ -1027,7 +1246,30 @@ HRESULT UnifiedResourceView::GetOrAddManagedSchema(
 
     ManagedSchema* pNewSchema;
     RETURN_IF_FAILED(ManagedSchema::CreateInstance(pFile, pSchema, &pNewSchema));
-    RETURN_IF_FAILED(m_pSchemas->Add(pNewSchema));
+
+    // Index the schema only once it's in the list.  Lookups check every
+    // candidate, so an entry left behind by a failed second add is harmless.
+    int newIndex;
+    HRESULT hr = m_pSchemas->Add(pNewSchema, &newIndex);
+    if (SUCCEEDED(hr))
+    {
+        hr = m_pSchemasBySimpleId->Add(CaseInsensitiveStringIndex::ComputeHash(pNewSchema->GetSimpleId()), newIndex);
+        if (SUCCEEDED(hr))
+        {
+            hr = m_pSchemasByUniqueId->Add(CaseInsensitiveStringIndex::ComputeHash(pNewSchema->GetUniqueId()), newIndex);
+        }
+
+        if (FAILED(hr))
+        {
+            (void)m_pSchemas->Delete(newIndex);
+        }
+    }
+
+    if (FAILED(hr))
+    {
+        delete pNewSchema;
+        return hr;
+    }
 
     if (ppSchemaOut != nullptr)
     {
@@ -1082,6 +1324,7 @@ HRESULT UnifiedResourceView::GetOrAddManagedResourceMap(
                     {
                         *ppMapOut = pHaveMap;
                     }
+                    m_generation++;
                     return pHaveMap->NoteFileAdded(pFile, pMap);
                 }
             }
@@ -1096,7 +1339,31 @@ HRESULT UnifiedResourceView::GetOrAddManagedResourceMap(
 
     ManagedResourceMap* pNewMap;
     RETURN_IF_FAILED(ManagedResourceMap::CreateInstance(pFile, pMap, pSchema, m_pDecisions, this, &pNewMap));
-    RETURN_IF_FAILED(m_pMaps->Add(pNewMap));
+
+    // Index the map only once it's in the list.  Lookups check every
+    // candidate, so an entry left behind by a failed second add is harmless.
+    int newIndex;
+    hr = m_pMaps->Add(pNewMap, &newIndex);
+    if (SUCCEEDED(hr))
+    {
+        hr = m_pMapsBySimpleId->Add(CaseInsensitiveStringIndex::ComputeHash(pSchema->GetSimpleId()), newIndex);
+        if (SUCCEEDED(hr))
+        {
+            hr = m_pMapsByUniqueId->Add(CaseInsensitiveStringIndex::ComputeHash(pSchema->GetUniqueId()), newIndex);
+        }
+
+        if (FAILED(hr))
+        {
+            (void)m_pMaps->Delete(newIndex);
+        }
+    }
+
+    if (FAILED(hr))
+    {
+        delete pNewMap;
+        return hr;
+    }
+    m_generation++;
 
     if (ppMapOut != nullptr)
     {
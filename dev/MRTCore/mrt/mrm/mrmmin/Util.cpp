@@ -4,6 +4,14 @@
 #include "mrm/common/BaseInternal.h"
 #include "mrm/common/Base.h"
 
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define DEF_STRING_SSE2
+#elif defined(_M_ARM64)
+#include <arm64_neon.h>
+#define DEF_STRING_NEON
+#endif
+
 BOOLEAN
 DefString_IsEmpty(__in PCWSTR pSelf) { return ((!pSelf) || (!pSelf[0])); }
 
@@ -60,6 +68,65 @@ DefString_CchCompareWithOptions(__in PCWSTR pSelf, __in PCWSTR pOther, __in size
     return Def_CompareError;
 }
 
+// Upper-case mapping for every BMP code unit, built on first use.
+static WCHAR g_ordinalUpperCase[0x10000];
+static INIT_ONCE g_ordinalUpperCaseInit = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK InitOrdinalUpperCase(_Inout_ PINIT_ONCE, _Inout_opt_ PVOID, _Outptr_opt_result_maybenull_ PVOID*)
+{
+    for (UINT32 i = 0; i < ARRAYSIZE(g_ordinalUpperCase); i++)
+    {
+        g_ordinalUpperCase[i] = static_cast<WCHAR>(i);
+    }
+
+    // CompareStringOrdinal ignores case by upper-casing each code unit with
+    // the file system case table, which is what LCMapStringEx uses unless
+    // asked for linguistic casing.  Surrogates are left alone.
+    static const UINT32 ChunkSize = 256;
+    static const UINT32 TableSize = ARRAYSIZE(g_ordinalUpperCase);
+    WCHAR source[ChunkSize];
+    bool mapped = true;
+    UINT32 start = 1;
+    while (mapped && (start < TableSize))
+    {
+        UINT32 end = min(start + ChunkSize, TableSize);
+        if ((start < 0xd800) && (end > 0xd800))
+        {
+            end = 0xd800;
+        }
+
+        int cch = static_cast<int>(end - start);
+        for (int i = 0; i < cch; i++)
+        {
+            source[i] = static_cast<WCHAR>(start + i);
+        }
+        int cchMapped =
+            LCMapStringEx(LOCALE_NAME_INVARIANT, LCMAP_UPPERCASE, source, cch, &g_ordinalUpperCase[start], cch, nullptr, nullptr, 0);
+        mapped = (cchMapped == cch);
+
+        start = ((end == 0xd800) ? 0xe000 : end);
+    }
+
+    if (!mapped)
+    {
+        // Without the OS table, fold ASCII and send every character that could
+        // be equal to another one ignoring case to the same place.
+        for (UINT32 i = 0; i < ARRAYSIZE(g_ordinalUpperCase); i++)
+        {
+            WCHAR ch = static_cast<WCHAR>(((i >= L'a') && (i <= L'z')) ? (i - (L'a' - L'A')) : i);
+            g_ordinalUpperCase[i] = (((ch > 0x7f) || (ch == L'I') || (ch == L'K') || (ch == L'S')) ? 0x80 : ch);
+        }
+    }
+    return TRUE;
+}
+
+WCHAR
+DefString_ToUpperOrdinal(__in WCHAR ch)
+{
+    InitOnceExecuteOnce(&g_ordinalUpperCaseInit, InitOrdinalUpperCase, nullptr, nullptr);
+    return g_ordinalUpperCase[ch];
+}
+
 BOOLEAN
 DefString_IsPrefixWithOptions(__in PCWSTR pPrefix, __in PCWSTR pString, __in DEFCOMPAREOPTIONS options)
 {
@@ -165,96 +232,235 @@ DefString_IsSuffixWithOptions(__in PCWSTR pSuffix, __in PCWSTR pString, __in DEF
 
 #define UNICODE_MAX_CODEPOINT 0x10FFFF
 
-// Returns the encoding that results in the smallest needed buffer. Accounts for NULL terminator.
-// If ASCII is possible it picks ASCII over UTF8 because it is easier to decode.
-// If UTF8 and UTF16 produce the exact same size, it picks UTF16 because that is the encoding we use publicly.
-
-// This function has no error model. If an invalid code point is passed in, it returns UTF-16.
-// Why? Because we pass UTF-16 through without transformation (meaning invalid code points won't produce a break),
-// and we cannot block on invalid code points because we didn't do this in the past and want to avoid changing behavior.
-
-// This function is hand-rolled because it sits at a point in the stack where we cannot call many helpers.// This function is hand-rolled because it sits at a point in the stack where we cannot call many helpers,
-// and the helpers it can call (eg, RtlUTF8ToUnicodeN) are not available downlevel.
+// Returns the encoding that results in the smallest needed buffer.  See DefString_ChooseBestEncodingWithSizes.
 DEFSTRING_ENCODING
 DefString_ChooseBestEncoding(_In_ PCWSTR pszStringUtf16)
 {
-    PCWSTR pszRemainingStringUtf16 = pszStringUtf16;
-    size_t cbStringUtf16;
-    size_t cbStringUtf8 = 1; // 1 to account for the single-byte NULL terminator.
-    BOOL fAllAscii = TRUE;
+    size_t cchStringUtf16;
+    size_t cbStringUtf8;
+    return DefString_ChooseBestEncodingWithSizes(pszStringUtf16, &cchStringUtf16, &cbStringUtf8);
+}
+
+// Widening and UTF-8 decoding for strings stored in a compact encoding.  These
+// run on every load of such a string, so runs of ASCII are handled a vector at
+// a time: 16 bytes with SSE2 or NEON, or 32 with AVX2 where the processor has it.
 
-    while (pszRemainingStringUtf16[0] != L'\0')
+#if defined(DEF_STRING_SSE2)
+
+static BOOLEAN _DefString_HasAvx2()
+{
+    // AVX2, and an OS that saves the YMM registers.
+    int info[4];
+    __cpuid(info, 1);
+    if (((info[2] & (1 << 27)) == 0) || ((info[2] & (1 << 28)) == 0) || ((_xgetbv(0) & 6) != 6))
     {
+        return FALSE;
+    }
+
+    __cpuidex(info, 7, 0);
+    return ((info[1] & (1 << 5)) != 0);
+}
 
-        UINT32 firstCodeUnitOfCurrentCharacter = (UINT32)pszRemainingStringUtf16[0];
+static size_t _DefString_WidenBytesAvx2(_In_reads_(cb) const BYTE* pIn, _In_ size_t cb, _Out_writes_(cb) WCHAR* pOut)
+{
+    size_t i = 0;
+    for (; (cb - i) >= 32; i += 32)
+    {
+        __m256i lo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(pIn + i)));
+        __m256i hi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(pIn + i + 16)));
+        _mm256_storeu_si256((__m256i*)(pOut + i), lo);
+        _mm256_storeu_si256((__m256i*)(pOut + i + 16), hi);
+    }
+    _mm256_zeroupper();
+    return i;
+}
 
-        // See if it is in the basic multilingual plane.
-        if (firstCodeUnitOfCurrentCharacter <= UTF16_BMP_FIRST_BATCH_END || firstCodeUnitOfCurrentCharacter >= UTF16_BMP_SECOND_BATCH_START)
+static size_t _DefString_WidenAsciiRunAvx2(_In_reads_(cb) const BYTE* pIn, _In_ size_t cb, _Out_writes_opt_(cb) WCHAR* pOut)
+{
+    size_t i = 0;
+    for (; (cb - i) >= 32; i += 32)
+    {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)(pIn + i));
+        if (_mm256_movemask_epi8(bytes) != 0)
         {
-            // It's a two byte UTF-16 character. Move string up one character.
-            pszRemainingStringUtf16++;
-
-            // Next we have to determine if it is a single, double, triple-byte UTF-8 character.
-            if (firstCodeUnitOfCurrentCharacter <= UTF8_ONE_BYTE_BOUNDARY)
-            {
-                // Single-byte UTF-8 strings are more efficiently encoded in ASCII, so leave fAllAscii as true;
-                cbStringUtf8++;
-            }
-            else if (firstCodeUnitOfCurrentCharacter <= UTF8_TWO_BYTE_BOUNDARY)
-            {
-                // We cannot encode characters above 127 as ASCII so disallow ASCII for the entire string.
-                fAllAscii = FALSE;
-                cbStringUtf8 += 2;
-            }
-            else
-            {
-                fAllAscii = FALSE;
-                cbStringUtf8 += 3;
-            }
+            break;
         }
-        else if (
-            firstCodeUnitOfCurrentCharacter >= UTF_16_LEAD_SURROGATE_MIN_VALUE &&
-            firstCodeUnitOfCurrentCharacter <= UTF_16_LEAD_SURROGATE_MAX_VALUE)
+
+        if (pOut != nullptr)
         {
-            // It's a four-byte UTF-8 and UTF-16 character.
-            UINT32 secondCodeUnitOfCurrentCharacter = (UINT32)pszRemainingStringUtf16[1];
-            if (secondCodeUnitOfCurrentCharacter < UTF_16_TRAIL_SURROGATE_MIN_VALUE ||
-                secondCodeUnitOfCurrentCharacter > UTF_16_TRAIL_SURROGATE_MAX_VALUE)
-            {
-                // This is an invalid code point. Return UTF-16 to ensure the string is passed through the pipeline without processing.
-                return DEFSTRING_ENCODING_UTF16;
-            }
+            _mm256_storeu_si256((__m256i*)(pOut + i), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes)));
+            _mm256_storeu_si256((__m256i*)(pOut + i + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1)));
+        }
+    }
+    _mm256_zeroupper();
+    return i;
+}
 
-            pszRemainingStringUtf16 += 2;
+#endif
 
-            fAllAscii = FALSE;
-            cbStringUtf8 += 4;
+// Widens every byte to a UTF-16 code unit.
+static void _DefString_WidenBytes(_In_reads_(cb) const BYTE* pIn, _In_ size_t cb, _Out_writes_(cb) WCHAR* pOut)
+{
+    size_t i = 0;
+
+#if defined(DEF_STRING_SSE2)
+    static const BOOLEAN hasAvx2 = _DefString_HasAvx2();
+    if (hasAvx2)
+    {
+        i = _DefString_WidenBytesAvx2(pIn, cb, pOut);
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    for (; (cb - i) >= 16; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(pIn + i));
+        _mm_storeu_si128((__m128i*)(pOut + i), _mm_unpacklo_epi8(bytes, zero));
+        _mm_storeu_si128((__m128i*)(pOut + i + 8), _mm_unpackhi_epi8(bytes, zero));
+    }
+#elif defined(DEF_STRING_NEON)
+    for (; (cb - i) >= 16; i += 16)
+    {
+        uint8x16_t bytes = vld1q_u8(pIn + i);
+        vst1q_u16((uint16_t*)(pOut + i), vmovl_u8(vget_low_u8(bytes)));
+        vst1q_u16((uint16_t*)(pOut + i + 8), vmovl_high_u8(bytes));
+    }
+#endif
+
+    for (; i < cb; i++)
+    {
+        pOut[i] = pIn[i];
+    }
+}
+
+// Finds the run of ASCII bytes at the start of pIn and, if pOut is supplied,
+// widens it into pOut.  Returns the length of the run.
+static size_t _DefString_WidenAsciiRun(_In_reads_(cb) const BYTE* pIn, _In_ size_t cb, _Out_writes_opt_(cb) WCHAR* pOut)
+{
+    size_t i = 0;
+
+#if defined(DEF_STRING_SSE2)
+    static const BOOLEAN hasAvx2 = _DefString_HasAvx2();
+    if (hasAvx2)
+    {
+        i = _DefString_WidenAsciiRunAvx2(pIn, cb, pOut);
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    for (; (cb - i) >= 16; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(pIn + i));
+        if (_mm_movemask_epi8(bytes) != 0)
+        {
+            break;
         }
-        else
+
+        if (pOut != nullptr)
         {
-            // This is an invalid code point. Return UTF-16 to ensure the string is passed through the pipeline without processing.
-            return DEFSTRING_ENCODING_UTF16;
+            _mm_storeu_si128((__m128i*)(pOut + i), _mm_unpacklo_epi8(bytes, zero));
+            _mm_storeu_si128((__m128i*)(pOut + i + 8), _mm_unpackhi_epi8(bytes, zero));
         }
     }
+#elif defined(DEF_STRING_NEON)
+    for (; (cb - i) >= 16; i += 16)
+    {
+        uint8x16_t bytes = vld1q_u8(pIn + i);
+        if (vmaxvq_u8(bytes) > ASCII_BOUNDARY)
+        {
+            break;
+        }
 
-    // + 1 to account for the NULL terminator.
-    cbStringUtf16 = (pszRemainingStringUtf16 - pszStringUtf16 + 1) * sizeof(pszStringUtf16[0]);
+        if (pOut != nullptr)
+        {
+            vst1q_u16((uint16_t*)(pOut + i), vmovl_u8(vget_low_u8(bytes)));
+            vst1q_u16((uint16_t*)(pOut + i + 8), vmovl_high_u8(bytes));
+        }
+    }
+#else
+    for (; (cb - i) >= 8; i += 8)
+    {
+        UINT64 bytes;
+        memcpy(&bytes, pIn + i, sizeof(bytes));
+        if ((bytes & 0x8080808080808080ULL) != 0)
+        {
+            break;
+        }
 
-    if (fAllAscii)
+        if (pOut != nullptr)
+        {
+            for (size_t j = 0; j < 8; j++)
+            {
+                pOut[i + j] = pIn[i + j];
+            }
+        }
+    }
+#endif
+
+    for (; (i < cb) && (pIn[i] <= ASCII_BOUNDARY); i++)
     {
+        if (pOut != nullptr)
+        {
+            pOut[i] = pIn[i];
+        }
+    }
 
-        return DEFSTRING_ENCODING_ASCII;
+    return i;
+}
+
+// Decodes one multi-byte UTF-8 sequence.  Only well-formed sequences (Unicode
+// table 3-7) are accepted, like MultiByteToWideChar with MB_ERR_INVALID_CHARS:
+// no overlong forms, surrogates, values above U+10FFFF or truncated sequences.
+// Returns the length of the sequence, or 0 if it's ill-formed.
+static size_t _DefString_DecodeUtf8Sequence(_In_reads_(cb) const BYTE* pIn, _In_ size_t cb, _Out_ UINT32* pCodePoint)
+{
+    *pCodePoint = 0;
+
+    BYTE lead = pIn[0];
+    size_t length;
+    BYTE minSecond = 0x80;
+    BYTE maxSecond = 0xbf;
+    UINT32 codePoint;
+
+    if ((lead >= 0xc2) && (lead <= 0xdf))
+    {
+        length = 2;
+        codePoint = (lead & 0x1f);
     }
-    else if (cbStringUtf16 <= cbStringUtf8)
+    else if ((lead >= 0xe0) && (lead <= 0xef))
     {
-        // If the strings are equal in size return UTF16 since it's easier to decode.
-        return DEFSTRING_ENCODING_UTF16;
+        length = 3;
+        minSecond = ((lead == 0xe0) ? 0xa0 : 0x80);
+        maxSecond = ((lead == 0xed) ? 0x9f : 0xbf);
+        codePoint = (lead & 0x0f);
+    }
+    else if ((lead >= 0xf0) && (lead <= 0xf4))
+    {
+        length = 4;
+        minSecond = ((lead == 0xf0) ? 0x90 : 0x80);
+        maxSecond = ((lead == 0xf4) ? 0x8f : 0xbf);
+        codePoint = (lead & 0x07);
     }
     else
     {
+        return 0;
+    }
 
-        return DEFSTRING_ENCODING_UTF8;
+    if ((cb < length) || (pIn[1] < minSecond) || (pIn[1] > maxSecond))
+    {
+        return 0;
     }
+
+    codePoint = ((codePoint << 6) | (pIn[1] & 0x3f));
+    for (size_t i = 2; i < length; i++)
+    {
+        if ((pIn[i] & 0xc0) != 0x80)
+        {
+            return 0;
+        }
+        codePoint = ((codePoint << 6) | (pIn[i] & 0x3f));
+    }
+
+    *pCodePoint = codePoint;
+    return length;
 }
 
 // Converts an ASCII encoded string into a UTF-16-encoded one.
@@ -280,38 +486,60 @@ DefString_ConvertAsciiToUtf16(
         return E_OUTOFMEMORY;
     }
 
-    for (size_t i = 0; i < cchStringAsciiIncludingNull; i++)
-    {
+    const BYTE* pBytes = reinterpret_cast<const BYTE*>(pszStringAscii);
 
-        // Since we control who creates these strings we don't test for them being ASCII here for performance reasons.
-        // Even if they are not, they will convert up cleanly if they are ANSI and will convert into garbage but won't
-        // produce a failure if they are UTF-8 or garbage to begin with. We will never read over the end of the buffer
-        // or do other truly bad things so the extra check is not worth it.
-        // We still do the check on debug builds to catch any potential violations of the "is always ASCII in the PRI file"
-        // invariant or other bugs.
+    // Since we control who creates these strings we don't test for them being ASCII here for performance reasons.
+    // Even if they are not, they will convert up cleanly if they are ANSI and will convert into garbage but won't
+    // produce a failure if they are UTF-8 or garbage to begin with. We will never read over the end of the buffer
+    // or do other truly bad things so the extra check is not worth it.
+    // We still do the check on debug builds to catch any potential violations of the "is always ASCII in the PRI file"
+    // invariant or other bugs.
 
 #ifdef DBG
-
-        if (((unsigned char)pszStringAscii[i]) > ASCII_BOUNDARY)
-        {
-
-            _DefFree(pszRet);
-            return E_INVALIDARG;
-        }
+    if (_DefString_WidenAsciiRun(pBytes, cchStringAsciiIncludingNull, nullptr) != cchStringAsciiIncludingNull)
+    {
+        _DefFree(pszRet);
+        return E_INVALIDARG;
+    }
 #endif
 
-        // Even though this compiles without the cast, the cast is critical to avoid the compiler doing sign extension
-        // when the string isn't ASCII.
-        pszRet[i] = (unsigned char)(pszStringAscii[i]);
-    }
+    // Bytes are zero-extended, never sign-extended, when the string isn't ASCII.
+    _DefString_WidenBytes(pBytes, cchStringAsciiIncludingNull, pszRet);
 
     *result = pszRet;
 
     return S_OK;
 }
 
+// Returns TRUE if the bytes are well-formed UTF-8, accepting exactly what DefString_ConvertUtf8ToUtf16 does.
+BOOLEAN DefString_IsValidUtf8(_In_reads_bytes_(cbString) PCSTR pszString, _In_ size_t cbString)
+{
+    const BYTE* pBytes = reinterpret_cast<const BYTE*>(pszString);
+
+    for (size_t i = 0; i < cbString;)
+    {
+        if (pBytes[i] <= ASCII_BOUNDARY)
+        {
+            i += _DefString_WidenAsciiRun(&pBytes[i], cbString - i, nullptr);
+            continue;
+        }
+
+        UINT32 codePoint;
+        size_t cbSequence = _DefString_DecodeUtf8Sequence(&pBytes[i], cbString - i, &codePoint);
+        if (cbSequence == 0)
+        {
+            return FALSE;
+        }
+        i += cbSequence;
+    }
+
+    return TRUE;
+}
+
 // Converts an UTF-8 encoded string into a UTF-16-encoded one.
 // Returns NULL on failure.
+// Accepts and rejects exactly what MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS) does,
+// failing with ERROR_NO_UNICODE_TRANSLATION for ill-formed input.
 HRESULT
 DefString_ConvertUtf8ToUtf16(
     _In_reads_bytes_(cbStringUtf8IncludingNull) PCSTR pszStringUtf8,
@@ -325,11 +553,29 @@ DefString_ConvertUtf8ToUtf16(
 
     *cchStringUtf16IncludingNull = 0;
 
-    int cchStringUtf16IncludingNullLocal =
-        MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, pszStringUtf8, (int)cbStringUtf8IncludingNull, nullptr, 0);
-    if (cchStringUtf16IncludingNullLocal == 0)
+    const BYTE* pBytes = reinterpret_cast<const BYTE*>(pszStringUtf8);
+    size_t cbBytes = cbStringUtf8IncludingNull;
+
+    // Validate and measure, then decode.  Both passes skip through ASCII a vector at a time.
+    size_t cchStringUtf16IncludingNullLocal = 0;
+    for (size_t i = 0; i < cbBytes;)
     {
-        return HRESULT_FROM_WIN32(GetLastError());
+        if (pBytes[i] <= ASCII_BOUNDARY)
+        {
+            size_t cchRun = _DefString_WidenAsciiRun(&pBytes[i], cbBytes - i, nullptr);
+            i += cchRun;
+            cchStringUtf16IncludingNullLocal += cchRun;
+            continue;
+        }
+
+        UINT32 codePoint;
+        size_t cbSequence = _DefString_DecodeUtf8Sequence(&pBytes[i], cbBytes - i, &codePoint);
+        if (cbSequence == 0)
+        {
+            return HRESULT_FROM_WIN32(ERROR_NO_UNICODE_TRANSLATION);
+        }
+        i += cbSequence;
+        cchStringUtf16IncludingNullLocal += ((codePoint > UTF8_THREE_BYTE_BOUNDARY) ? 2 : 1);
     }
 
     PWSTR pszRet = _DefArray_Alloc(WCHAR, cchStringUtf16IncludingNullLocal);
@@ -338,13 +584,31 @@ DefString_ConvertUtf8ToUtf16(
         return E_OUTOFMEMORY;
     }
 
-    cchStringUtf16IncludingNullLocal = MultiByteToWideChar(
-        CP_UTF8, MB_ERR_INVALID_CHARS, pszStringUtf8, (int)cbStringUtf8IncludingNull, pszRet, cchStringUtf16IncludingNullLocal);
-    if (cchStringUtf16IncludingNullLocal == 0)
+    PWSTR pOut = pszRet;
+    for (size_t i = 0; i < cbBytes;)
     {
-        _DefFree(pszRet);
-        return HRESULT_FROM_WIN32(GetLastError());
+        if (pBytes[i] <= ASCII_BOUNDARY)
+        {
+            size_t cchRun = _DefString_WidenAsciiRun(&pBytes[i], cbBytes - i, pOut);
+            i += cchRun;
+            pOut += cchRun;
+            continue;
+        }
+
+        UINT32 codePoint;
+        i += _DefString_DecodeUtf8Sequence(&pBytes[i], cbBytes - i, &codePoint);
+        if (codePoint > UTF8_THREE_BYTE_BOUNDARY)
+        {
+            codePoint -= UTF_16_SUPPLEMENTARY_PLANES_START;
+            *pOut++ = static_cast<WCHAR>(UTF_16_LEAD_SURROGATE_MIN_VALUE + (codePoint >> 10));
+            *pOut++ = static_cast<WCHAR>(UTF_16_TRAIL_SURROGATE_MIN_VALUE + (codePoint & 0x3ff));
+        }
+        else
+        {
+            *pOut++ = static_cast<WCHAR>(codePoint);
+        }
     }
+    DEF_ASSERT(static_cast<size_t>(pOut - pszRet) == cchStringUtf16IncludingNullLocal);
 
     *cchStringUtf16IncludingNull = cchStringUtf16IncludingNullLocal;
 
@@ -352,6 +616,364 @@ DefString_ConvertUtf8ToUtf16(
     return S_OK;
 }
 
+// Reads one code point from a UTF-16 string.  Returns the number of UTF-16 chars
+// consumed, or 0 for an unpaired surrogate.
+static size_t _DefString_DecodeUtf16Sequence(_In_reads_(cchIn) PCWSTR pIn, _In_ size_t cchIn, _Out_ UINT32* pCodePoint)
+{
+    *pCodePoint = pIn[0];
+
+    if ((pIn[0] < UTF_16_LEAD_SURROGATE_MIN_VALUE) || (pIn[0] > UTF_16_TRAIL_SURROGATE_MAX_VALUE))
+    {
+        return 1;
+    }
+
+    if ((pIn[0] > UTF_16_LEAD_SURROGATE_MAX_VALUE) || (cchIn < 2) || (pIn[1] < UTF_16_TRAIL_SURROGATE_MIN_VALUE) ||
+        (pIn[1] > UTF_16_TRAIL_SURROGATE_MAX_VALUE))
+    {
+        return 0;
+    }
+
+    *pCodePoint = UTF_16_SUPPLEMENTARY_PLANES_START + (((pIn[0] - UTF_16_LEAD_SURROGATE_MIN_VALUE) << 10) |
+                                                       (pIn[1] - UTF_16_TRAIL_SURROGATE_MIN_VALUE));
+    return 2;
+}
+
+// Measuring and narrowing for strings being written in a compact encoding.  The
+// builder runs these on every string it stores, so they also work a vector at a time.
+
+#if defined(DEF_STRING_SSE2)
+
+// Measures aligned blocks of 8 chars up to the first block holding a nul or a
+// surrogate.  Adds their UTF-8 size to *pcbUtf8 and returns the number of chars measured.
+// Aligned loads never cross a page, so reading the rest of the block past the nul is safe.
+static size_t _DefString_MeasureUtf8Run(_In_ const WCHAR* pIn, _Inout_ size_t* pcbUtf8)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i oneByteMax = _mm_set1_epi16(UTF8_ONE_BYTE_BOUNDARY);
+    const __m128i twoByteMax = _mm_set1_epi16(UTF8_TWO_BYTE_BOUNDARY);
+    const __m128i surrogateMin = _mm_set1_epi16(static_cast<short>(UTF_16_LEAD_SURROGATE_MIN_VALUE));
+    const __m128i surrogateSpan = _mm_set1_epi16(UTF_16_TRAIL_SURROGATE_MAX_VALUE - UTF_16_LEAD_SURROGATE_MIN_VALUE);
+
+    // Every char is counted as 3 bytes, less a byte for each one below U+0800 and another below U+0080.
+    __m128i shortfall = zero;
+    size_t i = 0;
+    for (;; i += 8)
+    {
+        __m128i chars = _mm_load_si128((const __m128i*)(pIn + i));
+        __m128i isNull = _mm_cmpeq_epi16(chars, zero);
+        __m128i isSurrogate = _mm_cmpeq_epi16(_mm_subs_epu16(_mm_sub_epi16(chars, surrogateMin), surrogateSpan), zero);
+        if (_mm_movemask_epi8(_mm_or_si128(isNull, isSurrogate)) != 0)
+        {
+            break;
+        }
+
+        __m128i isOneByte = _mm_cmpeq_epi16(_mm_subs_epu16(chars, oneByteMax), zero);
+        __m128i isUpToTwoBytes = _mm_cmpeq_epi16(_mm_subs_epu16(chars, twoByteMax), zero);
+        __m128i fewer = _mm_sub_epi16(zero, _mm_add_epi16(isOneByte, isUpToTwoBytes));
+        shortfall = _mm_add_epi64(shortfall, _mm_sad_epu8(fewer, zero));
+    }
+
+    size_t cbShortfall = static_cast<UINT32>(_mm_cvtsi128_si32(shortfall)) + static_cast<UINT32>(_mm_cvtsi128_si32(_mm_srli_si128(shortfall, 8)));
+    *pcbUtf8 += (i * 3) - cbShortfall;
+    return i;
+}
+
+#elif defined(DEF_STRING_NEON)
+
+// Measures aligned blocks of 8 chars up to the first block holding a nul or a
+// surrogate.  Adds their UTF-8 size to *pcbUtf8 and returns the number of chars measured.
+// Aligned loads never cross a page, so reading the rest of the block past the nul is safe.
+static size_t _DefString_MeasureUtf8Run(_In_ const WCHAR* pIn, _Inout_ size_t* pcbUtf8)
+{
+    const uint16x8_t one = vdupq_n_u16(1);
+    const uint16x8_t oneByteMax = vdupq_n_u16(UTF8_ONE_BYTE_BOUNDARY);
+    const uint16x8_t twoByteMax = vdupq_n_u16(UTF8_TWO_BYTE_BOUNDARY);
+    const uint16x8_t surrogateMin = vdupq_n_u16(UTF_16_LEAD_SURROGATE_MIN_VALUE);
+    const uint16x8_t surrogateSpan = vdupq_n_u16(UTF_16_TRAIL_SURROGATE_MAX_VALUE - UTF_16_LEAD_SURROGATE_MIN_VALUE);
+
+    size_t cbUtf8 = 0;
+    size_t i = 0;
+    for (;; i += 8)
+    {
+        uint16x8_t chars = vld1q_u16((const uint16_t*)(pIn + i));
+        uint16x8_t isSurrogate = vcleq_u16(vsubq_u16(chars, surrogateMin), surrogateSpan);
+        if ((vminvq_u16(chars) == 0) || (vmaxvq_u16(isSurrogate) != 0))
+        {
+            break;
+        }
+
+        // The compares are all ones where true, so subtracting them adds one.
+        uint16x8_t bytes = vsubq_u16(vsubq_u16(one, vcgtq_u16(chars, oneByteMax)), vcgtq_u16(chars, twoByteMax));
+        cbUtf8 += vaddvq_u16(bytes);
+    }
+
+    *pcbUtf8 += cbUtf8;
+    return i;
+}
+
+#endif
+
+// Narrows the run of ASCII chars at the start of pIn into pOut.  Returns the length of the run.
+static size_t _DefString_NarrowAsciiRun(_In_reads_(cch) const WCHAR* pIn, _In_ size_t cch, _Out_writes_(cch) BYTE* pOut)
+{
+    size_t i = 0;
+
+#if defined(DEF_STRING_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i asciiMax = _mm_set1_epi16(ASCII_BOUNDARY);
+    for (; (cch - i) >= 16; i += 16)
+    {
+        __m128i lo = _mm_loadu_si128((const __m128i*)(pIn + i));
+        __m128i hi = _mm_loadu_si128((const __m128i*)(pIn + i + 8));
+        __m128i above = _mm_or_si128(_mm_subs_epu16(lo, asciiMax), _mm_subs_epu16(hi, asciiMax));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(above, zero)) != 0xffff)
+        {
+            break;
+        }
+        _mm_storeu_si128((__m128i*)(pOut + i), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(DEF_STRING_NEON)
+    for (; (cch - i) >= 16; i += 16)
+    {
+        uint16x8_t lo = vld1q_u16((const uint16_t*)(pIn + i));
+        uint16x8_t hi = vld1q_u16((const uint16_t*)(pIn + i + 8));
+        if (vmaxvq_u16(vmaxq_u16(lo, hi)) > ASCII_BOUNDARY)
+        {
+            break;
+        }
+        vst1q_u8(pOut + i, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+    }
+#endif
+
+    for (; (i < cch) && (pIn[i] <= ASCII_BOUNDARY); i++)
+    {
+        pOut[i] = static_cast<BYTE>(pIn[i]);
+    }
+
+    return i;
+}
+
+// Returns the encoding that results in the smallest needed buffer. Accounts for NULL terminator.
+// If ASCII is possible it picks ASCII over UTF8 because it is easier to decode.
+// If UTF8 and UTF16 produce the exact same size, it picks UTF16 because that is the encoding we use publicly.
+// Also returns the size of the string in UTF-16 chars and, unless it holds an invalid code point, in UTF-8
+// bytes, so callers can encode it without measuring it again.  ASCII strings are the same size in either.
+
+// This function has no error model. If an invalid code point is passed in, it returns UTF-16.
+// Why? Because we pass UTF-16 through without transformation (meaning invalid code points won't produce a break),
+// and we cannot block on invalid code points because we didn't do this in the past and want to avoid changing behavior.
+
+// This function is hand-rolled because it sits at a point in the stack where we cannot call many helpers,
+// and the helpers it can call (eg, RtlUTF8ToUnicodeN) are not available downlevel.
+DEFSTRING_ENCODING
+DefString_ChooseBestEncodingWithSizes(
+    _In_ PCWSTR pszStringUtf16,
+    _Out_ size_t* cchStringUtf16IncludingNull,
+    _Out_ size_t* cbStringUtf8IncludingNull)
+{
+    size_t i = 0;
+    size_t cbStringUtf8 = 1; // 1 to account for the single-byte NULL terminator.
+
+    for (;;)
+    {
+#if defined(DEF_STRING_SSE2) || defined(DEF_STRING_NEON)
+        if ((reinterpret_cast<UINT_PTR>(&pszStringUtf16[i]) & 15) == 0)
+        {
+            i += _DefString_MeasureUtf8Run(&pszStringUtf16[i], &cbStringUtf8);
+        }
+#endif
+
+        UINT32 firstCodeUnitOfCurrentCharacter = pszStringUtf16[i];
+        if (firstCodeUnitOfCurrentCharacter == L'\0')
+        {
+            break;
+        }
+
+        if (firstCodeUnitOfCurrentCharacter <= UTF8_ONE_BYTE_BOUNDARY)
+        {
+            cbStringUtf8++;
+            i++;
+        }
+        else if (firstCodeUnitOfCurrentCharacter <= UTF8_TWO_BYTE_BOUNDARY)
+        {
+            cbStringUtf8 += 2;
+            i++;
+        }
+        else if (
+            (firstCodeUnitOfCurrentCharacter <= UTF16_BMP_FIRST_BATCH_END) ||
+            (firstCodeUnitOfCurrentCharacter >= UTF16_BMP_SECOND_BATCH_START))
+        {
+            cbStringUtf8 += 3;
+            i++;
+        }
+        else if (
+            (firstCodeUnitOfCurrentCharacter <= UTF_16_LEAD_SURROGATE_MAX_VALUE) &&
+            (pszStringUtf16[i + 1] >= UTF_16_TRAIL_SURROGATE_MIN_VALUE) && (pszStringUtf16[i + 1] <= UTF_16_TRAIL_SURROGATE_MAX_VALUE))
+        {
+            // It's a four-byte UTF-8 and UTF-16 character.
+            cbStringUtf8 += 4;
+            i += 2;
+        }
+        else
+        {
+            // This is an invalid code point. Return UTF-16 to ensure the string is passed through the pipeline without processing.
+            *cchStringUtf16IncludingNull = i + wcslen(&pszStringUtf16[i]) + 1;
+            *cbStringUtf8IncludingNull = 0;
+            return DEFSTRING_ENCODING_UTF16;
+        }
+    }
+
+    // + 1 to account for the NULL terminator.
+    *cchStringUtf16IncludingNull = i + 1;
+    *cbStringUtf8IncludingNull = cbStringUtf8;
+
+    if (cbStringUtf8 == (i + 1))
+    {
+        // Only ASCII characters take a single UTF-8 byte per UTF-16 char.
+        return DEFSTRING_ENCODING_ASCII;
+    }
+    else if (((i + 1) * sizeof(WCHAR)) <= cbStringUtf8)
+    {
+        // If the strings are equal in size return UTF16 since it's easier to decode.
+        return DEFSTRING_ENCODING_UTF16;
+    }
+    else
+    {
+        return DEFSTRING_ENCODING_UTF8;
+    }
+}
+
+// Encodes a UTF-16 string as UTF-8 into a caller-supplied buffer, in one pass.  Sized with
+// DefString_ChooseBestEncodingWithSizes, the buffer is filled exactly.  ASCII strings come out as ASCII.
+HRESULT
+DefString_EncodeUtf16AsUtf8(
+    _In_reads_(cchStringUtf16IncludingNull) PCWSTR pszStringUtf16,
+    _In_ size_t cchStringUtf16IncludingNull,
+    _Out_writes_bytes_to_(cbBuffer, *cbWrittenIncludingNull) PSTR pBuffer,
+    _In_ size_t cbBuffer,
+    _Out_ size_t* cbWrittenIncludingNull)
+{
+    *cbWrittenIncludingNull = 0;
+
+    BYTE* pOut = reinterpret_cast<BYTE*>(pBuffer);
+    size_t cbOut = 0;
+    for (size_t i = 0; i < cchStringUtf16IncludingNull;)
+    {
+        if (pszStringUtf16[i] <= ASCII_BOUNDARY)
+        {
+            size_t cchRun = _DefString_NarrowAsciiRun(&pszStringUtf16[i], min(cchStringUtf16IncludingNull - i, cbBuffer - cbOut), &pOut[cbOut]);
+            if (cchRun == 0)
+            {
+                return HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
+            }
+            i += cchRun;
+            cbOut += cchRun;
+            continue;
+        }
+
+        UINT32 codePoint;
+        size_t cchSequence = _DefString_DecodeUtf16Sequence(&pszStringUtf16[i], cchStringUtf16IncludingNull - i, &codePoint);
+        if (cchSequence == 0)
+        {
+            return HRESULT_FROM_WIN32(ERROR_NO_UNICODE_TRANSLATION);
+        }
+        i += cchSequence;
+
+        size_t cbSequence = ((codePoint <= UTF8_TWO_BYTE_BOUNDARY) ? 2 : ((codePoint <= UTF8_THREE_BYTE_BOUNDARY) ? 3 : 4));
+        if ((cbBuffer - cbOut) < cbSequence)
+        {
+            return HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
+        }
+
+        switch (cbSequence)
+        {
+        case 2:
+            pOut[cbOut++] = static_cast<BYTE>(0xc0 | (codePoint >> 6));
+            break;
+        case 3:
+            pOut[cbOut++] = static_cast<BYTE>(0xe0 | (codePoint >> 12));
+            pOut[cbOut++] = static_cast<BYTE>(0x80 | ((codePoint >> 6) & 0x3f));
+            break;
+        default:
+            pOut[cbOut++] = static_cast<BYTE>(0xf0 | (codePoint >> 18));
+            pOut[cbOut++] = static_cast<BYTE>(0x80 | ((codePoint >> 12) & 0x3f));
+            pOut[cbOut++] = static_cast<BYTE>(0x80 | ((codePoint >> 6) & 0x3f));
+            break;
+        }
+        pOut[cbOut++] = static_cast<BYTE>(0x80 | (codePoint & 0x3f));
+    }
+
+    *cbWrittenIncludingNull = cbOut;
+    return S_OK;
+}
+
+// Converts a UTF-16 encoded string into a UTF-8-encoded one.
+// Accepts and rejects exactly what WideCharToMultiByte(CP_UTF8, WC_ERR_INVALID_CHARS) does,
+// failing with ERROR_NO_UNICODE_TRANSLATION for unpaired surrogates.
+HRESULT
+DefString_ConvertUtf16ToUtf8(
+    _In_reads_(cchStringUtf16IncludingNull) PCWSTR pszStringUtf16,
+    _Pre_satisfies_(cchStringUtf16IncludingNull > 0) size_t cchStringUtf16IncludingNull,
+    _Out_ size_t* cbStringUtf8IncludingNull,
+    _Outptr_ PSTR* result)
+{
+    *result = nullptr;
+
+    DEF_ASSERT(cchStringUtf16IncludingNull > 0);
+
+    *cbStringUtf8IncludingNull = 0;
+
+    // Validate and measure, then encode.
+    size_t cbStringUtf8IncludingNullLocal = 0;
+    for (size_t i = 0; i < cchStringUtf16IncludingNull;)
+    {
+        UINT32 codePoint;
+        size_t cchSequence = _DefString_DecodeUtf16Sequence(&pszStringUtf16[i], cchStringUtf16IncludingNull - i, &codePoint);
+        if (cchSequence == 0)
+        {
+            return HRESULT_FROM_WIN32(ERROR_NO_UNICODE_TRANSLATION);
+        }
+        i += cchSequence;
+
+        if (codePoint <= UTF8_ONE_BYTE_BOUNDARY)
+        {
+            cbStringUtf8IncludingNullLocal += 1;
+        }
+        else if (codePoint <= UTF8_TWO_BYTE_BOUNDARY)
+        {
+            cbStringUtf8IncludingNullLocal += 2;
+        }
+        else if (codePoint <= UTF8_THREE_BYTE_BOUNDARY)
+        {
+            cbStringUtf8IncludingNullLocal += 3;
+        }
+        else
+        {
+            cbStringUtf8IncludingNullLocal += 4;
+        }
+    }
+
+    PSTR pszRet = _DefArray_Alloc(CHAR, cbStringUtf8IncludingNullLocal);
+    if (pszRet == nullptr)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    size_t cbWritten;
+    HRESULT hr = DefString_EncodeUtf16AsUtf8(pszStringUtf16, cchStringUtf16IncludingNull, pszRet, cbStringUtf8IncludingNullLocal, &cbWritten);
+    if (FAILED(hr))
+    {
+        _DefFree(pszRet);
+        return hr;
+    }
+    DEF_ASSERT(cbWritten == cbStringUtf8IncludingNullLocal);
+
+    *cbStringUtf8IncludingNull = cbStringUtf8IncludingNullLocal;
+
+    *result = pszRet;
+    return S_OK;
+}
+
 DEFCOMPARISON
 DefBlob_Compare(__in const void* pSelf, __in const void* pOther, __in size_t cbCmp)
 {